@@ -2,6 +2,41 @@
 //! @brief Simulator node for turtlebot.
 // Parameters:
 //    rate: int - frequency of simulation timer updates (hz)
+//    time_mode: string - how simulation time advances.
+//      wall - physics and sensors run on wall timers, no /clock.
+//      fast - step as fast as the CPU allows, publishing /clock. Throughput
+//      only, consumers run asynchronously so their results depend on scheduling.
+//      lockstep - publish /clock, and only step once every consumer acknowledged
+//      the encoder data of the last step on ~/step_ack. Repeatable with a fixed
+//      seed while no step times out.
+//    lockstep_consumers: int - number of different consumers each lockstep step
+//    waits for
+//    lockstep_timeout: double - wall seconds a lockstep step waits before stepping anyway
+//    seed: int - seed of the counter based noise, 0 seeds from the random device
+//    fake_sensor_rate, laser_rate: double - sample rate of the sensor (hz)
+//    fake_sensor_phase, laser_phase: double - offset of the samples from the
+//    start of the simulation (s)
+//    fake_sensor_latency, laser_latency: double - delay from taking a sample to
+//    publishing it, the stamp stays at the sample time (s)
+//    record_log: string - file to record ground truth poses, wheel commands,
+//    encoders and sensor readings to (see turtlelib::SimLogWriter), empty (default) for none
+//    replay_log: string - sim log to publish instead of simulating, empty
+//    (default) to simulate. It must hold the same robots.
+//    replay_rate: double - log seconds replayed per wall second, 0 for as fast as possible
+//    encoder_batch: int - physics steps of encoder samples per sensor_data_batch
+//    message, 0 (default) publishes one sensor_data per step instead
+//    sensor_threads: int - threads sampling the sensors from world snapshots in
+//    wall time_mode, 0 samples them on the executor between physics steps
+//    rollout_threads: int - threads running the candidates of a ~/rollout call,
+//    beside the executor, 0 (default) for every core
+//    trace: bool - record the nusim.step and nusim.robot trace points of every
+//    physics step, and nusim.tick in wall time_mode (see turtlelib/trace.hpp),
+//    default false
+//    trace_file: string - file the trace is written to at shutdown, read with
+//    turtlelib's trace_format. Empty (default) writes none.
+//    load_shed_max_level: int - highest level of work shed when physics and
+//    the sensors overrun the update period in wall time_mode (see
+//    turtlelib::LoadShedder), default 3. 0 never sheds.
 // Parameters for robot itself
 //    motor_cmd_max: int - max motor cmd value
 //    motor_cmd_per_rad_sec: double - ratio between motor cmd and rad/sec
@@ -11,14 +46,30 @@
 //    collision_radius: double - collision radius of robot (used to simulate
 //    simple collision)
 // parameter of the simulated world
-//    x0: double - Initial x position
-//    y0: double - Initial y position
-//    theta0: double - Initial theta position
+//    robots: vector<string> - namespaces of the simulated robots, empty (default)
+//    for the single robot red
+//    x0: double - Initial x position (single robot)
+//    y0: double - Initial y position (single robot)
+//    theta0: double - Initial theta position (single robot)
+//    robots/x0, robots/y0, robots/theta0: vector<double> - initial pose of
+//    each of the robots
 //    arena_x_length: double - x length of arena
 //    arena_y_length: double - y length of arena
 //    obstacles/x: vector<double> - List of obstical's x coordinates
 //    obstacles/y: vector<double> - List of obstical's y coordinates
-//    obstacles/r: double - obstacle's radius, all obstacle share this radius
+//    obstacles/r: double - obstacle's radius, shared by obstacles without their own
+//    obstacles/radii: vector<double> - radius of each obstacle, empty (default)
+//    gives every obstacle obstacles/r
+//    obstacle_grid_cell: double - cell size of the grid indexing obstacles and
+//    walls for the laser, collision and fake sensor (m)
+//    world_map: string - floor plan replacing the arena walls, a segment file
+//    (see turtlelib::LoadSegmentWorld) or a .pgm occupancy image. Empty for the arena.
+//    world_map_resolution: double - meters per pixel of a .pgm world_map
+//    world_map_origin_x, world_map_origin_y: double - world position of the
+//    lower left corner of a .pgm world_map
+//    world_file: string - binary world from turtlelib's world_convert, its
+//    obstacles, walls and grid replace the obstacles/ params, the arena and
+//    obstacle_grid_cell. Empty (default) for none.
 // Noise in robot's motion
 //    input_noise: double - motor cmd noise, applied to how robot move (and
 //    tracked) slip_fraction: double - wheel slippage, affect the encoder
@@ -30,48 +81,100 @@
 //
 // Publishers:
 //   /nusim/obstacles: visualization_msgs/msg/MarkerArray
-//   /nusim/timestep: std_msgs/msg/UInt64
+//   /nusim/timestep: std_msgs/msg/UInt64 - after the data of the step, in
+//   lockstep after every event at the time of the step
 //   /nusim/walls: visualization_msgs/msg/MarkerArray
 //   /parameter_events: rcl_interfaces/msg/ParameterEvent
-//   /fake_sensor: visualization_msgs::msg::MarkerArray
+//   /fake_sensor: visualization_msgs::msg::MarkerArray (<robot>/fake_sensor with robots)
+//   <robot>/sensor_data: nuturtlebot_msgs/msg/SensorData (encoder_batch 0 only)
+//   <robot>/sensor_data_batch: nuturtle_control/msg/SensorDataBatch (encoder_batch above 0)
+//   <robot>/path: nav_msgs/msg/Path
 //   ~/wall: visualization_msgs::msg::MarkerArray
 //   ~/obstacles: visualization_msgs::msg::MarkerArray
+//   ~/laser_scan: sensor_msgs/msg/LaserScan (<robot>/laser_scan with robots)
 //   /tf: tf2_msgs/msg/TFMessage
+//   /clock: rosgraph_msgs/msg/Clock (fast and lockstep time_mode only)
+//   <robot>/wheel_cmd: nuturtlebot_msgs/msg/WheelCommands (replay only)
+//   /diagnostics: diagnostic_msgs/msg/DiagnosticArray - load shedding level and
+//   tick deadlines, once a second and on every level change (wall time_mode only)
+//
+// Subscriber:
+//   <robot>/wheel_cmd: nuturtlebot_msgs/msg/WheelCommands (not when replaying)
+//   <robot>/wheel_cmd_batch: nuturtle_control/msg/WheelCommandsBatch - commands
+//   applied at the first physics step at or after their stamp (not when replaying)
+//   ~/step_ack: nuturtle_control/msg/StepAck - a consumer handled the data up to
+//   the stamp (lockstep only)
 //
 // Service Servers:
 //   /nusim/reset: std_srvs/srv/Empty
 //   /nusim/teleport: nusim/srv/Teleport
+//   /nusim/rollout: nusim/srv/Rollout - candidate commands rolled forward from
+//   a snapshot of the simulation (not when replaying), answered once they ran
 
 #include <cstddef>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <diagnostic_msgs/msg/diagnostic_status.hpp>
+#include <diagnostic_msgs/msg/key_value.hpp>
 #include <rclcpp/parameter_value.hpp>
 #include <rclcpp/subscription.hpp>
 #include <rmw/qos_profiles.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_ros/transform_broadcaster.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <deque>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <geometry_msgs/msg/point.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <nuturtle_control/msg/sensor_data_batch.hpp>
+#include <nuturtle_control/msg/step_ack.hpp>
+#include <nuturtle_control/msg/wheel_commands_batch.hpp>
 #include <nuturtlebot_msgs/msg/sensor_data.hpp>
 #include <nuturtlebot_msgs/msg/wheel_commands.hpp>
 #include <optional>
 #include <random>
 #include <rclcpp/qos.hpp>
 #include <rclcpp/rclcpp.hpp>
+#include <rosgraph_msgs/msg/clock.hpp>
+#include <sstream>
 #include <std_msgs/msg/string.hpp>
 #include <std_msgs/msg/u_int64.hpp>
 #include <std_srvs/srv/empty.hpp>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <turtlelib/batch_sim.hpp>
 #include <turtlelib/diff_drive.hpp>
+#include <turtlelib/event_scheduler.hpp>
 #include <turtlelib/geometry2d.hpp>
+#include <turtlelib/laser_sim.hpp>
+#include <turtlelib/load_shedder.hpp>
+#include <turtlelib/noise.hpp>
 #include <turtlelib/se2d.hpp>
+#include <turtlelib/sim_log.hpp>
+#include <turtlelib/sweep_and_prune.hpp>
+#include <turtlelib/swept_circle.hpp>
+#include <turtlelib/trace.hpp>
+#include <turtlelib/triple_buffer.hpp>
+#include <turtlelib/uniform_grid.hpp>
+#include <turtlelib/worker_pool.hpp>
+#include <turtlelib/world_file.hpp>
+#include <turtlelib/world_map.hpp>
+#include <utility>
 #include <vector>
 #include <visualization_msgs/msg/marker.hpp>
 #include <visualization_msgs/msg/marker_array.hpp>
 
+#include "nusim/srv/rollout.hpp"
 #include "nusim/srv/teleport.hpp"
 #include <nav_msgs/msg/path.hpp>
 
@@ -82,8 +185,15 @@
 
 namespace {
 
-std::random_device rd{};
-std::mt19937 rand_eng{rd()};
+//! @brief The noise seed, a random one for seed 0.
+uint64_t ResolveSeed(int seed) {
+  if (seed != 0) {
+    return static_cast<uint64_t>(seed);
+  }
+  std::random_device rd{};
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
 auto get_transient_local_qos() {
   auto profile = rmw_qos_profile_default;
   profile.durability = rmw_qos_durability_policy_e::RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL;
@@ -95,28 +205,29 @@ auto get_transient_local_qos() {
 }
 auto transient_local_qos = get_transient_local_qos();
 
+//! @brief Cylindrical obstacles, one array per field. Index k is obstacle k
+//! everywhere, including its marker ids.
+struct Obstacles {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> r;
+
+  size_t size() const { return x.size(); }
+};
+
 // markers generated from here missing: header, id, action,
-std::vector<visualization_msgs::msg::Marker> GenObstacles(std::vector<double> x_s,
-                                                          std::vector<double> y_s, double radius) {
-  std::vector<visualization_msgs::msg::Marker> out;
-
-  for (size_t i = 0; i < x_s.size(); ++i) {
-
-    visualization_msgs::msg::Marker obstacle_marker;
-    obstacle_marker.type = obstacle_marker.CYLINDER;
-    obstacle_marker.scale.x = radius * 2;
-    obstacle_marker.scale.y = radius * 2;
-    obstacle_marker.scale.z = 0.25;
-    obstacle_marker.pose.position.x = x_s.at(i);
-    obstacle_marker.pose.position.y = y_s.at(i);
-    obstacle_marker.pose.position.z = 0.25 / 2;
-    obstacle_marker.color.r = 1.0;
-    obstacle_marker.color.a = 0.8;
-
-    // If the center offset is a thing, try to calculate a new xy.
-    out.push_back(obstacle_marker); // P_world_obs
-  }
-  return out;
+visualization_msgs::msg::Marker ObstacleMarker(double x, double y, double radius) {
+  visualization_msgs::msg::Marker obstacle_marker;
+  obstacle_marker.type = obstacle_marker.CYLINDER;
+  obstacle_marker.scale.x = radius * 2;
+  obstacle_marker.scale.y = radius * 2;
+  obstacle_marker.scale.z = 0.25;
+  obstacle_marker.pose.position.x = x;
+  obstacle_marker.pose.position.y = y;
+  obstacle_marker.pose.position.z = 0.25 / 2;
+  obstacle_marker.color.r = 1.0;
+  obstacle_marker.color.a = 0.8;
+  return obstacle_marker;
 }
 
 struct LaserParam {
@@ -128,19 +239,63 @@ struct LaserParam {
   double noise_level;
 };
 
-std::vector<std::pair<turtlelib::Point2D, turtlelib::Point2D>> ArenaCorners(double x_len,
-                                                                            double y_len) {
-  //
-  return {
-      {{x_len / 2, y_len / 2}, {-x_len / 2, y_len / 2}},   // right
-      {{-x_len / 2, y_len / 2}, {-x_len / 2, -y_len / 2}}, // btm
-      {{-x_len / 2, -y_len / 2}, {x_len / 2, -y_len / 2}}, // left
-      {{x_len / 2, -y_len / 2}, {x_len / 2, y_len / 2}}    // top
-  };
-}
+//! @brief Other robots as circles, a world for LaserSim::Cast.
+struct RobotCircles {
+  const std::vector<double> &x;
+  const std::vector<double> &y;
+  double radius;
+  // The robots to cast against, by index into x and y.
+  const std::vector<size_t> &robots;
+
+  double Raycast(turtlelib::Point2D origin, turtlelib::Vector2D direction,
+                 double range_max) const {
+    double nearest = std::numeric_limits<double>::infinity();
+    for (const size_t k : robots) {
+      nearest = std::min(nearest,
+                         turtlelib::RayCircleDistance(origin, direction, {x[k], y[k]}, radius));
+    }
+    return nearest <= range_max ? nearest : std::numeric_limits<double>::infinity();
+  }
+};
+
+//! @brief What the sensors see of one moment of the simulation. Physics
+//! writes one after every step, sensors only ever read these. The obstacles
+//! and walls never change once nusim is up, so a snapshot only holds the robots.
+struct WorldSnapshot {
+  //! @brief sim time of the state
+  std::chrono::nanoseconds time{0};
+  uint64_t step = 0;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> theta;
+
+  turtlelib::Transform2D Pose(size_t robot) const {
+    return {{x[robot], y[robot]}, theta[robot]};
+  }
+};
 
 const std::string kWorldFrame = "nusim/world";
-const std::string kSimRobotBaseFrameID = "red/base_footprint";
+const std::string kDefaultRobot = "red";
+
+//! @brief How the simulation clock advances.
+enum class TimeMode {
+  kWall,     // Wall timers, the ROS clock is left alone
+  kFast,     // Step as fast as possible, publish /clock
+  kLockstep, // Step after every consumer acknowledged, publish /clock
+};
+
+TimeMode ParseTimeMode(const std::string &mode) {
+  if (mode == "wall") {
+    return TimeMode::kWall;
+  }
+  if (mode == "fast") {
+    return TimeMode::kFast;
+  }
+  if (mode == "lockstep") {
+    return TimeMode::kLockstep;
+  }
+  throw std::invalid_argument("time_mode must be one of wall, fast or lockstep, got " + mode);
+}
 
 } // namespace
 
@@ -155,9 +310,6 @@ public:
         // Ros related params
         update_period(std::chrono::milliseconds(
             1000 / GetParam<int>(*this, "rate", "The rate of simulator", 200))),
-        x0(GetParam<double>(*this, "x0", "inital robot x location")),
-        y0(GetParam<double>(*this, "y0", "inital robot y location")),
-        theta0(GetParam<double>(*this, "theta0", "initial robot theta")),
         motor_cmd_max(GetParam<int>(*this, "motor_cmd_max", "radius of wheel")),
         motor_cmd_per_rad_sec(GetParam<double>(*this, "motor_cmd_per_rad_sec",
                                                "motor cmd per rad/s (actually the inverse)")),
@@ -165,30 +317,11 @@ public:
             GetParam<double>(*this, "encoder_ticks_per_rad", "encoder_ticks_per_rad")),
             collision_radius(
             GetParam<double>(*this, "collision_radius", "collision radius of the robot")),
-
-        red_bot(turtlelib::DiffDrive{
-            GetParam<double>(*this, "track_width", "robot center to wheel-track distance"),
-            GetParam<double>(*this, "wheel_radius", "wheel radius"),
-            turtlelib::Transform2D{{x0, y0}, theta0}}),
-        obstacles_r(GetParam<double>(*this, "obstacles/r", "obstacle radius")),
-
-
-        // This is quite a crazy hack. Using trinary statement and lambda to do it inside initializer
-        // So we can do const on this object.
-        static_obstacles(
-            (GetParam<std::vector<double>>(*this, "obstacles/x", "list of obstacle's x coord")
-                 .size() ==
-             GetParam<std::vector<double>>(*this, "obstacles/y", "list of obstacle's y coord")
-                 .size())
-                ? GenObstacles(get_parameter("obstacles/x").get_value<std::vector<double>>(),
-                               get_parameter("obstacles/y").get_value<std::vector<double>>(),
-                               get_parameter("obstacles/r").get_value<double>())
-                : [&](){
-                  RCLCPP_ERROR(get_logger(), "Mismatch obstacle x y numbers");
-                  throw;
-                  return std::vector<visualization_msgs::msg::Marker>{};
-                  }()),
-        arena_corners(ArenaCorners(GetParam<double>(*this, "arena_x_length", "x length of arena", 5.0),GetParam<double>(*this, "arena_y_length", "x length of arena", 3.0))),
+        robots_(LoadRobots()),
+        robot_r_(robots_.size(), collision_radius),
+        world_file_(LoadWorldFile()),
+        obstacles_(LoadObstacles()),
+        arena_walls(LoadWalls()),
 
         // Simulation only params
         input_noise(GetParam<double>(*this, "input_noise",
@@ -214,38 +347,128 @@ public:
         GetParam<double>(*this, "laser_noise_level",
                                        "nose level of laser measurement.", 0),
         }),
+        laser_sims_(robots_.size(), MakeLaserSim()),
+        seed_(ResolveSeed(GetParam<int>(*this, "seed", "noise seed, 0 for random", 0))),
+        sim_(robots_.size(), MotionParams()),
         // Member variable, not param
-        input_gauss_distribution(0.0, input_noise),
-        wheel_uniform_distribution(-slip_fraction, slip_fraction),
-        basic_sensor_gauss_distribution(
-            0.0, GetParam<double>(*this, "basic_sensor_variance",
-                                  "variance of noise in basic sensor's reading.", 0))
+        noise_(seed_),
+        basic_sensor_variance(GetParam<double>(*this, "basic_sensor_variance",
+                                               "variance of noise in basic sensor's reading.", 0)),
+        time_mode_(ParseTimeMode(
+            GetParam<std::string>(*this, "time_mode", "wall, fast or lockstep", "wall"))),
+        encoder_batch_(static_cast<size_t>(std::max(
+            0, GetParam<int>(*this, "encoder_batch",
+                             "encoder samples per sensor_data_batch, 0 for sensor_data", 0))))
 
   {
+    // All noise is a function of the seed, so a sim time run with the same
+    // seed repeats exactly.
+    RCLCPP_INFO_STREAM(get_logger(), "Noise seed " << seed_);
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      sim_.SetPose(i, robots_[i].initial_pose);
+    }
+
     // Uncomment this to turn on debug level and enable debug statements
     // rcutils_logging_set_logger_level(get_logger().get_name(),
     // RCUTILS_LOG_SEVERITY_DEBUG);
+    // Each physics step goes to trace points instead of the debug log, off
+    // they cost a branch.
+    if (GetParam<bool>(*this, "trace", "record the trace points of every physics step", false)) {
+      turtlelib::SetTraceMask(kTraceSim);
+    }
+    trace_file_ =
+        GetParam<std::string>(*this, "trace_file", "file the trace is written to at shutdown", "");
+
+    // Arena wall stuff, unless a floor plan replaces the arena.
+    const auto world_map = GetParam<std::string>(
+        *this, "world_map", "segment file or .pgm image of the world, empty for the arena", "");
+    const bool pgm_map =
+        world_map.size() >= 4 && world_map.compare(world_map.size() - 4, 4, ".pgm") == 0;
+    if (world_file_ && !world_map.empty()) {
+      throw std::invalid_argument("world_file and world_map both replace the arena, set one");
+    }
+    if (world_file_) {
+      RCLCPP_INFO_STREAM(get_logger(), "World file with " << obstacles_.size() << " obstacles and "
+                                                          << arena_walls.size() << " walls");
+      PublishMapWalls();
+    } else if (world_map.empty()) {
+      const double arena_x_length = get_parameter("arena_x_length").get_value<double>();
+      const double arena_y_length = get_parameter("arena_y_length").get_value<double>();
+      // It's a lot more code to change if I change it to use corner pair lists
+      PublishArenaWalls(arena_x_length, arena_y_length);
+    } else if (pgm_map) {
+      occupancy_map_.emplace(turtlelib::LoadPgmMap(
+          world_map,
+          GetParam<double>(*this, "world_map_resolution", "meters per pixel of the map", 0.05),
+          {GetParam<double>(*this, "world_map_origin_x", "x of the map's lower left corner", 0.0),
+           GetParam<double>(*this, "world_map_origin_y", "y of the map's lower left corner",
+                            0.0)}));
+      PublishMapWalls();
+    } else {
+      segment_map_.emplace(turtlelib::LoadSegmentWorld(world_map));
+      PublishMapWalls();
+    }
 
-    // Arena wall stuff
-    const double arena_x_length = get_parameter("arena_x_length").get_value<double>();
-    const double arena_y_length = get_parameter("arena_y_length").get_value<double>();
-    // It's a lot more code to change if I change it to use corner pair lists
-    PublishArenaWalls(arena_x_length, arena_y_length);
-
-    PublishStaticObstacles(static_obstacles);
+    PublishStaticObstacles();
+    if (world_file_) {
+      // Built by world_convert, the grid is read from the mapped file as it is.
+      obstacle_grid_.emplace(world_file_->View());
+    } else {
+      // A floor plan has its own structure for the laser, the grid only gets the arena.
+      obstacle_grid_.emplace(obstacles_.x, obstacles_.y, obstacles_.r,
+                             world_map.empty() ? arena_walls : std::vector<turtlelib::Segment2D>{},
+                             GetParam<double>(*this, "obstacle_grid_cell",
+                                              "cell size of the obstacle grid (m)", 0.5));
+    }
 
     // Setup pub/sub
     time_step_publisher_ = create_publisher<std_msgs::msg::UInt64>("~/timestep", 10);
-    red_sensor_publisher_ =
-        create_publisher<nuturtlebot_msgs::msg::SensorData>("red/sensor_data", 10);
-    fake_sensor_publisher_ =
-        create_publisher<visualization_msgs::msg::MarkerArray>("/fake_sensor", 10);
-    path_publisher_ = create_publisher<nav_msgs::msg::Path>("red/path", 10);
-    sim_laser_publisher_ = create_publisher<sensor_msgs::msg::LaserScan>("~/laser_scan", 10);
     tf_broadcaster_ = std::make_unique<tf2_ros::TransformBroadcaster>(*this);
+    // A lone robot keeps the sensor topics it had before there could be several.
+    const bool single_robot = get_parameter("robots").get_value<std::vector<std::string>>().empty();
+    const auto replay_log = GetParam<std::string>(
+        *this, "replay_log", "sim log to publish instead of simulating, empty to simulate", "");
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      auto &robot = robots_[i];
+      robot.sensor_publisher =
+          create_publisher<nuturtlebot_msgs::msg::SensorData>(robot.name + "/sensor_data", 10);
+      robot.fake_sensor_publisher = create_publisher<visualization_msgs::msg::MarkerArray>(
+          single_robot ? "/fake_sensor" : robot.name + "/fake_sensor", 10);
+      robot.path_publisher = create_publisher<nav_msgs::msg::Path>(robot.name + "/path", 10);
+      if (encoder_batch_ > 0) {
+        robot.sensor_batch_publisher = create_publisher<nuturtle_control::msg::SensorDataBatch>(
+            robot.name + "/sensor_data_batch", 10);
+      }
+      robot.laser_publisher = create_publisher<sensor_msgs::msg::LaserScan>(
+          single_robot ? "~/laser_scan" : robot.name + "/laser_scan", 10);
+      if (replay_log.empty()) {
+        robot.wheel_cmd_listener = create_subscription<nuturtlebot_msgs::msg::WheelCommands>(
+            robot.name + "/wheel_cmd", 10,
+            [this, i](const nuturtlebot_msgs::msg::WheelCommands &msg) { WheelCmdCb(i, msg); });
+        robot.wheel_cmd_batch_listener =
+            create_subscription<nuturtle_control::msg::WheelCommandsBatch>(
+                robot.name + "/wheel_cmd_batch", 10,
+                [this, i](const nuturtle_control::msg::WheelCommandsBatch &msg) {
+                  WheelCmdBatchCb(i, msg);
+                });
+      } else {
+        robot.wheel_cmd_publisher = create_publisher<nuturtlebot_msgs::msg::WheelCommands>(
+            robot.name + "/wheel_cmd", 10);
+      }
 
-    wheel_cmd_listener_ = create_subscription<nuturtlebot_msgs::msg::WheelCommands>(
-        "red/wheel_cmd", 10, std::bind(&NuSim::WheelCmdCb, this, std::placeholders::_1));
+      // Everything but the stamp and the ranges is the same for every scan.
+      auto &laser_msg = robot.laser_msg;
+      laser_msg.header.frame_id = robot.base_frame;
+      laser_msg.angle_min = 0;
+      laser_msg.angle_increment = sim_laser_param.angle_increment;
+      // This assume angle_max is inclusive
+      laser_msg.angle_max =
+          (sim_laser_param.number_of_sample - 1) * sim_laser_param.angle_increment;
+      laser_msg.time_increment = 0;
+      laser_msg.scan_time = 0;
+      laser_msg.range_min = sim_laser_param.range_min;
+      laser_msg.range_max = sim_laser_param.range_max;
+    }
 
     // Setup srv/client
     reset_service_ = create_service<std_srvs::srv::Empty>(
@@ -255,337 +478,934 @@ public:
         "~/teleport",
         std::bind(&NuSim::teleport_callback, this, std::placeholders::_1, std::placeholders::_2));
 
-    // Setup timer and set things in motion.
-    main_timer_ = this->create_wall_timer(update_period, std::bind(&NuSim::MainTimerStep, this));
-    // 5HZ update rate
-    fake_sensor_timer_ = this->create_wall_timer(std::chrono::milliseconds{200},
-                                                 std::bind(&NuSim::FakeSensorTimerStep, this));
+    if (!replay_log.empty()) {
+      StartReplay(replay_log);
+      return;
+    }
+    const auto record_log = GetParam<std::string>(
+        *this, "record_log", "file to record the simulation to, empty for none", "");
+    if (!record_log.empty()) {
+      std::vector<std::string> names;
+      for (const auto &robot : robots_) {
+        names.push_back(robot.name);
+      }
+      sim_log_.emplace(record_log, names);
+      RCLCPP_INFO_STREAM(get_logger(), "Recording the simulation to " << record_log);
+    }
+
+    rollout_threads_ = static_cast<size_t>(std::max(
+        0, GetParam<int>(*this, "rollout_threads",
+                         "threads running the candidates of a rollout, 0 for every core", 0)));
+    // Responds from a rollout thread once the candidates are done, not from
+    // the callback.
+    rollout_service_ = create_service<nusim::srv::Rollout>(
+        "~/rollout",
+        std::bind(&NuSim::rollout_callback, this, std::placeholders::_1, std::placeholders::_2));
+
+    // Sensors only read the world snapshots physics publishes after each step,
+    // so a sensor never sees a robot half way through a physics step. In wall
+    // time_mode they run on their own threads with their own scheduler, and a
+    // costly scan can't hold up the physics timer. The sim time modes keep
+    // every event on one scheduler, so a run with the same seed repeats exactly.
+    const int sensor_threads = GetParam<int>(
+        *this, "sensor_threads", "threads sampling the sensors in wall time_mode", 2);
+    if (time_mode_ == TimeMode::kWall && sensor_threads > 0) {
+      // The executor only submits and never joins in, so one worker per thread.
+      sensor_pool_.emplace(static_cast<size_t>(sensor_threads) + 1);
+    }
+    // Physics is the first stream of scheduler_, so its step at time 0
+    // publishes the first snapshot before any sensor samples.
+    scheduler_.AddStream({update_period}, [this](std::chrono::nanoseconds) { PhysicsStep(); });
+    AddSensorStream<visualization_msgs::msg::MarkerArray>(
+        "fake_sensor",
+        [this](size_t robot, const WorldSnapshot &world, std::chrono::nanoseconds time)
+            -> const auto & { return SampleFakeSensor(robot, world, time); },
+        &Robot::fake_sensor_publisher, &Robot::pending_fake_sensor, true);
     if (sim_laser_param.number_of_sample > 0) {
-      sim_laser_timer_ = this->create_wall_timer(std::chrono::milliseconds{200},
-                                                 std::bind(&NuSim::SimLaserTimerStep, this));
+      AddSensorStream<sensor_msgs::msg::LaserScan>(
+          "laser",
+          [this](size_t robot, const WorldSnapshot &world, std::chrono::nanoseconds time)
+              -> const auto & { return SampleLaser(robot, world, time); },
+          &Robot::laser_publisher, &Robot::pending_laser);
     } else {
       RCLCPP_WARN_STREAM(get_logger(),
                          "Requested 0 samples in sim laser ! will not publish this at all");
     }
+
+    // Setup timer and set things in motion.
+    if (time_mode_ == TimeMode::kWall) {
+      // Sim time follows the wall clock, polled finely enough that events run
+      // within a tick of when they are due.
+      wall_start_ = std::chrono::steady_clock::now();
+      wall_start_stamp_ = get_clock()->now();
+      step_timer_ = this->create_wall_timer(kWallTick, std::bind(&NuSim::WallTick, this));
+      // Only wall time has a deadline, sim time waits for the slowest work.
+      turtlelib::LoadShedParams shed_params;
+      shed_params.budget = update_period;
+      shed_params.max_level = static_cast<size_t>(std::max(
+          0, GetParam<int>(*this, "load_shed_max_level",
+                           "highest level of work shed on overrun, 0 never sheds", 3)));
+      load_shedder_.emplace(shed_params);
+      diagnostics_publisher_ =
+          create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+      diagnostics_timer_ =
+          create_wall_timer(std::chrono::seconds{1}, std::bind(&NuSim::PublishDiagnostics, this));
+      return;
+    }
+
+    // Sim time: nusim owns the clock, everyone else runs with use_sim_time.
+    clock_publisher_ = create_publisher<rosgraph_msgs::msg::Clock>("/clock", 10);
+    if (time_mode_ == TimeMode::kFast) {
+      // A zero period timer fires on every spin, so the sim steps as fast as
+      // the executor can turn around, while still serving wheel commands and
+      // services between steps.
+      step_timer_ = this->create_wall_timer(std::chrono::nanoseconds{0},
+                                            std::bind(&NuSim::RunNextEvents, this));
+      return;
+    }
+    lockstep_consumers_ = static_cast<uint64_t>(std::max(
+        1, GetParam<int>(*this, "lockstep_consumers", "consumers each lockstep step waits for",
+                         1)));
+    const double lockstep_timeout = GetParam<double>(
+        *this, "lockstep_timeout", "wall seconds to wait for acknowledgements", 1.0);
+    step_ack_listener_ = create_subscription<nuturtle_control::msg::StepAck>(
+        "~/step_ack", 100, std::bind(&NuSim::StepAckCb, this, std::placeholders::_1));
+    // Steps are driven by the acknowledgements, this timer only kicks off the
+    // first step and keeps the sim going when a consumer stalls or dies.
+    step_timer_ = this->create_wall_timer(
+        std::chrono::duration<double>(lockstep_timeout), [this]() {
+          if (time_step_ == last_watchdog_step_) {
+            if (time_step_ != 0) {
+              RCLCPP_WARN_STREAM(get_logger(), "Lockstep timed out on step "
+                                                   << time_step_ << " with "
+                                                   << LockstepAcks()
+                                                   << "/" << lockstep_consumers_ << " acks");
+            }
+            LockstepStep();
+          }
+          last_watchdog_step_ = time_step_;
+        });
+  }
+
+  //! @brief Write the trace out at shutdown, when trace_file is set.
+  ~NuSim() override {
+    if (trace_file_.empty()) {
+      return;
+    }
+    try {
+      const size_t count = turtlelib::DumpTrace(trace_file_);
+      RCLCPP_INFO_STREAM(get_logger(), "Wrote " << count << " trace records to " << trace_file_);
+    } catch (const std::runtime_error &error) {
+      RCLCPP_ERROR_STREAM(get_logger(), error.what());
+    }
   }
 
 private:
+  //! @brief Scratch of a laser cast, one per robot or rollout casting at a time.
+  struct LaserScratch {
+    std::vector<size_t> robots;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> r;
+  };
+
+  //! @brief Scratch of a physics step, one per copy of the physics stepping at a time.
+  struct PhysicsScratch {
+    // Where each robot started the step, and whether it hit something.
+    std::vector<turtlelib::Transform2D> step_start;
+    std::vector<uint8_t> contact;
+    // What a robot can hit during a step.
+    turtlelib::SweepShapes sweep_shapes;
+    std::vector<size_t> nearby_obstacles;
+    std::vector<size_t> nearby_segments;
+    std::vector<turtlelib::Segment2D> nearby_map_edges;
+    std::vector<size_t> pushed_robots;
+    turtlelib::SweepAndPrune broad_phase;
+    std::vector<std::pair<size_t, size_t>> robot_pairs;
+  };
+
+  //! @brief All a rollout needs of the simulation at one moment: the physics
+  //! of every robot, with where each is in its noise stream, and the sim time
+  //! of the physics step it is the state after. Taken on the executor, so a
+  //! rollout running beside it never reads the live simulation. The world never
+  //! changes, so forks share it instead of copying it.
+  struct SimSnapshot {
+    std::chrono::nanoseconds time{0};
+    turtlelib::BatchSimState physics;
+    turtlelib::BatchSimParams params;
+  };
+
+  //! @brief ROS side and sensor state of one simulated robot. How it moves is
+  //! in sim_, at the same index.
+  struct Robot {
+    std::string name;
+    std::string base_frame;
+    turtlelib::Transform2D initial_pose;
+    std::deque<geometry_msgs::msg::PoseStamped> path_history;
+
+    rclcpp::Publisher<nuturtlebot_msgs::msg::SensorData>::SharedPtr sensor_publisher;
+    rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr fake_sensor_publisher;
+    rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr path_publisher;
+    rclcpp::Publisher<sensor_msgs::msg::LaserScan>::SharedPtr laser_publisher;
+    rclcpp::Subscription<nuturtlebot_msgs::msg::WheelCommands>::SharedPtr wheel_cmd_listener;
+    // Replay publishes the recorded commands instead of listening to them.
+    rclcpp::Publisher<nuturtlebot_msgs::msg::WheelCommands>::SharedPtr wheel_cmd_publisher;
+    rclcpp::Publisher<nuturtle_control::msg::SensorDataBatch>::SharedPtr sensor_batch_publisher;
+    rclcpp::Subscription<nuturtle_control::msg::WheelCommandsBatch>::SharedPtr
+        wheel_cmd_batch_listener;
+    // Encoder samples not published yet, and batched commands not due yet by sim time.
+    nuturtle_control::msg::SensorDataBatch sensor_batch;
+    std::deque<std::pair<std::chrono::nanoseconds, nuturtlebot_msgs::msg::WheelCommands>>
+        queued_wheel_cmds;
+
+    std::deque<visualization_msgs::msg::MarkerArray> pending_fake_sensor;
+    std::deque<sensor_msgs::msg::LaserScan> pending_laser;
+    // Sensor readings are built in place and published from here.
+    visualization_msgs::msg::MarkerArray fake_sensor_msg;
+    std::vector<size_t> fake_sensor_seen;
+    std::vector<size_t> fake_sensor_last_seen;
+    uint64_t fake_sensor_samples = 0;
+    sensor_msgs::msg::LaserScan laser_msg;
+    // Beams of the robots' laser per beam of laser_msg, above 1 while shedding load.
+    size_t laser_stride = 1;
+    // Scratch of the sensors, one set per robot so robots are sampled at once.
+    std::vector<size_t> fake_sensor_lost;
+    std::vector<double> sensor_noise;
+    LaserScratch scan;
+    std::vector<double> sim_log_values;
+  };
+
   // Private functions
 
-  //! @brief Main timer callback function.
-  void MainTimerStep() {
-    std_msgs::msg::UInt64 time_step_msg;
-    time_step_msg.data = ++time_step_;
-    time_step_publisher_->publish(time_step_msg);
-    auto current_stamp = get_clock()->now();
-    std::stringstream debug_ss;
-    debug_ss << "\n===>\n";
+  //! @brief Read the robots from the robots parameters, or the single red
+  //! robot at x0, y0, theta0.
+  //! @return the robots, without their ROS objects
+  std::vector<Robot> LoadRobots() {
+    const auto names = GetParam<std::vector<std::string>>(
+        *this, "robots", "namespaces of the simulated robots, empty for one red robot",
+        std::vector<std::string>{});
+    std::vector<Robot> robots;
+    if (names.empty()) {
+      robots.emplace_back();
+      robots.back().name = kDefaultRobot;
+      robots.back().initial_pose = {{GetParam<double>(*this, "x0", "inital robot x location"),
+                                     GetParam<double>(*this, "y0", "inital robot y location")},
+                                    GetParam<double>(*this, "theta0", "initial robot theta")};
+    } else {
+      const auto x0 = GetParam<std::vector<double>>(*this, "robots/x0", "inital x of each robot");
+      const auto y0 = GetParam<std::vector<double>>(*this, "robots/y0", "inital y of each robot");
+      const auto theta0 =
+          GetParam<std::vector<double>>(*this, "robots/theta0", "inital theta of each robot");
+      if (x0.size() != names.size() || y0.size() != names.size() ||
+          theta0.size() != names.size()) {
+        RCLCPP_ERROR(get_logger(), "Mismatch robots and initial pose numbers");
+        throw std::invalid_argument("robots/x0, y0 and theta0 need one entry per robot");
+      }
+      for (size_t i = 0; i < names.size(); ++i) {
+        robots.emplace_back();
+        robots.back().name = names[i];
+        robots.back().initial_pose = {{x0[i], y0[i]}, theta0[i]};
+      }
+    }
+    for (auto &robot : robots) {
+      robot.base_frame = robot.name + "/base_footprint";
+      robot.path_history.resize(kRobotPathHistorySize);
+    }
+    return robots;
+  }
 
-    // Let's move the red bot
-    // Directly using duration constructor does work! (default std::ratio is
-    // 1:1) Proof here : https://godbolt.org/z/TxMMqvrKh
-    double period_sec = std::chrono::duration<double>(update_period).count();
+  //! @brief Robot geometry and motion noise of every robot, from the parameters.
+  turtlelib::BatchSimParams MotionParams() {
+    turtlelib::BatchSimParams params;
+    params.wheel_track_to_body =
+        GetParam<double>(*this, "track_width", "robot center to wheel-track distance");
+    params.wheel_radius = GetParam<double>(*this, "wheel_radius", "wheel radius");
+    params.dt = std::chrono::duration<double>(update_period).count();
+    params.input_noise = input_noise;
+    params.slip_fraction = slip_fraction;
+    params.seed = seed_;
+    return params;
+  }
 
-    // Why I get warning saying int to double is narrowing conversion?
-    turtlelib::WheelVelocity raw_cmd_vel = {static_cast<double>(latest_wheel_cmd.left_velocity),
-                                            static_cast<double>(latest_wheel_cmd.right_velocity)};
-    turtlelib::WheelVelocity wheel_cmd_vel = raw_cmd_vel * motor_cmd_per_rad_sec * period_sec;
-
-    // This is a special catch showing we have jumped more then pi/2 on
-    // wheel in one iteration, which should not happen! (but let's just let
-    // error play out)
-    if (std::abs(wheel_cmd_vel.left) > turtlelib::PI ||
-        std::abs(wheel_cmd_vel.right) > turtlelib::PI) {
-      RCLCPP_WARN_STREAM(get_logger(),
-                         "This steps's wheel increment is more then PI! " << wheel_cmd_vel);
-    }
-
-    debug_ss << "wheel_cmd " << raw_cmd_vel << "\n";
-    debug_ss << "wheel_vel " << wheel_cmd_vel << "\n";
-    // inject noise between wheel command, and how much motor actually turned.
-    if (!turtlelib::almost_equal(wheel_cmd_vel.left, 0)) {
-      wheel_cmd_vel.left += input_gauss_distribution(rand_eng);
-    }
-    if (!turtlelib::almost_equal(wheel_cmd_vel.right, 0)) {
-      wheel_cmd_vel.left += input_gauss_distribution(rand_eng);
-    }
-    debug_ss << "wheel_vel with noise" << wheel_cmd_vel << "\n";
-    red_bot.UpdateBodyConfigWithVel(wheel_cmd_vel);
-    debug_ss << "new bot body " << red_bot.GetBodyConfig() << "\n";
-
-    // Do a collision update.
-    if (CollisionUpdate()) {
-      debug_ss << "bot body after collision check" << red_bot.GetBodyConfig() << "\n";
-    }
-
-    auto new_wheel_config = red_bot.GetWheelConfig();
-    debug_ss << "new wheel_config " << new_wheel_config << "\n";
-    // The internal tracking of our simulated robot doesn't have wheel slip.
-    // Wheel slip only show up as a encoder reading goes off, not robot itself
-    // goes off.
-    new_wheel_config.left += wheel_uniform_distribution(rand_eng);
-    new_wheel_config.right += wheel_uniform_distribution(rand_eng);
-    debug_ss << "new wheel_config with noise" << new_wheel_config << "\n";
-    // Since we let diff bot to track our wheel config, it needs to know about
-    // this slip-age update as well. Or next cycle it will ignore this.
-    red_bot.SetWheelConfig(new_wheel_config);
-
-    nuturtlebot_msgs::msg::SensorData red_sensor_msg;
-    red_sensor_msg.left_encoder = encoder_ticks_per_rad * new_wheel_config.left;
-    red_sensor_msg.right_encoder = encoder_ticks_per_rad * new_wheel_config.right;
-    red_sensor_msg.stamp = current_stamp;
-    red_sensor_publisher_->publish(red_sensor_msg);
-    debug_ss << "encoder sensor value" << nuturtlebot_msgs::msg::to_yaml(red_sensor_msg, true);
-
-    // Publish TF for red robot
-    auto tf =
-        Gen2DTransform(red_bot.GetBodyConfig(), kWorldFrame, kSimRobotBaseFrameID, current_stamp);
-    tf_broadcaster_->sendTransform(tf);
-    latest_bot_tf = tf;
-    // Publish the robot track path.
-    geometry_msgs::msg::PoseStamped new_pose;
-    new_pose.pose = leo_ros_utils::Convert(red_bot.GetBodyConfig());
-    new_pose.header.frame_id = kWorldFrame;
-    new_pose.header.stamp = current_stamp;
-
-    bot_path_history.push_back(new_pose);
-    if (bot_path_history.size() >= kRobotPathHistorySize) {
-      bot_path_history.pop_front();
-    }
-    nav_msgs::msg::Path path_msg;
-    path_msg.header = new_pose.header;
-    path_msg.poses = std::vector<geometry_msgs::msg::PoseStamped>{bot_path_history.begin(),
-                                                                  bot_path_history.end()};
-    path_publisher_->publish(path_msg);
-
-    RCLCPP_DEBUG_STREAM(get_logger(), debug_ss.str());
-  }
-
-  void FakeSensorTimerStep() {
-    visualization_msgs::msg::MarkerArray msg;
-    size_t i = 0;
-    for (const auto &obs : static_obstacles) {
-      auto obstacle_marker = obs;
-      obstacle_marker.header.frame_id = kSimRobotBaseFrameID;
-      obstacle_marker.header.stamp = latest_bot_tf.header.stamp;
-      obstacle_marker.id = kFakeSenorStartingID + (i++);
-
-      auto new_loc = red_bot.GetBodyConfig().inv()(
-          {turtlelib::Point2D{obs.pose.position.x, obs.pose.position.y}}); // P_center_obs
-
-      double range = turtlelib::Vector2D{new_loc.x, new_loc.y}.magnitude();
-      if (range > max_range && max_range >= 0.0) {
-        // Because of this, it's easier to merge logic for both usecase, instead
-        // of doing these math outside and have this function simple.
-        obstacle_marker.action = obstacle_marker.DELETE;
-      } else {
-        obstacle_marker.action = obstacle_marker.MODIFY;
+  //! @brief Add a sensor of every robot to the scheduler of the sensors,
+  //! timed by the <name>_rate, <name>_phase and <name>_latency parameters.
+  //! All robots sample at the same time.
+  //! @param name prefix of the parameters
+  //! @param sample build a reading of a robot in a world snapshot, stamped at
+  //! the given sim time, in a buffer reused by the next sample
+  //! @param publisher where a robot's reading goes once its latency passed
+  //! @param pending copies of a robot's readings taken but not delivered yet
+  //! @param decimate take only every ShedFactor()-th sample while shedding load
+  template <typename MsgT>
+  void AddSensorStream(
+      const std::string &name,
+      std::function<const MsgT &(size_t, const WorldSnapshot &, std::chrono::nanoseconds)> sample,
+      typename rclcpp::Publisher<MsgT>::SharedPtr Robot::*publisher,
+      std::deque<MsgT> Robot::*pending, bool decimate = false) {
+    const double rate = GetParam<double>(*this, name + "_rate", "sample rate (hz)", 5.0);
+    const double phase =
+        GetParam<double>(*this, name + "_phase", "offset of the samples (s)", 0.0);
+    const double latency =
+        GetParam<double>(*this, name + "_latency", "delay from sample to publish (s)", 0.0);
+    if (rate <= 0.0) {
+      throw std::invalid_argument(name + "_rate must be positive");
+    }
+    turtlelib::EventStreamConfig config;
+    config.period = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(1.0 / rate));
+    config.phase = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(phase));
+    config.latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(latency));
+    auto &scheduler = sensor_pool_ ? sensor_scheduler_ : scheduler_;
+    // Every callback of a stream runs on the same scheduler, so they share
+    // its sample count without a lock.
+    auto samples = std::make_shared<uint64_t>(0);
+    const auto keep = [this, decimate, samples]() {
+      return !decimate || (*samples)++ % ShedFactor() == 0;
+    };
+    if (config.latency.count() == 0) {
+      scheduler.AddStream(config, [this, sample, publisher, keep](std::chrono::nanoseconds time) {
+        if (!keep()) {
+          return;
+        }
+        SampleRobots(time, [&](size_t i, const WorldSnapshot &world, std::chrono::nanoseconds at) {
+          (robots_[i].*publisher)->publish(sample(i, world, at));
+        });
+      });
+      return;
+    }
+    // Constant latency, so readings are delivered in the order they were
+    // taken. Each delivery looks up whether its sample was taken.
+    auto taken = std::make_shared<std::deque<bool>>();
+    scheduler.AddStream(
+        config,
+        [this, sample, pending, keep, taken](std::chrono::nanoseconds time) {
+          taken->push_back(keep());
+          if (!taken->back()) {
+            return;
+          }
+          SampleRobots(time, [&](size_t i, const WorldSnapshot &world, std::chrono::nanoseconds at) {
+            (robots_[i].*pending).push_back(sample(i, world, at));
+          });
+        },
+        [this, publisher, pending, taken](std::chrono::nanoseconds) {
+          const bool was_taken = taken->front();
+          taken->pop_front();
+          if (!was_taken) {
+            return;
+          }
+          for (auto &robot : robots_) {
+            (robot.*publisher)->publish((robot.*pending).front());
+            (robot.*pending).pop_front();
+          }
+        });
+  }
+
+  //! @brief Run a sensor sample of every robot on the latest world snapshot,
+  //! spread over the sensor threads when there are any.
+  //! @param time sim time of the sample
+  //! @param fn called as fn(robot, world, stamp time) once per robot
+  template <typename Fn> void SampleRobots(std::chrono::nanoseconds time, const Fn &fn) {
+    world_.Update();
+    const auto &world = world_.Front();
+    // A sensor thread may only get to a sample after physics went on. The
+    // reading is then of the newer state, and stamped with its time.
+    time = std::max(time, world.time);
+    if (!sensor_pool_) {
+      for (size_t i = 0; i < robots_.size(); ++i) {
+        fn(i, world, time);
+      }
+      return;
+    }
+    sensor_pool_->ParallelFor(0, robots_.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        fn(i, world, time);
       }
+    });
+  }
 
-      // Sensor noise after detection
-      obstacle_marker.pose.position.x = new_loc.x + basic_sensor_gauss_distribution(rand_eng);
-      obstacle_marker.pose.position.y = new_loc.y + basic_sensor_gauss_distribution(rand_eng);
-      obstacle_marker.scale.z = 0.4;
-      obstacle_marker.pose.position.z = 0.4 / 2;
-      obstacle_marker.color.g = 1.0;
-      obstacle_marker.color.a = 0.4;
+  //! @brief Hand the robots' current state to the sensors as the latest world
+  //! snapshot. With sensor threads, one of them is started on it unless one is
+  //! still busy. A snapshot that comes in just as that one finishes waits for
+  //! the next step.
+  void PublishWorld() {
+    auto &world = world_.Back();
+    world.time = scheduler_.Now();
+    world.step = time_step_;
+    world.x = sim_.X();
+    world.y = sim_.Y();
+    world.theta = sim_.Theta();
+    world_.Publish();
+    if (sensor_pool_ && !sensor_tick_running_.exchange(true, std::memory_order_acq_rel)) {
+      sensor_pool_->Submit([this]() { SensorTick(); });
+    }
+  }
 
-      msg.markers.push_back(obstacle_marker);
+  //! @brief Run the sensor events up to the latest world snapshot. Runs on a
+  //! sensor thread, never two at once.
+  void SensorTick() {
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      world_.Update();
+      sensor_scheduler_.RunUntil(world_.Front().time);
+    } catch (const std::exception &e) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Sensor sample failed: " << e.what());
+    }
+    sensor_busy_ns_.fetch_add((std::chrono::steady_clock::now() - start).count(),
+                              std::memory_order_relaxed);
+    sensor_tick_running_.store(false, std::memory_order_release);
+  }
 
+  //! @brief Run the events that are due by the wall clock, then account the
+  //! time physics and the sensors took per physics step against the update
+  //! period. Past the period, LoadShedder moves up a level.
+  void WallTick() {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t step = time_step_;
+    scheduler_.RunUntil(start - wall_start_);
+    // Polls without a step may still run sensor events on the executor, they
+    // count towards the next step.
+    tick_busy_ += std::chrono::steady_clock::now() - start;
+    const uint64_t steps = time_step_ - step;
+    if (!load_shedder_ || steps == 0) {
+      return;
+    }
+    if (steps > 1) {
+      late_steps_ += steps - 1;
+    }
+    const auto executor_cost = tick_busy_ / static_cast<int64_t>(steps);
+    tick_busy_ = std::chrono::nanoseconds{0};
+    // The sensor threads run next to physics, whichever of the two is slower
+    // is what falls behind.
+    const auto sensor_cost = std::chrono::nanoseconds{
+        sensor_busy_ns_.exchange(0, std::memory_order_relaxed) / static_cast<int64_t>(steps)};
+    const auto cost = std::max(executor_cost, sensor_cost);
+    const auto level = static_cast<uint32_t>(load_shedder_->Record(cost));
+    TURTLELIB_TRACE_POINT(kTraceSim, "nusim.tick", "steps,executor_ns,sensor_ns,load,level",
+                          steps, executor_cost.count(), sensor_cost.count(),
+                          load_shedder_->Load(), level);
+    if (level != shed_level_.load(std::memory_order_relaxed)) {
+      RCLCPP_INFO_STREAM(get_logger(), "Load shedding level " << level << " at load "
+                                                              << load_shedder_->Load());
+      shed_level_.store(level, std::memory_order_relaxed);
+      PublishDiagnostics();
     }
+  }
 
-    fake_sensor_publisher_->publish(msg);
+  //! @brief How much the sensors thin out at the current load shedding level:
+  //! 1 below level 2, then doubling with each level. The laser casts every
+  //! ShedFactor()-th beam, and the fake sensor takes every ShedFactor()-th sample.
+  size_t ShedFactor() const {
+    const uint32_t level = shed_level_.load(std::memory_order_relaxed);
+    return level >= 2 ? size_t{1} << (level - 1) : 1;
   }
 
-  void SimLaserTimerStep() {
-    sensor_msgs::msg::LaserScan laser_msg;
+  //! @brief Publish the load shedding state on /diagnostics.
+  void PublishDiagnostics() {
+    const auto &shedder = *load_shedder_;
+    const uint32_t level = shed_level_.load(std::memory_order_relaxed);
+    const size_t factor = ShedFactor();
+    const size_t beams = static_cast<size_t>(std::max(sim_laser_param.number_of_sample, 0));
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = std::string(get_name()) + ": load shedding";
+    status.hardware_id = get_name();
+    status.level = level == 0 ? diagnostic_msgs::msg::DiagnosticStatus::OK
+                              : diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = level == 0 ? "Full simulation" : "Shedding level " + std::to_string(level);
+    const auto add = [&status](const std::string &key, const auto &value) {
+      diagnostic_msgs::msg::KeyValue entry;
+      entry.key = key;
+      std::ostringstream text;
+      text << value;
+      entry.value = text.str();
+      status.values.push_back(entry);
+    };
+    add("level", level);
+    add("max_level", shedder.Params().max_level);
+    add("load", shedder.Load());
+    add("budget_ms", std::chrono::duration<double, std::milli>(shedder.Params().budget).count());
+    add("worst_tick_ms", std::chrono::duration<double, std::milli>(shedder.WorstTick()).count());
+    add("ticks", shedder.Ticks());
+    add("overruns", shedder.Overruns());
+    add("late_steps", late_steps_);
+    add("path_published", level < 1 ? "true" : "false");
+    add("laser_beams", (beams + factor - 1) / factor);
+    add("fake_sensor_decimation", factor);
+
+    diagnostic_msgs::msg::DiagnosticArray msg;
+    msg.header.stamp = get_clock()->now();
+    msg.status.push_back(status);
+    diagnostics_publisher_->publish(msg);
+  }
 
-    // TODO check if we need to emit laser scan from tip of robot
-    laser_msg.header.frame_id = kSimRobotBaseFrameID;
-    laser_msg.header.stamp = latest_bot_tf.header.stamp;
+  //! @brief Append to the sim log. Physics, wheel commands and the sensor
+  //! threads all write to it.
+  template <typename T>
+  void RecordLog(turtlelib::SimLogChannel channel, std::chrono::nanoseconds time, size_t robot,
+                 const T *values, size_t count) {
+    std::lock_guard<std::mutex> lock(sim_log_mutex_);
+    sim_log_->Append(channel, time.count(), static_cast<uint32_t>(robot), values, count);
+  }
 
-    laser_msg.angle_min = 0;
-    laser_msg.angle_increment = sim_laser_param.angle_increment;
+  //! @brief Publish the sim time of the earliest pending events, then run them.
+  //! Used in fast and lockstep time_mode.
+  void RunNextEvents() {
+    const auto next = scheduler_.NextEventTime();
+    rosgraph_msgs::msg::Clock clock_msg;
+    clock_msg.clock = rclcpp::Time(next.count(), RCL_ROS_TIME);
+    clock_publisher_->publish(clock_msg);
+    scheduler_.RunUntil(next);
+  }
 
-    laser_msg.time_increment = 0;
-    laser_msg.scan_time = 0;
+  //! @brief Run events up to and including the next physics step, then
+  //! publish its timestep. RunUntil ran every event at the time of the step
+  //! by then, the sensor samples after physics too.
+  void LockstepStep() {
+    const uint64_t step = time_step_;
+    while (time_step_ == step) {
+      RunNextEvents();
+    }
+    std_msgs::msg::UInt64 time_step_msg;
+    time_step_msg.data = time_step_;
+    time_step_publisher_->publish(time_step_msg);
+  }
 
-    laser_msg.range_min = sim_laser_param.range_min;
-    laser_msg.range_max = sim_laser_param.range_max;
-    for (int count = 0; count < sim_laser_param.number_of_sample; count++) {
-      auto maybe_dist = ray_hitting(count * sim_laser_param.angle_increment);
-      // TODO revert this after debug
-      laser_msg.ranges.push_back(maybe_dist.value_or(sim_laser_param.range_max - 1));
+  //! @brief Number of consumers that handled the encoder data of the last step.
+  size_t LockstepAcks() const {
+    return static_cast<size_t>(
+        std::count_if(acked_times_.begin(), acked_times_.end(),
+                      [this](const auto &acked) { return acked.second >= data_time_; }));
+  }
+
+  //! @brief A lockstep consumer handled the data up to a stamp. A step without
+  //! encoder data, under encoder_batch, needs no new acks, so several steps
+  //! may run here.
+  void StepAckCb(const nuturtle_control::msg::StepAck &msg) {
+    // Only the newest stamp of each consumer counts, so a consumer acking
+    // twice can't stand in for one that is still busy.
+    auto &acked = acked_times_[msg.consumer];
+    acked = std::max(acked, std::chrono::nanoseconds{rclcpp::Time(msg.stamp).nanoseconds()});
+    while (LockstepAcks() >= lockstep_consumers_) {
+      LockstepStep();
     }
-    // This assume angle_max is inclusive
-    // assume number of sample is >1 (which is checked in constructor)
-    laser_msg.angle_max = (sim_laser_param.number_of_sample - 1) * sim_laser_param.angle_increment;
-    sim_laser_publisher_->publish(laser_msg);
   }
 
-  //! @param ray_angle_body - angle of the ray in body frame.
+  //! @brief Stamp of a time since the start of the simulation.
+  rclcpp::Time Stamp(std::chrono::nanoseconds sim_time) {
+    if (time_mode_ == TimeMode::kWall) {
+      return wall_start_stamp_ + rclcpp::Duration(sim_time);
+    }
+    return rclcpp::Time(sim_time.count(), RCL_ROS_TIME);
+  }
+
+  //! @brief Current time of the simulation, the time of the running event.
+  rclcpp::Time Now() { return Stamp(scheduler_.Now()); }
+
+  //! @brief Move every robot by one update period, publish encoders and tf.
+  void PhysicsStep() {
+    ++time_step_;
+    last_step_time_ = scheduler_.Now();
+    auto current_stamp = Now();
+
+    ApplyQueuedWheelCmds();
+
+    const bool collided = StepPhysics(sim_, physics_scratch_);
+    TURTLELIB_TRACE_POINT(kTraceSim, "nusim.step", "step,collided", time_step_.load(),
+                          collided);
+
+    transforms_.resize(robots_.size());
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      auto &robot = robots_[i];
+      const auto body = sim_.Pose(i);
+      const auto wheels = sim_.Wheels(i);
+      TURTLELIB_TRACE_POINT(kTraceSim, "nusim.robot", "robot,x,y,theta,left,right", i,
+                            body.translation().x, body.translation().y, body.rotation(),
+                            wheels.left, wheels.right);
+
+      nuturtlebot_msgs::msg::SensorData sensor_msg;
+      sensor_msg.left_encoder = encoder_ticks_per_rad * wheels.left;
+      sensor_msg.right_encoder = encoder_ticks_per_rad * wheels.right;
+      sensor_msg.stamp = current_stamp;
+      if (encoder_batch_ == 0) {
+        robot.sensor_publisher->publish(sensor_msg);
+        data_time_ = last_step_time_;
+      } else {
+        // The messages are reused, clear() keeps their storage.
+        auto &batch = robot.sensor_batch;
+        batch.stamps.push_back(sensor_msg.stamp);
+        batch.left_encoder.push_back(sensor_msg.left_encoder);
+        batch.right_encoder.push_back(sensor_msg.right_encoder);
+        if (batch.stamps.size() >= encoder_batch_) {
+          robot.sensor_batch_publisher->publish(batch);
+          data_time_ = last_step_time_;
+          batch.stamps.clear();
+          batch.left_encoder.clear();
+          batch.right_encoder.clear();
+        }
+      }
+      if (sim_log_) {
+        const double pose[3] = {body.translation().x, body.translation().y, body.rotation()};
+        const double ticks[2] = {static_cast<double>(sensor_msg.left_encoder),
+                                 static_cast<double>(sensor_msg.right_encoder)};
+        RecordLog(turtlelib::SimLogChannel::kPose, scheduler_.Now(), i, pose, 3);
+        RecordLog(turtlelib::SimLogChannel::kEncoders, scheduler_.Now(), i, ticks, 2);
+      }
+
+      transforms_[i] = Gen2DTransform(body, kWorldFrame, robot.base_frame, current_stamp);
 
-  std::optional<double> ray_obstacle_check(turtlelib::Vector2D v_ray_unit,
-                                           turtlelib::Vector2D v_bot_obs) {
+      // Publish the robot track path.
+      geometry_msgs::msg::PoseStamped new_pose;
+      new_pose.pose = leo_ros_utils::Convert(body);
+      new_pose.header.frame_id = kWorldFrame;
+      new_pose.header.stamp = current_stamp;
 
-    if (v_bot_obs.magnitude() - obstacles_r > sim_laser_param.range_max) {
-      // Don't care if obstacle is 100% too far away.
-      return std::nullopt;
+      robot.path_history.push_back(new_pose);
+      if (robot.path_history.size() >= kRobotPathHistorySize) {
+        robot.path_history.pop_front();
+      }
+      // Only for display, the first thing shed under load.
+      if (shed_level_.load(std::memory_order_relaxed) >= 1) {
+        continue;
+      }
+      nav_msgs::msg::Path path_msg;
+      path_msg.header = new_pose.header;
+      path_msg.poses = std::vector<geometry_msgs::msg::PoseStamped>{robot.path_history.begin(),
+                                                                    robot.path_history.end()};
+      robot.path_publisher->publish(path_msg);
     }
+    // One tf message for the whole fleet.
+    tf_broadcaster_->sendTransform(transforms_);
+    PublishWorld();
+    // Lockstep publishes it once the sensor events at this time ran too.
+    if (time_mode_ != TimeMode::kLockstep) {
+      std_msgs::msg::UInt64 time_step_msg;
+      time_step_msg.data = time_step_;
+      time_step_publisher_->publish(time_step_msg);
+    }
+  }
 
-    // ############# Begin Citation [6]#############
-    // Project bot_obs onto ray, length of U1 in citation graph
-    double proj_obs_ray_mag = turtlelib::dot(v_bot_obs, v_ray_unit);
-    // Unless ray origin is inside the obstacle. They won't intersect
-    // (regardless how big the circle is) if circle center is not in "front"
-    // +-90 of ray. IF the projected magnitude negative, the obs is behind the
-    // ray.
-    if (proj_obs_ray_mag < 0.0) {
-      // This is 50% of the case. for each obstacle, half the ray will skip out
-      // here.
-      return std::nullopt;
+  //! @brief Fake landmark sensor reading of a robot in a world snapshot.
+  //! Only obstacles within max_range get a marker, plus a DELETE for each one
+  //! that went out of range since the last reading. Other robots are not landmarks.
+  //! @param index the robot
+  //! @param world the snapshot
+  //! @param time sim time the reading is stamped with
+  const visualization_msgs::msg::MarkerArray &
+  SampleFakeSensor(size_t index, const WorldSnapshot &world, std::chrono::nanoseconds time) {
+    auto &robot = robots_[index];
+    auto &seen = robot.fake_sensor_seen;
+    auto &lost = robot.fake_sensor_lost;
+    const auto bot_config = world.Pose(index);
+    const auto world_bot = bot_config.inv();
+    if (max_range >= 0.0) {
+      obstacle_grid_->CirclesNear(bot_config.translation().ToPoint(), max_range, seen);
+      // The grid hands back obstacles touching the range, keep the centers inside it.
+      const auto out_of_range = [&](size_t k) {
+        const auto loc = world_bot(turtlelib::Point2D{obstacles_.x[k], obstacles_.y[k]});
+        return turtlelib::Vector2D{loc.x, loc.y}.magnitude() > max_range;
+      };
+      seen.erase(std::remove_if(seen.begin(), seen.end(), out_of_range), seen.end());
+    } else {
+      seen.resize(obstacles_.size());
+      std::iota(seen.begin(), seen.end(), 0);
     }
-    double circle_to_ray_d = (v_bot_obs - proj_obs_ray_mag * v_ray_unit).magnitude();
-    if (circle_to_ray_d > obstacles_r) {
-      // This is the case of not intersect
-      return std::nullopt;
+    lost.clear();
+    std::set_difference(robot.fake_sensor_last_seen.begin(), robot.fake_sensor_last_seen.end(),
+                        seen.begin(), seen.end(), std::back_inserter(lost));
+
+    // Assigning over the markers of the last sample reuses their storage.
+    robot.fake_sensor_msg.markers.resize(seen.size() + lost.size());
+    // The noise of every marker in one draw, keyed by the robot and its sample count.
+    auto &noise = robot.sensor_noise;
+    noise.resize(2 * robot.fake_sensor_msg.markers.size());
+    noise_.Gaussians(kFakeSensorStreams + static_cast<uint32_t>(index),
+                     robot.fake_sensor_samples++, noise.data(), noise.size());
+    const auto stamp = Stamp(time);
+    size_t i = 0;
+    const auto fill = [&](size_t k, int32_t action) {
+      const size_t slot = i++;
+      // P_center_obs
+      auto new_loc = world_bot(turtlelib::Point2D{obstacles_.x[k], obstacles_.y[k]});
+      // Sensor noise after detection
+      new_loc.x += basic_sensor_variance * noise[2 * slot];
+      new_loc.y += basic_sensor_variance * noise[2 * slot + 1];
+      FillFakeSensorMarker(robot.fake_sensor_msg.markers[slot], robot, k, action, stamp, new_loc);
+    };
+    for (const size_t k : seen) {
+      fill(k, visualization_msgs::msg::Marker::MODIFY);
     }
-    // Then we can form the small triangle
-    double intersect_offset =
-        std::sqrt(obstacles_r * obstacles_r - circle_to_ray_d * circle_to_ray_d);
-    // ############# End Citation [6]#############
-
-    // This (proj_obs_ray_mag - intersect_offset) *v_ray_unit is the vector to
-    // the closest intersect. It should be positive!
-    double ray_length = (proj_obs_ray_mag - intersect_offset);
-    if (ray_length < 0.0) {
-      RCLCPP_ERROR_STREAM(get_logger(), "Intersection behind the ray! dist: "
-                                            << ray_length << "\n Ray unit vector: " << v_ray_unit
-                                            << " bot to obs vector: " << v_bot_obs
-                                            << "\n projected length on ray " << proj_obs_ray_mag
-                                            << " obs to ray dis: " << circle_to_ray_d);
-    }
-
-    return ray_length;
-  }
-
-  std::optional<double>
-  ray_wall_check(turtlelib::Vector2D v_ray_unit,
-                 std::pair<turtlelib::Point2D, turtlelib::Point2D> wall_endpoints,
-                 turtlelib::Point2D bot_loc) {
-
-    // ############# Citation [7]#############
-    // Also see doc/Line_Ray_intersect_math.md for the full math.
-
-    // clang-format off
-    //                            ray_direction              P2                     
-    //                           ^                      ---->                       
-    //                           |              -------/    >                       
-    //                           |      -------/          -/ ^                      
-    //                          -x-----/                 /   |                      
-    //                  -------/ | intersect            /    |                      
-    //    P1    -------/         |                    -/     |                      
-    //     <---/                 |                   /       |                      
-    //       <                   |                  /        |                      
-    //     ^  \-                 |                -/ V_a2    |                      
-    //     |    \                |               /           |                      
-    //     |     \-              |              /            |                      
-    //     |       \ V_a1        |            -/             |                      
-    //     |        \-           |           /               |                      
-    //     |          \          |         -/                |V_b2                  
-    // V_b1|           \         |        /                  |                      
-    //     |            \-       |       /                   |                      
-    //     |              \      |     -/                    |                      
-    //     |               \-    |    /                      |                      
-    //     |                 \   |   /                       |                      
-    //     |   V_c1           \- | -/         V_c2           |        Normal to ray 
-    //     <------------------- \|---------------------------->---------->          
-    //                            P                                                 
-    //
-    // clang-format on
-    // Bot loc is our p
-    auto v_ray_perp = v_ray_unit.Perpendicular();
-
-    turtlelib::Vector2D v_a1 = wall_endpoints.first - bot_loc;
-    turtlelib::Vector2D v_a2 = wall_endpoints.second - bot_loc;
-
-    auto b1_proj = turtlelib::dot(v_a1, v_ray_unit);
-    auto b2_proj = turtlelib::dot(v_a2, v_ray_unit);
-    if (b1_proj < 0 && b2_proj < 0) {
-      // This is the case the entire line is behind the ray
-      return std::nullopt;
+    for (const size_t k : lost) {
+      fill(k, visualization_msgs::msg::Marker::DELETE);
+    }
+    if (sim_log_) {
+      // The landmarks seen, as index and position, the deletes follow from them.
+      auto &values = robot.sim_log_values;
+      values.clear();
+      for (size_t slot = 0; slot < seen.size(); ++slot) {
+        const auto &position = robot.fake_sensor_msg.markers[slot].pose.position;
+        values.insert(values.end(), {static_cast<double>(seen[slot]), position.x, position.y});
+      }
+      RecordLog(turtlelib::SimLogChannel::kFakeSensor, time, index, values.data(), values.size());
     }
+    robot.fake_sensor_last_seen.swap(seen);
+    return robot.fake_sensor_msg;
+  }
 
-    auto c1_proj = turtlelib::dot(v_a1, v_ray_perp);
-    auto c2_proj = turtlelib::dot(v_a2, v_ray_perp);
-    // don't know any better way for same sign check
+  //! @brief Fill the fake sensor marker of an obstacle.
+  //! @param marker the marker
+  //! @param robot the robot that sees it
+  //! @param k index of the obstacle
+  //! @param action MODIFY or DELETE
+  //! @param stamp time of the reading
+  //! @param loc where the robot sees the obstacle, in its body frame
+  void FillFakeSensorMarker(visualization_msgs::msg::Marker &marker, const Robot &robot,
+                            size_t k, int32_t action, const rclcpp::Time &stamp,
+                            turtlelib::Point2D loc) {
+    marker.header.frame_id = robot.base_frame;
+    marker.header.stamp = stamp;
+    marker.id = kFakeSenorStartingID + static_cast<int32_t>(k);
+    marker.action = action;
+    marker.type = visualization_msgs::msg::Marker::CYLINDER;
+    marker.scale.x = obstacles_.r[k] * 2;
+    marker.scale.y = obstacles_.r[k] * 2;
+    marker.pose.position.x = loc.x;
+    marker.pose.position.y = loc.y;
+    marker.scale.z = 0.4;
+    marker.pose.position.z = 0.4 / 2;
+    marker.color.r = 1.0;
+    marker.color.g = 1.0;
+    marker.color.a = 0.4;
+  }
 
-    if (c1_proj * c2_proj > 0) {
-      // This is the case the entire line is off to one side of the ray
-      return std::nullopt;
+  //! @brief Laser scan of a robot in a world snapshot. The other robots show
+  //! up as circles of collision_radius.
+  //! @param index the robot
+  //! @param world the snapshot
+  //! @param time sim time the scan is stamped with
+  const sensor_msgs::msg::LaserScan &SampleLaser(size_t index, const WorldSnapshot &world,
+                                                 std::chrono::nanoseconds time) {
+    auto &robot = robots_[index];
+    auto &laser_msg = robot.laser_msg;
+    laser_msg.header.stamp = Stamp(time);
+    // Under load the scan keeps every stride-th beam, over the same sweep.
+    const size_t stride = ShedFactor();
+    if (stride != robot.laser_stride) {
+      laser_sims_[index] = MakeLaserSim(stride);
+      robot.laser_stride = stride;
+      SetLaserBeams(laser_msg, laser_sims_[index].Beams(), stride);
     }
-
-    double c1_mag = std::abs(c1_proj);
-    double c2_mag = std::abs(c2_proj);
-
-    auto x = (c1_mag * (b2_proj - b1_proj)) / (c1_mag + c2_mag);
-    auto intersect_mag = x + b1_proj;
-    RCLCPP_DEBUG_STREAM(get_logger(), "v ray " << v_ray_unit << " perp " << v_ray_perp);
-    RCLCPP_DEBUG_STREAM(get_logger(), "v_a1 " << v_a1 << " v_a2" << v_a2);
-    RCLCPP_DEBUG_STREAM(get_logger(), " b1_proj " << b1_proj << " b2_proj " << b2_proj);
-    RCLCPP_DEBUG_STREAM(get_logger(), " c1_proj " << c1_proj << " c2_proj " << c2_proj);
-    RCLCPP_DEBUG_STREAM(get_logger(), " c1_mag " << c1_mag << " c2_mag " << c2_mag);
-    RCLCPP_DEBUG_STREAM(get_logger(), "X: " << x);
-    RCLCPP_DEBUG_STREAM(get_logger(),
-                        "Hit at " << intersect_mag << " Vhit " << (intersect_mag)*v_ray_unit);
-    if (intersect_mag < 0) {
-      return std::nullopt;
+    CastLaser(laser_sims_[index], robot.scan, index, world, laser_msg.ranges);
+    if (sim_log_) {
+      RecordLog(turtlelib::SimLogChannel::kLaser, time, index, laser_msg.ranges.data(),
+                laser_msg.ranges.size());
     }
-    return intersect_mag;
+    return laser_msg;
   }
 
-  //! @param ray_angle_body - angle of the ray in body frame.
-  std::optional<double> ray_hitting(double ray_angle_body) {
-
-    // We put all calculation in world frame. Its easier for walls.
-    // We only need a magnitude measure along a vector ray, so frame is not the problem.
-    auto bot_config = red_bot.GetBodyConfig();
-    double ray_angle_world = ray_angle_body + bot_config.rotation();
-
-    std::optional<double> closest_intersect = std::nullopt;
+  //! @brief Cast the laser of a robot in a world snapshot. The other robots
+  //! show up as circles of collision_radius. Only reads the world, so casts
+  //! with their own laser and scratch can run at once.
+  //! @param laser_sim the laser
+  //! @param scratch reused between casts
+  //! @param index the robot
+  //! @param world the snapshot
+  //! @param ranges the ranges, resized to the beams
+  void CastLaser(turtlelib::LaserSim &laser_sim, LaserScratch &scratch, size_t index,
+                 const WorldSnapshot &world, std::vector<float> &ranges) const {
+    // TODO check if we need to emit laser scan from tip of robot
+    // TODO revert the miss value after debug
+    const auto miss = static_cast<float>(sim_laser_param.range_max - 1);
+    const auto pose = world.Pose(index);
+
+    // Only robots that can be in range are worth a beam test.
+    scratch.robots.clear();
+    const double reach = sim_laser_param.range_max + collision_radius;
+    for (size_t k = 0; k < world.x.size(); ++k) {
+      const turtlelib::Vector2D offset{world.x[k] - pose.translation().x,
+                                       world.y[k] - pose.translation().y};
+      if (k != index && offset.magnitude() <= reach) {
+        scratch.robots.push_back(k);
+      }
+    }
+    const RobotCircles others{world.x, world.y, collision_radius, scratch.robots};
+
+    if (segment_map_) {
+      laser_sim.Cast(pose, ranges, miss, *obstacle_grid_, *segment_map_, others);
+    } else if (occupancy_map_) {
+      laser_sim.Cast(pose, ranges, miss, *obstacle_grid_, *occupancy_map_, others);
+    } else if (obstacles_.size() + arena_walls.size() < kLaserGridMinShapes) {
+      // Few enough obstacles and walls that testing all of them, and the
+      // robots in range, in SIMD lanes wins.
+      scratch.x = obstacles_.x;
+      scratch.y = obstacles_.y;
+      scratch.r = obstacles_.r;
+      for (const size_t k : scratch.robots) {
+        scratch.x.push_back(world.x[k]);
+        scratch.y.push_back(world.y[k]);
+        scratch.r.push_back(collision_radius);
+      }
+      laser_sim.Cast(pose, scratch.x, scratch.y, scratch.r, arena_walls, ranges, miss);
+    } else {
+      laser_sim.Cast(pose, ranges, miss, *obstacle_grid_, others);
+    }
+  }
 
-    // Unit vector ray in world
-    auto v_ray_unit =
-        turtlelib::Vector2D{std::cos(ray_angle_world), std::sin(ray_angle_world)}.normalize();
+  //! @brief A laser like the robots', with scratch of its own.
+  //! @param stride cast every stride-th beam of the robots' laser only
+  turtlelib::LaserSim MakeLaserSim(size_t stride = 1) const {
+    const size_t beams = static_cast<size_t>(std::max(sim_laser_param.number_of_sample, 0));
+    return turtlelib::LaserSim(0.0, sim_laser_param.angle_increment * static_cast<double>(stride),
+                               (beams + stride - 1) / stride, sim_laser_param.range_max);
+  }
 
+  //! @brief Set the angles of a scan of every stride-th beam.
+  //! @param laser_msg the scan
+  //! @param beams number of beams it has
+  //! @param stride beams of the robots' laser per beam of the scan
+  void SetLaserBeams(sensor_msgs::msg::LaserScan &laser_msg, size_t beams, size_t stride) const {
+    laser_msg.angle_increment =
+        static_cast<float>(sim_laser_param.angle_increment * static_cast<double>(stride));
+    // This assume angle_max is inclusive
+    laser_msg.angle_max =
+        static_cast<float>(beams > 0 ? (beams - 1) * laser_msg.angle_increment : 0.0);
+  }
 
-    for (const auto &obs : static_obstacles) {
-      // robot to obs center
-      auto maybe_point = ray_obstacle_check(
-          v_ray_unit,
-          turtlelib::Vector2D{obs.pose.position.x, obs.pose.position.y} - bot_config.translation());
-      // using short circuit in if here
-      if (maybe_point.has_value() &&
-          maybe_point.value() < closest_intersect.value_or(sim_laser_param.range_max + 1)) {
-        // It's safe to assume this. If we have intersect further then this, we want to discard that
-        // anyway
-        // The fun part of this is if the ray hits nothing, it will still be nullopt
-        closest_intersect = maybe_point.value();
-      }
+  //! @brief Publish a sim log instead of simulating, paced by replay_rate.
+  //! @param path the sim log
+  void StartReplay(const std::string &path) {
+    replay_.emplace(path);
+    replay_cursor_.emplace(*replay_);
+    std::vector<std::string> names;
+    for (const auto &robot : robots_) {
+      names.push_back(robot.name);
+    }
+    if (replay_->Robots() != names) {
+      RCLCPP_ERROR(get_logger(), "replay_log holds other robots than the robots parameter");
+      throw std::invalid_argument("replay_log " + path + " was recorded with other robots");
     }
+    replay_rate_ = GetParam<double>(*this, "replay_rate",
+                                    "log seconds per wall second, 0 for as fast as possible", 1.0);
+    if (replay_rate_ < 0.0) {
+      throw std::invalid_argument("replay_rate must not be negative");
+    }
+    RCLCPP_INFO_STREAM(get_logger(), "Replaying " << path << ", "
+                                                  << replay_->EndTime() * 1e-9 << " s of log");
+    if (time_mode_ != TimeMode::kWall) {
+      clock_publisher_ = create_publisher<rosgraph_msgs::msg::Clock>("/clock", 10);
+    }
+    wall_start_ = std::chrono::steady_clock::now();
+    wall_start_stamp_ = get_clock()->now();
+    step_timer_ = this->create_wall_timer(
+        replay_rate_ > 0.0 ? std::chrono::nanoseconds{kWallTick} : std::chrono::nanoseconds{0},
+        std::bind(&NuSim::ReplayTick, this));
+  }
 
-    if (! closest_intersect.has_value()){
-      for ( const auto & wall_corner_pair : arena_corners){
-        RCLCPP_DEBUG_STREAM(get_logger() , "Wall "<< wall_corner_pair.first << wall_corner_pair.second );
-        auto maybe_length = ray_wall_check(v_ray_unit  ,wall_corner_pair, bot_config.translation().ToPoint() );
+  //! @brief Publish the records of the sim log that are due. As fast as
+  //! possible publishes one window of the log per tick, so services are still served.
+  void ReplayTick() {
+    if (replay_rate_ > 0.0) {
+      replay_until_ = static_cast<int64_t>(std::chrono::duration<double, std::nano>(
+                                               std::chrono::steady_clock::now() - wall_start_)
+                                               .count() *
+                                           replay_rate_);
+    } else {
+      replay_until_ += std::chrono::nanoseconds{kReplayWindow}.count();
+    }
+    replay_cursor_->ReadUntil(replay_until_, replay_records_);
+    for (const auto &record : replay_records_) {
+      PublishRecord(record);
+    }
+    if (replay_cursor_->Done()) {
+      RCLCPP_INFO(get_logger(), "Replay finished");
+      step_timer_->cancel();
+    }
+  }
 
-        if (maybe_length.has_value()){
-          closest_intersect = maybe_length.value();
-          break;
-        }
+  //! @brief Publish a sim log record on the topic the simulation published it on.
+  //! @param record the record
+  void PublishRecord(const turtlelib::SimLogRecord &record) {
+    const auto stamp = Stamp(std::chrono::nanoseconds{record.time_ns});
+    if (clock_publisher_ && record.time_ns > replay_clock_) {
+      rosgraph_msgs::msg::Clock clock_msg;
+      clock_msg.clock = stamp;
+      clock_publisher_->publish(clock_msg);
+      replay_clock_ = record.time_ns;
+    }
+    auto &robot = robots_.at(record.robot);
+    const auto &values = record.values;
+    const auto wrong_size = [&](size_t expected) {
+      if (values.size() == expected) {
+        return false;
+      }
+      RCLCPP_WARN_STREAM(get_logger(), "Skipping a replay record with " << values.size()
+                                                                        << " values");
+      return true;
+    };
+    switch (record.channel) {
+    case turtlelib::SimLogChannel::kPose:
+      if (!wrong_size(3)) {
+        tf_broadcaster_->sendTransform(Gen2DTransform({{values[0], values[1]}, values[2]},
+                                                      kWorldFrame, robot.base_frame, stamp));
       }
+      break;
+    case turtlelib::SimLogChannel::kWheelCommand:
+      if (!wrong_size(2)) {
+        nuturtlebot_msgs::msg::WheelCommands cmd_msg;
+        cmd_msg.left_velocity = static_cast<int32_t>(values[0]);
+        cmd_msg.right_velocity = static_cast<int32_t>(values[1]);
+        robot.wheel_cmd_publisher->publish(cmd_msg);
+      }
+      break;
+    case turtlelib::SimLogChannel::kEncoders:
+      if (!wrong_size(2)) {
+        nuturtlebot_msgs::msg::SensorData sensor_msg;
+        sensor_msg.left_encoder = static_cast<int32_t>(values[0]);
+        sensor_msg.right_encoder = static_cast<int32_t>(values[1]);
+        sensor_msg.stamp = stamp;
+        robot.sensor_publisher->publish(sensor_msg);
+      }
+      break;
+    case turtlelib::SimLogChannel::kFakeSensor: {
+      auto &seen = robot.fake_sensor_seen;
+      seen.clear();
+      for (size_t j = 0; j + 2 < values.size(); j += 3) {
+        seen.push_back(static_cast<size_t>(values[j]));
+      }
+      if (wrong_size(3 * seen.size()) ||
+          std::any_of(seen.begin(), seen.end(), [&](size_t k) { return k >= obstacles_.size(); })) {
+        break;
+      }
+      auto &lost = robot.fake_sensor_lost;
+      lost.clear();
+      std::set_difference(robot.fake_sensor_last_seen.begin(), robot.fake_sensor_last_seen.end(),
+                          seen.begin(), seen.end(), std::back_inserter(lost));
+      auto &markers = robot.fake_sensor_msg.markers;
+      markers.resize(seen.size() + lost.size());
+      for (size_t j = 0; j < seen.size(); ++j) {
+        FillFakeSensorMarker(markers[j], robot, seen[j], visualization_msgs::msg::Marker::MODIFY,
+                             stamp, {values[3 * j + 1], values[3 * j + 2]});
+      }
+      for (size_t j = 0; j < lost.size(); ++j) {
+        FillFakeSensorMarker(markers[seen.size() + j], robot, lost[j],
+                             visualization_msgs::msg::Marker::DELETE, stamp, {});
+      }
+      robot.fake_sensor_last_seen.swap(seen);
+      robot.fake_sensor_publisher->publish(robot.fake_sensor_msg);
+      break;
+    }
+    case turtlelib::SimLogChannel::kLaser: {
+      // Scans recorded while shedding load have fewer beams over the same sweep.
+      const size_t beams = static_cast<size_t>(std::max(sim_laser_param.number_of_sample, 0));
+      const size_t stride =
+          values.empty() ? 1 : std::max<size_t>(1, (beams + values.size() - 1) / values.size());
+      SetLaserBeams(robot.laser_msg, values.size(), stride);
+      robot.laser_msg.header.stamp = stamp;
+      robot.laser_msg.ranges.assign(values.begin(), values.end());
+      robot.laser_publisher->publish(robot.laser_msg);
+      break;
+    }
     }
-    return closest_intersect;
   }
 
   //! @brief service callback for reset
@@ -594,20 +1414,252 @@ private:
   void reset_srv(const std_srvs::srv::Empty::Request::SharedPtr,
                  std_srvs::srv::Empty::Response::SharedPtr) {
     time_step_ = 0;
-    red_bot.SetBodyConfig({{x0, y0}, theta0});
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      sim_.SetPose(i, robots_[i].initial_pose);
+    }
+    PublishWorld();
     return;
   }
 
   //! @brief service callback for teleport
-  //! @param req teleport request data
+  //! @param req teleport request data, an empty robot moves the first one
   //! @param / service response, not used
   void teleport_callback(const nusim::srv::Teleport::Request::SharedPtr req,
                          nusim::srv::Teleport::Response::SharedPtr) {
-    red_bot.SetBodyConfig({{req->x, req->y}, req->theta});
+    const auto robot = std::find_if(robots_.begin(), robots_.end(),
+                                    [&req](const Robot &r) { return r.name == req->robot; });
+    if (!req->robot.empty() && robot == robots_.end()) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Can't teleport unknown robot " << req->robot);
+      return;
+    }
+    const size_t index =
+        req->robot.empty() ? 0 : static_cast<size_t>(robot - robots_.begin());
+    sim_.SetPose(index, {{req->x, req->y}, req->theta});
+    PublishWorld();
     return;
   }
 
-  void WheelCmdCb(const nuturtlebot_msgs::msg::WheelCommands &msg) { latest_wheel_cmd = msg; }
+  //! @brief The simulation as of the last physics step, for rollouts.
+  SimSnapshot Snapshot() const { return {last_step_time_, sim_.State(), sim_.Params()}; }
+
+  //! @brief Roll candidate commands of one robot forward from a snapshot.
+  //! Each candidate steps a fork of the physics, a BatchSim set to the
+  //! snapshot's state, with the same collisions as the simulation. The world
+  //! and the grids are only read, so the candidates run at once on
+  //! rollout_threads, each with its own scratch. Without independent_noise a
+  //! fork draws the very noise the simulation would, given the same commands.
+  //! The other robots keep the commands they had. Queued wheel_cmd_batch
+  //! commands are not applied. Scans are cast every scan_every steps, not on
+  //! the laser's own rate, phase and latency, and there is no fake_sensor.
+  //! Runs on a rollout thread, so it reads nothing of the simulation that
+  //! the executor changes, only the snapshot.
+  //! @param start where every candidate starts
+  //! @param req the candidates, see Rollout.srv
+  //! @param res the trajectories and scans
+  //! @param index the robot the commands are for
+  void Rollout(const SimSnapshot &start, const nusim::srv::Rollout::Request &req,
+               nusim::srv::Rollout::Response &res, size_t index) {
+    const size_t steps = req.steps;
+    const size_t candidates = req.left_velocity.size() / steps;
+    const size_t scans = req.scan_every > 0 ? steps / req.scan_every : 0;
+    const size_t beams = static_cast<size_t>(std::max(sim_laser_param.number_of_sample, 0));
+    const size_t samples = candidates * steps;
+    res.start = Stamp(start.time);
+    res.x.resize(samples);
+    res.y.resize(samples);
+    res.theta.resize(samples);
+    res.left_encoder.resize(samples);
+    res.right_encoder.resize(samples);
+    res.scans = static_cast<uint32_t>(scans);
+    res.beams = static_cast<uint32_t>(beams);
+    res.ranges.resize(candidates * scans * beams);
+    // A bool[] is a std::vector<bool>, whose elements can't be written from
+    // several threads.
+    std::vector<uint8_t> contact(samples, 0);
+
+    rollout_pool_->ParallelFor(0, candidates, [&](size_t begin, size_t end) {
+      PhysicsScratch scratch;
+      auto laser_sim = MakeLaserSim();
+      LaserScratch scan;
+      WorldSnapshot world;
+      std::vector<float> ranges;
+      for (size_t c = begin; c < end; ++c) {
+        auto params = start.params;
+        if (req.independent_noise) {
+          params.seed = seed_ + 1 + c;
+        }
+        turtlelib::BatchSim fork(robots_.size(), params);
+        fork.SetState(start.physics);
+        for (size_t k = 0; k < steps; ++k) {
+          const size_t sample = c * steps + k;
+          fork.SetCommand(index, turtlelib::WheelVelocity{
+                                     static_cast<double>(req.left_velocity[sample]),
+                                     static_cast<double>(req.right_velocity[sample])} *
+                                     motor_cmd_per_rad_sec);
+          StepPhysics(fork, scratch);
+          const auto pose = fork.Pose(index);
+          const auto wheels = fork.Wheels(index);
+          res.x[sample] = pose.translation().x;
+          res.y[sample] = pose.translation().y;
+          res.theta[sample] = pose.rotation();
+          res.left_encoder[sample] = static_cast<int32_t>(encoder_ticks_per_rad * wheels.left);
+          res.right_encoder[sample] = static_cast<int32_t>(encoder_ticks_per_rad * wheels.right);
+          contact[sample] = scratch.contact[index];
+          if (scans == 0 || (k + 1) % req.scan_every != 0) {
+            continue;
+          }
+          world.time = start.time + update_period * static_cast<int64_t>(k + 1);
+          world.x = fork.X();
+          world.y = fork.Y();
+          world.theta = fork.Theta();
+          CastLaser(laser_sim, scan, index, world, ranges);
+          std::copy(ranges.begin(), ranges.end(),
+                    res.ranges.begin() + ((c * scans + (k + 1) / req.scan_every - 1) * beams));
+        }
+      }
+    }, 1);
+    res.contact.assign(contact.begin(), contact.end());
+  }
+
+  //! @brief service callback for rollout, refused while replaying. The
+  //! snapshot is taken here, between two events of the simulation. The
+  //! candidates then run on the rollout pool and the response is sent when they
+  //! are done, so the executor keeps stepping and publishing meanwhile.
+  //! @param header the request to respond to
+  //! @param req the candidates, see Rollout.srv
+  void rollout_callback(const std::shared_ptr<rmw_request_id_t> header,
+                        const nusim::srv::Rollout::Request::SharedPtr req) {
+    // A bad request gets an empty response.
+    nusim::srv::Rollout::Response empty;
+    if (replay_) {
+      RCLCPP_ERROR(get_logger(), "Can't roll out a replayed simulation");
+      rollout_service_->send_response(*header, empty);
+      return;
+    }
+    const auto robot = std::find_if(robots_.begin(), robots_.end(),
+                                    [&req](const Robot &r) { return r.name == req->robot; });
+    if (!req->robot.empty() && robot == robots_.end()) {
+      RCLCPP_ERROR_STREAM(get_logger(), "Can't roll out unknown robot " << req->robot);
+      rollout_service_->send_response(*header, empty);
+      return;
+    }
+    if (req->steps == 0 || req->left_velocity.size() != req->right_velocity.size() ||
+        req->left_velocity.size() % req->steps != 0) {
+      RCLCPP_ERROR(get_logger(), "Rollout needs steps commands per wheel of every candidate");
+      rollout_service_->send_response(*header, empty);
+      return;
+    }
+    const size_t index =
+        req->robot.empty() ? 0 : static_cast<size_t>(robot - robots_.begin());
+    if (!rollout_pool_) {
+      // The worker a call is submitted to runs candidates as well. Two at
+      // least, a pool of one would run the call inline on the executor.
+      const size_t threads = rollout_threads_ > 0 ? rollout_threads_
+                                                  : std::thread::hardware_concurrency();
+      rollout_pool_.emplace(std::max<size_t>(threads, 2));
+    }
+    rollout_pool_->Submit([this, header, req, index, snapshot = Snapshot()]() {
+      const auto start = std::chrono::steady_clock::now();
+      nusim::srv::Rollout::Response res;
+      try {
+        Rollout(snapshot, *req, res, index);
+        RCLCPP_DEBUG_STREAM(get_logger(), "Rolled out " << req->left_velocity.size() / req->steps
+                                                        << " candidates of " << req->steps
+                                                        << " steps in "
+                                                        << std::chrono::duration<double>(
+                                                               std::chrono::steady_clock::now() -
+                                                               start)
+                                                               .count()
+                                                        << " s");
+      } catch (const std::exception &e) {
+        RCLCPP_ERROR_STREAM(get_logger(), "Rollout failed: " << e.what());
+        res = nusim::srv::Rollout::Response{};
+      }
+      try {
+        rollout_service_->send_response(*header, res);
+      } catch (const std::exception &e) {
+        // The client or the context may be gone by now.
+        RCLCPP_WARN_STREAM(get_logger(), "Rollout response not sent: " << e.what());
+      }
+    });
+  }
+
+  //! @brief New wheel command of a robot, held until the next one.
+  //! @param index the robot
+  //! @param msg the motor command
+  void WheelCmdCb(size_t index, const nuturtlebot_msgs::msg::WheelCommands &msg) {
+    // Why I get warning saying int to double is narrowing conversion?
+    const turtlelib::WheelVelocity raw_cmd_vel = {static_cast<double>(msg.left_velocity),
+                                                  static_cast<double>(msg.right_velocity)};
+    const turtlelib::WheelVelocity wheel_vel = raw_cmd_vel * motor_cmd_per_rad_sec;
+    // This is a special catch showing we would jump more then pi on a wheel
+    // in one step, which should not happen! (but let's just let error play out)
+    const double period_sec = std::chrono::duration<double>(update_period).count();
+    if (std::abs(wheel_vel.left * period_sec) > turtlelib::PI ||
+        std::abs(wheel_vel.right * period_sec) > turtlelib::PI) {
+      RCLCPP_WARN_STREAM(get_logger(), "This steps's wheel increment is more then PI! "
+                                           << wheel_vel * period_sec);
+    }
+    sim_.SetCommand(index, wheel_vel);
+    if (sim_log_) {
+      const double command[2] = {raw_cmd_vel.left, raw_cmd_vel.right};
+      RecordLog(turtlelib::SimLogChannel::kWheelCommand, scheduler_.Now(), index, command, 2);
+    }
+  }
+
+  //! @brief New wheel commands of a robot, each held from its stamp until the next.
+  //! They replace the robot's queued commands from the first stamp on.
+  //! @param index the robot
+  //! @param msg the motor commands
+  void WheelCmdBatchCb(size_t index, const nuturtle_control::msg::WheelCommandsBatch &msg) {
+    const size_t count = msg.stamps.size();
+    if (msg.left_velocity.size() != count || msg.right_velocity.size() != count) {
+      RCLCPP_WARN_STREAM(get_logger(), "Skipping a wheel_cmd_batch with columns of "
+                                           << count << ", " << msg.left_velocity.size()
+                                           << " and " << msg.right_velocity.size()
+                                           << " commands");
+      return;
+    }
+    if (count == 0) {
+      return;
+    }
+    auto &queue = robots_[index].queued_wheel_cmds;
+    const auto first = SimTime(msg.stamps.front());
+    while (!queue.empty() && queue.back().first >= first) {
+      queue.pop_back();
+    }
+    for (size_t k = 0; k < count; ++k) {
+      nuturtlebot_msgs::msg::WheelCommands cmd;
+      cmd.left_velocity = msg.left_velocity[k];
+      cmd.right_velocity = msg.right_velocity[k];
+      const auto time = SimTime(msg.stamps[k]);
+      if (!queue.empty() && time < queue.back().first) {
+        RCLCPP_WARN(get_logger(), "wheel_cmd_batch stamps must not go back, dropping the rest");
+        return;
+      }
+      queue.emplace_back(time, cmd);
+    }
+  }
+
+  //! @brief Apply every batched command that is due by the current sim time, in order.
+  void ApplyQueuedWheelCmds() {
+    const auto now = scheduler_.Now();
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      auto &queue = robots_[i].queued_wheel_cmds;
+      while (!queue.empty() && queue.front().first <= now) {
+        WheelCmdCb(i, queue.front().second);
+        queue.pop_front();
+      }
+    }
+  }
+
+  //! @brief Sim time of a stamp, the inverse of Stamp.
+  std::chrono::nanoseconds SimTime(const rclcpp::Time &stamp) {
+    if (time_mode_ == TimeMode::kWall) {
+      return std::chrono::nanoseconds{(stamp - wall_start_stamp_).nanoseconds()};
+    }
+    return std::chrono::nanoseconds{stamp.nanoseconds()};
+  }
 
   // rclcpp time
   // From https://en.cppreference.com/w/cpp/language/default_arguments
@@ -644,28 +1696,116 @@ private:
     return tf_stamped;
   }
 
-  //! @brief Update robot's current config by checking for collision.
-  //! If collision happens, Simply push robot off to the side a bit (to a tangent point)
-  bool CollisionUpdate() {
+  //! @brief Move every robot of a copy of the physics by one period, out of
+  //! whatever it ran into. Only reads the world, so copies with their own
+  //! scratch can step at once.
+  //! All robots move together in the arrays of the sim, with the noise of
+  //! their commands. Wheel slip only shows in the encoders, not in how the
+  //! robots moved.
+  //! @param sim the physics, sim_ or a fork of it
+  //! @param scratch reused between steps, its contact says which robots collided
+  //! @return whether any robot collided
+  bool StepPhysics(turtlelib::BatchSim &sim, PhysicsScratch &scratch) const {
+    scratch.step_start.resize(robots_.size());
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      scratch.step_start[i] = sim.Pose(i);
+    }
+    sim.Step();
+    return CollisionUpdate(sim, scratch);
+  }
+
+  //! @brief Keep the robots out of the obstacles, the walls and each other.
+  //! Each robot is swept along the arc it drove this step, so it stops at
+  //! whatever it meets on the way instead of passing through it, and slides
+  //! along it. Robots that then overlap each back off half the overlap.
+  //! @param sim the physics after the step
+  //! @param scratch holds where the robots started the step
+  //! @return whether any robot collided
+  bool CollisionUpdate(turtlelib::BatchSim &sim, PhysicsScratch &scratch) const {
     bool collision = false;
-    for (const auto &obs : static_obstacles) {
-      // Get current robot to obstacle vector
-      turtlelib::Vector2D v_obs{obs.pose.position.x, obs.pose.position.y};
-      auto v_robot = red_bot.GetBodyConfig().translation();
+    scratch.contact.assign(robots_.size(), 0);
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      const auto twist = sim.StepTwist(i);
+      const auto start = scratch.step_start[i];
+      GatherSweepShapes(start.translation().ToPoint(),
+                        std::hypot(twist.x, twist.y) + collision_radius, scratch);
+      const auto sweep =
+          turtlelib::SweepCircle(start, twist, collision_radius, scratch.sweep_shapes);
+      // Without contact the sim already holds the end of the arc.
+      if (sweep.contact) {
+        collision = true;
+        scratch.contact[i] = 1;
+        sim.SetPose(i, sweep.pose);
+      }
+    }
 
-      auto v_obs_robot = v_obs - v_robot;
-      double overlap_amount = v_obs_robot.magnitude() - (obstacles_r + collision_radius);
+    // Robots against each other. The broad phase only hands back pairs whose
+    // boxes overlap, each robot of a pair backs off half the overlap.
+    scratch.broad_phase.Update(sim.X(), sim.Y(), robot_r_, scratch.robot_pairs);
+    scratch.pushed_robots.clear();
+    for (const auto &[i, j] : scratch.robot_pairs) {
+      const auto pose_i = sim.Pose(i);
+      const auto pose_j = sim.Pose(j);
+      const auto v_ij = pose_j.translation() - pose_i.translation();
+      const double distance = v_ij.magnitude();
+      const double overlap_amount = distance - 2.0 * collision_radius;
       if (overlap_amount < 0) {
         collision = true;
-        // There is a collision, we need to push robot out in this direction.
-        auto push_amount = v_obs_robot.normalize() * overlap_amount;
-
-        red_bot.SetBodyConfig({{v_robot += push_amount}, red_bot.GetBodyConfig().rotation()});
+        // Robots right on top of each other split along x.
+        const auto direction = distance > 0.0 ? v_ij * (1.0 / distance) : turtlelib::Vector2D{1, 0};
+        const auto push_amount = direction * (overlap_amount / 2.0);
+        sim.SetPose(i, {pose_i.translation() + push_amount, pose_i.rotation()});
+        sim.SetPose(j, {pose_j.translation() - push_amount, pose_j.rotation()});
+        scratch.contact[i] = 1;
+        scratch.contact[j] = 1;
+        scratch.pushed_robots.push_back(i);
+        scratch.pushed_robots.push_back(j);
       }
     }
+
+    // A robot pushed by another may now sit in an obstacle or a wall.
+    for (const size_t i : scratch.pushed_robots) {
+      const auto pose = sim.Pose(i);
+      GatherSweepShapes(pose.translation().ToPoint(), collision_radius, scratch);
+      sim.SetPose(i,
+                  turtlelib::SweepCircle(pose, {}, collision_radius, scratch.sweep_shapes).pose);
+    }
     return collision;
   }
 
+  //! @brief Collect the obstacles and walls a robot can touch into scratch.sweep_shapes.
+  //! The walls of a .pgm world_map are the borders of its occupied cells.
+  //! The arena or world_file walls are found through the grid they are in.
+  //! @param center where the robot starts
+  //! @param reach how far from center the robot's edge can get
+  //! @param scratch of the physics step
+  void GatherSweepShapes(turtlelib::Point2D center, double reach, PhysicsScratch &scratch) const {
+    auto &shapes = scratch.sweep_shapes;
+    shapes.Clear();
+    obstacle_grid_->CirclesNear(center, reach, scratch.nearby_obstacles);
+    for (const size_t k : scratch.nearby_obstacles) {
+      shapes.x.push_back(obstacles_.x[k]);
+      shapes.y.push_back(obstacles_.y[k]);
+      shapes.r.push_back(obstacles_.r[k]);
+    }
+    if (segment_map_) {
+      segment_map_->SegmentsNear(center, reach, scratch.nearby_segments);
+      for (const size_t k : scratch.nearby_segments) {
+        shapes.segments.push_back(segment_map_->Segments()[k]);
+      }
+    } else if (occupancy_map_) {
+      // The walls of a floor plan image are the borders of its occupied cells.
+      occupancy_map_->EdgesNear(center, reach, scratch.nearby_map_edges);
+      shapes.segments.insert(shapes.segments.end(), scratch.nearby_map_edges.begin(),
+                             scratch.nearby_map_edges.end());
+    } else {
+      obstacle_grid_->SegmentsNear(center, reach, scratch.nearby_segments);
+      for (const size_t k : scratch.nearby_segments) {
+        shapes.segments.push_back(arena_walls[k]);
+      }
+    }
+  }
+
   //! @brief Publish visualization markers for arena walls
   //! @param x_length Wall length in x
   //! @param y_length Wall length in y
@@ -714,23 +1854,123 @@ private:
     std::cout << "Published markers" << std::endl;
   }
 
-  //! @brief Publish vitilization markers for obstacles
-  //! @param obstacles list of obstacle positions
-  //! @param rad radius for all obstacle
-  void PublishStaticObstacles(std::vector<visualization_msgs::msg::Marker> obstacles) {
+  //! @brief Publish visualization markers for the walls of the world_map or world_file.
+  //! Segments are one line list, an occupancy map one cube per occupied cell.
+  void PublishMapWalls() {
+    area_wall_publisher_ =
+        create_publisher<visualization_msgs::msg::MarkerArray>("~/walls", transient_local_qos);
+
+    visualization_msgs::msg::Marker wall_marker;
+    wall_marker.header.frame_id = kWorldFrame;
+    wall_marker.header.stamp = get_clock()->now();
+    wall_marker.id = 1;
+    wall_marker.pose.orientation.w = 1.0;
+    wall_marker.color.r = 1.0;
+    wall_marker.color.a = 1.0;
+    geometry_msgs::msg::Point point;
+    if (!occupancy_map_) {
+      wall_marker.type = wall_marker.LINE_LIST;
+      wall_marker.scale.x = 0.02;
+      for (const auto &segment : segment_map_ ? segment_map_->Segments() : arena_walls) {
+        for (const auto &end : {segment.a, segment.b}) {
+          point.x = end.x;
+          point.y = end.y;
+          wall_marker.points.push_back(point);
+        }
+      }
+    } else {
+      const double resolution = occupancy_map_->Resolution();
+      const auto origin = occupancy_map_->Origin();
+      wall_marker.type = wall_marker.CUBE_LIST;
+      wall_marker.scale.x = resolution;
+      wall_marker.scale.y = resolution;
+      wall_marker.scale.z = 0.25;
+      point.z = 0.25 / 2;
+      for (size_t row = 0; row < occupancy_map_->Height(); ++row) {
+        for (size_t col = 0; col < occupancy_map_->Width(); ++col) {
+          if (occupancy_map_->Cells()[row * occupancy_map_->Width() + col] != 0) {
+            point.x = origin.x + (static_cast<double>(col) + 0.5) * resolution;
+            point.y = origin.y + (static_cast<double>(row) + 0.5) * resolution;
+            wall_marker.points.push_back(point);
+          }
+        }
+      }
+    }
+    visualization_msgs::msg::MarkerArray msg;
+    msg.markers.push_back(wall_marker);
+    area_wall_publisher_->publish(msg);
+  }
+
+  //! @brief Map the world_file, if one is set.
+  //! @return the file, empty without one
+  std::optional<turtlelib::WorldFile> LoadWorldFile() {
+    const auto path = GetParam<std::string>(
+        *this, "world_file", "binary world replacing the obstacles and arena, empty for none", "");
+    if (path.empty()) {
+      return std::nullopt;
+    }
+    return std::optional<turtlelib::WorldFile>(std::in_place, path);
+  }
+
+  //! @brief Read the obstacles from the world_file, else the obstacles/ parameters.
+  //! @return the obstacles, each with its own radius
+  Obstacles LoadObstacles() {
+    Obstacles obstacles;
+    if (world_file_) {
+      // The only copy of the file, three flat arrays for the markers and the fake sensor.
+      const auto &view = world_file_->View();
+      obstacles.x.assign(view.circle_x, view.circle_x + view.circles);
+      obstacles.y.assign(view.circle_y, view.circle_y + view.circles);
+      obstacles.r.assign(view.circle_r, view.circle_r + view.circles);
+      return obstacles;
+    }
+    obstacles.x =
+        GetParam<std::vector<double>>(*this, "obstacles/x", "list of obstacle's x coord");
+    obstacles.y =
+        GetParam<std::vector<double>>(*this, "obstacles/y", "list of obstacle's y coord");
+    obstacles.r = GetParam<std::vector<double>>(
+        *this, "obstacles/radii", "radius of each obstacle, empty to share obstacles/r",
+        std::vector<double>{});
+    if (obstacles.y.size() != obstacles.size()) {
+      RCLCPP_ERROR(get_logger(), "Mismatch obstacle x y numbers");
+      throw std::invalid_argument("obstacles/x and obstacles/y differ in length");
+    }
+    if (obstacles.r.empty()) {
+      obstacles.r.assign(obstacles.size(),
+                         GetParam<double>(*this, "obstacles/r", "obstacle radius"));
+    } else if (obstacles.r.size() != obstacles.size()) {
+      RCLCPP_ERROR(get_logger(), "Mismatch obstacle x radii numbers");
+      throw std::invalid_argument("obstacles/radii and obstacles/x differ in length");
+    }
+    return obstacles;
+  }
+
+  //! @brief The walls of the world_file, else of the arena.
+  //! @return the walls, in the order the grid has them
+  std::vector<turtlelib::Segment2D> LoadWalls() {
+    const double x_length = GetParam<double>(*this, "arena_x_length", "x length of arena", 5.0);
+    const double y_length = GetParam<double>(*this, "arena_y_length", "y length of arena", 3.0);
+    if (world_file_) {
+      const auto &view = world_file_->View();
+      return {view.segments, view.segments + view.segment_count};
+    }
+    return turtlelib::ArenaWalls(x_length, y_length);
+  }
+
+  //! @brief Publish vitilization markers for obstacles, once on a transient local topic.
+  void PublishStaticObstacles() {
     static_obstacle_publisher_ =
         create_publisher<visualization_msgs::msg::MarkerArray>("~/obstacles", transient_local_qos);
 
     visualization_msgs::msg::MarkerArray msg;
-
-    size_t i = 0;
-    for (const auto &obs : obstacles) {
-      auto copy = obs;
-      copy.header.frame_id = kWorldFrame;
-      copy.header.stamp = get_clock()->now();
-      copy.id = kStaticObstacleStartingID + (i++);
-      copy.action = copy.ADD;
-      msg.markers.push_back(copy);
+    const auto stamp = get_clock()->now();
+    for (size_t k = 0; k < obstacles_.size(); ++k) {
+      auto marker = ObstacleMarker(obstacles_.x[k], obstacles_.y[k], obstacles_.r[k]);
+      marker.header.frame_id = kWorldFrame;
+      marker.header.stamp = stamp;
+      marker.id = kStaticObstacleStartingID + static_cast<int32_t>(k);
+      marker.action = marker.ADD;
+      msg.markers.push_back(marker);
     }
     static_obstacle_publisher_->publish(msg);
   }
@@ -742,63 +1982,120 @@ private:
   constexpr static int32_t kStaticObstacleStartingID = 10;
   constexpr static int32_t kFakeSenorStartingID = 50;
   constexpr static size_t kRobotPathHistorySize = 10 ; // number of data points
+  constexpr static std::chrono::milliseconds kWallTick{1}; // wall time_mode polling period
+  constexpr static size_t kLaserGridMinShapes = 68; // laser walks the grid from here on
+  constexpr static uint32_t kFakeSensorStreams = 1u << 30; // noise stream of robot 0's fake sensor
+  constexpr static std::chrono::milliseconds kReplayWindow{100}; // log per tick at replay_rate 0
+  constexpr static uint32_t kTraceSim = 1; // trace category of the physics steps
 
   // Ros Params
   const std::chrono::nanoseconds update_period; // period for each cycle of update
-  const double x0 = 0;                          // Init x location
-  const double y0 = 0;                          // Init y location
-  const double theta0 = 0;                      // Init theta location
 
   const int motor_cmd_max;
   const double motor_cmd_per_rad_sec;
   const double encoder_ticks_per_rad;
   const double collision_radius;
-  turtlelib::DiffDrive red_bot;
-
-  double obstacles_r; // Extra copy for quick access
-  // The order of the array also defined their ID. so it matters they don't
-  // change Obstacle constructed using input x_s and y_s Due to check needed on
-  // x_s and y_s, not const
-  const std::vector<visualization_msgs::msg::Marker> static_obstacles;
-  
-  const std::vector<std::pair<turtlelib::Point2D,turtlelib::Point2D>> arena_corners;
+  // The robots in the order of sim_, collision_radius of each for the broad phase.
+  std::vector<Robot> robots_;
+  const std::vector<double> robot_r_;
+
+  // Mapped before everything read from it, and unmapped after the grid over it.
+  std::optional<turtlelib::WorldFile> world_file_;
+  // The order of the obstacles also defined their ID. so it matters they don't change
+  const Obstacles obstacles_;
+
+  // The arena, or the walls of the world_file.
+  const std::vector<turtlelib::Segment2D> arena_walls;
+  // Obstacles and walls by cell, so queries only look near the robot.
+  std::optional<turtlelib::UniformGrid> obstacle_grid_;
+  // The world_map, when one replaces the arena.
+  std::optional<turtlelib::SegmentBvh> segment_map_;
+  std::optional<turtlelib::OccupancyMap> occupancy_map_;
+  // Scratch of the steps of sim_, forks have their own.
+  PhysicsScratch physics_scratch_;
   // simulation only param
   const double input_noise;
   const double slip_fraction;
   const double max_range;
   const LaserParam sim_laser_param;
+  // One scanner per robot, so scans of several robots can run at once.
+  std::vector<turtlelib::LaserSim> laser_sims_;
+  const uint64_t seed_;
+  // Poses, wheels and commands of all robots, stepped together.
+  turtlelib::BatchSim sim_;
   // These are member variable
-  std::normal_distribution<double> input_gauss_distribution;
-  std::uniform_real_distribution<double> wheel_uniform_distribution;
-  std::normal_distribution<double> basic_sensor_gauss_distribution;
+  // Sensor noise. The motion noise of robot i is stream i of the same seed,
+  // drawn by sim_, so sensors take streams from kFakeSensorStreams on.
+  turtlelib::CounterNoise noise_;
+  // Used as the standard deviation of the fake sensor noise.
+  const double basic_sensor_variance;
+  const TimeMode time_mode_;
+  const size_t encoder_batch_;
 
   std::atomic<uint64_t> time_step_ = 0;
-  nuturtlebot_msgs::msg::WheelCommands latest_wheel_cmd;
-  std::deque<geometry_msgs::msg::PoseStamped> bot_path_history = std::deque<geometry_msgs::msg::PoseStamped>(kRobotPathHistorySize);
-  geometry_msgs::msg::TransformStamped latest_bot_tf ; 
+  // Sim time of the last physics step, sensor events may have run since.
+  std::chrono::nanoseconds last_step_time_{0};
+  std::vector<geometry_msgs::msg::TransformStamped> transforms_;
+
+  // Physics and sensor events, in sim time since the start
+  turtlelib::EventScheduler scheduler_;
+  // Sensor events instead, run by the sensor threads when there are any.
+  turtlelib::EventScheduler sensor_scheduler_;
+  // Written by physics, read by the sensors.
+  turtlelib::TripleBuffer<WorldSnapshot> world_;
+  std::atomic<bool> sensor_tick_running_ = false;
+  // Deadlines of wall time_mode. The level is read by the sensor threads.
+  std::optional<turtlelib::LoadShedder> load_shedder_;
+  std::atomic<uint32_t> shed_level_ = 0;
+  std::chrono::nanoseconds tick_busy_{0};
+  std::atomic<int64_t> sensor_busy_ns_ = 0;
+  uint64_t late_steps_ = 0;
+  std::chrono::steady_clock::time_point wall_start_;
+  rclcpp::Time wall_start_stamp_;
+  uint64_t lockstep_consumers_ = 1;
+  // Newest stamp each lockstep consumer acked, and the time of the last step
+  // that published encoder data.
+  std::map<std::string, std::chrono::nanoseconds> acked_times_;
+  std::chrono::nanoseconds data_time_{0};
+  uint64_t last_watchdog_step_ = 0;
+  // Ground truth and sensor output, when recording.
+  std::optional<turtlelib::SimLogWriter> sim_log_;
+  std::string trace_file_;
+  std::mutex sim_log_mutex_;
+  // The sim log and how far it was published, when replaying.
+  std::optional<turtlelib::SimLogReader> replay_;
+  std::optional<turtlelib::SimLogCursor> replay_cursor_;
+  double replay_rate_ = 1.0;
+  int64_t replay_until_ = 0;
+  int64_t replay_clock_ = -1;
+  std::vector<turtlelib::SimLogRecord> replay_records_;
 
   // Ros objects
-  rclcpp::TimerBase::SharedPtr main_timer_;
-  rclcpp::TimerBase::SharedPtr fake_sensor_timer_;
-  rclcpp::TimerBase::SharedPtr sim_laser_timer_;
+  rclcpp::TimerBase::SharedPtr step_timer_;
   
   rclcpp::Service<std_srvs::srv::Empty>::SharedPtr reset_service_;
   rclcpp::Service<nusim::srv::Teleport>::SharedPtr teleport_service_;
+  rclcpp::Service<nusim::srv::Rollout>::SharedPtr rollout_service_;
   
   rclcpp::Publisher<std_msgs::msg::UInt64>::SharedPtr time_step_publisher_;
-  rclcpp::Publisher<nuturtlebot_msgs::msg::SensorData>::SharedPtr red_sensor_publisher_;
-  rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr fake_sensor_publisher_;
-  rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr path_publisher_;
-  rclcpp::Publisher<sensor_msgs::msg::LaserScan>::SharedPtr sim_laser_publisher_;
+  rclcpp::Publisher<rosgraph_msgs::msg::Clock>::SharedPtr clock_publisher_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_publisher_;
+  rclcpp::TimerBase::SharedPtr diagnostics_timer_;
   std::unique_ptr<tf2_ros::TransformBroadcaster> tf_broadcaster_;
 
-  rclcpp::Subscription<nuturtlebot_msgs::msg::WheelCommands>::SharedPtr wheel_cmd_listener_;
+  rclcpp::Subscription<nuturtle_control::msg::StepAck>::SharedPtr step_ack_listener_;
 
   // The publisher need to be kept so the transient local message can still be
   // available later
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr area_wall_publisher_;
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr static_obstacle_publisher_;
 
+  // Runs the candidates of rollout calls, off the executor. Made at the first
+  // call, and destroyed before anything a rollout reads.
+  size_t rollout_threads_ = 0;
+  std::optional<turtlelib::WorkerPool> rollout_pool_;
+  // Last, so its threads are done with the sensors before anything they use goes away.
+  std::optional<turtlelib::WorkerPool> sensor_pool_;
 };
 
 //! @brief Main entry point for the nusim node
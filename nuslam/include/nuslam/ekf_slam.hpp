@@ -0,0 +1,169 @@
+#ifndef NUSLAM_EKF_SLAM_INCLUDE_GUARD_HPP
+#define NUSLAM_EKF_SLAM_INCLUDE_GUARD_HPP
+//! @file
+//! @brief Extended Kalman filter SLAM for one or more robots sharing a single
+//! landmark map.
+
+#include <armadillo>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <turtlelib/geometry2d.hpp>
+#include <turtlelib/se2d.hpp>
+#include <turtlelib/worker_pool.hpp>
+
+#include "nuslam/filter_trace.hpp"
+
+namespace nuslam {
+
+//! @brief One range/bearing observation of a landmark, taken by a robot.
+struct LandmarkMeasurement {
+  //! @brief index of the landmark, zero indexed
+  size_t landmark_index = 0;
+  //! @brief measured distance from robot to landmark
+  double range = 0.0;
+  //! @brief measured bearing of the landmark in robot frame
+  double bearing = 0.0;
+  //! @brief Measured landmark location in world. Used to initialize the
+  //! landmark the first time it's seen.
+  turtlelib::Point2D world_guess;
+};
+
+//! @brief What the filter expected for one measurement, before correction.
+struct MeasurementPrediction {
+  size_t landmark_index = 0;
+  double range = 0.0;
+  double bearing = 0.0;
+};
+
+// State layout:
+// [theta_0 x_0 y_0 ... theta_n-1 x_n-1 y_n-1 | mx_0 my_0 ... mx_m-1 my_m-1]
+//  <------------ robot pose blocks --------> <--- shared landmark block --->
+// Landmarks are addressed by a stable index everywhere in the interface. The
+// slot a landmark takes in the landmark block can change when the filter
+// reorders them, see ReorderLandmarks and LandmarkSlot.
+//! @brief EKF SLAM with N robot pose blocks and one shared landmark block.
+class EkfSlam {
+public:
+  //! @brief Construct the filter. All robots start at the origin with zero
+  //! covariance, all landmarks start uninitialized with very large covariance.
+  //! @param num_robots number of robot pose blocks
+  //! @param max_landmarks size of the landmark block
+  //! @param process_noise variance added to each robot pose entry on predict
+  //! @param sensor_noise variance of range and bearing measurements
+  EkfSlam(size_t num_robots, size_t max_landmarks, double process_noise, double sensor_noise);
+
+  //! @brief number of robots in the filter
+  size_t NumRobots() const;
+
+  //! @brief number of landmark slots in the filter
+  size_t MaxLandmarks() const;
+
+  //! @brief size of the full state vector
+  size_t StateSize() const;
+
+  //! @brief Prediction step for a single robot.
+  //! @param robot index of the robot
+  //! @param T_old_new robot motion since last prediction, in old robot frame
+  void Predict(size_t robot, const turtlelib::Transform2D &T_old_new);
+
+  //! @brief Prediction step for every robot that moved.
+  //! Each robot only touches its own rows and columns of the covariance, so the
+  //! robots are processed in parallel on the pool.
+  //! @param robot_deltas motion of each robot since its last prediction.
+  //! nullopt for robots with nothing new.
+  //! @param pool optional pool to spread the robots on
+  void PredictAll(const std::vector<std::optional<turtlelib::Transform2D>> &robot_deltas,
+                  turtlelib::WorkerPool *pool = nullptr);
+
+  //! @brief Measurement update with every measurement a robot made in one go.
+  //! Landmarks seen for the first time are initialized from world_guess. All
+  //! measurements are linearized at the current state and applied as a single
+  //! stacked update.
+  //! @param robot index of the robot that made the measurements
+  //! @param measurements the batch of measurements
+  //! @return what the filter predicted for each measurement, same order
+  std::vector<MeasurementPrediction> Update(size_t robot,
+                                            const std::vector<LandmarkMeasurement> &measurements);
+
+  //! @brief Match measurements without a known landmark to the map.
+  //! Pairs are matched greedily, smallest Mahalanobis distance first, and a
+  //! landmark goes to at most one measurement of the batch. A measurement with
+  //! no free initialized landmark under the threshold gets a fresh landmark
+  //! slot. Measurements that need a slot when none is left get
+  //! landmark_index = MaxLandmarks().
+  //! @param robot index of the robot that made the measurements
+  //! @param measurements measurements to label, landmark_index is overwritten
+  //! @param new_landmark_distance squared Mahalanobis distance above which a
+  //! measurement is a new landmark
+  void AssociateLandmarks(size_t robot, std::vector<LandmarkMeasurement> &measurements,
+                          double new_landmark_distance) const;
+
+  //! @brief Sort the landmark slots along a Hilbert curve over the map.
+  //! Landmarks seen together are close in space, so afterwards they are close
+  //! in the state vector too, and an update reads a few nearby bands of the
+  //! covariance instead of rows scattered over all of it. Initialized landmarks
+  //! come first in curve order, the unseen slots after. The state and
+  //! covariance are permuted to match; landmark indices don't change.
+  void ReorderLandmarks();
+
+  //! @brief Reorder the landmarks automatically after every n updates.
+  //! @param updates number of updates between reorders, 0 (default) never
+  void SetReorderInterval(size_t updates);
+
+  //! @brief slot of a landmark in the landmark block of GetState()
+  size_t LandmarkSlot(size_t landmark) const;
+
+  //! @brief current pose estimate of a robot
+  turtlelib::Transform2D GetRobotPose(size_t robot) const;
+
+  //! @brief overwrite the pose estimate of a robot, covariance is kept
+  void SetRobotPose(size_t robot, const turtlelib::Transform2D &pose);
+
+  //! @brief current location estimate of a landmark
+  turtlelib::Point2D GetLandmark(size_t landmark) const;
+
+  //! @brief whether the landmark has been seen at least once
+  bool IsLandmarkInitialized(size_t landmark) const;
+
+  //! @brief full state vector, landmarks are in slot order
+  const arma::vec &GetState() const;
+
+  //! @brief full covariance
+  const arma::mat &GetCovariance() const;
+
+  //! @brief Record every predict and update from now on.
+  //! @param recorder where the records go, nullptr to stop. Not owned, must
+  //! outlive the filter or be reset first.
+  void SetRecorder(FilterFlightRecorder *recorder);
+
+  //! @brief record of the latest predict or update, kept even without a recorder
+  const FilterTraceRecord &LastTrace() const;
+
+private:
+  size_t RobotOffset(size_t robot) const;
+  size_t LandmarkOffset(size_t landmark) const;
+  //! @brief Fill in the parts every record shares, then keep and record it.
+  void FinishTrace(FilterTraceRecord &record, std::chrono::steady_clock::time_point start);
+
+  size_t num_robots_;
+  size_t max_landmarks_;
+  double process_noise_;
+  double sensor_noise_;
+  arma::vec state_;
+  arma::mat covariance_;
+  std::vector<bool> initialized_landmark_;
+  // Landmark index to slot in the landmark block, and back.
+  std::vector<size_t> slot_of_landmark_;
+  std::vector<size_t> landmark_of_slot_;
+  size_t reorder_interval_ = 0;
+  size_t updates_since_reorder_ = 0;
+  FilterFlightRecorder *recorder_ = nullptr;
+  FilterTraceRecord last_trace_;
+};
+
+} // namespace nuslam
+
+#endif
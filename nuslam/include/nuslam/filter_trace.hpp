@@ -0,0 +1,55 @@
+#ifndef NUSLAM_FILTER_TRACE_INCLUDE_GUARD_HPP
+#define NUSLAM_FILTER_TRACE_INCLUDE_GUARD_HPP
+//! @file
+//! @brief What the flight recorder keeps about each filter step.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <turtlelib/flight_recorder.hpp>
+
+namespace nuslam {
+
+//! @brief Number of leading state entries kept per record. Enough for one robot
+//! and a dozen landmarks, larger states are cut.
+constexpr size_t kTraceStateSize = 32;
+//! @brief Number of leading innovation entries kept per record.
+constexpr size_t kTraceInnovationSize = 16;
+
+//! @brief Which filter step a record is about.
+enum class FilterStepKind : uint32_t { kPredict = 1, kUpdate = 2 };
+
+//! @brief One filter step, fixed size so it can live in the flight recorder.
+struct FilterTraceRecord {
+  //! @brief wall clock at the end of the step, nanoseconds since epoch
+  int64_t stamp_ns = 0;
+  FilterStepKind kind = FilterStepKind::kPredict;
+  //! @brief full size of the state, may be larger than what's kept
+  uint32_t state_size = 0;
+  //! @brief bit i set when robot i took part in the step
+  uint64_t robot_mask = 0;
+  //! @brief number of landmark measurements, 0 for predict
+  uint32_t num_measurements = 0;
+  uint32_t reserved = 0;
+  //! @brief time spent in the step, microseconds
+  double duration_us = 0.0;
+  //! @brief euclidean norm of the innovation
+  double innovation_norm = 0.0;
+  //! @brief normalized innovation squared, err^T S^-1 err
+  double innovation_nis = 0.0;
+  //! @brief frobenius norm of the kalman gain
+  double gain_norm = 0.0;
+  //! @brief trace of the robot pose blocks of the covariance
+  double robot_covariance_trace = 0.0;
+  //! @brief leading entries of the state after the step
+  double state[kTraceStateSize] = {};
+  //! @brief leading entries of the innovation, range and bearing interleaved
+  double innovation[kTraceInnovationSize] = {};
+};
+
+//! @brief The recorder type the filter writes to.
+using FilterFlightRecorder = turtlelib::FlightRecorder<FilterTraceRecord>;
+
+} // namespace nuslam
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef NUSLAM_SLAM_RUN_INCLUDE_GUARD_HPP
+#define NUSLAM_SLAM_RUN_INCLUDE_GUARD_HPP
+//! @file
+//! @brief Recorded SLAM runs, and replaying them offline through the filter.
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+#include <turtlelib/geometry2d.hpp>
+#include <turtlelib/se2d.hpp>
+#include <turtlelib/worker_pool.hpp>
+
+namespace nuslam {
+
+//! @brief A robot pose at a point in time.
+struct StampedPose {
+  double stamp = 0.0; //!< seconds
+  turtlelib::Transform2D pose;
+};
+
+//! @brief One landmark observation, in the robot frame.
+struct StampedObservation {
+  double stamp = 0.0; //!< seconds
+  size_t landmark_index = 0;
+  turtlelib::Point2D robot_frame;
+};
+
+//! @brief Everything needed to run the filter offline and score it.
+// Text format, one entry per line, '#' starts a comment:
+//   odom <stamp> <theta> <x> <y>       odometry pose T_odom_robot
+//   obs <stamp> <index> <x> <y>        landmark seen at x y in the robot frame
+//   truth <stamp> <theta> <x> <y>      true robot pose in world
+//   landmark <index> <x> <y>           true landmark location in world
+struct SlamRun {
+  std::vector<StampedPose> odom;
+  std::vector<StampedObservation> observations;
+  std::vector<StampedPose> truth;
+  std::map<size_t, turtlelib::Point2D> landmark_truth;
+};
+
+//! @brief Read a run, throws std::runtime_error on a malformed line.
+SlamRun ReadSlamRun(std::istream &is);
+
+//! @brief Write a run in the format ReadSlamRun reads.
+void WriteSlamRun(std::ostream &os, const SlamRun &run);
+
+//! @brief Filter settings being tuned.
+struct NoiseConfig {
+  double process_noise = 1e-4;
+  double sensor_noise = 1e-4;
+};
+
+//! @brief How well the filter did on a run.
+struct ReplayScore {
+  //! @brief RMS distance between estimated and true robot position, meters
+  double trajectory_rmse = 0.0;
+  //! @brief RMS distance between estimated and true landmark locations, meters
+  double landmark_rmse = 0.0;
+  //! @brief number of true landmarks the filter never initialized
+  size_t missed_landmarks = 0;
+  //! @brief the filter produced non finite numbers
+  bool diverged = false;
+};
+
+//! @brief Run a recording through the filter the way the slam node does:
+//! each odom message predicts, observations with the same stamp are one
+//! batched update.
+//! @param run the recording
+//! @param config noise to use
+//! @param max_landmarks size of the filter's landmark block
+//! @param trajectory if given, gets the estimated robot pose after each odom
+//! message, stamped like it. Left as far as it got when the filter fails.
+//! @return the errors against the recorded truth
+ReplayScore ReplaySlamRun(const SlamRun &run, const NoiseConfig &config, size_t max_landmarks,
+                          std::vector<StampedPose> *trajectory = nullptr);
+
+//! @brief How a noise config did over a set of runs.
+struct TuneResult {
+  NoiseConfig config;
+  //! @brief mean over the runs
+  double trajectory_rmse = 0.0;
+  //! @brief mean over the runs
+  double landmark_rmse = 0.0;
+  //! @brief summed over the runs
+  size_t missed_landmarks = 0;
+  size_t diverged_runs = 0;
+  //! @brief trajectory_rmse + landmark_weight * landmark_rmse, infinite when
+  //! any run diverged. Lower is better.
+  double score = 0.0;
+};
+
+//! @brief Replay every run with every config and rank the configs.
+//! One job per config and run, spread over the pool.
+//! @param runs the recordings
+//! @param configs noise values to try
+//! @param max_landmarks size of the filter's landmark block
+//! @param landmark_weight weight of the landmark error in the score
+//! @param pool where the replays run
+//! @return one result per config, best score first
+std::vector<TuneResult> RankNoiseConfigs(const std::vector<SlamRun> &runs,
+                                         const std::vector<NoiseConfig> &configs,
+                                         size_t max_landmarks, double landmark_weight,
+                                         turtlelib::WorkerPool &pool);
+
+} // namespace nuslam
+
+#endif
@@ -0,0 +1,421 @@
+#include "nuslam/ekf_slam.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+#include <turtlelib/space_filling_curve.hpp>
+
+namespace nuslam {
+
+namespace {
+constexpr size_t kRobotStateSize = 3;
+constexpr size_t kLandmarkStateSize = 2;
+// Initial variance of landmarks nobody has seen yet.
+constexpr double kUnknownLandmarkVariance = 2e10;
+} // namespace
+
+EkfSlam::EkfSlam(size_t num_robots, size_t max_landmarks, double process_noise,
+                 double sensor_noise)
+    : num_robots_(num_robots), max_landmarks_(max_landmarks), process_noise_(process_noise),
+      sensor_noise_(sensor_noise),
+      state_(arma::zeros(num_robots * kRobotStateSize + max_landmarks * kLandmarkStateSize)),
+      covariance_(arma::zeros(state_.n_elem, state_.n_elem)),
+      initialized_landmark_(max_landmarks, false), slot_of_landmark_(max_landmarks),
+      landmark_of_slot_(max_landmarks) {
+  std::iota(slot_of_landmark_.begin(), slot_of_landmark_.end(), 0);
+  std::iota(landmark_of_slot_.begin(), landmark_of_slot_.end(), 0);
+  if (num_robots == 0) {
+    throw std::invalid_argument("EkfSlam needs at least one robot");
+  }
+  // Robots start at a known pose, landmarks are unknown.
+  for (size_t i = num_robots * kRobotStateSize; i < state_.n_elem; ++i) {
+    covariance_.at(i, i) = kUnknownLandmarkVariance;
+  }
+}
+
+size_t EkfSlam::NumRobots() const { return num_robots_; }
+
+size_t EkfSlam::MaxLandmarks() const { return max_landmarks_; }
+
+size_t EkfSlam::StateSize() const { return state_.n_elem; }
+
+void EkfSlam::Predict(size_t robot, const turtlelib::Transform2D &T_old_new) {
+  std::vector<std::optional<turtlelib::Transform2D>> robot_deltas(num_robots_);
+  robot_deltas.at(robot) = T_old_new;
+  PredictAll(robot_deltas);
+}
+
+void EkfSlam::PredictAll(const std::vector<std::optional<turtlelib::Transform2D>> &robot_deltas,
+                         turtlelib::WorkerPool *pool) {
+  if (robot_deltas.size() != num_robots_) {
+    throw std::invalid_argument("PredictAll needs one entry per robot");
+  }
+  const auto start = std::chrono::steady_clock::now();
+  FilterTraceRecord trace;
+  trace.kind = FilterStepKind::kPredict;
+
+  std::vector<size_t> moved;
+  for (size_t robot = 0; robot < num_robots_; ++robot) {
+    if (robot_deltas.at(robot).has_value()) {
+      moved.push_back(robot);
+      trace.robot_mask |= uint64_t{1} << (robot % 64);
+    }
+  }
+
+  // The A matrix is identity except for two entries in the robot's theta column:
+  //   A(x, theta) = -dy, A(y, theta) = dx
+  // So A * sigma * A^T only needs row and column operations on the robot's own
+  // block. Rows of different robots don't overlap, and neither do columns, so
+  // each pass runs in parallel over robots. The row pass must finish for all
+  // robots before the column pass starts.
+  auto for_each_moved = [&](const std::function<void(size_t)> &fn) {
+    auto chunk = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        fn(moved.at(i));
+      }
+    };
+    if (pool != nullptr) {
+      pool->ParallelFor(0, moved.size(), chunk);
+    } else {
+      chunk(0, moved.size());
+    }
+  };
+
+  // Row pass, this is A * sigma. Also moves the robot state itself.
+  for_each_moved([&](size_t robot) {
+    const auto &T_old_new = robot_deltas.at(robot).value();
+    const size_t r = RobotOffset(robot);
+    const double a_x = -T_old_new.translation().y;
+    const double a_y = T_old_new.translation().x;
+    covariance_.row(r + 1) += a_x * covariance_.row(r);
+    covariance_.row(r + 2) += a_y * covariance_.row(r);
+    SetRobotPose(robot, GetRobotPose(robot) * T_old_new);
+  });
+
+  // Column pass, (A * sigma) * A^T, then add the process noise.
+  for_each_moved([&](size_t robot) {
+    const auto &T_old_new = robot_deltas.at(robot).value();
+    const size_t r = RobotOffset(robot);
+    const double a_x = -T_old_new.translation().y;
+    const double a_y = T_old_new.translation().x;
+    covariance_.col(r + 1) += a_x * covariance_.col(r);
+    covariance_.col(r + 2) += a_y * covariance_.col(r);
+    for (size_t i = r; i < r + kRobotStateSize; ++i) {
+      covariance_.at(i, i) += process_noise_;
+    }
+  });
+  FinishTrace(trace, start);
+}
+
+std::vector<MeasurementPrediction>
+EkfSlam::Update(size_t robot, const std::vector<LandmarkMeasurement> &measurements) {
+  std::vector<MeasurementPrediction> predictions;
+  if (measurements.empty()) {
+    return predictions;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto &measurement : measurements) {
+    const size_t index = measurement.landmark_index;
+    if (index >= max_landmarks_) {
+      throw std::out_of_range("landmark index is larger than the filter's landmark block");
+    }
+    // Init with trusting the sensor value.
+    if (!initialized_landmark_.at(index)) {
+      state_.at(LandmarkOffset(index)) = measurement.world_guess.x + 1e-2;
+      state_.at(LandmarkOffset(index) + 1) = measurement.world_guess.y + 1e-2;
+      initialized_landmark_.at(index) = true;
+    }
+  }
+
+  // Only the robot's columns and the observed landmarks' columns of H are non
+  // zero. Collect them so the products below only read those columns of sigma.
+  const size_t r = RobotOffset(robot);
+  arma::uvec cols(kRobotStateSize + kLandmarkStateSize * measurements.size());
+  for (size_t i = 0; i < kRobotStateSize; ++i) {
+    cols.at(i) = r + i;
+  }
+  const size_t num_rows = 2 * measurements.size();
+  arma::mat h_mat(num_rows, cols.n_elem, arma::fill::zeros);
+  arma::vec err(num_rows);
+
+  const auto bot_pose = GetRobotPose(robot);
+  const double bot_x = bot_pose.translation().x;
+  const double bot_y = bot_pose.translation().y;
+  for (size_t k = 0; k < measurements.size(); ++k) {
+    const auto &measurement = measurements.at(k);
+    const size_t l = LandmarkOffset(measurement.landmark_index);
+    const size_t c = kRobotStateSize + kLandmarkStateSize * k;
+    cols.at(c) = l;
+    cols.at(c + 1) = l + 1;
+
+    const double dx = state_.at(l) - bot_x;
+    const double dy = state_.at(l + 1) - bot_y;
+    const double d = dx * dx + dy * dy;
+    const double d_rt = std::sqrt(d);
+
+    // Robot part of H_j
+    h_mat.at(2 * k, 1) = -dx / d_rt;
+    h_mat.at(2 * k, 2) = -dy / d_rt;
+    h_mat.at(2 * k + 1, 0) = -1;
+    h_mat.at(2 * k + 1, 1) = dy / d;
+    h_mat.at(2 * k + 1, 2) = -dx / d;
+    // Landmark part of H_j
+    h_mat.at(2 * k, c) = dx / d_rt;
+    h_mat.at(2 * k, c + 1) = dy / d_rt;
+    h_mat.at(2 * k + 1, c) = -dy / d;
+    h_mat.at(2 * k + 1, c + 1) = dx / d;
+
+    MeasurementPrediction prediction;
+    prediction.landmark_index = measurement.landmark_index;
+    prediction.range = d_rt;
+    prediction.bearing = turtlelib::normalize_angle(std::atan2(dy, dx) - bot_pose.rotation());
+    predictions.push_back(prediction);
+
+    err.at(2 * k) = measurement.range - prediction.range;
+    err.at(2 * k + 1) = turtlelib::normalize_angle(measurement.bearing - prediction.bearing);
+  }
+
+  // sigma is symmetric, so sigma * H^T only needs the selected columns.
+  const arma::mat sigma_ht = covariance_.cols(cols) * h_mat.t();
+  const arma::mat s_mat =
+      h_mat * sigma_ht.rows(cols) + arma::eye(num_rows, num_rows) * sensor_noise_;
+  // K = sigma * H^T * S^-1. S is symmetric, so solve for K^T instead of inverting.
+  const arma::mat k_mat = arma::solve(s_mat, sigma_ht.t()).t();
+
+  state_ += k_mat * err;
+  for (size_t i = 0; i < num_robots_; ++i) {
+    state_.at(RobotOffset(i)) = turtlelib::normalize_angle(state_.at(RobotOffset(i)));
+  }
+  // (I - K * H) * sigma = sigma - K * (sigma * H^T)^T
+  covariance_ -= k_mat * sigma_ht.t();
+  // The column trick above relies on sigma being symmetric. The huge variance of
+  // fresh landmarks makes round off pile up, so force it back.
+  covariance_ = 0.5 * (covariance_ + covariance_.t());
+
+  FilterTraceRecord trace;
+  trace.kind = FilterStepKind::kUpdate;
+  trace.robot_mask = uint64_t{1} << (robot % 64);
+  trace.num_measurements = static_cast<uint32_t>(measurements.size());
+  trace.innovation_norm = arma::norm(err);
+  // NIS stays around the measurement count while the filter is consistent.
+  trace.innovation_nis = arma::dot(err, arma::solve(s_mat, err));
+  trace.gain_norm = arma::norm(k_mat, "fro");
+  std::copy_n(err.memptr(), std::min<size_t>(err.n_elem, kTraceInnovationSize), trace.innovation);
+  FinishTrace(trace, start);
+
+  if (reorder_interval_ > 0 && ++updates_since_reorder_ >= reorder_interval_) {
+    ReorderLandmarks();
+  }
+  return predictions;
+}
+
+void EkfSlam::AssociateLandmarks(size_t robot, std::vector<LandmarkMeasurement> &measurements,
+                                 double new_landmark_distance) const {
+  const size_t r = RobotOffset(robot);
+  const auto bot_pose = GetRobotPose(robot);
+  std::vector<bool> taken = initialized_landmark_;
+  size_t next_free = 0;
+
+  // Every measurement and landmark pair under the threshold, so that a scan
+  // can give each landmark to only one of its measurements.
+  struct Candidate {
+    double distance;
+    size_t measurement;
+    size_t landmark;
+  };
+  std::vector<Candidate> candidates;
+
+  for (size_t m = 0; m < measurements.size(); ++m) {
+    const auto &measurement = measurements.at(m);
+    // Slot order walks the covariance front to back.
+    for (size_t slot = 0; slot < max_landmarks_; ++slot) {
+      const size_t k = landmark_of_slot_.at(slot);
+      if (!initialized_landmark_.at(k)) {
+        continue;
+      }
+      const size_t l = LandmarkOffset(k);
+      const double dx = state_.at(l) - bot_pose.translation().x;
+      const double dy = state_.at(l + 1) - bot_pose.translation().y;
+      const double d = dx * dx + dy * dy;
+      const double d_rt = std::sqrt(d);
+      // Same H_j as Update, over [theta x y mx my].
+      const size_t idx[5] = {r, r + 1, r + 2, l, l + 1};
+      const double h[2][5] = {{0.0, -dx / d_rt, -dy / d_rt, dx / d_rt, dy / d_rt},
+                              {-1.0, dy / d, -dx / d, -dy / d, dx / d}};
+      // S = H * sigma * H^T + R, only 2x2.
+      double s_mat[2][2] = {{sensor_noise_, 0.0}, {0.0, sensor_noise_}};
+      for (size_t a = 0; a < 2; ++a) {
+        for (size_t b = 0; b < 2; ++b) {
+          for (size_t i = 0; i < 5; ++i) {
+            for (size_t j = 0; j < 5; ++j) {
+              s_mat[a][b] += h[a][i] * covariance_.at(idx[i], idx[j]) * h[b][j];
+            }
+          }
+        }
+      }
+      const double err_range = measurement.range - d_rt;
+      const double err_bearing = turtlelib::normalize_angle(
+          measurement.bearing - (std::atan2(dy, dx) - bot_pose.rotation()));
+      const double det = s_mat[0][0] * s_mat[1][1] - s_mat[0][1] * s_mat[1][0];
+      const double distance = (s_mat[1][1] * err_range * err_range -
+                               (s_mat[0][1] + s_mat[1][0]) * err_range * err_bearing +
+                               s_mat[0][0] * err_bearing * err_bearing) /
+                              det;
+      if (distance < new_landmark_distance) {
+        candidates.push_back({distance, m, k});
+      }
+    }
+  }
+
+  // Greedy, closest pair first. Ties go by measurement then landmark index,
+  // never by slot, so reordering the slots cannot change the result.
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+    if (a.distance != b.distance) {
+      return a.distance < b.distance;
+    }
+    if (a.measurement != b.measurement) {
+      return a.measurement < b.measurement;
+    }
+    return a.landmark < b.landmark;
+  });
+  std::vector<size_t> match(measurements.size(), max_landmarks_);
+  std::vector<bool> used(max_landmarks_, false);
+  for (const auto &candidate : candidates) {
+    if (match.at(candidate.measurement) != max_landmarks_ || used.at(candidate.landmark)) {
+      continue;
+    }
+    match.at(candidate.measurement) = candidate.landmark;
+    used.at(candidate.landmark) = true;
+  }
+
+  for (size_t m = 0; m < measurements.size(); ++m) {
+    size_t best = match.at(m);
+    if (best == max_landmarks_) {
+      // New landmark, take the lowest slot nobody uses yet.
+      while (next_free < max_landmarks_ && taken.at(next_free)) {
+        ++next_free;
+      }
+      if (next_free < max_landmarks_) {
+        best = next_free;
+        taken.at(next_free) = true;
+      }
+    }
+    measurements.at(m).landmark_index = best;
+  }
+}
+
+void EkfSlam::ReorderLandmarks() {
+  updates_since_reorder_ = 0;
+  std::vector<size_t> seen;
+  std::vector<size_t> unseen;
+  std::vector<turtlelib::Point2D> points;
+  for (const size_t landmark : landmark_of_slot_) {
+    if (initialized_landmark_.at(landmark)) {
+      seen.push_back(landmark);
+      points.push_back(GetLandmark(landmark));
+    } else {
+      unseen.push_back(landmark);
+    }
+  }
+  std::vector<size_t> new_order;
+  new_order.reserve(max_landmarks_);
+  for (const size_t i : turtlelib::HilbertOrder(points)) {
+    new_order.push_back(seen.at(i));
+  }
+  new_order.insert(new_order.end(), unseen.begin(), unseen.end());
+  if (new_order == landmark_of_slot_) {
+    return;
+  }
+
+  // perm maps each new state index to the old one. Robots stay where they are.
+  const size_t base = num_robots_ * kRobotStateSize;
+  arma::uvec perm(state_.n_elem);
+  for (size_t i = 0; i < base; ++i) {
+    perm.at(i) = i;
+  }
+  for (size_t slot = 0; slot < max_landmarks_; ++slot) {
+    const size_t old_offset = LandmarkOffset(new_order.at(slot));
+    perm.at(base + kLandmarkStateSize * slot) = old_offset;
+    perm.at(base + kLandmarkStateSize * slot + 1) = old_offset + 1;
+  }
+  state_ = arma::vec(state_.elem(perm));
+  covariance_ = arma::mat(covariance_.submat(perm, perm));
+
+  landmark_of_slot_ = std::move(new_order);
+  for (size_t slot = 0; slot < max_landmarks_; ++slot) {
+    slot_of_landmark_.at(landmark_of_slot_.at(slot)) = slot;
+  }
+}
+
+void EkfSlam::SetReorderInterval(size_t updates) {
+  reorder_interval_ = updates;
+  updates_since_reorder_ = 0;
+}
+
+size_t EkfSlam::LandmarkSlot(size_t landmark) const { return slot_of_landmark_.at(landmark); }
+
+turtlelib::Transform2D EkfSlam::GetRobotPose(size_t robot) const {
+  const size_t r = RobotOffset(robot);
+  return {{state_.at(r + 1), state_.at(r + 2)}, state_.at(r)};
+}
+
+void EkfSlam::SetRobotPose(size_t robot, const turtlelib::Transform2D &pose) {
+  const size_t r = RobotOffset(robot);
+  state_.at(r) = turtlelib::normalize_angle(pose.rotation());
+  state_.at(r + 1) = pose.translation().x;
+  state_.at(r + 2) = pose.translation().y;
+}
+
+turtlelib::Point2D EkfSlam::GetLandmark(size_t landmark) const {
+  const size_t l = LandmarkOffset(landmark);
+  return {state_.at(l), state_.at(l + 1)};
+}
+
+bool EkfSlam::IsLandmarkInitialized(size_t landmark) const {
+  return initialized_landmark_.at(landmark);
+}
+
+const arma::vec &EkfSlam::GetState() const { return state_; }
+
+const arma::mat &EkfSlam::GetCovariance() const { return covariance_; }
+
+void EkfSlam::SetRecorder(FilterFlightRecorder *recorder) { recorder_ = recorder; }
+
+const FilterTraceRecord &EkfSlam::LastTrace() const { return last_trace_; }
+
+void EkfSlam::FinishTrace(FilterTraceRecord &record,
+                          std::chrono::steady_clock::time_point start) {
+  const auto end = std::chrono::steady_clock::now();
+  record.duration_us = std::chrono::duration<double, std::micro>(end - start).count();
+  record.stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+  record.state_size = static_cast<uint32_t>(state_.n_elem);
+  std::copy_n(state_.memptr(), std::min<size_t>(state_.n_elem, kTraceStateSize), record.state);
+  for (size_t i = 0; i < num_robots_ * kRobotStateSize; ++i) {
+    record.robot_covariance_trace += covariance_.at(i, i);
+  }
+  last_trace_ = record;
+  if (recorder_ != nullptr) {
+    recorder_->Push(record);
+  }
+}
+
+size_t EkfSlam::RobotOffset(size_t robot) const {
+  if (robot >= num_robots_) {
+    throw std::out_of_range("robot index out of range");
+  }
+  return robot * kRobotStateSize;
+}
+
+size_t EkfSlam::LandmarkOffset(size_t landmark) const {
+  if (landmark >= max_landmarks_) {
+    throw std::out_of_range("landmark index out of range");
+  }
+  return num_robots_ * kRobotStateSize + slot_of_landmark_[landmark] * kLandmarkStateSize;
+}
+
+} // namespace nuslam
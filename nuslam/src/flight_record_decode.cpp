@@ -0,0 +1,68 @@
+//! @file flight record decoder
+//! @brief Print a SLAM flight record, live or dumped, as CSV.
+// Usage:
+//  flight_record_decode <record file> [--state]
+//  --state adds the recorded state and innovation entries to each row.
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "nuslam/filter_trace.hpp"
+
+namespace {
+
+const char *KindName(nuslam::FilterStepKind kind) {
+  switch (kind) {
+  case nuslam::FilterStepKind::kPredict:
+    return "predict";
+  case nuslam::FilterStepKind::kUpdate:
+    return "update";
+  }
+  return "unknown";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <record file> [--state]\n";
+    return 1;
+  }
+  const bool with_state = argc > 2 && std::strcmp(argv[2], "--state") == 0;
+
+  try {
+    const auto records = turtlelib::ReadFlightRecord<nuslam::FilterTraceRecord>(argv[1]);
+    std::cout << "stamp_ns,kind,robot_mask,state_size,num_measurements,duration_us,"
+                 "innovation_norm,innovation_nis,gain_norm,robot_covariance_trace";
+    if (with_state) {
+      std::cout << ",state...,innovation...";
+    }
+    std::cout << "\n" << std::setprecision(9);
+    for (const auto &record : records) {
+      std::cout << record.stamp_ns << "," << KindName(record.kind) << "," << record.robot_mask
+                << "," << record.state_size << "," << record.num_measurements << ","
+                << record.duration_us << "," << record.innovation_norm << ","
+                << record.innovation_nis << "," << record.gain_norm << ","
+                << record.robot_covariance_trace;
+      if (with_state) {
+        for (size_t i = 0; i < std::min<size_t>(record.state_size, nuslam::kTraceStateSize); ++i) {
+          std::cout << "," << record.state[i];
+        }
+        for (size_t i = 0;
+             i < std::min<size_t>(2 * record.num_measurements, nuslam::kTraceInnovationSize); ++i) {
+          std::cout << "," << record.innovation[i];
+        }
+      }
+      std::cout << "\n";
+    }
+    std::cerr << records.size() << " records\n";
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+//! @file scan matching odometry node
+//! @brief Estimate robot motion by matching consecutive laser scans with ICP.
+//! The scan frame is taken to be the body frame, as in nusim.
+// Parameters:
+//  odom_id - string: name of the odom frame of the published odometry
+//  body_id - string: name of the body frame of the published odometry
+//  keyframe_distance - double: distance from the keyframe that makes a new one
+//  keyframe_angle - double: rotation from the keyframe that makes a new one
+//  max_iterations - int: upper bound on ICP iterations per scan
+//  max_correspondence_distance - double: point pairs further apart are not used
+//  min_correspondences - int: fewer point pairs than this means no match
+
+// Publishers:
+//  icp_odom - nav_msgs::msg::Odometry : pose of the body in odom_id from scan
+//  matching, with the twist between the last two scans. Has the same form as
+//  the wheel odometry so slam can use it in its place.
+
+// Subscriber:
+//  scan - sensor_msgs::msg::LaserScan : the scan to match
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nav_msgs/msg/odometry.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <turtlelib/icp.hpp>
+
+#include <leo_ros_utils/math_helper.hpp>
+#include <leo_ros_utils/param_helper.hpp>
+
+using leo_ros_utils::GetParam;
+
+class IcpOdometry : public rclcpp::Node {
+public:
+  IcpOdometry() : Node("icp_odometry"), matcher_(MakeParams()) {
+    odom_id_ = GetParam<std::string>(*this, "odom_id", "name of the odom frame", "icp_odom");
+    body_id_ = GetParam<std::string>(*this, "body_id", "name of the body frame",
+                                     "blue/base_footprint");
+    keyframe_distance_ = GetParam<double>(*this, "keyframe_distance",
+                                          "distance from the keyframe that makes a new one", 0.1);
+    keyframe_angle_ = GetParam<double>(*this, "keyframe_angle",
+                                       "rotation from the keyframe that makes a new one", 0.1);
+    odom_pub_ = create_publisher<nav_msgs::msg::Odometry>("icp_odom", 10);
+    scan_sub_ = create_subscription<sensor_msgs::msg::LaserScan>(
+        "scan", rclcpp::SensorDataQoS(),
+        std::bind(&IcpOdometry::ScanCb, this, std::placeholders::_1));
+  }
+
+  void ScanCb(const sensor_msgs::msg::LaserScan &scan) {
+    turtlelib::ScanToPoints(scan.ranges, scan.angle_min, scan.angle_increment, scan.range_min,
+                            scan.range_max, x_, y_);
+    const double stamp = rclcpp::Time{scan.header.stamp}.seconds();
+    if (!matcher_.HasReference()) {
+      matcher_.SetReference(x_, y_);
+      last_stamp_ = stamp;
+      Publish(scan.header.stamp, turtlelib::Transform2D{}, 0.0);
+      return;
+    }
+
+    // Matching against a keyframe instead of the last scan keeps the drift of
+    // a standing robot at zero. The last motion is the guess for the next.
+    const auto start = std::chrono::steady_clock::now();
+    const auto guess = T_key_last_ * T_last_motion_;
+    const auto result = matcher_.Match(x_, y_, guess);
+    RCLCPP_DEBUG_STREAM(get_logger(),
+                        "ICP " << result.iterations << " iterations, " << result.correspondences
+                               << " pairs, rms " << result.rms_error << " in "
+                               << std::chrono::duration<double, std::micro>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count()
+                               << " us");
+
+    turtlelib::Transform2D T_key_scan = guess;
+    if (result.valid) {
+      T_key_scan = result.T_ref_scan;
+    } else {
+      RCLCPP_WARN_STREAM_THROTTLE(get_logger(), *get_clock(), 1000,
+                                  "ICP found only " << result.correspondences
+                                                    << " pairs, extrapolating");
+    }
+    T_last_motion_ = T_key_last_.inv() * T_key_scan;
+    T_key_last_ = T_key_scan;
+
+    const double dt = stamp - last_stamp_;
+    last_stamp_ = stamp;
+    Publish(scan.header.stamp, T_last_motion_, dt);
+
+    const auto offset = T_key_last_.translation();
+    if (!result.valid || std::hypot(offset.x, offset.y) > keyframe_distance_ ||
+        std::abs(T_key_last_.rotation()) > keyframe_angle_) {
+      T_odom_key_ = T_odom_key_ * T_key_last_;
+      T_key_last_ = turtlelib::Transform2D{};
+      matcher_.SetReference(x_, y_);
+    }
+  }
+
+private:
+  turtlelib::IcpParams MakeParams() {
+    turtlelib::IcpParams params;
+    params.max_iterations =
+        GetParam<int>(*this, "max_iterations", "upper bound on ICP iterations",
+                      static_cast<int>(params.max_iterations));
+    params.max_correspondence_distance =
+        GetParam<double>(*this, "max_correspondence_distance",
+                         "point pairs further apart are not used",
+                         params.max_correspondence_distance);
+    params.min_correspondences =
+        GetParam<int>(*this, "min_correspondences", "fewer point pairs means no match",
+                      static_cast<int>(params.min_correspondences));
+    return params;
+  }
+
+  //! @brief Publish the current pose, with the twist of the last motion.
+  void Publish(const builtin_interfaces::msg::Time &stamp, const turtlelib::Transform2D &motion,
+               double dt) {
+    nav_msgs::msg::Odometry odom_msg;
+    odom_msg.header.stamp = stamp;
+    odom_msg.header.frame_id = odom_id_;
+    odom_msg.child_frame_id = body_id_;
+    odom_msg.pose.pose = leo_ros_utils::Convert(T_odom_key_ * T_key_last_);
+    if (dt > 0.0) {
+      // Twist in the body frame, as in nav_msgs.
+      odom_msg.twist.twist.linear.x = motion.translation().x / dt;
+      odom_msg.twist.twist.linear.y = motion.translation().y / dt;
+      odom_msg.twist.twist.angular.z = motion.rotation() / dt;
+    }
+    odom_pub_->publish(odom_msg);
+  }
+
+  turtlelib::ScanMatcher matcher_;
+  std::string odom_id_;
+  std::string body_id_;
+  double keyframe_distance_;
+  double keyframe_angle_;
+
+  turtlelib::Transform2D T_odom_key_;
+  turtlelib::Transform2D T_key_last_;
+  turtlelib::Transform2D T_last_motion_;
+  double last_stamp_ = 0.0;
+  // Reused between scans.
+  std::vector<double> x_;
+  std::vector<double> y_;
+
+  rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr odom_pub_;
+  rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr scan_sub_;
+};
+
+int main(int argc, char *argv[]) {
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<IcpOdometry>());
+  rclcpp::shutdown();
+  return 0;
+}
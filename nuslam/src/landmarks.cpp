@@ -0,0 +1,113 @@
+//! @file landmark detection node
+//! @brief Find cylindrical landmarks in laser scans and publish them as
+//! markers the slam node reads.
+// Parameters:
+//  cluster_threshold - double: neighbouring points further apart start a new cluster
+//  min_cluster_points - int: smaller clusters are ignored
+//  min_radius - double: smallest radius accepted as a landmark
+//  max_radius - double: largest radius accepted as a landmark
+//  max_rms_residual - double: largest rms distance of points from the circle
+
+// Publishers:
+//  landmarks - visualization_msgs::msg::MarkerArray : one cylinder per detected
+//  landmark, in the scan frame. Ids carry no landmark identity, slam matches
+//  them to its map with data association.
+
+// Subscriber:
+//  scan - sensor_msgs::msg::LaserScan : the scan to process
+
+#include <chrono>
+#include <memory>
+
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <turtlelib/circle_fit.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+
+#include <leo_ros_utils/param_helper.hpp>
+
+using leo_ros_utils::GetParam;
+
+namespace {
+// Same as nusim and slam.
+constexpr int32_t kFakeSenorStartingID = 50;
+} // namespace
+
+class Landmarks : public rclcpp::Node {
+public:
+  Landmarks() : Node("landmarks"), detector_(MakeParams()) {
+    landmark_pub_ = create_publisher<visualization_msgs::msg::MarkerArray>("landmarks", 10);
+    scan_sub_ = create_subscription<sensor_msgs::msg::LaserScan>(
+        "scan", rclcpp::SensorDataQoS(),
+        std::bind(&Landmarks::ScanCb, this, std::placeholders::_1));
+  }
+
+  void ScanCb(const sensor_msgs::msg::LaserScan &scan) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto &found = detector_.Detect(scan.ranges, scan.angle_min, scan.angle_increment,
+                                         scan.range_min, scan.range_max);
+    RCLCPP_DEBUG_STREAM(get_logger(),
+                        found.size() << " landmarks from " << detector_.Clusters().size()
+                                     << " clusters in "
+                                     << std::chrono::duration<double, std::micro>(
+                                            std::chrono::steady_clock::now() - start)
+                                            .count()
+                                     << " us");
+
+    visualization_msgs::msg::MarkerArray msg;
+    // Clear the last scan's markers, the number of landmarks changes per scan.
+    visualization_msgs::msg::Marker clear;
+    clear.header = scan.header;
+    clear.action = clear.DELETEALL;
+    msg.markers.push_back(clear);
+    int32_t id = kFakeSenorStartingID;
+    for (const auto &landmark : found) {
+      visualization_msgs::msg::Marker marker;
+      marker.header = scan.header;
+      marker.ns = "detected";
+      marker.id = id++;
+      marker.type = marker.CYLINDER;
+      marker.action = marker.ADD;
+      marker.pose.position.x = landmark.circle.center.x;
+      marker.pose.position.y = landmark.circle.center.y;
+      marker.pose.position.z = 0.2;
+      marker.scale.x = 2.0 * landmark.circle.radius;
+      marker.scale.y = 2.0 * landmark.circle.radius;
+      marker.scale.z = 0.4;
+      marker.color.b = 1.0;
+      marker.color.a = 0.6;
+      msg.markers.push_back(marker);
+    }
+    landmark_pub_->publish(msg);
+  }
+
+private:
+  turtlelib::LandmarkDetectorParams MakeParams() {
+    turtlelib::LandmarkDetectorParams params;
+    params.cluster_threshold =
+        GetParam<double>(*this, "cluster_threshold", "max gap between points of a cluster",
+                         params.cluster_threshold);
+    params.min_cluster_points = GetParam<int>(*this, "min_cluster_points",
+                                              "smallest cluster that is fitted",
+                                              static_cast<int>(params.min_cluster_points));
+    params.min_radius =
+        GetParam<double>(*this, "min_radius", "smallest landmark radius", params.min_radius);
+    params.max_radius =
+        GetParam<double>(*this, "max_radius", "largest landmark radius", params.max_radius);
+    params.max_rms_residual =
+        GetParam<double>(*this, "max_rms_residual", "largest rms distance from the circle",
+                         params.max_rms_residual);
+    return params;
+  }
+
+  turtlelib::LandmarkDetector detector_;
+  rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr landmark_pub_;
+  rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr scan_sub_;
+};
+
+int main(int argc, char *argv[]) {
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<Landmarks>());
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,224 @@
+//! @file Monte Carlo localization node
+//! @brief Localize the robot in the known arena with the laser scan, using a
+//! particle filter over a precomputed likelihood field.
+//! The scan frame is taken to be the body frame, as in nusim.
+// Parameters:
+//  arena_x_length - double: x length of the arena, as in nusim
+//  arena_y_length - double: y length of the arena, as in nusim
+//  obstacles/x - vector<double>: obstacle x coordinates, as in nusim
+//  obstacles/y - vector<double>: obstacle y coordinates, as in nusim
+//  obstacles/r - double: obstacle radius, as in nusim
+//  x0, y0, theta0 - double: initial pose guess, as in nusim
+//  global_localization - bool: spread particles over the whole arena instead
+//  of around the initial pose
+//  initial_sigma_xy - double: spread of the initial particles (m)
+//  initial_sigma_theta - double: spread of the initial particles (rad)
+//  map_resolution - double: cell size of the likelihood field (m)
+//  sigma_hit - double: standard deviation of a beam end around an obstacle
+//  z_hit - double: weight of the hit component of the beam model
+//  z_rand - double: weight of the random component of the beam model
+//  min_particles - int: fewest particles KLD sampling keeps
+//  max_particles - int: most particles, and the initial count
+//  kld_error - double: KLD bound on the error of the sampled distribution
+//  beam_skip - int: use every beam_skip-th beam
+//  update_min_distance - double: travel needed before the next update (m)
+//  update_min_angle - double: rotation needed before the next update (rad)
+//  threads - int: threads scoring particles, 0 for auto
+
+// Publishers:
+//  ~/pose - geometry_msgs::msg::PoseStamped : weighted mean of the particles
+//  ~/particles - geometry_msgs::msg::PoseArray : all particles
+
+// Subscriber:
+//  odom - nav_msgs::msg::Odometry : motion between scans
+//  scan - sensor_msgs::msg::LaserScan : the scan to localize with
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/msg/pose_array.hpp>
+#include <geometry_msgs/msg/pose_stamped.hpp>
+#include <nav_msgs/msg/odometry.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <turtlelib/likelihood_field.hpp>
+#include <turtlelib/mcl.hpp>
+#include <turtlelib/worker_pool.hpp>
+
+#include <leo_ros_utils/math_helper.hpp>
+#include <leo_ros_utils/param_helper.hpp>
+
+using leo_ros_utils::GetParam;
+
+namespace {
+// Same as nusim.
+const std::string kWorldFrame = "nusim/world";
+// Space around the walls kept in the map, beams end a bit past them.
+constexpr double kMapMargin = 0.25;
+} // namespace
+
+class Mcl : public rclcpp::Node {
+public:
+  Mcl()
+      : Node("mcl"),
+        pool_(static_cast<size_t>(GetParam<int>(*this, "threads", "threads scoring particles", 0))),
+        filter_(MakeField(), MakeParams(), &pool_) {
+    update_min_distance_ = GetParam<double>(*this, "update_min_distance",
+                                            "travel needed before the next update", 0.02);
+    update_min_angle_ = GetParam<double>(*this, "update_min_angle",
+                                         "rotation needed before the next update", 0.05);
+    const turtlelib::Transform2D initial{
+        {GetParam<double>(*this, "x0", "initial x", 0.0),
+         GetParam<double>(*this, "y0", "initial y", 0.0)},
+        GetParam<double>(*this, "theta0", "initial theta", 0.0)};
+    const double sigma_xy =
+        GetParam<double>(*this, "initial_sigma_xy", "spread of the initial particles", 0.1);
+    const double sigma_theta =
+        GetParam<double>(*this, "initial_sigma_theta", "spread of the initial particles", 0.1);
+    if (GetParam<bool>(*this, "global_localization", "particles over the whole arena", false)) {
+      filter_.InitializeUniform({-arena_x_ / 2.0, -arena_y_ / 2.0},
+                                {arena_x_ / 2.0, arena_y_ / 2.0});
+    } else {
+      filter_.Initialize(initial, sigma_xy, sigma_theta);
+    }
+
+    pose_pub_ = create_publisher<geometry_msgs::msg::PoseStamped>("~/pose", 10);
+    particle_pub_ = create_publisher<geometry_msgs::msg::PoseArray>("~/particles", 10);
+    odom_sub_ = create_subscription<nav_msgs::msg::Odometry>(
+        "odom", 10, std::bind(&Mcl::OdomCb, this, std::placeholders::_1));
+    scan_sub_ = create_subscription<sensor_msgs::msg::LaserScan>(
+        "scan", rclcpp::SensorDataQoS(), std::bind(&Mcl::ScanCb, this, std::placeholders::_1));
+    RCLCPP_INFO_STREAM(get_logger(), "MCL with " << filter_.Size() << " particles on "
+                                                 << pool_.Size() << " threads");
+  }
+
+  void OdomCb(const nav_msgs::msg::Odometry &odom) {
+    T_odom_robot_ = leo_ros_utils::ConvertBack(odom.pose.pose);
+  }
+
+  void ScanCb(const sensor_msgs::msg::LaserScan &scan) {
+    if (!T_odom_robot_) {
+      return;
+    }
+    if (!T_odom_last_update_) {
+      T_odom_last_update_ = T_odom_robot_;
+    }
+    const auto motion = T_odom_last_update_->inv() * *T_odom_robot_;
+    const auto moved = motion.translation();
+    const bool first = !updated_once_;
+    if (!first && std::hypot(moved.x, moved.y) < update_min_distance_ &&
+        std::abs(motion.rotation()) < update_min_angle_) {
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    filter_.Predict(motion);
+    filter_.Update(scan.ranges, scan.angle_min, scan.angle_increment, scan.range_min,
+                   scan.range_max);
+    filter_.Resample();
+    T_odom_last_update_ = T_odom_robot_;
+    updated_once_ = true;
+    RCLCPP_DEBUG_STREAM(get_logger(), "MCL update of " << filter_.Size() << " particles in "
+                                                       << std::chrono::duration<double, std::micro>(
+                                                              std::chrono::steady_clock::now() -
+                                                              start)
+                                                              .count()
+                                                       << " us");
+    Publish(scan.header.stamp);
+  }
+
+private:
+  std::shared_ptr<const turtlelib::LikelihoodField> MakeField() {
+    arena_x_ = GetParam<double>(*this, "arena_x_length", "x length of arena", 5.0);
+    arena_y_ = GetParam<double>(*this, "arena_y_length", "y length of arena", 3.0);
+    const auto obstacles_x =
+        GetParam<std::vector<double>>(*this, "obstacles/x", "obstacle x", std::vector<double>{});
+    const auto obstacles_y =
+        GetParam<std::vector<double>>(*this, "obstacles/y", "obstacle y", std::vector<double>{});
+    const double obstacles_r = GetParam<double>(*this, "obstacles/r", "obstacle radius", 0.038);
+    if (obstacles_x.size() != obstacles_y.size()) {
+      throw std::invalid_argument("obstacles/x and obstacles/y must be the same length");
+    }
+    const double resolution =
+        GetParam<double>(*this, "map_resolution", "cell size of the likelihood field", 0.02);
+    turtlelib::LikelihoodFieldParams params;
+    params.sigma_hit = GetParam<double>(*this, "sigma_hit", "beam end spread", params.sigma_hit);
+    params.z_hit = GetParam<double>(*this, "z_hit", "hit weight", params.z_hit);
+    params.z_rand = GetParam<double>(*this, "z_rand", "random weight", params.z_rand);
+
+    // Rasterize the walls and obstacles, the same world nusim simulates.
+    const turtlelib::Point2D origin{-arena_x_ / 2.0 - kMapMargin, -arena_y_ / 2.0 - kMapMargin};
+    const auto width = static_cast<size_t>(std::ceil((arena_x_ + 2.0 * kMapMargin) / resolution));
+    const auto height = static_cast<size_t>(std::ceil((arena_y_ + 2.0 * kMapMargin) / resolution));
+    std::vector<uint8_t> occupied(width * height, 0);
+    for (size_t row = 0; row < height; ++row) {
+      for (size_t col = 0; col < width; ++col) {
+        const double x = origin.x + (col + 0.5) * resolution;
+        const double y = origin.y + (row + 0.5) * resolution;
+        bool hit = std::abs(std::abs(x) - arena_x_ / 2.0) < 0.5 * resolution ||
+                   std::abs(std::abs(y) - arena_y_ / 2.0) < 0.5 * resolution;
+        for (size_t i = 0; i < obstacles_x.size() && !hit; ++i) {
+          hit = std::hypot(x - obstacles_x[i], y - obstacles_y[i]) < obstacles_r;
+        }
+        occupied[row * width + col] = hit ? 1 : 0;
+      }
+    }
+    return std::make_shared<turtlelib::LikelihoodField>(occupied, width, height, resolution,
+                                                        origin, params);
+  }
+
+  turtlelib::MclParams MakeParams() {
+    turtlelib::MclParams params;
+    params.min_particles = GetParam<int>(*this, "min_particles", "fewest particles",
+                                         static_cast<int>(params.min_particles));
+    params.max_particles = GetParam<int>(*this, "max_particles", "most particles",
+                                         static_cast<int>(params.max_particles));
+    params.kld_error = GetParam<double>(*this, "kld_error", "KLD sampling error bound",
+                                        params.kld_error);
+    params.beam_skip = GetParam<int>(*this, "beam_skip", "use every beam_skip-th beam",
+                                     static_cast<int>(params.beam_skip));
+    return params;
+  }
+
+  void Publish(const builtin_interfaces::msg::Time &stamp) {
+    geometry_msgs::msg::PoseStamped pose;
+    pose.header.stamp = stamp;
+    pose.header.frame_id = kWorldFrame;
+    pose.pose = leo_ros_utils::Convert(filter_.Estimate());
+    pose_pub_->publish(pose);
+
+    geometry_msgs::msg::PoseArray particles;
+    particles.header = pose.header;
+    particles.poses.reserve(filter_.Size());
+    for (size_t i = 0; i < filter_.Size(); ++i) {
+      particles.poses.push_back(leo_ros_utils::Convert(
+          turtlelib::Transform2D{{filter_.X()[i], filter_.Y()[i]}, filter_.Theta()[i]}));
+    }
+    particle_pub_->publish(particles);
+  }
+
+  double arena_x_;
+  double arena_y_;
+  turtlelib::WorkerPool pool_;
+  turtlelib::ParticleFilter filter_;
+  double update_min_distance_;
+  double update_min_angle_;
+  bool updated_once_ = false;
+  std::optional<turtlelib::Transform2D> T_odom_robot_;
+  std::optional<turtlelib::Transform2D> T_odom_last_update_;
+
+  rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr pose_pub_;
+  rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr particle_pub_;
+  rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub_;
+  rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr scan_sub_;
+};
+
+int main(int argc, char *argv[]) {
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<Mcl>());
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,212 @@
+//! @file occupancy grid mapping node
+//! @brief Ray trace laser scans into a tiled log-odds occupancy grid, and
+//! publish only the tiles that changed.
+// Parameters:
+//  map_frame - string: frame of the map, the scan pose is looked up in tf
+//  resolution - double: cell side length (m)
+//  log_odds_hit - double: log-odds added where a beam ends
+//  log_odds_miss - double: log-odds added along a beam
+//  log_odds_limit - double: log-odds cells saturate at
+//  compact_cells - bool: int8 cells instead of int16, half the memory but
+//  coarser log-odds steps
+//  max_hit_range - double: ranges at or beyond this only clear space. 0 uses
+//  the range_max of the scan.
+//  publish_rate - double: rate of map publishing (hz), positive
+//  full_map_every - int: publish the full map every N publishes, so late
+//  subscribers catch up. The full map is also sent whenever the map grows.
+
+// Publishers:
+//  map - nav_msgs::msg::OccupancyGrid : the full map, transient local
+//  map_updates - map_msgs::msg::OccupancyGridUpdate : one per tile changed
+//  since the last publish, relative to the last full map
+
+// Subscriber:
+//  scan - sensor_msgs::msg::LaserScan : the scans to map
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <map_msgs/msg/occupancy_grid_update.hpp>
+#include <nav_msgs/msg/occupancy_grid.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/laser_scan.hpp>
+#include <tf2/exceptions.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <turtlelib/occupancy_grid.hpp>
+
+#include <leo_ros_utils/math_helper.hpp>
+#include <leo_ros_utils/param_helper.hpp>
+
+using leo_ros_utils::GetParam;
+
+namespace {
+// Same as nusim.
+const std::string kWorldFrame = "nusim/world";
+} // namespace
+
+class OccupancyMapper : public rclcpp::Node {
+public:
+  OccupancyMapper() : Node("occupancy_mapper") {
+    map_frame_ = GetParam<std::string>(*this, "map_frame", "frame of the map", kWorldFrame);
+    turtlelib::OccupancyGridParams params;
+    params.resolution =
+        GetParam<double>(*this, "resolution", "cell side length", params.resolution);
+    params.log_odds_hit =
+        GetParam<double>(*this, "log_odds_hit", "log-odds where a beam ends", params.log_odds_hit);
+    params.log_odds_miss = GetParam<double>(*this, "log_odds_miss", "log-odds along a beam",
+                                            params.log_odds_miss);
+    params.log_odds_limit = GetParam<double>(*this, "log_odds_limit",
+                                             "log-odds cells saturate at", params.log_odds_limit);
+    if (GetParam<bool>(*this, "compact_cells", "int8 cells instead of int16", false)) {
+      grid_.emplace<turtlelib::TiledLogOddsGrid<int8_t>>(params);
+    } else {
+      grid_.emplace<turtlelib::TiledLogOddsGrid<int16_t>>(params);
+    }
+    max_hit_range_ = GetParam<double>(*this, "max_hit_range",
+                                      "ranges at or beyond this only clear space", 0.0);
+    full_map_every_ = GetParam<int>(*this, "full_map_every", "publishes between full maps", 20);
+    const double publish_rate = GetParam<double>(*this, "publish_rate", "map publish rate", 2.0);
+    if (!(publish_rate > 0.0)) {
+      throw std::invalid_argument("publish_rate must be positive");
+    }
+
+    tf_buffer_ = std::make_unique<tf2_ros::Buffer>(get_clock());
+    tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_);
+    map_pub_ = create_publisher<nav_msgs::msg::OccupancyGrid>(
+        "map", rclcpp::QoS(1).reliable().transient_local());
+    update_pub_ = create_publisher<map_msgs::msg::OccupancyGridUpdate>("map_updates", 10);
+    scan_sub_ = create_subscription<sensor_msgs::msg::LaserScan>(
+        "scan", rclcpp::SensorDataQoS(),
+        std::bind(&OccupancyMapper::ScanCb, this, std::placeholders::_1));
+    publish_timer_ =
+        rclcpp::create_timer(this, get_clock(), std::chrono::duration<double>(1.0 / publish_rate),
+                             std::bind(&OccupancyMapper::PublishTimerStep, this));
+  }
+
+  void ScanCb(const sensor_msgs::msg::LaserScan &scan) {
+    geometry_msgs::msg::TransformStamped T_map_scan_msg;
+    try {
+      T_map_scan_msg =
+          tf_buffer_->lookupTransform(map_frame_, scan.header.frame_id, scan.header.stamp);
+    } catch (const tf2::TransformException &ex) {
+      RCLCPP_WARN_STREAM_THROTTLE(get_logger(), *get_clock(), 1000,
+                                  "No pose for scan, dropping it: " << ex.what());
+      return;
+    }
+    geometry_msgs::msg::Pose pose;
+    pose.position.x = T_map_scan_msg.transform.translation.x;
+    pose.position.y = T_map_scan_msg.transform.translation.y;
+    pose.orientation = T_map_scan_msg.transform.rotation;
+    const auto T_map_scan = leo_ros_utils::ConvertBack(pose);
+    const double range_max = max_hit_range_ > 0.0
+                                 ? std::min<double>(max_hit_range_, scan.range_max)
+                                 : scan.range_max;
+    std::visit(
+        [&](auto &grid) {
+          grid.InsertScan(T_map_scan, scan.ranges, scan.angle_min, scan.angle_increment,
+                          scan.range_min, range_max);
+        },
+        grid_);
+    stamp_ = scan.header.stamp;
+  }
+
+  void PublishTimerStep() {
+    std::visit([this](auto &grid) { Publish(grid); }, grid_);
+  }
+
+private:
+  template <typename Grid> void Publish(Grid &grid) {
+    const auto dirty = grid.TakeDirtyTiles();
+    if (dirty.empty()) {
+      return;
+    }
+    turtlelib::GridIndex min;
+    turtlelib::GridIndex max;
+    grid.TileBounds(min, max);
+    const bool grown = !published_ || min.x != map_min_.x || min.y != map_min_.y ||
+                       max.x != map_max_.x || max.y != map_max_.y;
+    if (grown || ++publishes_since_full_ >= full_map_every_) {
+      PublishFull(grid, min, max);
+      return;
+    }
+    // Updates are placed relative to the origin of the last full map.
+    for (const auto &tile : dirty) {
+      map_msgs::msg::OccupancyGridUpdate update;
+      update.header.stamp = stamp_;
+      update.header.frame_id = map_frame_;
+      update.x = (tile.x - map_min_.x) * Grid::kTileSize;
+      update.y = (tile.y - map_min_.y) * Grid::kTileSize;
+      update.width = Grid::kTileSize;
+      update.height = Grid::kTileSize;
+      grid.TileOccupancy(tile, tile_buffer_);
+      update.data.assign(tile_buffer_.begin(), tile_buffer_.end());
+      update_pub_->publish(update);
+    }
+  }
+
+  template <typename Grid>
+  void PublishFull(const Grid &grid, turtlelib::GridIndex min, turtlelib::GridIndex max) {
+    const double resolution = grid.Params().resolution;
+    const size_t width = static_cast<size_t>(max.x - min.x + 1) * Grid::kTileSize;
+    const size_t height = static_cast<size_t>(max.y - min.y + 1) * Grid::kTileSize;
+    nav_msgs::msg::OccupancyGrid map;
+    map.header.stamp = stamp_;
+    map.header.frame_id = map_frame_;
+    map.info.map_load_time = stamp_;
+    map.info.resolution = static_cast<float>(resolution);
+    map.info.width = static_cast<uint32_t>(width);
+    map.info.height = static_cast<uint32_t>(height);
+    map.info.origin.position.x = min.x * Grid::kTileSize * resolution;
+    map.info.origin.position.y = min.y * Grid::kTileSize * resolution;
+    map.info.origin.orientation.w = 1.0;
+    map.data.assign(width * height, -1);
+    for (const auto &tile : grid.Tiles()) {
+      grid.TileOccupancy(tile, tile_buffer_);
+      const size_t x0 = static_cast<size_t>(tile.x - min.x) * Grid::kTileSize;
+      const size_t y0 = static_cast<size_t>(tile.y - min.y) * Grid::kTileSize;
+      for (int32_t row = 0; row < Grid::kTileSize; ++row) {
+        std::copy_n(tile_buffer_.begin() + row * Grid::kTileSize, Grid::kTileSize,
+                    map.data.begin() + (y0 + row) * width + x0);
+      }
+    }
+    map_pub_->publish(map);
+    published_ = true;
+    map_min_ = min;
+    map_max_ = max;
+    publishes_since_full_ = 0;
+  }
+
+  std::string map_frame_;
+  double max_hit_range_;
+  int full_map_every_;
+  std::variant<turtlelib::TiledLogOddsGrid<int16_t>, turtlelib::TiledLogOddsGrid<int8_t>> grid_;
+  builtin_interfaces::msg::Time stamp_;
+
+  // Extent of the last full map, updates are relative to it.
+  bool published_ = false;
+  turtlelib::GridIndex map_min_;
+  turtlelib::GridIndex map_max_;
+  int publishes_since_full_ = 0;
+  std::vector<int8_t> tile_buffer_;
+
+  std::unique_ptr<tf2_ros::Buffer> tf_buffer_;
+  std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
+  rclcpp::Publisher<nav_msgs::msg::OccupancyGrid>::SharedPtr map_pub_;
+  rclcpp::Publisher<map_msgs::msg::OccupancyGridUpdate>::SharedPtr update_pub_;
+  rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr scan_sub_;
+  rclcpp::TimerBase::SharedPtr publish_timer_;
+};
+
+int main(int argc, char *argv[]) {
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<OccupancyMapper>());
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,109 @@
+//! @file run recorder node
+//! @brief Record odometry, landmark observations and simulator truth to a run
+//! file for offline tuning with slam_tuner.
+// Parameters:
+//  run_file - string: file the run is written to
+//  truth_path_topic - string: path of the true robot pose (red/path)
+//  obstacles_topic - string: true landmark markers (/nusim/obstacles)
+
+// Subscriber:
+//  odom - nav_msgs::msg::Odometry : odometry the filter predicts with
+//  /fake_sensor - visualization_msgs::msg::MarkerArray : landmark observations
+//  red/path - nav_msgs::msg::Path : true robot pose, newest pose is used
+//  /nusim/obstacles - visualization_msgs::msg::MarkerArray : true landmarks
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <nav_msgs/msg/odometry.hpp>
+#include <nav_msgs/msg/path.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <turtlelib/geometry2d.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+
+#include <leo_ros_utils/math_helper.hpp>
+#include <leo_ros_utils/param_helper.hpp>
+
+#include "nuslam/slam_run.hpp"
+
+using leo_ros_utils::GetParam;
+
+namespace {
+// Same as nusim and slam.
+constexpr int32_t kFakeSenorStartingID = 50;
+} // namespace
+
+class RunRecorder : public rclcpp::Node {
+public:
+  RunRecorder()
+      : Node("run_recorder"),
+        run_file_(GetParam<std::string>(*this, "run_file", "file the run is written to")) {
+    auto transient_local_qos = rclcpp::QoS(rclcpp::KeepLast(2)).transient_local();
+
+    odom_sub_ = create_subscription<nav_msgs::msg::Odometry>(
+        "odom", 100, [this](const nav_msgs::msg::Odometry &msg) {
+          run_.odom.push_back({rclcpp::Time(msg.header.stamp).seconds(),
+                               leo_ros_utils::ConvertBack(msg.pose.pose)});
+        });
+    sensor_sub_ = create_subscription<visualization_msgs::msg::MarkerArray>(
+        "/fake_sensor", 10, [this](const visualization_msgs::msg::MarkerArray &msg) {
+          for (const auto &marker : msg.markers) {
+            if (marker.action == marker.DELETE) {
+              continue;
+            }
+            run_.observations.push_back(
+                {rclcpp::Time(marker.header.stamp).seconds(),
+                 static_cast<size_t>(marker.id - kFakeSenorStartingID),
+                 turtlelib::Point2D{marker.pose.position.x, marker.pose.position.y}});
+          }
+        });
+    truth_sub_ = create_subscription<nav_msgs::msg::Path>(
+        GetParam<std::string>(*this, "truth_path_topic", "path of the true robot pose",
+                              "red/path"),
+        10, [this](const nav_msgs::msg::Path &msg) {
+          if (msg.poses.empty()) {
+            return;
+          }
+          const auto &newest = msg.poses.back();
+          run_.truth.push_back({rclcpp::Time(newest.header.stamp).seconds(),
+                                leo_ros_utils::ConvertBack(newest.pose)});
+        });
+    obstacles_sub_ = create_subscription<visualization_msgs::msg::MarkerArray>(
+        GetParam<std::string>(*this, "obstacles_topic", "true landmark markers",
+                              "/nusim/obstacles"),
+        transient_local_qos, [this](const visualization_msgs::msg::MarkerArray &msg) {
+          // Obstacles are listed in landmark index order.
+          run_.landmark_truth.clear();
+          for (size_t i = 0; i < msg.markers.size(); ++i) {
+            const auto &marker = msg.markers.at(i);
+            run_.landmark_truth[i] = {marker.pose.position.x, marker.pose.position.y};
+          }
+        });
+  }
+
+  ~RunRecorder() {
+    std::ofstream out(run_file_);
+    nuslam::WriteSlamRun(out, run_);
+    RCLCPP_INFO_STREAM(get_logger(), "Wrote " << run_.odom.size() << " odom, "
+                                              << run_.observations.size() << " observations to "
+                                              << run_file_);
+  }
+
+private:
+  std::string run_file_;
+  nuslam::SlamRun run_;
+
+  rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub_;
+  rclcpp::Subscription<visualization_msgs::msg::MarkerArray>::SharedPtr sensor_sub_;
+  rclcpp::Subscription<nav_msgs::msg::Path>::SharedPtr truth_sub_;
+  rclcpp::Subscription<visualization_msgs::msg::MarkerArray>::SharedPtr obstacles_sub_;
+};
+
+int main(int argc, char *argv[]) {
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<RunRecorder>());
+  rclcpp::shutdown();
+  return 0;
+}
@@ -1,18 +1,58 @@
 //! @file odometry calculation node
 //! @brief Generate odometry base on wheel encoder change
 // Parameters:
+//  body_id - string: name of the body frame (single robot mode)
+//  odom_id - string: name of the odom frame (single robot mode)
+//  odom_topic - string: odometry to follow (single robot mode), e.g. icp_odom
+//  for scan matching odometry instead of the wheels
+//  robots - vector<string>: robot namespaces. Empty (default) runs the single
+//  robot mode. With N names, one filter tracks N robots and a shared landmark
+//  map, reading <ns>/odom and <ns>/fake_sensor for each.
+//  filter_rate - int: rate of the multi robot filter step (hz), positive
+//  filter_threads - int: threads used for per robot prediction, 0 for auto.
+//  process_noise - double: variance added to the robot pose on each prediction
+//  sensor_noise - double: variance of landmark range and bearing
+//  max_landmarks - int: size of the filter's landmark block
+//  landmark_reorder_interval - int: updates between sorting the landmark
+//  block along a Hilbert curve for locality, 0 (default) never
+//  data_association - bool: read unlabeled landmarks (from the landmarks node)
+//  and match them to the map, instead of fake_sensor markers with known ids.
+//  new_landmark_distance - double: squared Mahalanobis distance above which
+//  an unlabeled landmark is added as a new one
+//  flight_record_path - string: file backing the filter flight recorder, empty
+//  (default) keeps it in memory only.
+//  flight_record_capacity - int: number of filter steps the recorder keeps
+//  flight_record_dump_dir - string: where dumps are written
+//  divergence_nis - double: normalized innovation squared per measurement that
+//  counts as divergence and triggers a dump
+//  lockstep - bool: acknowledge the odometry handled on /nusim/step_ack, for
+//  nusim's lockstep time_mode, default false. With several robots the filter
+//  then steps once every robot's odometry of a step is in, not on a timer.
 
 // Publishers:
-//  tf : world to green odom to blue robot.
+//  tf : world to green odom to blue robot. In multi robot mode world to
+//  <ns>/odom for each robot.
+//  green/path - nav_msgs::msg::Path (<ns>/slam_path in multi robot mode)
+//  /nusim/step_ack - nuturtle_control::msg::StepAck, stamp of the odometry
+//  in the filter (lockstep only)
 
 // Subscriber:
-//  odom - nav_msgs::msg::Odometry : calculated odometry value
+//  odom - nav_msgs::msg::Odometry : calculated odometry value (odom_topic)
+//  /fake_sensor - visualization_msgs::msg::MarkerArray : landmark observations
+//  landmarks - visualization_msgs::msg::MarkerArray : unlabeled landmark
+//  observations, used instead of /fake_sensor with data_association
+//  (<ns>/landmarks in multi robot mode)
 
 // Service Server:
 //  initial_pose - nuturtle_control::srv::InitPose : Set the initial pose of the
 //  robot when called.
+//  ~/dump_flight_record - std_srvs::srv::Trigger : write the filter flight
+//  record to flight_record_dump_dir. Read it back with flight_record_decode.
 
+#include <algorithm>
 #include <builtin_interfaces/msg/time.hpp>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <geometry_msgs/msg/pose_with_covariance.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
@@ -23,8 +63,10 @@
 #include <geometry_msgs/msg/transform_stamped.hpp>
 #include <nav_msgs/msg/odometry.hpp>
 #include <nav_msgs/msg/path.hpp>
+#include <nuturtle_control/msg/step_ack.hpp>
 #include <nuturtlebot_msgs/msg/sensor_data.hpp>
 #include <nuturtlebot_msgs/msg/wheel_commands.hpp>
+#include <optional>
 #include <rclcpp/exceptions/exceptions.hpp>
 #include <rclcpp/logger.hpp>
 #include <rclcpp/logging.hpp>
@@ -35,6 +77,8 @@
 #include <rclcpp/time.hpp>
 #include <sensor_msgs/msg/detail/joint_state__traits.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
+#include <stdexcept>
+#include <std_srvs/srv/trigger.hpp>
 #include <string>
 #include <tf2_ros/transform_broadcaster.h>
 #include <turtlelib/diff_drive.hpp>
@@ -45,6 +89,12 @@
 
 #include <leo_ros_utils/math_helper.hpp>
 #include <leo_ros_utils/param_helper.hpp>
+#include <memory>
+
+#include <turtlelib/worker_pool.hpp>
+
+#include "nuslam/ekf_slam.hpp"
+#include "nuslam/filter_trace.hpp"
 
 #include <armadillo>
 #include <tf2/LinearMath/Quaternion.h>
@@ -63,29 +113,11 @@ constexpr int32_t kActualSensorPolarID = 260;
 constexpr size_t kOdomBufferSize = 100;      // cache odom for
 constexpr size_t kRobotPathHistorySize = 10; // number of data points
 
-constexpr size_t kMaxLandmarkSize = 3;
-constexpr size_t kTotalStateSize = 3 + kMaxLandmarkSize * 2;
-
+// Defaults, tune them per floor with slam_tuner.
+constexpr int kMaxLandmarkSize = 3;
 constexpr double kProcessNoise = 1e-4;
 constexpr double kSensorNoise = 1e-4;
 
-arma::mat GetQMat() {
-  arma::mat q_mat = arma::zeros(kTotalStateSize, kTotalStateSize);
-  q_mat.at(0, 0) = kProcessNoise;
-  q_mat.at(1, 1) = kProcessNoise;
-  q_mat.at(2, 2) = kProcessNoise;
-  return q_mat;
-}
-
-arma::mat GetSigmaZero() {
-
-  arma::mat seg_0 = arma::zeros(kTotalStateSize, kTotalStateSize);
-  double large_number = 2e10;
-  seg_0.submat(3, 3, kTotalStateSize - 1, kTotalStateSize - 1) =
-      arma::eye(kMaxLandmarkSize * 2, kMaxLandmarkSize * 2) * large_number;
-  return seg_0;
-}
-
 std::ostream &operator<<(std::ostream &os, const std::tuple<double, double> &p) {
   auto [x, y] = p;
   os << "[" << x << y << "]";
@@ -94,177 +126,293 @@ std::ostream &operator<<(std::ostream &os, const std::tuple<double, double> &p)
 
 } // namespace
 
+//! @brief Everything the filter keeps per robot, besides the robot's state block.
+struct RobotChannel {
+  std::string name; // namespace, empty in single robot mode
+  std::string body_id;
+  std::string odom_id;
+  std::string predict_frame_id;
+
+  turtlelib::Transform2D T_odom_oldrobot;
+  // Odom motion not yet fed to the filter, and the stamp of the newest odom.
+  std::optional<turtlelib::Transform2D> pending_delta;
+  builtin_interfaces::msg::Time pending_stamp;
+
+  std::deque<std::pair<rclcpp::Time, turtlelib::Transform2D>> time_bot_loc_buffer;
+  std::deque<visualization_msgs::msg::Marker> sensor_msg_buffer;
+  std::deque<geometry_msgs::msg::PoseStamped> bot_path_history =
+      std::deque<geometry_msgs::msg::PoseStamped>(kRobotPathHistorySize);
+
+  rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr path_publisher;
+  rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub;
+  rclcpp::Subscription<visualization_msgs::msg::MarkerArray>::SharedPtr fake_sensor_sub;
+};
+
 class Slam : public rclcpp::Node {
 public:
   Slam()
       : Node("odometry"),
-        body_id(GetParam<std::string>(*this, "body_id", "name of the body frame")),
-        odom_id(GetParam<std::string>(*this, "odom_id", "name of the body frame")),
-        time_bot_loc_buffer_({{get_clock()->now(), turtlelib::Transform2D{}}} ), covariance_sigma(GetSigmaZero()),
-        combined_states(arma::zeros(3 + kMaxLandmarkSize * 2, 1)),
-        // We do pre sensor update, so R_mat is only 2x2
-        R_mat(arma::eye(2, 2) * kSensorNoise), initialized_landmark(kMaxLandmarkSize, false),
+        robot_names(GetParam<std::vector<std::string>>(
+            *this, "robots", "namespaces of robots sharing the map, empty for single robot",
+            std::vector<std::string>{})),
+        ekf(std::max<size_t>(1, robot_names.size()),
+            GetParam<int>(*this, "max_landmarks", "size of the landmark block", kMaxLandmarkSize),
+            GetParam<double>(*this, "process_noise", "variance added to robot pose on predict",
+                             kProcessNoise),
+            GetParam<double>(*this, "sensor_noise", "variance of landmark range and bearing",
+                             kSensorNoise)),
+        filter_pool(robot_names.size() > 1
+                        ? GetParam<int>(*this, "filter_threads",
+                                        "threads for per robot prediction, 0 for auto", 0)
+                        : 1),
         tf_broadcaster(*this) {
     // Uncomment this to turn on debug level and enable debug statements
     // rcutils_logging_set_logger_level(get_logger().get_name(), RCUTILS_LOG_SEVERITY_DEBUG);
-    combined_states.at(0) = 0.0;
-    combined_states.at(1) = 0.0;
-    path_publisher_ = create_publisher<nav_msgs::msg::Path>("green/path", 10);
     sensor_estimate_pub_ =
         create_publisher<visualization_msgs::msg::MarkerArray>("estimate_sensor", 10);
     debug_sensor_pub_ = create_publisher<visualization_msgs::msg::MarkerArray>("debug_sensor", 10);
 
-    // Listen to odom
-
-    // odom topic is always odom
-    odom_sub_ = create_subscription<nav_msgs::msg::Odometry>(
-        "odom", 10, std::bind(&Slam::OdomCb, this, std::placeholders::_1));
-
-    // Listen to fake sensor
-
-    fake_sensor_sub_ = create_subscription<visualization_msgs::msg::MarkerArray>(
-        "/fake_sensor", 10, std::bind(&Slam::SensorCb, this, std::placeholders::_1));
+    // The flight recorder is always on, the filter writes every step to it.
+    flight_recorder_ = std::make_unique<nuslam::FilterFlightRecorder>(
+        GetParam<std::string>(*this, "flight_record_path",
+                              "file backing the filter flight recorder, empty for memory only",
+                              ""),
+        GetParam<int>(*this, "flight_record_capacity", "filter steps kept by the recorder", 4096));
+    ekf.SetRecorder(flight_recorder_.get());
+    ekf.SetReorderInterval(GetParam<int>(*this, "landmark_reorder_interval",
+                                         "updates between landmark reorders", 0));
+    flight_record_dump_dir_ =
+        GetParam<std::string>(*this, "flight_record_dump_dir", "where dumps are written", "/tmp");
+    divergence_nis_ = GetParam<double>(
+        *this, "divergence_nis", "NIS per measurement that counts as divergence", 50.0);
+    dump_service_ = create_service<std_srvs::srv::Trigger>(
+        "~/dump_flight_record",
+        std::bind(&Slam::DumpFlightRecordSrv, this, std::placeholders::_1, std::placeholders::_2));
+
+    data_association_ = GetParam<bool>(
+        *this, "data_association", "match unlabeled landmarks to the map", false);
+    new_landmark_distance_ =
+        GetParam<double>(*this, "new_landmark_distance",
+                         "squared mahalanobis distance that makes a new landmark", 9.21);
+    // Absolute, nusim listens outside any robot namespace.
+    if (GetParam<bool>(*this, "lockstep", "acknowledge nusim odometry", false)) {
+      step_ack_pub_ = create_publisher<nuturtle_control::msg::StepAck>("/nusim/step_ack", 10);
+    }
+    multi_robot_ = !robot_names.empty();
+    if (!multi_robot_) {
+      // Single robot, keep the original topics and frames.
+      RobotChannel channel;
+      channel.body_id = GetParam<std::string>(*this, "body_id", "name of the body frame");
+      channel.odom_id = GetParam<std::string>(*this, "odom_id", "name of the body frame");
+      channel.predict_frame_id = "green/base_predict";
+      const auto odom_topic =
+          GetParam<std::string>(*this, "odom_topic", "odometry to follow", "odom");
+      AddRobot(std::move(channel), "green/path", odom_topic,
+               data_association_ ? "landmarks" : "/fake_sensor");
+    } else {
+      for (const auto &name : robot_names) {
+        RobotChannel channel;
+        channel.name = name;
+        channel.body_id = name + "/base_footprint";
+        channel.odom_id = name + "/odom";
+        channel.predict_frame_id = name + "/base_predict";
+        AddRobot(std::move(channel), name + "/slam_path", name + "/odom",
+                 name + (data_association_ ? "/landmarks" : "/fake_sensor"));
+      }
+      // With several robots, odom only queues the motion. The timer feeds all
+      // queued motion to the filter at once so robots predict in parallel.
+      // In lockstep OdomCb steps it instead, at the pace of the simulation.
+      const int filter_rate = GetParam<int>(*this, "filter_rate", "rate of filter step", 100);
+      if (filter_rate <= 0) {
+        throw std::invalid_argument("filter_rate must be positive");
+      }
+      if (!step_ack_pub_) {
+        filter_timer_ = rclcpp::create_timer(
+            this, get_clock(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(1.0 / filter_rate)),
+            std::bind(&Slam::FilterStep, this));
+      }
+      RCLCPP_INFO_STREAM(get_logger(), "Multi robot SLAM with " << robots_.size() << " robots, "
+                                                                << filter_pool.Size()
+                                                                << " prediction threads");
+    }
   }
 
-  void OdomCb(const nav_msgs::msg::Odometry &new_odom) { 
-    
-    //***************************************
-    // Prediction half of SLAM
+  //! @brief Tell nusim the odometry up to stamp is in the filter, in lockstep.
+  //! @param stamp stamp of the oldest odometry of any robot in the filter
+  void AckStep(const rclcpp::Time &stamp) {
+    if (!step_ack_pub_) {
+      return;
+    }
+    nuturtle_control::msg::StepAck ack;
+    ack.stamp = stamp;
+    ack.consumer = get_fully_qualified_name();
+    step_ack_pub_->publish(ack);
+  }
 
-    // Predict state
+  void OdomCb(size_t robot, const nav_msgs::msg::Odometry &new_odom) {
+    auto &channel = robots_.at(robot);
 
     // Static last_used_odom,
     // update slam's robot pose guess with the delta in odom (odom is accurate with delta)
     turtlelib::Transform2D T_odom_newrobot = leo_ros_utils::ConvertBack(new_odom.pose.pose);
     // Want T_old_new = T_old_odom * T_odom_new = T_odom_old.inv() * T_odom_new
-    turtlelib::Transform2D T_old_new_robot = T_odom_oldrobot_.inv() * T_odom_newrobot;
-    turtlelib::Transform2D guessed_robot_world = GetCurrentStateTF() * T_old_new_robot;
-    SetCurrentStateTF(guessed_robot_world);
-
-    // predict A matrix
-    arma::mat a_mat = arma::eye(kTotalStateSize, kTotalStateSize);
-    a_mat.at(1, 0) = -T_old_new_robot.translation().y;
-    a_mat.at(2, 0) = T_old_new_robot.translation().x;
-
-    covariance_sigma = a_mat * covariance_sigma * a_mat.t() + GetQMat();
-
-    T_odom_oldrobot_ = T_odom_newrobot;
-
-    if (time_bot_loc_buffer_.size() >= kOdomBufferSize){
-      time_bot_loc_buffer_.pop_front();
+    turtlelib::Transform2D T_old_new_robot = channel.T_odom_oldrobot.inv() * T_odom_newrobot;
+    channel.pending_delta = channel.pending_delta.value_or(turtlelib::Transform2D{}) * T_old_new_robot;
+    channel.pending_stamp = new_odom.header.stamp;
+    channel.T_odom_oldrobot = T_odom_newrobot;
+
+    if (!multi_robot_) {
+      FilterStep();
+      AckStep(rclcpp::Time(new_odom.header.stamp));
+      return;
+    }
+    if (!step_ack_pub_) {
+      return;
+    }
+    // Lockstep: step once every robot sent odometry newer than the last step.
+    rclcpp::Time oldest(channel.pending_stamp);
+    for (const auto &other : robots_) {
+      oldest = std::min(oldest, rclcpp::Time(other.pending_stamp));
+    }
+    if (oldest > acked_stamp_) {
+      FilterStep();
+      acked_stamp_ = oldest;
+      AckStep(oldest);
     }
-    time_bot_loc_buffer_.push_back({new_odom.header.stamp , GetCurrentStateTF() });
-    PublishOdomRobot(T_odom_newrobot, new_odom.header.stamp);
-    SensorProcess();
-    PublishPath(GetCurrentStateTF() , new_odom.header.stamp);
-
   }
 
-  void SensorCb(const visualization_msgs::msg::MarkerArray &msg) {
+  void SensorCb(size_t robot, const visualization_msgs::msg::MarkerArray &msg) {
     for (const auto &marker : msg.markers) {
-      sensor_msg_buffer_.push_back(marker);
+      robots_.at(robot).sensor_msg_buffer.push_back(marker);
     }
   }
 
-  void SensorProcess(){
-  
+  //! @brief Feed all queued odom motion to the filter, then process sensors.
+  void FilterStep() {
+    //***************************************
+    // Prediction half of SLAM
+    std::vector<std::optional<turtlelib::Transform2D>> robot_deltas(robots_.size());
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      robot_deltas.at(i) = robots_.at(i).pending_delta;
+      robots_.at(i).pending_delta.reset();
+    }
+    ekf.PredictAll(robot_deltas, &filter_pool);
+    CheckDivergence();
 
-    auto current_bot_tf = GetCurrentStateTF();
+    for (size_t i = 0; i < robots_.size(); ++i) {
+      if (!robot_deltas.at(i).has_value()) {
+        continue;
+      }
+      auto &channel = robots_.at(i);
+      if (channel.time_bot_loc_buffer.size() >= kOdomBufferSize) {
+        channel.time_bot_loc_buffer.pop_front();
+      }
+      channel.time_bot_loc_buffer.push_back({channel.pending_stamp, ekf.GetRobotPose(i)});
+      // Other robots have their own odometry publishing odom to body.
+      if (!multi_robot_) {
+        PublishOdomRobot(channel, channel.T_odom_oldrobot, channel.pending_stamp);
+      }
+      SensorProcess(i);
+      PublishPath(channel, ekf.GetRobotPose(i), channel.pending_stamp);
+    }
+  }
+
+  void SensorProcess(size_t robot) {
+    auto &channel = robots_.at(robot);
+    auto current_bot_tf = ekf.GetRobotPose(robot);
     //***************************************
     // Measurement update half of SLAM
     visualization_msgs::msg::MarkerArray arrow_msgs;
-    while(!sensor_msg_buffer_.empty()){
+    std::vector<nuslam::LandmarkMeasurement> measurements;
+    builtin_interfaces::msg::Time latest_sensor_stamp;
+    while (!channel.sensor_msg_buffer.empty()) {
 
       // We made a copy here specifically to allow popping it later.
-      const auto marker = sensor_msg_buffer_.front();
+      const auto marker = channel.sensor_msg_buffer.front();
 
-      
       // Skip not used markers
-      if (marker.action == marker.DELETE) {
-        sensor_msg_buffer_.pop_front();
+      if (marker.action != marker.ADD) {
+        channel.sensor_msg_buffer.pop_front();
         continue;
       }
       // Data formatting
 
-      // We want to find the closest odom to marker time stamp 
-      
+      // We want to find the closest odom to marker time stamp
+
       // If sensor time is newer then our newest odom time
       auto sensor_stamp = marker.header.stamp;
-      auto maybe_matching_tf = WorldBotTFLoopUp( sensor_stamp );
-      if (! maybe_matching_tf.has_value()){
-        RCLCPP_DEBUG(get_logger(),  "defer sensor process to next cycle");
+      auto maybe_matching_tf = WorldBotTFLoopUp(channel, sensor_stamp);
+      if (!maybe_matching_tf.has_value()) {
+        RCLCPP_DEBUG(get_logger(), "defer sensor process to next cycle");
         break;
       }
       // Pop doesn't actually return things
-      sensor_msg_buffer_.pop_front();
+      channel.sensor_msg_buffer.pop_front();
 
       auto [marker_world_p, marker_index] = StripMarker(marker, maybe_matching_tf.value());
+      if (data_association_) {
+        // Detected landmarks carry no identity, they get labeled below.
+        marker_index = ekf.MaxLandmarks();
+      } else if (marker_index >= ekf.MaxLandmarks()) {
+        RCLCPP_WARN_STREAM(get_logger(), "Marker " << marker_index
+                                                   << " is beyond the landmark capacity, skipped");
+        continue;
+      }
 
       RCLCPP_DEBUG_STREAM(get_logger(), "\n---------------->   Processing Marker "
-                                           << marker_index << " At world: " << marker_world_p);
-
-      // Init with trusting the sensor value.
-      if (!initialized_landmark[marker_index]) {
-        combined_states.at(3 + marker_index * 2) = marker_world_p.x + 1e-2;
-        combined_states.at(3 + marker_index * 2 + 1) = marker_world_p.y + 1e-2;
-        initialized_landmark[marker_index] = true;
+                                            << marker_index << " At world: " << marker_world_p);
+      if (!data_association_ && !ekf.IsLandmarkInitialized(marker_index)) {
         RCLCPP_INFO_STREAM(get_logger(), "Marker " << marker_index << " Init for the first time");
       }
 
-      // Get predict and measured marker to robot xy
-      RCLCPP_DEBUG_STREAM(get_logger(), "Combined state\n" << combined_states);
-      turtlelib::Point2D predict_landmark_world = GetCurrentLandmarkWold(marker_index);
-
-      auto predict_landmark_polar = World2RelativePolar(predict_landmark_world, current_bot_tf);
-      arrow_msgs.markers.push_back(
-          MakeArrowMarker(predict_landmark_polar, marker_index, kPredictSensorPolarID, sensor_stamp));
-
-      auto H_j_mat = GetH_j(marker_index, predict_landmark_world, current_bot_tf);
-      arma::mat K_j_mat =
-          covariance_sigma * H_j_mat.t() * (H_j_mat * covariance_sigma * H_j_mat.t() + R_mat).i();
-
-
       auto measured_landmark_polar = World2RelativePolar(marker_world_p, current_bot_tf);
-      arrow_msgs.markers.push_back(
-          MakeArrowMarker(measured_landmark_polar, marker_index, kMeasureSensorPolarID, sensor_stamp));
-      arrow_msgs.markers.push_back(MakeArrowMarker(measured_landmark_polar, marker_index,
-                                                   kActualSensorPolarID, sensor_stamp, marker.header.frame_id));
-      auto [predict_range, predict_bearing] = predict_landmark_polar;
+      const size_t arrow_id = data_association_ ? measurements.size() : marker_index;
+      arrow_msgs.markers.push_back(MakeArrowMarker(channel, measured_landmark_polar, arrow_id,
+                                                   kMeasureSensorPolarID, sensor_stamp));
+      arrow_msgs.markers.push_back(MakeArrowMarker(channel, measured_landmark_polar, arrow_id,
+                                                   kActualSensorPolarID, sensor_stamp,
+                                                   marker.header.frame_id));
+      RCLCPP_DEBUG_STREAM(get_logger(), " measured_landmark_polar " << measured_landmark_polar);
       auto [measured_range, measured_bearing] = measured_landmark_polar;
-      arma::Col<double> err{measured_range - predict_range,
-                            turtlelib::normalize_angle(measured_bearing - predict_bearing)};
-
-      arma::Col<double> correction = K_j_mat * (err);
-
-      combined_states = combined_states + correction;
-      combined_states.at(0) = turtlelib::normalize_angle(combined_states.at(0));
-      covariance_sigma =
-          (arma::eye(kTotalStateSize, kTotalStateSize) - K_j_mat * H_j_mat) * covariance_sigma;
-
-      RCLCPP_DEBUG_STREAM(get_logger(), "H_j \n" << H_j_mat);
-      RCLCPP_DEBUG_STREAM(get_logger(), "R_mat \n" << R_mat);
-      RCLCPP_DEBUG_STREAM(get_logger(),
-                          "arma::inv(H_j_mat * covariance_sigma * H_j_mat.t() + R_mat) \n"
-                              << (H_j_mat * covariance_sigma * H_j_mat.t() + R_mat).i());
+      measurements.push_back({marker_index, measured_range, measured_bearing, marker_world_p});
+      latest_sensor_stamp = sensor_stamp;
+    }
 
-      RCLCPP_DEBUG_STREAM(get_logger(), " K_j \n" << K_j_mat);
-      RCLCPP_DEBUG_STREAM(get_logger(), " predict_landmark_polar " << predict_landmark_polar);
-      RCLCPP_DEBUG_STREAM(get_logger(), " measured_landmark_polar " << measured_landmark_polar);
+    if (data_association_ && !measurements.empty()) {
+      ekf.AssociateLandmarks(robot, measurements, new_landmark_distance_);
+      const size_t before = measurements.size();
+      measurements.erase(std::remove_if(measurements.begin(), measurements.end(),
+                                        [this](const nuslam::LandmarkMeasurement &m) {
+                                          return m.landmark_index >= ekf.MaxLandmarks();
+                                        }),
+                         measurements.end());
+      if (measurements.size() < before) {
+        RCLCPP_WARN_STREAM(get_logger(), before - measurements.size()
+                                             << " new landmarks skipped, the map is full");
+      }
+    }
 
-      RCLCPP_DEBUG_STREAM(get_logger(), "err normalized \n" << err);
-      RCLCPP_DEBUG_STREAM(get_logger(), "K_j * err transpose \n" << (K_j_mat * (err)).t());
-      RCLCPP_DEBUG_STREAM(get_logger(), "Combined state transposed \n" << combined_states.t());
-      RCLCPP_DEBUG_STREAM(get_logger(), "covariance sigma\n " << covariance_sigma);
-      PublishObsLocation(
-          {combined_states.at(3 + marker_index * 2), combined_states.at(3 + marker_index * 2 + 1)},
-          marker_index, kWorldFrame);
+    if (!measurements.empty()) {
+      // All the measurements of this robot go in as one batched update.
+      auto predictions = ekf.Update(robot, measurements);
+      CheckDivergence();
+      for (const auto &prediction : predictions) {
+        arrow_msgs.markers.push_back(MakeArrowMarker(
+            channel, {prediction.range, prediction.bearing}, prediction.landmark_index,
+            kPredictSensorPolarID, latest_sensor_stamp));
+        PublishObsLocation(ekf.GetLandmark(prediction.landmark_index), prediction.landmark_index,
+                           kWorldFrame);
+      }
+      RCLCPP_DEBUG_STREAM(get_logger(), "Combined state transposed \n" << ekf.GetState().t());
+      RCLCPP_DEBUG_STREAM(get_logger(), "covariance sigma\n " << ekf.GetCovariance());
       debug_sensor_pub_->publish(arrow_msgs);
       //  End of slam math
-      auto T_world_odom = GetCurrentStateTF() * (T_odom_oldrobot_.inv());
-      PublishWorldOdom(T_world_odom, sensor_stamp);
+      auto T_world_odom = ekf.GetRobotPose(robot) * (channel.T_odom_oldrobot.inv());
+      PublishWorldOdom(channel, T_world_odom, latest_sensor_stamp);
     }
-    PublishPredictTF(current_bot_tf);
-
+    PublishPredictTF(channel, current_bot_tf);
   }
 
   std::tuple<double, double> World2RelativePolar(turtlelib::Point2D landmark_world_xy,
@@ -276,68 +424,34 @@ public:
     return {range, bearing};
   }
 
-  // landmark_index is zero indexed
-  //! @brief - Get the big H_j matrix for landmark J, given it's relative location from robot
-  //! @param landmark_index - index of the landmark, zero indexed (max n-1 for n landmarks)
-  //! @param landmark_robot_xy- relative location of landmark relative to robot
-  arma::mat GetH_j(size_t landmark_index, turtlelib::Point2D predict_global_pose , turtlelib::Transform2D bot_pose) {
-     
-    auto [gx,gy] = predict_global_pose;
-    double dx = gx - bot_pose.translation().x;
-    double dy = gy - bot_pose.translation().y;
-
-    double d = dx * dx + dy * dy;
-    double d_rt = std::sqrt(d);
-
-    RCLCPP_DEBUG_STREAM(get_logger(),
-                        "dx " << dx << " dy " << dy << " d_sq " << d << " d_rt " << d_rt);
-
-    arma::mat first({{0, -dx / d_rt, -dy / d_rt}, {-1, dy / d, -dx / d}});
-
-    arma::mat second({{dx / d_rt, dy / d_rt}, {-dy / d, dx / d}});
-
-    return arma::join_rows(first, arma::zeros(2, 2 * (landmark_index)), second,
-                           arma::zeros(2, 2 * (kMaxLandmarkSize - 1 - landmark_index)));
-  }
-
   // #############################
   // Data type Helpers
   // #############################
 
-  turtlelib::Transform2D GetCurrentStateTF() {
-    return {{combined_states.at(1), combined_states.at(2)}, combined_states.at(0)};
-  }
-  void SetCurrentStateTF(turtlelib::Transform2D bot_pose) {
-    combined_states.at(0) = turtlelib::normalize_angle(bot_pose.rotation());
-    combined_states.at(1) = bot_pose.translation().x;
-    combined_states.at(2) = bot_pose.translation().y;
-  }
-
-  turtlelib::Point2D GetCurrentLandmarkWold(size_t landmark_id) {
-    return {combined_states.at(3 + landmark_id * 2), combined_states.at(3 + landmark_id * 2 + 1)};
-  }
-
   //! @brief Look up the World-Bot TF history that's closest to target time.
   //! This assume the TF history is ordered by time.
+  //! @param - channel: the robot whose history to search
   //! @param - target_time: the time we want the cloest TF to be
   //! @return - optional transform. If the target time is in future then newest
   //! TF, we refuse the look up
-  std::optional<turtlelib::Transform2D> WorldBotTFLoopUp(rclcpp::Time target_time) {
+  std::optional<turtlelib::Transform2D> WorldBotTFLoopUp(const RobotChannel &channel,
+                                                         rclcpp::Time target_time) {
+    const auto &time_bot_loc_buffer = channel.time_bot_loc_buffer;
 
-    if (target_time > time_bot_loc_buffer_.back().first) {
+    if (target_time > time_bot_loc_buffer.back().first) {
       RCLCPP_DEBUG_STREAM(get_logger(), "Sensor message is in the future of states! Latest bot state "
                                             << std::setw(24) << std::fixed
-                                            << time_bot_loc_buffer_.back().first.seconds());
+                                            << time_bot_loc_buffer.back().first.seconds());
       return std::nullopt;
     }
 
     // We do calculation in chrono because it have abs function.
     std::chrono::nanoseconds min_diff_abs = std::chrono::nanoseconds::max();
-    turtlelib::Transform2D best_tf = time_bot_loc_buffer_.back().second;
+    turtlelib::Transform2D best_tf = time_bot_loc_buffer.back().second;
 
-    for (auto riter = time_bot_loc_buffer_.rbegin(); riter != time_bot_loc_buffer_.rend(); ++riter) {
+    for (auto riter = time_bot_loc_buffer.rbegin(); riter != time_bot_loc_buffer.rend(); ++riter) {
       auto [odom_time, T_wb] = *riter;
-      
+
       auto diff = target_time - odom_time;
       auto diff_abs =
           std::chrono::abs((diff).to_chrono<std::chrono::nanoseconds>());
@@ -362,49 +476,46 @@ public:
             marker.id - kFakeSenorStartingID};
   }
 
-  template <typename S> arma::mat Struct2Col(S xy) {
-    auto [x, y] = xy;
-    return arma::Col<double>{x, y};
-  }
-
-  void PublishOdomRobot(turtlelib::Transform2D T_odom_robot, builtin_interfaces::msg::Time stamp) {
+  void PublishOdomRobot(const RobotChannel &channel, turtlelib::Transform2D T_odom_robot,
+                        builtin_interfaces::msg::Time stamp) {
     geometry_msgs::msg::TransformStamped tf_stamped;
-    tf_stamped.header.frame_id = odom_id;
-    tf_stamped.child_frame_id = body_id;
+    tf_stamped.header.frame_id = channel.odom_id;
+    tf_stamped.child_frame_id = channel.body_id;
     tf_stamped.header.stamp = stamp;
     tf_stamped.transform = leo_ros_utils::Convert(leo_ros_utils::Convert(T_odom_robot));
     tf_broadcaster.sendTransform(tf_stamped);
   }
 
-  void PublishWorldOdom(turtlelib::Transform2D T_world_odom, builtin_interfaces::msg::Time stamp) {
+  void PublishWorldOdom(const RobotChannel &channel, turtlelib::Transform2D T_world_odom,
+                        builtin_interfaces::msg::Time stamp) {
 
     geometry_msgs::msg::TransformStamped tf_stamped;
     tf_stamped.header.frame_id = kWorldFrame;
-    tf_stamped.child_frame_id = odom_id;
+    tf_stamped.child_frame_id = channel.odom_id;
     tf_stamped.header.stamp = stamp;
     tf_stamped.transform = leo_ros_utils::Convert(leo_ros_utils::Convert(T_world_odom));
     tf_broadcaster.sendTransform(tf_stamped);
   }
 
-  void PublishPath(turtlelib::Transform2D bot_loc , builtin_interfaces::msg::Time stamp){
-        geometry_msgs::msg::PoseStamped new_pose;
+  void PublishPath(RobotChannel &channel, turtlelib::Transform2D bot_loc,
+                   builtin_interfaces::msg::Time stamp) {
+    geometry_msgs::msg::PoseStamped new_pose;
     new_pose.header.frame_id = kWorldFrame;
     new_pose.header.stamp = stamp;
     new_pose.pose.position.x = bot_loc.translation().x;
     new_pose.pose.position.y = bot_loc.translation().y;
-    bot_path_history_.push_back(new_pose);
-    if (bot_path_history_.size() >= kRobotPathHistorySize) {
-      bot_path_history_.pop_front();
+    channel.bot_path_history.push_back(new_pose);
+    if (channel.bot_path_history.size() >= kRobotPathHistorySize) {
+      channel.bot_path_history.pop_front();
     }
 
     nav_msgs::msg::Path path_msg;
     path_msg.header = new_pose.header;
 
-    path_msg.poses = std::vector<geometry_msgs::msg::PoseStamped>{bot_path_history_.begin(),
-                                                                  bot_path_history_.end()};
-
-    path_publisher_->publish(path_msg);
+    path_msg.poses = std::vector<geometry_msgs::msg::PoseStamped>{
+        channel.bot_path_history.begin(), channel.bot_path_history.end()};
 
+    channel.path_publisher->publish(path_msg);
   }
 
   void PublishObsLocation(turtlelib::Point2D loc, size_t LandmarkIndex, std::string frame_name) {
@@ -429,24 +540,28 @@ public:
     sensor_estimate_pub_->publish(msg);
   }
 
-  void PublishPredictTF(turtlelib::Transform2D T_world_robot_predict) {
+  void PublishPredictTF(const RobotChannel &channel, turtlelib::Transform2D T_world_robot_predict) {
     geometry_msgs::msg::TransformStamped tf_stamped;
     tf_stamped.header.frame_id = kWorldFrame;
-    tf_stamped.child_frame_id = "green/base_predict";
+    tf_stamped.child_frame_id = channel.predict_frame_id;
     tf_stamped.header.stamp = get_clock()->now();
     tf_stamped.transform = leo_ros_utils::Convert(leo_ros_utils::Convert(T_world_robot_predict));
     tf_broadcaster.sendTransform(tf_stamped);
   }
 
-  visualization_msgs::msg::Marker MakeArrowMarker(std::tuple<double, double> range_bearing,
+  //! @param frame_id - frame of the arrow, default to the robot's predict frame
+  visualization_msgs::msg::Marker MakeArrowMarker(const RobotChannel &channel,
+                                                  std::tuple<double, double> range_bearing,
                                                   size_t marker_id, size_t starting_id,builtin_interfaces::msg::Time stamp,
-                                                  std::string frame_id = "green/base_predict") {
+                                                  std::optional<std::string> frame_id = std::nullopt) {
 
     auto [range, bearing] = range_bearing;
     visualization_msgs::msg::Marker arr;
     arr.type = arr.ARROW;
     arr.header.stamp = stamp;
-    arr.header.frame_id = frame_id;
+    arr.header.frame_id = frame_id.value_or(channel.predict_frame_id);
+    // Robots share landmark ids, the namespace keeps their arrows apart.
+    arr.ns = channel.name;
     arr.id = starting_id + marker_id;
     // Position/Orientation
     // Pivot point is around the tip of its tail. Identity orientation points it along the +X axis.
@@ -484,34 +599,105 @@ public:
     return arr;
   }
 
+  //! @brief service callback, dump the flight record
+  //! @param / service request (not used)
+  //! @param response path of the dump on success
+  void DumpFlightRecordSrv(const std_srvs::srv::Trigger::Request::SharedPtr,
+                           std_srvs::srv::Trigger::Response::SharedPtr response) {
+    try {
+      response->message = DumpFlightRecord("request");
+      response->success = true;
+    } catch (const std::exception &e) {
+      response->message = e.what();
+      response->success = false;
+    }
+  }
+
 private:
-  const std::string body_id;
-  const std::string odom_id;
+  //! @brief Write the flight record to a new file in the dump directory.
+  //! @param reason goes in the file name
+  //! @return path of the dump
+  std::string DumpFlightRecord(const std::string &reason) {
+    const auto stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    const std::string path = flight_record_dump_dir_ + "/slam_flight_record_" + reason + "_" +
+                             std::to_string(stamp_ns) + ".bin";
+    const size_t count = flight_recorder_->Dump(path);
+    RCLCPP_INFO_STREAM(get_logger(), "Dumped " << count << " filter steps to " << path);
+    return path;
+  }
+
+  //! @brief Dump the flight record when the last filter step looks diverged.
+  //! Only dumps on the step that starts a divergence, not on every step after.
+  void CheckDivergence() {
+    const auto &trace = ekf.LastTrace();
+    const double nis_limit = divergence_nis_ * std::max<uint32_t>(1, trace.num_measurements);
+    bool diverged = !std::isfinite(trace.robot_covariance_trace) ||
+                    trace.robot_covariance_trace < 0.0 || !std::isfinite(trace.innovation_nis) ||
+                    trace.innovation_nis > nis_limit;
+    for (size_t i = 0; i < std::min<size_t>(trace.state_size, nuslam::kTraceStateSize); ++i) {
+      diverged = diverged || !std::isfinite(trace.state[i]);
+    }
+    if (diverged && !diverged_) {
+      RCLCPP_WARN_STREAM(get_logger(), "Filter diverging, NIS " << trace.innovation_nis << " over "
+                                                                << trace.num_measurements
+                                                                << " measurements");
+      try {
+        DumpFlightRecord("divergence");
+      } catch (const std::exception &e) {
+        RCLCPP_ERROR_STREAM(get_logger(), "Flight record dump failed: " << e.what());
+      }
+    }
+    diverged_ = diverged;
+  }
+
+  //! @brief Set up topics of one robot and add it to the list.
+  //! @param channel the robot, with names and frames filled in
+  //! @param path_topic topic for the estimated path
+  //! @param odom_topic odometry input topic
+  //! @param sensor_topic landmark observation input topic
+  void AddRobot(RobotChannel channel, const std::string &path_topic,
+                const std::string &odom_topic, const std::string &sensor_topic) {
+    const size_t robot = robots_.size();
+    // Don't init this with default rclcpp::Time, It will fill with a different
+    // time source then what message gives.
+    channel.time_bot_loc_buffer.push_back({get_clock()->now(), turtlelib::Transform2D{}});
+    channel.path_publisher = create_publisher<nav_msgs::msg::Path>(path_topic, 10);
+    channel.odom_sub = create_subscription<nav_msgs::msg::Odometry>(
+        odom_topic, 10,
+        [this, robot](const nav_msgs::msg::Odometry &msg) { OdomCb(robot, msg); });
+    channel.fake_sensor_sub = create_subscription<visualization_msgs::msg::MarkerArray>(
+        sensor_topic, 10,
+        [this, robot](const visualization_msgs::msg::MarkerArray &msg) { SensorCb(robot, msg); });
+    robots_.push_back(std::move(channel));
+  }
+
+  const std::vector<std::string> robot_names;
+  // One filter holds every robot's pose block and the shared landmarks.
+  nuslam::EkfSlam ekf;
+  turtlelib::WorkerPool filter_pool;
+  std::vector<RobotChannel> robots_;
 
-  std::deque<geometry_msgs::msg::PoseStamped> bot_path_history_ =
-      std::deque<geometry_msgs::msg::PoseStamped>(kRobotPathHistorySize);
-      // Don't init this, It will fill the rclcpp::Time with default constructed onces, which is different time source 
-      // then what message gives.
-  
-  turtlelib::Transform2D T_odom_oldrobot_ ;
-
-  std::deque<std::pair<rclcpp::Time , turtlelib::Transform2D>> time_bot_loc_buffer_ ; 
-  std::deque<visualization_msgs::msg::Marker> sensor_msg_buffer_ ; 
-  // combined covariance segma_t
-  arma::mat covariance_sigma;
-  arma::mat combined_states;
-  arma::mat R_mat;
-  std::vector<bool> initialized_landmark;
   // ROS IDL stuff
   tf2_ros::TransformBroadcaster tf_broadcaster;
 
-  rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr path_publisher_;
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr sensor_estimate_pub_;
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr debug_sensor_pub_;
-  std::unique_ptr<tf2_ros::TransformBroadcaster> tf_broadcaster_;
-
-  rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr odom_sub_;
-  rclcpp::Subscription<visualization_msgs::msg::MarkerArray>::SharedPtr fake_sensor_sub_;
+  rclcpp::TimerBase::SharedPtr filter_timer_;
+
+  std::unique_ptr<nuslam::FilterFlightRecorder> flight_recorder_;
+  std::string flight_record_dump_dir_;
+  double divergence_nis_ = 0.0;
+  bool diverged_ = false;
+  // Set by the robots parameter, even with one name in it.
+  bool multi_robot_ = false;
+  bool data_association_ = false;
+  double new_landmark_distance_ = 0.0;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr dump_service_;
+  rclcpp::Publisher<nuturtle_control::msg::StepAck>::SharedPtr step_ack_pub_;
+  // Odometry stamp of the last lockstep filter step with several robots.
+  rclcpp::Time acked_stamp_{0, 0, RCL_ROS_TIME};
 };
 
 int main(int argc, char *argv[]) {
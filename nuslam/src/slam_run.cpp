@@ -0,0 +1,223 @@
+#include "nuslam/slam_run.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "nuslam/ekf_slam.hpp"
+
+namespace nuslam {
+
+namespace {
+// Truth further than this from an odom stamp is not used for scoring.
+constexpr double kTruthMatchTolerance = 0.1;
+
+StampedPose ReadPose(std::istringstream &line) {
+  StampedPose sample;
+  double theta = 0.0;
+  double x = 0.0;
+  double y = 0.0;
+  line >> sample.stamp >> theta >> x >> y;
+  sample.pose = turtlelib::Transform2D{{x, y}, theta};
+  return sample;
+}
+
+void WritePose(std::ostream &os, const std::string &tag, const StampedPose &sample) {
+  os << tag << " " << sample.stamp << " " << sample.pose.rotation() << " "
+     << sample.pose.translation().x << " " << sample.pose.translation().y << "\n";
+}
+
+//! @brief True pose closest in time to stamp, if one is close enough.
+const StampedPose *NearestTruth(const std::vector<StampedPose> &truth, double stamp) {
+  auto it = std::lower_bound(truth.begin(), truth.end(), stamp,
+                             [](const StampedPose &s, double t) { return s.stamp < t; });
+  const StampedPose *best = nullptr;
+  if (it != truth.end()) {
+    best = &*it;
+  }
+  if (it != truth.begin() &&
+      (best == nullptr || stamp - std::prev(it)->stamp < best->stamp - stamp)) {
+    best = &*std::prev(it);
+  }
+  if (best == nullptr || std::abs(best->stamp - stamp) > kTruthMatchTolerance) {
+    return nullptr;
+  }
+  return best;
+}
+} // namespace
+
+SlamRun ReadSlamRun(std::istream &is) {
+  SlamRun run;
+  std::string raw;
+  size_t line_number = 0;
+  while (std::getline(is, raw)) {
+    ++line_number;
+    raw = raw.substr(0, raw.find('#'));
+    std::istringstream line(raw);
+    std::string tag;
+    if (!(line >> tag)) {
+      continue;
+    }
+    if (tag == "odom") {
+      run.odom.push_back(ReadPose(line));
+    } else if (tag == "truth") {
+      run.truth.push_back(ReadPose(line));
+    } else if (tag == "obs") {
+      StampedObservation obs;
+      line >> obs.stamp >> obs.landmark_index >> obs.robot_frame.x >> obs.robot_frame.y;
+      run.observations.push_back(obs);
+    } else if (tag == "landmark") {
+      size_t index = 0;
+      turtlelib::Point2D p;
+      line >> index >> p.x >> p.y;
+      run.landmark_truth[index] = p;
+    } else {
+      throw std::runtime_error("Unknown entry '" + tag + "' on line " +
+                               std::to_string(line_number));
+    }
+    if (line.fail()) {
+      throw std::runtime_error("Malformed entry on line " + std::to_string(line_number));
+    }
+  }
+
+  auto by_stamp = [](const auto &a, const auto &b) { return a.stamp < b.stamp; };
+  std::stable_sort(run.odom.begin(), run.odom.end(), by_stamp);
+  std::stable_sort(run.observations.begin(), run.observations.end(), by_stamp);
+  std::stable_sort(run.truth.begin(), run.truth.end(), by_stamp);
+  return run;
+}
+
+void WriteSlamRun(std::ostream &os, const SlamRun &run) {
+  os << "# nuslam run\n";
+  os.precision(10);
+  for (const auto &[index, p] : run.landmark_truth) {
+    os << "landmark " << index << " " << p.x << " " << p.y << "\n";
+  }
+  for (const auto &sample : run.truth) {
+    WritePose(os, "truth", sample);
+  }
+  for (const auto &sample : run.odom) {
+    WritePose(os, "odom", sample);
+  }
+  for (const auto &obs : run.observations) {
+    os << "obs " << obs.stamp << " " << obs.landmark_index << " " << obs.robot_frame.x << " "
+       << obs.robot_frame.y << "\n";
+  }
+}
+
+ReplayScore ReplaySlamRun(const SlamRun &run, const NoiseConfig &config, size_t max_landmarks,
+                          std::vector<StampedPose> *trajectory) {
+  EkfSlam ekf(1, max_landmarks, config.process_noise, config.sensor_noise);
+  ReplayScore score;
+
+  turtlelib::Transform2D T_odom_oldrobot;
+  double trajectory_sq_sum = 0.0;
+  size_t trajectory_count = 0;
+
+  size_t next_obs = 0;
+  auto update_until = [&](double stamp) {
+    // Observations sharing a stamp came in one message, one batched update.
+    while (next_obs < run.observations.size() && run.observations.at(next_obs).stamp <= stamp) {
+      const double batch_stamp = run.observations.at(next_obs).stamp;
+      const auto bot_pose = ekf.GetRobotPose(0);
+      std::vector<LandmarkMeasurement> measurements;
+      for (; next_obs < run.observations.size() &&
+             run.observations.at(next_obs).stamp == batch_stamp;
+           ++next_obs) {
+        const auto &obs = run.observations.at(next_obs);
+        if (obs.landmark_index >= max_landmarks) {
+          continue;
+        }
+        const turtlelib::Vector2D v{obs.robot_frame.x, obs.robot_frame.y};
+        measurements.push_back({obs.landmark_index, v.magnitude(), std::atan2(v.y, v.x),
+                                bot_pose(obs.robot_frame)});
+      }
+      ekf.Update(0, measurements);
+    }
+  };
+
+  try {
+    for (const auto &sample : run.odom) {
+      // Same as the node, the sensor is processed after odom catches up to it.
+      ekf.Predict(0, T_odom_oldrobot.inv() * sample.pose);
+      T_odom_oldrobot = sample.pose;
+      update_until(sample.stamp);
+      if (trajectory != nullptr) {
+        trajectory->push_back({sample.stamp, ekf.GetRobotPose(0)});
+      }
+
+      if (const auto *truth = NearestTruth(run.truth, sample.stamp)) {
+        const auto error = ekf.GetRobotPose(0).translation() - truth->pose.translation();
+        trajectory_sq_sum += error.x * error.x + error.y * error.y;
+        ++trajectory_count;
+      }
+    }
+  } catch (const std::runtime_error &) {
+    // Bad enough noise values make S singular, that config is no good.
+    score.diverged = true;
+    return score;
+  }
+
+  double landmark_sq_sum = 0.0;
+  size_t landmark_count = 0;
+  for (const auto &[index, truth] : run.landmark_truth) {
+    if (index >= max_landmarks || !ekf.IsLandmarkInitialized(index)) {
+      ++score.missed_landmarks;
+      continue;
+    }
+    const auto error = ekf.GetLandmark(index) - truth;
+    landmark_sq_sum += error.x * error.x + error.y * error.y;
+    ++landmark_count;
+  }
+
+  score.trajectory_rmse =
+      trajectory_count > 0 ? std::sqrt(trajectory_sq_sum / trajectory_count) : 0.0;
+  score.landmark_rmse = landmark_count > 0 ? std::sqrt(landmark_sq_sum / landmark_count) : 0.0;
+  score.diverged = !std::isfinite(score.trajectory_rmse) || !std::isfinite(score.landmark_rmse);
+  return score;
+}
+
+std::vector<TuneResult> RankNoiseConfigs(const std::vector<SlamRun> &runs,
+                                         const std::vector<NoiseConfig> &configs,
+                                         size_t max_landmarks, double landmark_weight,
+                                         turtlelib::WorkerPool &pool) {
+  std::vector<TuneResult> results;
+  if (runs.empty()) {
+    return results;
+  }
+  // One job per (config, run) pair, so a few long runs don't idle the pool.
+  std::vector<ReplayScore> scores(configs.size() * runs.size());
+  pool.ParallelFor(0, scores.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const auto &run = runs.at(i % runs.size());
+      scores.at(i) = ReplaySlamRun(run, configs.at(i / runs.size()), max_landmarks);
+    }
+  });
+
+  for (size_t c = 0; c < configs.size(); ++c) {
+    TuneResult result;
+    result.config = configs.at(c);
+    for (size_t r = 0; r < runs.size(); ++r) {
+      const auto &score = scores.at(c * runs.size() + r);
+      result.trajectory_rmse += score.trajectory_rmse / runs.size();
+      result.landmark_rmse += score.landmark_rmse / runs.size();
+      result.missed_landmarks += score.missed_landmarks;
+      result.diverged_runs += score.diverged ? 1 : 0;
+    }
+    result.score = result.diverged_runs > 0
+                       ? std::numeric_limits<double>::infinity()
+                       : result.trajectory_rmse + landmark_weight * result.landmark_rmse;
+    results.push_back(result);
+  }
+  std::stable_sort(results.begin(), results.end(),
+                   [](const TuneResult &a, const TuneResult &b) { return a.score < b.score; });
+  return results;
+}
+
+} // namespace nuslam
@@ -0,0 +1,187 @@
+//! @file noise parameter tuner
+//! @brief Replay recorded runs through the filter over a grid of noise values,
+//! on every core, and rank the results.
+// Usage:
+//  slam_tuner [options] run_file...
+// Options:
+//  --process min:max:steps  process noise grid, log spaced (1e-6:1e-1:11)
+//  --sensor min:max:steps   sensor noise grid, log spaced (1e-6:1e-1:11)
+//  --refine rounds          zoom the grid around the best result this many
+//                           times (2)
+//  --landmarks n            size of the filter's landmark block (3)
+//  --landmark-weight w      weight of landmark error in the score (1.0)
+//  --threads n              worker threads, 0 for every core (0)
+//  --top n                  number of results printed (10)
+// Run files come from the run_recorder node. The score of a config is
+// mean trajectory RMSE + w * mean landmark RMSE over all runs.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <turtlelib/worker_pool.hpp>
+
+#include "nuslam/slam_run.hpp"
+
+namespace {
+
+//! @brief Log spaced range of values.
+struct LogRange {
+  double min = 1e-6;
+  double max = 1e-1;
+  size_t steps = 11;
+
+  std::vector<double> Values() const {
+    std::vector<double> values;
+    if (steps <= 1) {
+      values.push_back(std::sqrt(min * max));
+      return values;
+    }
+    const double log_min = std::log(min);
+    const double log_step = (std::log(max) - log_min) / (steps - 1);
+    for (size_t i = 0; i < steps; ++i) {
+      values.push_back(std::exp(log_min + log_step * i));
+    }
+    return values;
+  }
+
+  //! @brief ratio between neighbouring values
+  double StepRatio() const { return steps <= 1 ? 1.0 : std::pow(max / min, 1.0 / (steps - 1)); }
+
+  //! @brief Same number of steps, spanning one old step on each side of center.
+  LogRange ZoomTo(double center) const {
+    const double ratio = StepRatio();
+    return {center / ratio, center * ratio, steps};
+  }
+};
+
+LogRange ParseRange(const std::string &text) {
+  LogRange range;
+  if (std::sscanf(text.c_str(), "%lf:%lf:%zu", &range.min, &range.max, &range.steps) != 3 ||
+      range.min <= 0.0 || range.max < range.min || range.steps == 0) {
+    throw std::invalid_argument("Bad range '" + text + "', expected min:max:steps with 0 < min");
+  }
+  return range;
+}
+
+std::vector<nuslam::NoiseConfig> Grid(const LogRange &process, const LogRange &sensor) {
+  std::vector<nuslam::NoiseConfig> configs;
+  for (auto q : process.Values()) {
+    for (auto r : sensor.Values()) {
+      configs.push_back({q, r});
+    }
+  }
+  return configs;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  LogRange process_range;
+  LogRange sensor_range;
+  size_t refine_rounds = 2;
+  size_t max_landmarks = 3;
+  double landmark_weight = 1.0;
+  size_t num_threads = 0;
+  size_t top = 10;
+  std::vector<std::string> run_files;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::invalid_argument(arg + " needs a value");
+        }
+        return argv[++i];
+      };
+      if (arg == "--process") {
+        process_range = ParseRange(next());
+      } else if (arg == "--sensor") {
+        sensor_range = ParseRange(next());
+      } else if (arg == "--refine") {
+        refine_rounds = std::stoul(next());
+      } else if (arg == "--landmarks") {
+        max_landmarks = std::stoul(next());
+      } else if (arg == "--landmark-weight") {
+        landmark_weight = std::stod(next());
+      } else if (arg == "--threads") {
+        num_threads = std::stoul(next());
+      } else if (arg == "--top") {
+        top = std::stoul(next());
+      } else {
+        run_files.push_back(arg);
+      }
+    }
+    if (run_files.empty()) {
+      throw std::invalid_argument("No run files given");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\nusage: " << argv[0]
+              << " [--process min:max:steps] [--sensor min:max:steps] [--refine rounds]"
+                 " [--landmarks n] [--landmark-weight w] [--threads n] [--top n] run_file...\n";
+    return 1;
+  }
+
+  std::vector<nuslam::SlamRun> runs;
+  for (const auto &file : run_files) {
+    std::ifstream in(file);
+    if (!in) {
+      std::cerr << "Can't open " << file << "\n";
+      return 1;
+    }
+    try {
+      runs.push_back(nuslam::ReadSlamRun(in));
+    } catch (const std::exception &e) {
+      std::cerr << file << ": " << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  turtlelib::WorkerPool pool(num_threads);
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<nuslam::TuneResult> all_results;
+  for (size_t round = 0; round <= refine_rounds; ++round) {
+    const auto results = nuslam::RankNoiseConfigs(runs, Grid(process_range, sensor_range),
+                                                  max_landmarks, landmark_weight, pool);
+    const auto best = results.begin();
+    std::cerr << "round " << round << ": " << results.size() << " configs, best score "
+              << best->score << "\n";
+    all_results.insert(all_results.end(), results.begin(), results.end());
+    if (!std::isfinite(best->score)) {
+      break;
+    }
+    // Zoom in around the best config for the next round.
+    process_range = process_range.ZoomTo(best->config.process_noise);
+    sensor_range = sensor_range.ZoomTo(best->config.sensor_noise);
+  }
+
+  std::stable_sort(
+      all_results.begin(), all_results.end(),
+      [](const nuslam::TuneResult &a, const nuslam::TuneResult &b) { return a.score < b.score; });
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << all_results.size() << " configs x " << runs.size() << " runs on " << pool.Size()
+            << " threads in " << seconds << " s\n";
+
+  std::cout << "rank,process_noise,sensor_noise,score,trajectory_rmse,landmark_rmse,"
+               "missed_landmarks,diverged_runs\n"
+            << std::setprecision(6);
+  for (size_t i = 0; i < std::min(top, all_results.size()); ++i) {
+    const auto &result = all_results.at(i);
+    std::cout << i + 1 << "," << result.config.process_noise << "," << result.config.sensor_noise
+              << "," << result.score << "," << result.trajectory_rmse << ","
+              << result.landmark_rmse << "," << result.missed_landmarks << ","
+              << result.diverged_runs << "\n";
+  }
+  return 0;
+}
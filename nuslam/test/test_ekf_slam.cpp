@@ -0,0 +1,258 @@
+#include "nuslam/ekf_slam.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <turtlelib/se2d.hpp>
+#include <turtlelib/worker_pool.hpp>
+
+namespace nuslam {
+
+namespace {
+
+constexpr double kProcessNoise = 1e-3;
+constexpr double kSensorNoise = 1e-2;
+
+//! @brief Largest difference between two matrices of the same size.
+double MaxDifference(const arma::mat &a, const arma::mat &b) {
+  REQUIRE(a.n_rows == b.n_rows);
+  REQUIRE(a.n_cols == b.n_cols);
+  double most = 0.0;
+  for (size_t j = 0; j < a.n_cols; ++j) {
+    for (size_t i = 0; i < a.n_rows; ++i) {
+      most = std::max(most, std::abs(a.at(i, j) - b.at(i, j)));
+    }
+  }
+  return most;
+}
+
+//! @brief What a robot at its current estimate would measure of a landmark at p,
+//! off by a little so the update has something to correct.
+LandmarkMeasurement Measure(const EkfSlam &ekf, size_t robot, size_t landmark,
+                            turtlelib::Point2D p) {
+  const auto pose = ekf.GetRobotPose(robot);
+  const auto in_robot = pose.inv()(p);
+  const turtlelib::Vector2D v{in_robot.x, in_robot.y};
+  return {landmark, v.magnitude() + 0.01 * (landmark + 1), std::atan2(v.y, v.x) - 0.005, p};
+}
+
+const std::vector<turtlelib::Point2D> kLandmarks = {
+    {1.0, 1.0}, {2.0, -1.0}, {-1.0, 2.0}, {0.5, 3.0}};
+
+//! @brief A filter of three robots that all saw every landmark, so the
+//! covariance couples every part of the state.
+EkfSlam CorrelatedFilter() {
+  EkfSlam ekf(3, kLandmarks.size(), kProcessNoise, kSensorNoise);
+  for (size_t robot = 0; robot < ekf.NumRobots(); ++robot) {
+    ekf.Predict(robot, turtlelib::Transform2D{{0.1 * (robot + 1), 0.05}, 0.1 * robot});
+    std::vector<LandmarkMeasurement> measurements;
+    for (size_t k = 0; k < kLandmarks.size(); ++k) {
+      measurements.push_back(Measure(ekf, robot, k, kLandmarks.at(k)));
+    }
+    ekf.Update(robot, measurements);
+  }
+  return ekf;
+}
+
+//! @brief Measurement of a landmark off from what the filter expects by
+//! offset times a fixed error.
+LandmarkMeasurement MeasureEstimate(const EkfSlam &ekf, size_t robot, size_t landmark,
+                                    double offset) {
+  const auto p = ekf.GetLandmark(landmark);
+  const auto in_robot = ekf.GetRobotPose(robot).inv()(p);
+  const turtlelib::Vector2D v{in_robot.x, in_robot.y};
+  return {landmark, v.magnitude() + 2.0 * offset * (landmark % 2 == 0 ? 1.0 : -1.0),
+          std::atan2(v.y, v.x) + offset, p};
+}
+
+} // namespace
+
+TEST_CASE("PredictAll matches the dense A sigma A^T + Q", "[ekf_slam]") {
+  const std::vector<std::optional<turtlelib::Transform2D>> deltas = {
+      turtlelib::Transform2D{{0.2, -0.1}, 0.3}, std::nullopt,
+      turtlelib::Transform2D{{-0.05, 0.15}, -0.2}};
+
+  EkfSlam ekf = CorrelatedFilter();
+  const arma::mat sigma = ekf.GetCovariance();
+  const size_t n = ekf.StateSize();
+  // Every robot block is coupled to the rest, or the test would prove little.
+  REQUIRE(std::abs(sigma.at(0, n - 1)) > 1e-9);
+  REQUIRE(std::abs(sigma.at(0, 3)) > 1e-9);
+
+  // The prediction nuslam did before the block updates, over the whole state.
+  arma::mat a_mat = arma::eye(n, n);
+  arma::mat q_mat = arma::zeros(n, n);
+  std::vector<turtlelib::Transform2D> expected_poses;
+  for (size_t robot = 0; robot < deltas.size(); ++robot) {
+    expected_poses.push_back(ekf.GetRobotPose(robot));
+    if (!deltas.at(robot)) {
+      continue;
+    }
+    const size_t r = 3 * robot;
+    a_mat.at(r + 1, r) = -deltas.at(robot)->translation().y;
+    a_mat.at(r + 2, r) = deltas.at(robot)->translation().x;
+    for (size_t i = r; i < r + 3; ++i) {
+      q_mat.at(i, i) = kProcessNoise;
+    }
+    expected_poses.back() = expected_poses.back() * deltas.at(robot).value();
+  }
+  const arma::mat expected = a_mat * sigma * a_mat.t() + q_mat;
+
+  SECTION("on the calling thread") { ekf.PredictAll(deltas); }
+  SECTION("on a pool") {
+    turtlelib::WorkerPool pool(2);
+    ekf.PredictAll(deltas, &pool);
+  }
+
+  REQUIRE(MaxDifference(ekf.GetCovariance(), expected) <
+          1e-12 * (1.0 + MaxDifference(expected, arma::zeros(n, n))));
+  for (size_t robot = 0; robot < deltas.size(); ++robot) {
+    const auto pose = ekf.GetRobotPose(robot);
+    REQUIRE(std::abs(pose.translation().x - expected_poses.at(robot).translation().x) < 1e-12);
+    REQUIRE(std::abs(pose.translation().y - expected_poses.at(robot).translation().y) < 1e-12);
+    REQUIRE(std::abs(turtlelib::normalize_angle(pose.rotation() -
+                                                expected_poses.at(robot).rotation())) < 1e-12);
+  }
+}
+
+TEST_CASE("PredictAll wants one entry per robot", "[ekf_slam]") {
+  EkfSlam ekf(2, 1, kProcessNoise, kSensorNoise);
+  REQUIRE_THROWS_AS(ekf.PredictAll({turtlelib::Transform2D{}}), std::invalid_argument);
+}
+
+TEST_CASE("One batched update equals sequential updates", "[ekf_slam]") {
+  EkfSlam batched = CorrelatedFilter();
+  batched.Predict(1, turtlelib::Transform2D{{0.1, 0.02}, 0.05});
+  EkfSlam sequential = batched;
+  const arma::vec before = batched.GetState();
+  const double offset = GENERATE(0.0, 1e-4);
+
+  std::vector<LandmarkMeasurement> measurements;
+  for (size_t k = 0; k < kLandmarks.size(); ++k) {
+    measurements.push_back(MeasureEstimate(batched, 1, k, offset));
+  }
+  const auto predictions = batched.Update(1, measurements);
+  REQUIRE(predictions.size() == measurements.size());
+  for (const auto &measurement : measurements) {
+    sequential.Update(1, {measurement});
+  }
+
+  // Sequential updates linearize again after each one, the stacked update
+  // linearizes once. With no error they are the same algebra, with a small one
+  // they differ in second order terms only.
+  const arma::mat &sigma = batched.GetCovariance();
+  const double tolerance = offset == 0.0 ? 1e-9 : 1e-5;
+  REQUIRE(MaxDifference(sigma, sequential.GetCovariance()) <
+          tolerance * (1.0 + MaxDifference(sigma, arma::zeros(sigma.n_rows, sigma.n_cols))));
+  REQUIRE(MaxDifference(batched.GetState(), sequential.GetState()) < 1e-7);
+  if (offset > 0.0) {
+    // The error moved the state, or the mean check above proved nothing.
+    REQUIRE(MaxDifference(batched.GetState(), before) > 1e-5);
+  }
+}
+
+TEST_CASE("Reordering landmarks only permutes the filter", "[ekf_slam]") {
+  EkfSlam ekf = CorrelatedFilter();
+  const arma::vec state = ekf.GetState();
+  const arma::mat sigma = ekf.GetCovariance();
+  std::vector<size_t> old_slots;
+  for (size_t k = 0; k < ekf.MaxLandmarks(); ++k) {
+    old_slots.push_back(ekf.LandmarkSlot(k));
+  }
+
+  std::vector<LandmarkMeasurement> measurements;
+  for (size_t k = 0; k < ekf.MaxLandmarks(); ++k) {
+    measurements.push_back(MeasureEstimate(ekf, 2, k, 0.0));
+  }
+  // Nowhere near a known landmark.
+  measurements.push_back({0, 5.0, 0.5, {}});
+  auto associated_before = measurements;
+  ekf.AssociateLandmarks(2, associated_before, 9.0);
+
+  ekf.ReorderLandmarks();
+
+  // new_index maps each index of the old state to where it is now.
+  const size_t base = 3 * ekf.NumRobots();
+  std::vector<size_t> new_index(ekf.StateSize());
+  for (size_t i = 0; i < base; ++i) {
+    new_index.at(i) = i;
+  }
+  bool moved = false;
+  for (size_t k = 0; k < ekf.MaxLandmarks(); ++k) {
+    const size_t slot = ekf.LandmarkSlot(k);
+    moved = moved || slot != old_slots.at(k);
+    new_index.at(base + 2 * old_slots.at(k)) = base + 2 * slot;
+    new_index.at(base + 2 * old_slots.at(k) + 1) = base + 2 * slot + 1;
+    REQUIRE(ekf.GetLandmark(k).x == state.at(base + 2 * old_slots.at(k)));
+    REQUIRE(ekf.GetLandmark(k).y == state.at(base + 2 * old_slots.at(k) + 1));
+  }
+  // The landmarks were not in curve order, or this checks nothing.
+  REQUIRE(moved);
+
+  // Undoing the permutation gives back the filter bit for bit.
+  arma::vec state_back(state.n_elem);
+  arma::mat sigma_back(sigma.n_rows, sigma.n_cols);
+  for (size_t i = 0; i < state.n_elem; ++i) {
+    state_back.at(i) = ekf.GetState().at(new_index.at(i));
+    for (size_t j = 0; j < state.n_elem; ++j) {
+      sigma_back.at(i, j) = ekf.GetCovariance().at(new_index.at(i), new_index.at(j));
+    }
+  }
+  REQUIRE(MaxDifference(state_back, state) == 0.0);
+  REQUIRE(MaxDifference(sigma_back, sigma) == 0.0);
+
+  auto associated_after = measurements;
+  ekf.AssociateLandmarks(2, associated_after, 9.0);
+  for (size_t i = 0; i < measurements.size(); ++i) {
+    REQUIRE(associated_after.at(i).landmark_index == associated_before.at(i).landmark_index);
+  }
+  for (size_t k = 0; k < ekf.MaxLandmarks(); ++k) {
+    REQUIRE(associated_after.at(k).landmark_index == k);
+  }
+  // Every slot is taken, so the far one has nowhere to go.
+  REQUIRE(associated_after.back().landmark_index == ekf.MaxLandmarks());
+}
+
+TEST_CASE("A landmark gets at most one measurement of a scan", "[ekf_slam]") {
+  // One slot more than there are landmarks, so a new landmark has room.
+  EkfSlam ekf(1, kLandmarks.size() + 1, kProcessNoise, kSensorNoise);
+  ekf.Predict(0, turtlelib::Transform2D{{0.1, 0.05}, 0.1});
+  std::vector<LandmarkMeasurement> seen;
+  for (size_t k = 0; k < kLandmarks.size(); ++k) {
+    seen.push_back(Measure(ekf, 0, k, kLandmarks.at(k)));
+  }
+  ekf.Update(0, seen);
+
+  std::vector<LandmarkMeasurement> measurements;
+  for (size_t k = 0; k < kLandmarks.size(); ++k) {
+    measurements.push_back(MeasureEstimate(ekf, 0, k, 0.0));
+  }
+  // A second, worse look at landmark 1, listed before the good one.
+  measurements.insert(measurements.begin(), MeasureEstimate(ekf, 0, 1, 0.01));
+  ekf.AssociateLandmarks(0, measurements, 9.0);
+  for (size_t k = 0; k < kLandmarks.size(); ++k) {
+    REQUIRE(measurements.at(k + 1).landmark_index == k);
+  }
+  // Landmark 1 went to the closer one, so the other is a new landmark.
+  REQUIRE(measurements.front().landmark_index == kLandmarks.size());
+
+  SECTION("and is dropped when the map is full") {
+    EkfSlam full = CorrelatedFilter();
+    std::vector<LandmarkMeasurement> crowded;
+    for (size_t k = 0; k < full.MaxLandmarks(); ++k) {
+      crowded.push_back(MeasureEstimate(full, 2, k, 0.0));
+    }
+    crowded.insert(crowded.begin(), MeasureEstimate(full, 2, 1, 0.01));
+    full.AssociateLandmarks(2, crowded, 9.0);
+    REQUIRE(crowded.at(2).landmark_index == 1);
+    REQUIRE(crowded.front().landmark_index == full.MaxLandmarks());
+  }
+}
+
+} // namespace nuslam
@@ -0,0 +1,131 @@
+#include "nuslam/slam_run.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <turtlelib/se2d.hpp>
+#include <turtlelib/worker_pool.hpp>
+
+#include "nuslam/ekf_slam.hpp"
+
+namespace nuslam {
+
+namespace {
+
+constexpr size_t kLandmarks = 3;
+constexpr double kStep = 0.1;
+
+//! @brief A robot driving a circle among three landmarks. Odometry drifts, it
+//! overestimates every motion, the landmark observations are exact.
+SlamRun DriftingRun() {
+  SlamRun run;
+  run.landmark_truth = {{0, {1.0, 1.5}}, {1, {-0.5, 2.0}}, {2, {1.5, 0.5}}};
+  const turtlelib::Transform2D step{{0.02, 0.0}, 0.015};
+  const turtlelib::Transform2D drifted_step{{0.02 * 1.05, 0.0}, 0.015 * 1.04};
+  turtlelib::Transform2D truth;
+  turtlelib::Transform2D odom;
+  for (size_t i = 0; i <= 400; ++i) {
+    const double stamp = i * kStep;
+    run.truth.push_back({stamp, truth});
+    run.odom.push_back({stamp, odom});
+    if (i % 5 == 0) {
+      for (const auto &[index, landmark] : run.landmark_truth) {
+        run.observations.push_back({stamp, index, truth.inv()(landmark)});
+      }
+    }
+    truth = truth * step;
+    odom = odom * drifted_step;
+  }
+  return run;
+}
+
+//! @brief What the slam node does with the run as the messages come in, with
+//! none of the replay code.
+std::vector<turtlelib::Transform2D> LiveTrajectory(const SlamRun &run, const NoiseConfig &config) {
+  EkfSlam ekf(1, kLandmarks, config.process_noise, config.sensor_noise);
+  std::vector<turtlelib::Transform2D> poses;
+  turtlelib::Transform2D last_odom;
+  size_t next = 0;
+  for (const auto &sample : run.odom) {
+    ekf.Predict(0, last_odom.inv() * sample.pose);
+    last_odom = sample.pose;
+    std::vector<LandmarkMeasurement> measurements;
+    const auto bot = ekf.GetRobotPose(0);
+    for (; next < run.observations.size() && run.observations.at(next).stamp <= sample.stamp;
+         ++next) {
+      const auto &obs = run.observations.at(next);
+      measurements.push_back({obs.landmark_index,
+                              std::hypot(obs.robot_frame.x, obs.robot_frame.y),
+                              std::atan2(obs.robot_frame.y, obs.robot_frame.x),
+                              bot(obs.robot_frame)});
+    }
+    ekf.Update(0, measurements);
+    poses.push_back(ekf.GetRobotPose(0));
+  }
+  return poses;
+}
+
+} // namespace
+
+TEST_CASE("A written run reads back", "[slam_run]") {
+  const SlamRun run = DriftingRun();
+  std::stringstream text;
+  WriteSlamRun(text, run);
+  const SlamRun read = ReadSlamRun(text);
+  REQUIRE(read.odom.size() == run.odom.size());
+  REQUIRE(read.truth.size() == run.truth.size());
+  REQUIRE(read.observations.size() == run.observations.size());
+  REQUIRE(read.landmark_truth.size() == kLandmarks);
+  for (size_t i = 0; i < run.observations.size(); ++i) {
+    REQUIRE(read.observations.at(i).landmark_index == run.observations.at(i).landmark_index);
+    REQUIRE(std::abs(read.observations.at(i).robot_frame.x - run.observations.at(i).robot_frame.x) <
+            1e-8);
+  }
+
+  std::stringstream bad("odom 0 0 0 0\nwheel 1 2 3\n");
+  REQUIRE_THROWS_AS(ReadSlamRun(bad), std::runtime_error);
+}
+
+TEST_CASE("Replaying a recorded run follows the live filter", "[slam_run]") {
+  const SlamRun run = DriftingRun();
+  const NoiseConfig config{1e-3, 1e-4};
+  std::stringstream text;
+  WriteSlamRun(text, run);
+
+  std::vector<StampedPose> trajectory;
+  const auto score = ReplaySlamRun(ReadSlamRun(text), config, kLandmarks, &trajectory);
+  const auto live = LiveTrajectory(run, config);
+  REQUIRE_FALSE(score.diverged);
+  REQUIRE(score.missed_landmarks == 0);
+  REQUIRE(trajectory.size() == live.size());
+  for (size_t i = 0; i < live.size(); ++i) {
+    REQUIRE(std::abs(trajectory.at(i).stamp - run.odom.at(i).stamp) < 1e-9);
+    const auto error = trajectory.at(i).pose.translation() - live.at(i).translation();
+    // The text keeps 10 digits, nothing else may differ.
+    REQUIRE(std::hypot(error.x, error.y) < 1e-6);
+  }
+}
+
+TEST_CASE("The tuner ranks the noise that fits the run first", "[slam_run]") {
+  const std::vector<SlamRun> runs = {DriftingRun()};
+  // Odometry drifts and the landmarks are exact, so trusting the sensor wins.
+  const NoiseConfig fits{1e-3, 1e-4};
+  const std::vector<NoiseConfig> configs = {{1e-8, 1.0}, fits, {1e-6, 1e-1}};
+  turtlelib::WorkerPool pool(2);
+  const auto results = RankNoiseConfigs(runs, configs, kLandmarks, 1.0, pool);
+  REQUIRE(results.size() == configs.size());
+  REQUIRE(results.front().config.process_noise == fits.process_noise);
+  REQUIRE(results.front().config.sensor_noise == fits.sensor_noise);
+  REQUIRE(results.front().diverged_runs == 0);
+  for (size_t i = 1; i < results.size(); ++i) {
+    REQUIRE(results.at(i - 1).score <= results.at(i).score);
+  }
+  // A clear win, not a tie broken by order.
+  REQUIRE(results.front().score < 0.5 * results.at(1).score);
+}
+
+} // namespace nuslam
@@ -60,8 +60,8 @@ public:
 
     // Setup timer and set things in motion.
     main_timer_ =
-        this->create_wall_timer(std::chrono::milliseconds(1000 / rate),
-                                std::bind(&Circle::main_timer_callback, this));
+        rclcpp::create_timer(this, get_clock(), std::chrono::milliseconds(1000 / rate),
+                             std::bind(&Circle::main_timer_callback, this));
   }
   enum ControlState { kRunning,kStopping ,kStopped };
 
@@ -7,13 +7,27 @@
 //  wheel_right - string: name of right wheel joint
 //  wheel_radius - double: wheel radius
 //  track_width - double: distance between body center and wheel track.
+//  sensor_data_batch - bool: integrate every sample of sensor_data_batch
+//  instead of joint_states, default false
+//  encoder_ticks_per_rad - double: encoder ticks per wheel radian, only read
+//  with sensor_data_batch
+//  trace - bool: record the odometry.wheels, odometry.batch and odometry.body
+//  trace points (see turtlelib/trace.hpp), default false
+//  trace_file - string: file the trace is written to at shutdown, empty
+//  (default) writes none
+//  lockstep - bool: acknowledge the wheel data handled on /nusim/step_ack, for
+//  nusim's lockstep time_mode, default false
 
 // Publishers:
 //  odom - nav_msgs::msg::Odometry : calculated odometry value
 //  tf : odometry frame from body frame
+//  /nusim/step_ack - nuturtle_control::msg::StepAck, stamp of the odometry
+//  published (lockstep only)
 
 // Subscriber:
 //   joint_states - sensor_msgs::msg::JointState: Joint State of the robot
+//   sensor_data_batch - nuturtle_control::msg::SensorDataBatch: encoder
+//   samples, instead of joint_states with sensor_data_batch
 
 // Service Server:
 //  initial_pose - nuturtle_control::srv::InitPose : Set the initial pose of the
@@ -38,6 +52,8 @@
 #include <geometry_msgs/msg/transform_stamped.hpp>
 #include <nav_msgs/msg/odometry.hpp>
 #include <nav_msgs/msg/path.hpp>
+#include <nuturtle_control/msg/sensor_data_batch.hpp>
+#include <nuturtle_control/msg/step_ack.hpp>
 #include <nuturtle_control/srv/init_pose.hpp>
 #include <nuturtlebot_msgs/msg/sensor_data.hpp>
 #include <nuturtlebot_msgs/msg/wheel_commands.hpp>
@@ -52,12 +68,13 @@
 #include <rclcpp/time.hpp>
 #include <sensor_msgs/msg/detail/joint_state__traits.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
-#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <tf2_ros/transform_broadcaster.h>
 #include <turtlelib/diff_drive.hpp>
 #include <turtlelib/geometry2d.hpp>
 #include <turtlelib/se2d.hpp>
+#include <turtlelib/trace.hpp>
 
 #include <leo_ros_utils/math_helper.hpp>
 #include <leo_ros_utils/param_helper.hpp>
@@ -78,9 +95,25 @@ public:
 
     // Uncomment this to turn on debug level and enable debug statements
     // rcutils_logging_set_logger_level(get_logger().get_name(), RCUTILS_LOG_SEVERITY_DEBUG);
-
-    js_linstener = create_subscription<sensor_msgs::msg::JointState>(
-        "joint_states", 10, std::bind(&Odometry::JointStateCb, this, std::placeholders::_1));
+    if (GetParam<bool>(*this, "trace", "record the trace points of every update", false)) {
+      turtlelib::SetTraceMask(kTraceOdometry);
+    }
+    trace_file_ =
+        GetParam<std::string>(*this, "trace_file", "file the trace is written to at shutdown", "");
+
+    // turtle_control makes a batch into a single joint state, integrating
+    // each of its samples here follows the wheels at the rate they were read.
+    if (GetParam<bool>(*this, "sensor_data_batch",
+                       "integrate sensor_data_batch instead of joint_states", false)) {
+      encoder_ticks_per_rad =
+          GetParam<double>(*this, "encoder_ticks_per_rad", "encoder ticks per wheel radian");
+      sensor_data_batch_listener = create_subscription<nuturtle_control::msg::SensorDataBatch>(
+          "sensor_data_batch", 10,
+          std::bind(&Odometry::SensorDataBatchCb, this, std::placeholders::_1));
+    } else {
+      js_linstener = create_subscription<sensor_msgs::msg::JointState>(
+          "joint_states", 10, std::bind(&Odometry::JointStateCb, this, std::placeholders::_1));
+    }
 
     odom_publisher = create_publisher<nav_msgs::msg::Odometry>("odom", 10);
 
@@ -89,12 +122,39 @@ public:
     init_pose_srv = create_service<nuturtle_control::srv::InitPose>(
         "initial_pose",
         std::bind(&Odometry::init_pose_cb, this, std::placeholders::_1, std::placeholders::_2));
+
+    // Absolute, nusim listens outside any robot namespace.
+    if (GetParam<bool>(*this, "lockstep", "acknowledge nusim wheel data", false)) {
+      step_ack_publisher_ = create_publisher<nuturtle_control::msg::StepAck>("/nusim/step_ack", 10);
+    }
   }
 
-  void JointStateCb(const sensor_msgs::msg::JointState &msg) {
-    std::stringstream debug_ss;
-    debug_ss << "\n===>\n";
+  //! @brief Write the trace out at shutdown, when trace_file is set.
+  ~Odometry() override {
+    if (trace_file_.empty()) {
+      return;
+    }
+    try {
+      const size_t count = turtlelib::DumpTrace(trace_file_);
+      RCLCPP_INFO_STREAM(get_logger(), "Wrote " << count << " trace records to " << trace_file_);
+    } catch (const std::runtime_error &error) {
+      RCLCPP_ERROR_STREAM(get_logger(), error.what());
+    }
+  }
 
+  //! @brief Tell nusim the wheel data up to stamp is handled, in lockstep.
+  //! @param stamp stamp of the odometry just published
+  void AckStep(const builtin_interfaces::msg::Time &stamp) {
+    if (!step_ack_publisher_) {
+      return;
+    }
+    nuturtle_control::msg::StepAck ack;
+    ack.stamp = stamp;
+    ack.consumer = get_fully_qualified_name();
+    step_ack_publisher_->publish(ack);
+  }
+
+  void JointStateCb(const sensor_msgs::msg::JointState &msg) {
     turtlelib::WheelConfig new_config;
     for (size_t i = 0; i < msg.name.size(); ++i) {
       if (msg.name.at(i) == wheel_left) {
@@ -104,21 +164,46 @@ public:
       }
     }
 
-    // debug_ss << "JS value: \n" << sensor_msgs::msg::to_yaml(msg) << "\n";
-    debug_ss << "new config from sensor " << new_config << "\n";
+    TURTLELIB_TRACE_POINT(kTraceOdometry, "odometry.wheels", "left,right", new_config.left,
+                          new_config.right);
 
     diff_bot.UpdateRobotConfig(new_config);
+    PublishOdometry(msg.header.stamp);
+  }
+
+  //! @brief Integrate a batch of encoder samples in order, then publish the
+  //! odometry once, at the last one.
+  //! @param msg the samples
+  void SensorDataBatchCb(const nuturtle_control::msg::SensorDataBatch &msg) {
+    const size_t samples = msg.stamps.size();
+    if (msg.left_encoder.size() != samples || msg.right_encoder.size() != samples) {
+      RCLCPP_WARN(get_logger(), "Skipping a sensor_data_batch with uneven columns");
+      return;
+    }
+    if (samples == 0) {
+      return;
+    }
+    TURTLELIB_TRACE_POINT(kTraceOdometry, "odometry.batch", "samples", samples);
+    for (size_t i = 0; i < samples; ++i) {
+      diff_bot.UpdateRobotConfig({msg.left_encoder[i] / encoder_ticks_per_rad,
+                                  msg.right_encoder[i] / encoder_ticks_per_rad});
+    }
+    PublishOdometry(msg.stamps.back());
+  }
 
+  //! @brief Publish the odometry, its tf and the track of the current body configuration.
+  //! @param stamp time of the wheel reading it came from
+  void PublishOdometry(const builtin_interfaces::msg::Time &stamp) {
     turtlelib::Transform2D bot_tf = diff_bot.GetBodyConfig();
-    double current_time = rclcpp::Time{msg.header.stamp.sec, msg.header.stamp.nanosec}.seconds();
+    double current_time = rclcpp::Time{stamp.sec, stamp.nanosec}.seconds();
     double delta_time = current_time - last_stamped_tf2d.first;
 
-    debug_ss << "Body TF " << bot_tf;
-    RCLCPP_DEBUG_STREAM(get_logger(), debug_ss.str());
+    TURTLELIB_TRACE_POINT(kTraceOdometry, "odometry.body", "x,y,theta", bot_tf.translation().x,
+                          bot_tf.translation().y, bot_tf.rotation());
 
     // Publish a odom message.
     nav_msgs::msg::Odometry odom_msg;
-    odom_msg.header.stamp = msg.header.stamp;
+    odom_msg.header.stamp = stamp;
     odom_msg.header.frame_id = odom_id;
     odom_msg.child_frame_id = body_id;
 
@@ -136,7 +221,7 @@ public:
     geometry_msgs::msg::TransformStamped tf_stamped;
     tf_stamped.header.frame_id = odom_id;
     tf_stamped.child_frame_id = body_id;
-    tf_stamped.header.stamp = msg.header.stamp;
+    tf_stamped.header.stamp = stamp;
     tf_stamped.transform = leo_ros_utils::Convert(odom_msg.pose.pose);
 
     tf_broadcaster.sendTransform(tf_stamped);
@@ -174,6 +259,7 @@ public:
                                                                   odom_path_history.end()};
 
     path_publisher_->publish(path_msg);
+    AckStep(stamp);
   }
 
   void init_pose_cb(const nuturtle_control::srv::InitPose::Request::SharedPtr req,
@@ -184,6 +270,7 @@ public:
 
 private:
   constexpr static size_t kRobotPathHistorySize = 10; // number of data points
+  constexpr static uint32_t kTraceOdometry = 1; // trace category of the odometry updates
 
   std::string body_id;
   std::string odom_id;
@@ -204,8 +291,13 @@ private:
   rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr path_publisher_;
 
   rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr js_linstener;
+  rclcpp::Subscription<nuturtle_control::msg::SensorDataBatch>::SharedPtr
+      sensor_data_batch_listener;
+  double encoder_ticks_per_rad = 0.0;
 
   rclcpp::Service<nuturtle_control::srv::InitPose>::SharedPtr init_pose_srv;
+  rclcpp::Publisher<nuturtle_control::msg::StepAck>::SharedPtr step_ack_publisher_;
+  std::string trace_file_;
 };
 
 int main(int argc, char *argv[]) {
@@ -1,21 +1,28 @@
 //! @file Control turtle bot.
 
 // Param:
+//  lockstep - bool: acknowledge the sensor data handled on /nusim/step_ack,
+//  for nusim's lockstep time_mode (default false)
 
 // Publishes:
 //  wheel_cmd - nuturtlebot_msgs::msg::WheelCommands wheel command of robot base
 //  on cmd_vel
 //  joint_states - Publish robot's wheel joint state base on received sensor
 //  data (encoder)
+//  /nusim/step_ack - nuturtle_control::msg::StepAck, stamp of the joint state
+//  published (lockstep only)
 
 // Subscriber
 //  cmd_vel - geometry_msgs::msg::Twist
 //  sensor_data - nuturtlebot_msgs::msg::SensorData
+//  sensor_data_batch - nuturtle_control::msg::SensorDataBatch, several
+//  encoder samples at once
 
 // Workflow -
 //  Every received cmd_vel, generate and publish a wheel velocity command to
 //  wheel_cmd Every received sensor_data, generate and publish a joint_states
-//  from it.
+//  from it. A sensor_data_batch goes through its samples in order and
+//  publishes one joint_states, of the last one.
 
 #include <algorithm>
 #include <cstdint>
@@ -23,6 +30,8 @@
 #include <geometry_msgs/msg/pose_with_covariance.hpp>
 #include <geometry_msgs/msg/transform_stamped.hpp>
 #include <geometry_msgs/msg/twist.hpp>
+#include <nuturtle_control/msg/sensor_data_batch.hpp>
+#include <nuturtle_control/msg/step_ack.hpp>
 #include <nuturtlebot_msgs/msg/detail/sensor_data__traits.hpp>
 #include <nuturtlebot_msgs/msg/sensor_data.hpp>
 #include <nuturtlebot_msgs/msg/wheel_commands.hpp>
@@ -39,6 +48,7 @@
 #include <string>
 #include <turtlelib/diff_drive.hpp>
 #include <turtlelib/se2d.hpp>
+#include <utility>
 
 #include <leo_ros_utils/param_helper.hpp>
 
@@ -80,6 +90,11 @@ public:
             "sensor_data", 10,
             std::bind(&TurtleControl::SensorDataCb, this,
                       std::placeholders::_1));
+    sensor_data_batch_listener =
+        create_subscription<nuturtle_control::msg::SensorDataBatch>(
+            "sensor_data_batch", 10,
+            std::bind(&TurtleControl::SensorDataBatchCb, this,
+                      std::placeholders::_1));
 
     joint_state_publisher =
         create_publisher<sensor_msgs::msg::JointState>("joint_states", 10);
@@ -91,6 +106,14 @@ public:
     last_js.name.push_back("wheel_right_joint");
     last_js.position.push_back(0);
     last_js.position.push_back(0);
+
+    // Absolute, nusim listens outside any robot namespace.
+    if (GetParam<bool>(*this, "lockstep", "acknowledge nusim sensor data",
+                       false)) {
+      step_ack_publisher =
+          create_publisher<nuturtle_control::msg::StepAck>("/nusim/step_ack",
+                                                           10);
+    }
   }
 
 private:
@@ -134,19 +157,61 @@ private:
 
     wheel_cmd_publisher->publish(wheel_cmd);
   }
+  //! @brief Tell nusim the sensor data up to stamp is handled, in lockstep.
+  //! @param stamp stamp of the joint state just published
+  void AckStep(const builtin_interfaces::msg::Time &stamp) {
+    if (!step_ack_publisher) {
+      return;
+    }
+    nuturtle_control::msg::StepAck ack;
+    ack.stamp = stamp;
+    ack.consumer = get_fully_qualified_name();
+    step_ack_publisher->publish(ack);
+  }
+
   void SensorDataCb(const nuturtlebot_msgs::msg::SensorData &msg) {
+    UpdateJointState(msg.stamp, msg.left_encoder, msg.right_encoder);
+    // Publish to joint_states
+    joint_state_publisher->publish(last_js);
+    AckStep(last_js.header.stamp);
+  }
 
-    auto left_p = EncoderToRad(msg.left_encoder);
-    auto right_p = EncoderToRad(msg.right_encoder);
+  //! @brief Take a batch of encoder samples in order, in one callback.
+  //! joint_states only gets the last one, its velocity is over the last two.
+  //! @param msg the samples
+  void SensorDataBatchCb(const nuturtle_control::msg::SensorDataBatch &msg) {
+    const size_t samples = msg.stamps.size();
+    if (msg.left_encoder.size() != samples || msg.right_encoder.size() != samples) {
+      RCLCPP_WARN_STREAM(get_logger(), "Skipping a sensor_data_batch with columns of "
+                                           << samples << ", " << msg.left_encoder.size()
+                                           << " and " << msg.right_encoder.size()
+                                           << " samples");
+      return;
+    }
+    if (samples == 0) {
+      return;
+    }
+    for (size_t i = 0; i < samples; ++i) {
+      UpdateJointState(msg.stamps[i], msg.left_encoder[i], msg.right_encoder[i]);
+    }
+    joint_state_publisher->publish(last_js);
+    AckStep(last_js.header.stamp);
+  }
+
+  //! @brief Make last_js the wheel joint state of an encoder sample.
+  //! @param stamp time of the sample
+  //! @param left_tick left encoder
+  //! @param right_tick right encoder
+  void UpdateJointState(const builtin_interfaces::msg::Time &stamp,
+                        int32_t left_tick, int32_t right_tick) {
+    auto left_p = EncoderToRad(left_tick);
+    auto right_p = EncoderToRad(right_tick);
 
-    double time_diff =
-        rclcpp::Time{msg.stamp.sec, msg.stamp.nanosec}.seconds() -
-        rclcpp::Time{last_js.header.stamp.sec, msg.stamp.nanosec}.seconds();
+    double time_diff = (rclcpp::Time{stamp} - rclcpp::Time{last_js.header.stamp}).seconds();
 
     // TODO check the time_diff. it might not be doing velocity right.
     sensor_msgs::msg::JointState js;
-    js.header.stamp.sec = msg.stamp.sec;
-    js.header.stamp.nanosec = msg.stamp.nanosec;
+    js.header.stamp = stamp;
 
     js.name.push_back("wheel_left_joint");
     js.position.push_back(left_p);
@@ -156,9 +221,7 @@ private:
     js.position.push_back(right_p);
     js.velocity.push_back((right_p - last_js.position.at(1)) / time_diff);
 
-    // Publish to joint_states
-    joint_state_publisher->publish(js);
-    last_js = js;
+    last_js = std::move(js);
   }
 
   double EncoderToRad(int32_t tick) {
@@ -186,6 +249,10 @@ private:
   rclcpp::Subscription<geometry_msgs::msg::Twist>::SharedPtr cmd_vel_listener;
   rclcpp::Subscription<nuturtlebot_msgs::msg::SensorData>::SharedPtr
       sensor_data_listener;
+  rclcpp::Subscription<nuturtle_control::msg::SensorDataBatch>::SharedPtr
+      sensor_data_batch_listener;
+  rclcpp::Publisher<nuturtle_control::msg::StepAck>::SharedPtr
+      step_ack_publisher;
 };
 
 int main(int argc, char *argv[]) {
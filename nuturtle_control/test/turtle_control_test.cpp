@@ -19,6 +19,7 @@
 #include <geometry_msgs/msg/twist.hpp>
 #include <leo_ros_utils/param_helper.hpp>
 #include <memory>
+#include <nuturtle_control/msg/sensor_data_batch.hpp>
 #include <nuturtlebot_msgs/msg/sensor_data.hpp>
 #include <nuturtlebot_msgs/msg/wheel_commands.hpp>
 #include <sensor_msgs/msg/joint_state.hpp>
@@ -174,5 +175,45 @@ TEST_CASE("turtle control") {
       }
     }
   }
+
+  SECTION("JointState of a batch") {
+    auto batch_pub =
+        probe_node->create_publisher<nuturtle_control::msg::SensorDataBatch>(
+            "sensor_data_batch", 10);
+
+    std::optional<sensor_msgs::msg::JointState> js_opt;
+    auto js_sub = probe_node->create_subscription<sensor_msgs::msg::JointState>(
+        "joint_states", 10,
+        [&js_opt](const sensor_msgs::msg::JointState &msg) { js_opt = msg; });
+
+    // Three samples a millisecond apart, the joint state is of the last one.
+    nuturtle_control::msg::SensorDataBatch batch;
+    for (int32_t k = 1; k <= 3; ++k) {
+      builtin_interfaces::msg::Time stamp;
+      stamp.sec = 10;
+      stamp.nanosec = 1000000 * k;
+      batch.stamps.push_back(stamp);
+      batch.left_encoder.push_back(10 * k);
+      batch.right_encoder.push_back(-20 * k);
+    }
+    batch_pub->publish(batch);
+
+    INFO("Wait for joint state update");
+    REQUIRE(
+        SpinSomeUntil(probe_node, recv_timeout, [&]() { return js_opt.has_value(); }));
+
+    REQUIRE(js_opt->header.stamp == batch.stamps.back());
+    for (size_t i = 0; i < js_opt->name.size(); ++i) {
+      if (js_opt->name.at(i) == wheel_left_name) {
+        REQUIRE_THAT(js_opt->position.at(i), WithinAbs(30 / encoder_ticks_per_rad, 0.001));
+        // 10 ticks in one millisecond.
+        REQUIRE_THAT(js_opt->velocity.at(i),
+                     WithinRel(10 / encoder_ticks_per_rad / 0.001, 1e-6));
+      }
+      if (js_opt->name.at(i) == wheel_right_name) {
+        REQUIRE_THAT(js_opt->position.at(i), WithinAbs(-60 / encoder_ticks_per_rad, 0.001));
+      }
+    }
+  }
 }
 // }
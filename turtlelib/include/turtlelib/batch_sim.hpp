@@ -0,0 +1,188 @@
+#ifndef TURTLELIB_BATCH_SIM_INCLUDE_GUARD_HPP
+#define TURTLELIB_BATCH_SIM_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Many independent diff drive worlds stepped together, without ROS.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/noise.hpp"
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/worker_pool.hpp"
+
+namespace turtlelib {
+
+//! @brief Robot and noise shared by every world of a BatchSim, as in nusim.
+struct BatchSimParams {
+  //! @brief distance from the body center to a wheel, meters
+  double wheel_track_to_body = 0.08;
+  //! @brief wheel radius, meters
+  double wheel_radius = 0.033;
+  //! @brief duration of a step, seconds
+  double dt = 0.005;
+  //! @brief standard deviation of the wheel increment noise of a moving wheel, rad
+  double input_noise = 0.0;
+  //! @brief the encoders slip by up to this much each step, rad
+  double slip_fraction = 0.0;
+  //! @brief world i draws the noise of step k from CounterNoise(seed), stream i, step k
+  uint64_t seed = 0;
+};
+
+//! @brief Everything a BatchSim changes as it steps, one entry per world in
+//! each array. See BatchSim::State.
+struct BatchSimState {
+  //! @brief steps taken, which is where every world is in its noise stream
+  uint64_t steps = 0;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> theta;
+  std::vector<double> left;
+  std::vector<double> right;
+  std::vector<double> cmd_left;
+  std::vector<double> cmd_right;
+  std::vector<double> step_omega;
+  std::vector<double> step_vx;
+};
+
+//! @brief Thousands of diff drive worlds in a structure of arrays.
+//! Each world has its own pose, wheel config, command and noise stream, so the
+//! worlds never interact and a world's trajectory only depends on its seed and
+//! commands, not on the number of threads. A step computes the wheel
+//! increments and body twists of several worlds at once with SIMD lanes, and
+//! splits the worlds over a worker pool. The kinematics are those of
+//! DiffDrive::UpdateBodyConfigWithVel.
+class BatchSim {
+public:
+  //! @brief Create worlds at the origin, standing still.
+  //! @param worlds number of worlds
+  //! @param params robot and noise
+  //! @param pool pool to step on, nullptr steps inline. Must outlive the sim.
+  BatchSim(size_t worlds, BatchSimParams params = BatchSimParams{}, WorkerPool *pool = nullptr);
+
+  //! @brief number of worlds
+  size_t Size() const;
+
+  //! @brief Teleport a world.
+  void SetPose(size_t world, const Transform2D &pose);
+
+  //! @brief Wheel velocity command of a world, rad/s, held until changed.
+  void SetCommand(size_t world, WheelVelocity command);
+
+  //! @brief Advance every world by dt.
+  void Step();
+
+  //! @brief number of steps taken
+  uint64_t Steps() const;
+
+  //! @brief pose of a world
+  Transform2D Pose(size_t world) const;
+
+  //! @brief encoder reading of a world, with slip, rad
+  WheelConfig Wheels(size_t world) const;
+
+  //! @brief Body twist of a world's last step, integrated over dt. The step
+  //! moved the world from P to P * integrate_twist(StepTwist).
+  Twist2D StepTwist(size_t world) const;
+
+  //! @brief a DiffDrive in the current state of a world
+  DiffDrive ToDiffDrive(size_t world) const;
+
+  //! @brief Snapshot of every world. The noise of a step only depends on the
+  //! seed, the world and the step count, so a sim with the same params set to
+  //! this state does exactly what this one does from here on, given the same
+  //! commands. With another seed it goes on with other noise.
+  BatchSimState State() const;
+
+  //! @brief Go on from a snapshot. Throws std::invalid_argument when the
+  //! snapshot has another number of worlds.
+  void SetState(const BatchSimState &state);
+
+  //! @brief the robot and noise of every world
+  const BatchSimParams &Params() const;
+
+  const std::vector<double> &X() const;
+  const std::vector<double> &Y() const;
+  const std::vector<double> &Theta() const;
+
+private:
+  //! @brief Step worlds [begin, end).
+  void StepRange(size_t begin, size_t end);
+
+  BatchSimParams params_;
+  WorkerPool *pool_;
+  uint64_t steps_ = 0;
+
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> theta_;
+  std::vector<double> left_;
+  std::vector<double> right_;
+  std::vector<double> cmd_left_;
+  std::vector<double> cmd_right_;
+  std::vector<double> step_omega_;
+  std::vector<double> step_vx_;
+  CounterNoise noise_;
+};
+
+//! @brief Header of a batch log file. The header is followed by one frame per
+//! logged step: the step number as a uint64, then one BatchLogRecord per world.
+struct BatchLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t worlds;
+};
+
+//! @brief What a batch log keeps of a world at a step, in single precision.
+struct BatchLogRecord {
+  float x;
+  float y;
+  float theta;
+  float left;
+  float right;
+};
+
+//! @brief Magic bytes of a batch log file.
+constexpr char kBatchLogMagic[8] = {'T', 'L', 'B', 'A', 'T', 'C', 'H', '1'};
+//! @brief Version of the batch log layout.
+constexpr uint32_t kBatchLogVersion = 1;
+
+//! @brief Appends frames of every world of a BatchSim to a binary file.
+class BatchLogWriter {
+public:
+  //! @brief Create the file and write the header.
+  //! Throws std::runtime_error when the file cannot be written.
+  BatchLogWriter(const std::string &path, size_t worlds);
+
+  BatchLogWriter(const BatchLogWriter &) = delete;
+  BatchLogWriter &operator=(const BatchLogWriter &) = delete;
+
+  //! @brief Append the current state of every world as one frame.
+  //! The frame buffer is reused, so writing a frame does not allocate.
+  //! Throws std::runtime_error when the write fails.
+  void Write(const BatchSim &sim);
+
+private:
+  std::ofstream out_;
+  std::vector<BatchLogRecord> frame_;
+};
+
+//! @brief A batch log read back into memory.
+struct BatchLog {
+  uint64_t worlds = 0;
+  //! @brief step number of each frame
+  std::vector<uint64_t> steps;
+  //! @brief frame f, world w is records[f * worlds + w]
+  std::vector<BatchLogRecord> records;
+};
+
+//! @brief Read a file from BatchLogWriter, throws std::runtime_error on a bad file.
+BatchLog ReadBatchLog(const std::string &path);
+
+} // namespace turtlelib
+
+#endif
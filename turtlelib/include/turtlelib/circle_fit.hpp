@@ -0,0 +1,105 @@
+#ifndef TURTLELIB_CIRCLE_FIT_INCLUDE_GUARD_HPP
+#define TURTLELIB_CIRCLE_FIT_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Find cylindrical landmarks in a laser scan: cluster the scan, fit a
+/// circle to each cluster, keep the ones that look like cylinders.
+
+#include <cstddef>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+//! @brief A circle fitted to a set of points.
+struct CircleFit {
+  Point2D center;
+  double radius = 0.0;
+  //! @brief root mean square distance of the points from the circle
+  double rms_residual = 0.0;
+};
+
+//! @brief Algebraic circle fit (Taubin) of points stored as separate x and y arrays.
+//! The moment sums, the only part that touches every point, run as SIMD kernels.
+//! @param x x coordinates
+//! @param y y coordinates
+//! @param n number of points, at least 3
+//! @return the circle. Throws std::invalid_argument with less than 3 points,
+//! and std::domain_error when the points are on a line.
+CircleFit FitCircle(const double *x, const double *y, size_t n);
+
+//! @brief A run of neighbouring scan points, as indices into the point arrays.
+struct PointCluster {
+  size_t begin = 0;
+  size_t end = 0;
+};
+
+//! @brief Tuning of LandmarkDetector.
+struct LandmarkDetectorParams {
+  //! @brief neighbouring points further apart than this start a new cluster
+  double cluster_threshold = 0.05;
+  //! @brief clusters with fewer points are ignored
+  size_t min_cluster_points = 4;
+  //! @brief smallest radius accepted as a landmark
+  double min_radius = 0.01;
+  //! @brief largest radius accepted as a landmark
+  double max_radius = 0.1;
+  //! @brief largest rms distance of cluster points from the fitted circle
+  double max_rms_residual = 0.01;
+};
+
+//! @brief A cylinder found in a scan, in the scan frame.
+struct DetectedLandmark {
+  CircleFit circle;
+  double range = 0.0;
+  double bearing = 0.0;
+  size_t num_points = 0;
+};
+
+//! @brief Landmark detection on laser scans.
+//! Keeps its buffers and the sin/cos table between scans, so a stream of scans
+//! of the same shape does not allocate.
+class LandmarkDetector {
+public:
+  //! @brief Create the detector.
+  explicit LandmarkDetector(LandmarkDetectorParams params = LandmarkDetectorParams{});
+
+  //! @brief Find the landmarks in one scan.
+  //! Ranges outside [range_min, range_max) are treated as no return and break
+  //! clusters. A scan covering the full circle joins the clusters at its two ends.
+  //! @param ranges one range per beam
+  //! @param angle_min angle of the first beam
+  //! @param angle_increment angle between beams
+  //! @param range_min smallest valid range
+  //! @param range_max largest valid range
+  //! @return the landmarks, valid until the next call
+  const std::vector<DetectedLandmark> &Detect(const std::vector<float> &ranges, double angle_min,
+                                              double angle_increment, double range_min,
+                                              double range_max);
+
+  //! @brief clusters of the last scan, including rejected ones
+  const std::vector<PointCluster> &Clusters() const;
+
+  //! @brief x of the last scan's valid points, in cluster order
+  const std::vector<double> &PointsX() const;
+
+  //! @brief y of the last scan's valid points, in cluster order
+  const std::vector<double> &PointsY() const;
+
+private:
+  void UpdateAngleTable(size_t count, double angle_min, double angle_increment);
+
+  LandmarkDetectorParams params_;
+  std::vector<double> cos_table_;
+  std::vector<double> sin_table_;
+  double table_angle_min_ = 0.0;
+  double table_angle_increment_ = 0.0;
+  std::vector<double> points_x_;
+  std::vector<double> points_y_;
+  std::vector<PointCluster> clusters_;
+  std::vector<DetectedLandmark> landmarks_;
+};
+
+} // namespace turtlelib
+
+#endif
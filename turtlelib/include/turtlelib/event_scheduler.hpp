@@ -0,0 +1,93 @@
+#ifndef TURTLELIB_EVENT_SCHEDULER_INCLUDE_GUARD_HPP
+#define TURTLELIB_EVENT_SCHEDULER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Discrete-event scheduler for periodic streams in simulation time.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace turtlelib {
+
+//! @brief Timing of one periodic stream.
+struct EventStreamConfig {
+  //! @brief time between two samples, must be positive
+  std::chrono::nanoseconds period{0};
+  //! @brief offset of the samples from multiples of the period
+  std::chrono::nanoseconds phase{0};
+  //! @brief time from a sample to its delivery, must not be negative
+  std::chrono::nanoseconds latency{0};
+};
+
+//! @brief Runs periodic streams in order of their time, from one queue.
+//! A stream samples at phase + k * period. If it has a deliver callback, each
+//! sample is also delivered latency later. Events at the same time run in the
+//! order the streams were added, and a delivery before the sample of its own
+//! stream. So with physics added first, a sensor sampled at the time of a
+//! physics step sees the state after that step.
+//!
+//! The scheduler does not own a clock. The caller advances it with RunUntil,
+//! from a wall timer or as fast as it wants. The queue is sized when streams
+//! are added, so running events never allocates.
+class EventScheduler {
+public:
+  //! @brief callback of an event, given the sample time
+  using Callback = std::function<void(std::chrono::nanoseconds)>;
+
+  //! @brief Add a stream, its first sample is the first one not before Now().
+  //! Not to be called from a callback.
+  //! @param config timing of the stream
+  //! @param on_sample called at each sample time
+  //! @param on_deliver called latency after each sample, may be empty
+  //! @return index of the stream
+  //! @throws std::invalid_argument on a non positive period or negative latency
+  size_t AddStream(const EventStreamConfig &config, Callback on_sample,
+                   Callback on_deliver = nullptr);
+
+  //! @brief time of the earliest pending event, max() when there is none
+  std::chrono::nanoseconds NextEventTime() const;
+
+  //! @brief Run every event due at or before time, in order.
+  //! Events an event schedules are run as well if they are due.
+  //! @param time the new current time, never before Now()
+  //! @return number of events run
+  size_t RunUntil(std::chrono::nanoseconds time);
+
+  //! @brief time of the event being run, or the time of the last RunUntil
+  std::chrono::nanoseconds Now() const;
+
+  //! @brief number of pending events
+  size_t Pending() const;
+
+  //! @brief number of events the queue holds without allocating
+  size_t Capacity() const;
+
+private:
+  struct Stream {
+    EventStreamConfig config;
+    Callback on_sample;
+    Callback on_deliver;
+  };
+
+  struct Event {
+    std::chrono::nanoseconds time;
+    uint32_t stream;
+    //! 0 for a delivery, 1 for a sample, deliveries first at the same time
+    uint32_t kind;
+    std::chrono::nanoseconds sample_time;
+  };
+
+  //! @brief order of the min heap, true when a runs after b
+  static bool Later(const Event &a, const Event &b);
+  void Push(const Event &event);
+
+  std::vector<Stream> streams_;
+  std::vector<Event> queue_;
+  std::chrono::nanoseconds now_{0};
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef TURTLELIB_FLIGHT_RECORDER_INCLUDE_GUARD_HPP
+#define TURTLELIB_FLIGHT_RECORDER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Bounded, lock-free, memory mapped ring buffer of fixed size records.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace turtlelib {
+
+//! @brief The header at the start of a mapped ring, and of its dumps.
+//! File layout: header, then capacity slots. Each slot is a 64 bit sequence
+//! number followed by the record, padded to 8 bytes.
+struct FlightRecordHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t write_index; //!< total records ever pushed, atomic in a live ring
+};
+
+//! @brief Magic bytes of a flight record file.
+constexpr char kFlightRecordMagic[8] = {'T', 'L', 'F', 'L', 'T', 'R', 'E', 'C'};
+//! @brief Version of the file layout.
+constexpr uint32_t kFlightRecordVersion = 1;
+
+//! @brief Map memory for a ring.
+//! @param path file to back the mapping. An empty path gives an anonymous
+//! mapping that lives only in this process.
+//! @param bytes size of the mapping
+//! @return start of the zero filled mapping. Throws std::runtime_error on failure.
+void *MapFlightRecord(const std::string &path, size_t bytes);
+
+//! @brief Release memory from MapFlightRecord.
+void UnmapFlightRecord(void *memory, size_t bytes);
+
+//! @brief Write bytes to a file, throws std::runtime_error on failure.
+void WriteFlightRecordFile(const std::string &path, const std::vector<uint8_t> &bytes);
+
+//! @brief Read the raw bytes of a flight record file, live or dumped.
+//! @param path file to read
+//! @param record_size expected record size, checked against the header
+//! @return the raw records that were completely written, oldest first
+std::vector<std::vector<uint8_t>> ReadFlightRecordRaw(const std::string &path,
+                                                      size_t record_size);
+
+//! @brief Always-on recorder keeping the last N records of a trivially copyable type.
+//! Writers never allocate: a push is one atomic increment, a claim of the
+//! slot, a copy of the record, and an atomic store. Any number of threads can
+//! push at once. Each slot carries a sequence number (seqlock), so a reader
+//! copying the ring can tell a finished record from one being overwritten.
+//! Only a writer a whole lap ahead of another one in the same slot waits, for
+//! that one's copy to finish.
+//! When backed by a file, the ring is in the page cache all the time and
+//! survives a crash of the process.
+template <typename Record> class FlightRecorder {
+  static_assert(std::is_trivially_copyable_v<Record>, "Records are copied as raw bytes");
+
+public:
+  //! @brief Create the ring.
+  //! @param path backing file, truncated on open. Empty for anonymous memory.
+  //! @param capacity number of records kept
+  FlightRecorder(const std::string &path, size_t capacity)
+      : capacity_(std::max<size_t>(1, capacity)),
+        bytes_(sizeof(FlightRecordHeader) + capacity_ * kSlotSize),
+        memory_(static_cast<uint8_t *>(MapFlightRecord(path, bytes_))) {
+    auto *header = reinterpret_cast<FlightRecordHeader *>(memory_);
+    std::memcpy(header->magic, kFlightRecordMagic, sizeof(kFlightRecordMagic));
+    header->version = kFlightRecordVersion;
+    header->record_size = sizeof(Record);
+    header->capacity = capacity_;
+    write_index_ = new (&header->write_index) std::atomic<uint64_t>(0);
+  }
+
+  ~FlightRecorder() { UnmapFlightRecord(memory_, bytes_); }
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  //! @brief Record one entry, overwriting the oldest one when full.
+  //! @param record the entry
+  void Push(const Record &record) {
+    const uint64_t index = write_index_->fetch_add(1, std::memory_order_relaxed);
+    uint8_t *slot = SlotAt(index % capacity_);
+    auto *sequence = Sequence(slot);
+    // Odd while writing, even (and never 0) once done. Two writers a lap apart
+    // must not copy into the slot at once, or a reader could take their mixed
+    // bytes for the newer record. So the slot is claimed from an even sequence
+    // of an older lap only.
+    const uint64_t writing = 2 * index + 1;
+    uint64_t current = sequence->load(std::memory_order_relaxed);
+    for (;;) {
+      if (current > writing) {
+        // A later lap has the slot already, this record is overwritten anyway.
+        return;
+      }
+      if (current % 2 == 1) {
+        std::this_thread::yield();
+        current = sequence->load(std::memory_order_relaxed);
+      } else if (sequence->compare_exchange_weak(current, writing, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot + kSequenceSize, &record, sizeof(Record));
+    sequence->store(2 * index + 2, std::memory_order_release);
+  }
+
+  //! @brief total number of records ever pushed
+  uint64_t Count() const { return write_index_->load(std::memory_order_relaxed); }
+
+  //! @brief number of records kept
+  size_t Capacity() const { return capacity_; }
+
+  //! @brief Copy out every complete record, oldest first.
+  //! Records being written during the copy are skipped. Safe to call while
+  //! other threads push.
+  std::vector<Record> Snapshot() const {
+    std::vector<std::pair<uint64_t, Record>> found;
+    found.reserve(capacity_);
+    for (size_t i = 0; i < capacity_; ++i) {
+      const uint8_t *slot = SlotAt(i);
+      const uint64_t before = Sequence(slot)->load(std::memory_order_acquire);
+      if (before == 0 || before % 2 == 1) {
+        continue;
+      }
+      Record record;
+      std::memcpy(&record, slot + kSequenceSize, sizeof(Record));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (Sequence(slot)->load(std::memory_order_relaxed) == before) {
+        found.emplace_back(before, record);
+      }
+    }
+    std::sort(found.begin(), found.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::vector<Record> out;
+    out.reserve(found.size());
+    for (const auto &entry : found) {
+      out.push_back(entry.second);
+    }
+    return out;
+  }
+
+  //! @brief Write a consistent copy of the ring to a file.
+  //! The dump has the same layout as a live ring, so one reader handles both.
+  //! @param path output file
+  //! @return number of records written
+  size_t Dump(const std::string &path) const {
+    const auto records = Snapshot();
+    std::vector<uint8_t> out(sizeof(FlightRecordHeader) + records.size() * kSlotSize, 0);
+    FlightRecordHeader header{};
+    std::memcpy(header.magic, kFlightRecordMagic, sizeof(kFlightRecordMagic));
+    header.version = kFlightRecordVersion;
+    header.record_size = sizeof(Record);
+    header.capacity = records.size();
+    header.write_index = records.size();
+    std::memcpy(out.data(), &header, sizeof(header));
+    for (size_t i = 0; i < records.size(); ++i) {
+      uint8_t *slot = out.data() + sizeof(FlightRecordHeader) + i * kSlotSize;
+      const uint64_t sequence = 2 * i + 2;
+      std::memcpy(slot, &sequence, sizeof(sequence));
+      std::memcpy(slot + kSequenceSize, &records.at(i), sizeof(Record));
+    }
+    WriteFlightRecordFile(path, out);
+    return records.size();
+  }
+
+private:
+  static constexpr size_t kSequenceSize = sizeof(uint64_t);
+  static constexpr size_t kSlotSize = kSequenceSize + (sizeof(Record) + 7) / 8 * 8;
+
+  uint8_t *SlotAt(size_t i) const { return memory_ + sizeof(FlightRecordHeader) + i * kSlotSize; }
+  static std::atomic<uint64_t> *Sequence(const uint8_t *slot) {
+    return reinterpret_cast<std::atomic<uint64_t> *>(const_cast<uint8_t *>(slot));
+  }
+
+  size_t capacity_;
+  size_t bytes_;
+  uint8_t *memory_;
+  std::atomic<uint64_t> *write_index_;
+};
+
+//! @brief Read a flight record file written by FlightRecorder, live or dumped.
+//! @param path file to read
+//! @return the complete records, oldest first
+template <typename Record> std::vector<Record> ReadFlightRecord(const std::string &path) {
+  std::vector<Record> out;
+  for (const auto &raw : ReadFlightRecordRaw(path, sizeof(Record))) {
+    Record record;
+    std::memcpy(&record, raw.data(), sizeof(Record));
+    out.push_back(record);
+  }
+  return out;
+}
+
+} // namespace turtlelib
+
+#endif
@@ -191,6 +191,27 @@ double dot(const Vector2D &v1, const Vector2D &v2);
 //! (signed, within -PI PI)
 double angle(const Vector2D &v1, const Vector2D &v2);
 
+//! @brief A line segment from a to b, such as a wall.
+struct Segment2D {
+  Point2D a;
+  Point2D b;
+};
+
+//! @brief Distance along a ray to a circle.
+//! @param origin start of the ray
+//! @param direction unit direction of the ray
+//! @param center center of the circle
+//! @param radius radius of the circle
+//! @return distance to the near side, infinity on a miss or from inside the circle
+double RayCircleDistance(Point2D origin, Vector2D direction, Point2D center, double radius);
+
+//! @brief Distance along a ray to a segment.
+//! @param origin start of the ray
+//! @param direction unit direction of the ray
+//! @param segment the segment
+//! @return distance to the hit, infinity on a miss or when parallel to the segment
+double RaySegmentDistance(Point2D origin, Vector2D direction, const Segment2D &segment);
+
 constexpr bool almost_equal(const Vector2D &v1, const Vector2D &v2,
                             double epsilon = 1.0e-12) {
   if (!almost_equal(v1.x, v2.x, epsilon)) {
@@ -0,0 +1,124 @@
+#ifndef TURTLELIB_GRID_WALK_INCLUDE_GUARD_HPP
+#define TURTLELIB_GRID_WALK_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Cell by cell walk of a ray through a bounded grid of square cells.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Bounds and cell size of a grid whose cell (0, 0) has its lower left
+//! corner at min.
+struct GridFrame {
+  Point2D min;
+  double cell_size = 1.0;
+  size_t cells_x = 1;
+  size_t cells_y = 1;
+
+  //! @brief column holding x, clamped to the grid
+  size_t CellX(double x) const {
+    const double cell = std::floor((x - min.x) / cell_size);
+    return static_cast<size_t>(std::clamp(cell, 0.0, static_cast<double>(cells_x - 1)));
+  }
+
+  //! @brief row holding y, clamped to the grid
+  size_t CellY(double y) const {
+    const double cell = std::floor((y - min.y) / cell_size);
+    return static_cast<size_t>(std::clamp(cell, 0.0, static_cast<double>(cells_y - 1)));
+  }
+
+  //! @brief Clip a ray to the grid bounds, one slab per axis.
+  //! @param origin start of the ray
+  //! @param direction direction of the ray
+  //! @param t_enter in: start of the ray part of interest, out: where it enters the grid
+  //! @param t_leave in: end of the ray part of interest, out: where it leaves the grid
+  //! @return false if that part of the ray misses the grid
+  bool Clip(Point2D origin, Vector2D direction, double &t_enter, double &t_leave) const {
+    const double origins[2] = {origin.x, origin.y};
+    const double directions[2] = {direction.x, direction.y};
+    const double mins[2] = {min.x, min.y};
+    const double maxs[2] = {min.x + cell_size * static_cast<double>(cells_x),
+                            min.y + cell_size * static_cast<double>(cells_y)};
+    for (int axis = 0; axis < 2; ++axis) {
+      if (directions[axis] == 0.0) {
+        if (origins[axis] < mins[axis] || origins[axis] > maxs[axis]) {
+          return false;
+        }
+        continue;
+      }
+      double t0 = (mins[axis] - origins[axis]) / directions[axis];
+      double t1 = (maxs[axis] - origins[axis]) / directions[axis];
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+      t_enter = std::max(t_enter, t0);
+      t_leave = std::min(t_leave, t1);
+    }
+    return t_enter <= t_leave;
+  }
+};
+
+//! @brief Visit the cells a ray crosses, in order (Amanatides-Woo DDA).
+//! @param frame the grid
+//! @param start start of the ray, inside the grid bounds
+//! @param direction direction of the ray
+//! @param t_end the walk stops past this distance from start
+//! @param visit called as visit(x, y, t_exit) for each cell, where t_exit is
+//! the distance from start at which the ray leaves the cell. Returning true
+//! stops the walk.
+template <typename Visit>
+void GridWalk(const GridFrame &frame, Point2D start, Vector2D direction, double t_end,
+              Visit visit) {
+  constexpr double kInf = std::numeric_limits<double>::infinity();
+  // ############# Begin Citation [10]#############
+  size_t x = frame.CellX(start.x);
+  size_t y = frame.CellY(start.y);
+  const int step_x = direction.x > 0.0 ? 1 : (direction.x < 0.0 ? -1 : 0);
+  const int step_y = direction.y > 0.0 ? 1 : (direction.y < 0.0 ? -1 : 0);
+  // Distance to the next vertical and horizontal cell border, and between two of them.
+  double t_max_x = kInf;
+  double t_max_y = kInf;
+  double t_delta_x = kInf;
+  double t_delta_y = kInf;
+  if (step_x != 0) {
+    const double border =
+        frame.min.x + static_cast<double>(x + (step_x > 0 ? 1 : 0)) * frame.cell_size;
+    t_max_x = (border - start.x) / direction.x;
+    t_delta_x = frame.cell_size / std::abs(direction.x);
+  }
+  if (step_y != 0) {
+    const double border =
+        frame.min.y + static_cast<double>(y + (step_y > 0 ? 1 : 0)) * frame.cell_size;
+    t_max_y = (border - start.y) / direction.y;
+    t_delta_y = frame.cell_size / std::abs(direction.y);
+  }
+  while (true) {
+    const double t_exit = std::min(t_max_x, t_max_y);
+    if (visit(x, y, t_exit) || t_exit >= t_end) {
+      return;
+    }
+    if (t_max_x < t_max_y) {
+      if ((step_x < 0 && x == 0) || (step_x > 0 && x + 1 == frame.cells_x)) {
+        return;
+      }
+      x += step_x;
+      t_max_x += t_delta_x;
+    } else {
+      if ((step_y < 0 && y == 0) || (step_y > 0 && y + 1 == frame.cells_y)) {
+        return;
+      }
+      y += step_y;
+      t_max_y += t_delta_y;
+    }
+  }
+  // ############# End Citation [10]#############
+}
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef TURTLELIB_ICP_INCLUDE_GUARD_HPP
+#define TURTLELIB_ICP_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Point to line ICP scan matching.
+
+#include <cstddef>
+#include <vector>
+
+#include "turtlelib/kd_tree.hpp"
+#include "turtlelib/se2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Turn a laser scan into points in the scan frame, in beam order.
+//! Ranges outside [range_min, range_max) are dropped.
+//! @param ranges one range per beam
+//! @param angle_min angle of the first beam
+//! @param angle_increment angle between beams
+//! @param range_min smallest valid range
+//! @param range_max largest valid range
+//! @param x output x, cleared first
+//! @param y output y, cleared first
+void ScanToPoints(const std::vector<float> &ranges, double angle_min, double angle_increment,
+                  double range_min, double range_max, std::vector<double> &x,
+                  std::vector<double> &y);
+
+//! @brief Tuning of ScanMatcher.
+struct IcpParams {
+  //! @brief upper bound on Gauss-Newton iterations
+  size_t max_iterations = 30;
+  //! @brief pairs further apart than this are not used
+  double max_correspondence_distance = 0.3;
+  //! @brief neighbours further apart than this don't define a line
+  double max_neighbour_distance = 0.15;
+  //! @brief stop once a step moves less than this, meters
+  double translation_tolerance = 1e-4;
+  //! @brief stop once a step turns less than this, radians
+  double rotation_tolerance = 1e-4;
+  //! @brief fewer pairs than this means no match
+  size_t min_correspondences = 20;
+};
+
+//! @brief Outcome of a scan match.
+struct IcpResult {
+  //! @brief pose of the matched scan in the reference scan frame
+  Transform2D T_ref_scan;
+  size_t iterations = 0;
+  //! @brief number of point to line pairs in the last iteration
+  size_t correspondences = 0;
+  //! @brief rms point to line distance in the last iteration
+  double rms_error = 0.0;
+  //! @brief the steps got below the tolerances before max_iterations
+  bool converged = false;
+  //! @brief enough pairs were found for a solution
+  bool valid = false;
+};
+
+//! @brief Point to line ICP against a reference scan.
+//! The reference is indexed in a k-d tree once, and every reference point gets
+//! the line through its neighbours in beam order. Matching a scan then pairs
+//! each scan point with the nearest reference point and solves for the pose
+//! that moves the scan points onto those lines.
+class ScanMatcher {
+public:
+  //! @brief Create a matcher without a reference.
+  explicit ScanMatcher(IcpParams params = IcpParams{});
+
+  //! @brief Set the scan to match against.
+  //! @param x x of the reference points, in beam order
+  //! @param y y of the reference points, in beam order
+  void SetReference(const std::vector<double> &x, const std::vector<double> &y);
+
+  //! @brief whether SetReference was called with any points
+  bool HasReference() const;
+
+  //! @brief Find the pose of a scan in the reference frame.
+  //! @param x x of the scan points
+  //! @param y y of the scan points
+  //! @param initial_guess starting pose of the scan in the reference frame
+  //! @return the match, valid is false if too few pairs were found
+  IcpResult Match(const std::vector<double> &x, const std::vector<double> &y,
+                  const Transform2D &initial_guess) const;
+
+private:
+  IcpParams params_;
+  KdTree2D tree_;
+  std::vector<double> ref_x_;
+  std::vector<double> ref_y_;
+  // Unit normal of the line at each reference point, zero when there is none.
+  std::vector<double> normal_x_;
+  std::vector<double> normal_y_;
+};
+
+} // namespace turtlelib
+
+#endif
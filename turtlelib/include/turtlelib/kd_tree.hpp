@@ -0,0 +1,51 @@
+#ifndef TURTLELIB_KD_TREE_INCLUDE_GUARD_HPP
+#define TURTLELIB_KD_TREE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Static 2D k-d tree for nearest neighbour queries.
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Balanced 2D k-d tree, built once, queried many times.
+//! The tree is implicit: nodes are laid out in one array with the median of
+//! every range in its middle, so there are no node allocations or pointers.
+class KdTree2D {
+public:
+  //! @brief returned by Nearest when nothing is in range
+  static constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+  //! @brief Build the tree, replacing the old one. Keeps the memory of the
+  //! previous build.
+  //! @param x x coordinates of the points
+  //! @param y y coordinates of the points, same size as x
+  void Build(const std::vector<double> &x, const std::vector<double> &y);
+
+  //! @brief Find the point closest to query.
+  //! @param query the query point
+  //! @param max_distance points further than this are ignored
+  //! @return index of the point in the arrays given to Build, or kNone
+  size_t Nearest(Point2D query,
+                 double max_distance = std::numeric_limits<double>::infinity()) const;
+
+  //! @brief number of points in the tree
+  size_t Size() const;
+
+private:
+  void BuildRange(size_t begin, size_t end, size_t depth);
+  void Search(size_t begin, size_t end, size_t depth, Point2D query, size_t &best,
+              double &best_sq) const;
+
+  // Points in tree order, and their index in the original arrays.
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<size_t> index_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef TURTLELIB_LASER_SIM_INCLUDE_GUARD_HPP
+#define TURTLELIB_LASER_SIM_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Simulated laser scanner casting beams against circles and segments.
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Laser scanner casting every beam of a scan at once.
+//! The beam directions in the body frame are computed once, when the scanner
+//! is made. A scan rotates them by the heading and intersects kLanes beams at
+//! a time with each circle and each segment in SIMD lanes, keeping the nearest
+//! hit of every beam.
+class LaserSim {
+public:
+  //! @brief Make the scanner.
+  //! @param angle_min body frame angle of the first beam
+  //! @param angle_increment angle between two beams
+  //! @param beams number of beams
+  //! @param range_max hits further than this are misses
+  LaserSim(double angle_min, double angle_increment, size_t beams, double range_max);
+
+  //! @brief number of beams of a scan
+  size_t Beams() const;
+
+  //! @brief Cast every beam from a pose.
+  //! @param pose pose of the scanner in the world
+  //! @param circle_x x of each circle center
+  //! @param circle_y y of each circle center
+  //! @param circle_r radius of each circle
+  //! @param segments the segments
+  //! @param ranges distance to the nearest hit of each beam. Sized to Beams(),
+  //! so a reused vector is not reallocated.
+  //! @param miss written for a beam without a hit within range_max. Beams
+  //! starting inside a circle don't see that circle.
+  void Cast(const Transform2D &pose, const std::vector<double> &circle_x,
+            const std::vector<double> &circle_y, const std::vector<double> &circle_r,
+            const std::vector<Segment2D> &segments, std::vector<float> &ranges, float miss);
+
+  //! @brief Cast every beam from a pose through some worlds, one beam at a time.
+  //! A world is anything with a const
+  //! double Raycast(Point2D origin, Vector2D direction, double range_max)
+  //! returning the nearest hit or infinity, such as UniformGrid, SegmentBvh or
+  //! OccupancyMap. Each beam keeps its nearest hit over all of them.
+  //! @param pose pose of the scanner in the world
+  //! @param ranges as the other Cast
+  //! @param miss as the other Cast
+  //! @param worlds the worlds
+  template <typename... Worlds>
+  void Cast(const Transform2D &pose, std::vector<float> &ranges, float miss,
+            const Worlds &...worlds) {
+    const Point2D origin = pose.translation().ToPoint();
+    Rotate(pose.rotation());
+    ranges.resize(beams_);
+    for (size_t i = 0; i < beams_; ++i) {
+      const Vector2D direction{dir_x_[i], dir_y_[i]};
+      double hit = std::numeric_limits<double>::infinity();
+      ((hit = std::min(hit, worlds.Raycast(origin, direction, range_max_))), ...);
+      ranges[i] = hit <= range_max_ ? static_cast<float>(hit) : miss;
+    }
+  }
+
+private:
+  //! @brief Turn the body frame directions into world frame ones in dir_x_, dir_y_.
+  void Rotate(double heading);
+
+  double range_max_;
+  size_t beams_;
+  // Body frame unit directions, padded to a multiple of the SIMD lanes.
+  std::vector<double> body_x_;
+  std::vector<double> body_y_;
+  // Scratch of a scan: world frame directions and the nearest hit so far.
+  std::vector<double> dir_x_;
+  std::vector<double> dir_y_;
+  std::vector<double> nearest_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TURTLELIB_LIKELIHOOD_FIELD_INCLUDE_GUARD_HPP
+#define TURTLELIB_LIKELIHOOD_FIELD_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Distance transform and laser likelihood field of an occupancy map.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Exact squared Euclidean distance transform of a binary grid.
+//! Linear time in the number of cells.
+//! @param occupied one value per cell, row major, non zero is occupied
+//! @param width cells per row
+//! @param height number of rows
+//! @return squared distance in cells from each cell to the nearest occupied
+//! cell. Without any occupied cell every distance is infinite.
+std::vector<double> SquaredDistanceTransform(const std::vector<uint8_t> &occupied, size_t width,
+                                             size_t height);
+
+//! @brief Beam model of the likelihood field.
+struct LikelihoodFieldParams {
+  //! @brief standard deviation of a hit around the nearest obstacle, meters
+  double sigma_hit = 0.05;
+  //! @brief weight of the hit component
+  double z_hit = 0.9;
+  //! @brief weight of the uniform random component
+  double z_rand = 0.1;
+  //! @brief max range of the laser, scales the random component
+  double max_range = 3.5;
+};
+
+//! @brief Log-likelihood of a beam end point for every cell of a map.
+//! The distance transform is computed once when the field is built, so
+//! scoring a beam afterwards is one lookup. Beams ending outside the map only
+//! get the random component.
+class LikelihoodField {
+public:
+  //! @brief Build the field.
+  //! @param occupied one value per cell, row major, non zero is occupied
+  //! @param width cells per row
+  //! @param height number of rows
+  //! @param resolution cell side length, meters
+  //! @param origin map frame position of the corner of cell (0, 0)
+  //! @param params the beam model
+  LikelihoodField(const std::vector<uint8_t> &occupied, size_t width, size_t height,
+                  double resolution, Point2D origin,
+                  LikelihoodFieldParams params = LikelihoodFieldParams{});
+
+  //! @brief log-likelihood of a beam ending at (x, y) in the map frame
+  float LogLikelihood(double x, double y) const {
+    const double fx = (x - origin_.x) * inv_resolution_;
+    const double fy = (y - origin_.y) * inv_resolution_;
+    if (!(fx >= 0.0 && fy >= 0.0 && fx < width_ && fy < height_)) {
+      return outside_;
+    }
+    return log_likelihood_[static_cast<size_t>(fy) * width_ + static_cast<size_t>(fx)];
+  }
+
+  //! @brief distance from p to the nearest occupied cell, meters. Infinite
+  //! outside the map.
+  double Distance(Point2D p) const;
+
+  size_t Width() const;
+  size_t Height() const;
+  double Resolution() const;
+  Point2D Origin() const;
+
+private:
+  size_t width_;
+  size_t height_;
+  double inv_resolution_;
+  Point2D origin_;
+  float outside_;
+  std::vector<float> distance_;
+  std::vector<float> log_likelihood_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef TURTLELIB_LOAD_SHEDDER_INCLUDE_GUARD_HPP
+#define TURTLELIB_LOAD_SHEDDER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Deadline tracking of a periodic tick, with a level of work to shed.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace turtlelib {
+
+//! @brief When a LoadShedder sheds and restores work.
+struct LoadShedParams {
+  //! @brief time a tick may take, must be positive
+  std::chrono::nanoseconds budget{5'000'000};
+  //! @brief highest level, 0 never sheds
+  size_t max_level = 3;
+  //! @brief smoothed load above which one more level is shed. The load is
+  //! the time of a tick over the budget.
+  double shed_load = 0.9;
+  //! @brief smoothed load below which one level is restored, under shed_load
+  double restore_load = 0.4;
+  //! @brief weight of the newest tick in the smoothed load, in (0, 1]
+  double smoothing = 0.1;
+  //! @brief ticks in a row over shed_load before the next level is shed
+  size_t shed_hold = 20;
+  //! @brief ticks in a row under restore_load before a level is restored
+  size_t restore_hold = 400;
+};
+
+//! @brief Tracks how long each tick of a periodic loop takes against its
+//! budget, and picks how much optional work the loop should drop.
+//! Level 0 does everything, each level above sheds more, it is up to the
+//! caller what. The level moves one step at a time, only after the smoothed
+//! load stayed past a threshold for a number of ticks, and restoring takes a
+//! much lower load than shedding. A load between the two holds the level, so
+//! it does not flap between two neighbours. Shedding reacts in shed_hold
+//! ticks, restoring is slower on purpose.
+class LoadShedder {
+public:
+  //! @brief Start at level 0.
+  //! @throws std::invalid_argument on a budget that isn't positive, smoothing
+  //! outside (0, 1], or restore_load not under shed_load
+  explicit LoadShedder(const LoadShedParams &params = LoadShedParams{});
+
+  //! @brief Account one tick and move the level if the load calls for it.
+  //! @param tick time the tick took
+  //! @return the level for the next tick
+  size_t Record(std::chrono::nanoseconds tick);
+
+  //! @brief level to run the next tick at, 0 to max_level
+  size_t Level() const;
+
+  //! @brief smoothed tick time over the budget
+  double Load() const;
+
+  //! @brief number of ticks recorded
+  uint64_t Ticks() const;
+
+  //! @brief number of ticks that took longer than the budget
+  uint64_t Overruns() const;
+
+  //! @brief longest tick recorded
+  std::chrono::nanoseconds WorstTick() const;
+
+  //! @brief the parameters
+  const LoadShedParams &Params() const;
+
+private:
+  LoadShedParams params_;
+  size_t level_ = 0;
+  size_t over_ = 0;
+  size_t under_ = 0;
+  double load_ = 0.0;
+  uint64_t ticks_ = 0;
+  uint64_t overruns_ = 0;
+  std::chrono::nanoseconds worst_{0};
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef TURTLELIB_MCL_INCLUDE_GUARD_HPP
+#define TURTLELIB_MCL_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Monte Carlo localization against a likelihood field.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/likelihood_field.hpp"
+#include "turtlelib/se2d.hpp"
+#include "turtlelib/worker_pool.hpp"
+
+namespace turtlelib {
+
+//! @brief Tuning of ParticleFilter.
+struct MclParams {
+  //! @brief fewest particles kept after resampling
+  size_t min_particles = 100;
+  //! @brief most particles kept after resampling, and the initial count
+  size_t max_particles = 5000;
+  //! @brief KLD bound on the error of the sampled distribution
+  double kld_error = 0.05;
+  //! @brief upper standard normal quantile of the KLD bound (0.99)
+  double kld_z = 2.326;
+  //! @brief histogram bin size of the KLD bound in x and y, meters
+  double bin_size_xy = 0.1;
+  //! @brief histogram bin size of the KLD bound in heading, radians
+  double bin_size_theta = 0.175;
+  //! @brief rotation noise from rotation, odometry motion model
+  double alpha_rot_rot = 0.1;
+  //! @brief rotation noise from translation
+  double alpha_rot_trans = 0.05;
+  //! @brief translation noise from translation
+  double alpha_trans_trans = 0.1;
+  //! @brief translation noise from rotation
+  double alpha_trans_rot = 0.05;
+  //! @brief use every beam_skip-th beam of a scan
+  size_t beam_skip = 4;
+  //! @brief seed of the random generator
+  uint64_t seed = 0;
+};
+
+//! @brief Particle filter localizing a laser scanner in a known map.
+//! Particles are kept as a structure of arrays. A measurement update moves
+//! the beam end points of several particles at once with SIMD lanes, then
+//! scores each end point with one likelihood field lookup, with particles
+//! split over a worker pool. Resampling uses KLD sampling, so the particle
+//! count drops towards min_particles once the filter has converged.
+class ParticleFilter {
+public:
+  //! @brief Create a filter without particles.
+  //! @param field the map, shared with the caller
+  //! @param params tuning
+  //! @param pool pool for the measurement update, nullptr runs it inline.
+  //! Must outlive the filter.
+  //! @throws std::invalid_argument without a field, unless 0 < min_particles
+  //! <= max_particles, or on a kld_error or bin size that isn't positive, or
+  //! a kld_z that isn't finite
+  ParticleFilter(std::shared_ptr<const LikelihoodField> field, MclParams params = MclParams{},
+                 WorkerPool *pool = nullptr);
+
+  //! @brief Spread max_particles particles with normal noise around a pose.
+  void Initialize(const Transform2D &pose, double sigma_xy, double sigma_theta);
+
+  //! @brief Spread max_particles particles uniformly over a box, any heading.
+  void InitializeUniform(Point2D min, Point2D max);
+
+  //! @brief Move every particle by an odometry motion, with noise.
+  //! @param T_old_new motion of the robot in its old body frame
+  void Predict(const Transform2D &T_old_new);
+
+  //! @brief Weight the particles by a laser scan in the body frame.
+  //! Ranges outside [range_min, range_max) are skipped.
+  void Update(const std::vector<float> &ranges, double angle_min, double angle_increment,
+              double range_min, double range_max);
+
+  //! @brief Draw a new set from the weights, sized by the KLD bound.
+  void Resample();
+
+  //! @brief weighted mean pose of the particles
+  Transform2D Estimate() const;
+
+  //! @brief 1 / sum of squared normalized weights
+  double EffectiveSampleSize() const;
+
+  //! @brief number of particles
+  size_t Size() const;
+
+  const std::vector<double> &X() const;
+  const std::vector<double> &Y() const;
+  const std::vector<double> &Theta() const;
+  //! @brief normalized weights
+  const std::vector<double> &Weights() const;
+
+private:
+  //! @brief Score particles [begin, end) into log_weight_.
+  void Score(size_t begin, size_t end);
+  //! @brief number of samples the KLD bound asks for with k occupied bins
+  size_t KldBound(size_t k) const;
+
+  std::shared_ptr<const LikelihoodField> field_;
+  MclParams params_;
+  WorkerPool *pool_;
+  std::mt19937_64 gen_;
+
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> theta_;
+  std::vector<double> weight_;
+
+  // Scratch, kept to avoid allocation per scan.
+  std::vector<double> cos_;
+  std::vector<double> sin_;
+  std::vector<double> log_weight_;
+  std::vector<double> beam_x_;
+  std::vector<double> beam_y_;
+  std::vector<double> cdf_;
+  std::vector<double> next_x_;
+  std::vector<double> next_y_;
+  std::vector<double> next_theta_;
+  std::unordered_set<uint64_t> bins_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TURTLELIB_NOISE_INCLUDE_GUARD_HPP
+#define TURTLELIB_NOISE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Counter based random numbers, reproducible across threads and runs.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace turtlelib {
+
+//! @brief 128 bit counter of Philox4x32.
+using PhiloxCounter = std::array<uint32_t, 4>;
+//! @brief 64 bit key of Philox4x32.
+using PhiloxKey = std::array<uint32_t, 2>;
+
+//! @brief The Philox4x32-10 block function of Random123. Each (counter, key)
+//! maps to 128 random bits, with no state in between, so any number of
+//! threads can draw from it in any order and get the same numbers.
+//! @param counter the counter
+//! @param key the key
+//! @return the random bits of that counter under that key
+PhiloxCounter Philox4x32(PhiloxCounter counter, PhiloxKey key);
+
+//! @brief Noise as a pure function of a seed, a stream and a step.
+//! Counter word 0 is the block within a draw, word 1 the stream, words 2 and 3
+//! the step. A stream is one consumer of noise, such as one robot or one
+//! sensor, and the step is whatever it counts, such as sim steps or samples.
+//! Uniforms and Gaussians of the same stream and step don't share blocks.
+class CounterNoise {
+public:
+  //! @brief Noise keyed by a seed.
+  explicit CounterNoise(uint64_t seed = 0);
+
+  //! @brief Uniforms in [0, 1), with 53 random bits each.
+  //! @param stream the consumer
+  //! @param step the step of that consumer
+  //! @param out where the numbers go, n of them
+  //! @param n how many
+  void Uniforms(uint32_t stream, uint64_t step, double *out, size_t n) const;
+
+  //! @brief Standard normals, by Box-Muller on pairs of uniforms.
+  //! @param stream the consumer
+  //! @param step the step of that consumer
+  //! @param out where the numbers go, n of them
+  //! @param n how many
+  void Gaussians(uint32_t stream, uint64_t step, double *out, size_t n) const;
+
+  //! @brief the seed
+  uint64_t Seed() const;
+
+private:
+  //! @brief Counter of the first block of a draw of n numbers, two per block.
+  static PhiloxCounter FirstCounter(uint32_t stream, uint64_t step, uint32_t first_block,
+                                    size_t n);
+
+  PhiloxKey key_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef TURTLELIB_OCCUPANCY_GRID_INCLUDE_GUARD_HPP
+#define TURTLELIB_OCCUPANCY_GRID_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Tiled log-odds occupancy grid built from laser scans.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Integer index of a cell or of a tile.
+struct GridIndex {
+  int32_t x = 0;
+  int32_t y = 0;
+};
+
+//! @brief Sensor model and size of an occupancy grid.
+struct OccupancyGridParams {
+  //! @brief cell side length, meters
+  double resolution = 0.05;
+  //! @brief log-odds added to the cell a beam ends in
+  double log_odds_hit = 0.85;
+  //! @brief log-odds added to each cell a beam passes through
+  double log_odds_miss = -0.4;
+  //! @brief log-odds cells saturate at, in both directions
+  double log_odds_limit = 3.5;
+};
+
+//! @brief Unbounded occupancy grid of saturating integer log-odds.
+//! Space is split into square tiles of kTileSize cells, allocated the first
+//! time a beam touches them, so unexplored space costs nothing and every tile
+//! is one contiguous block. Log-odds are quantized so log_odds_limit maps to
+//! the largest Cell, which keeps an int8_t grid at a quarter of the memory of
+//! float cells. The smallest Cell marks a cell no beam has reached.
+//! Every tile changed since the last TakeDirtyTiles is tracked, so callers can
+//! send only those.
+//! @tparam Cell int8_t or int16_t
+template <typename Cell> class TiledLogOddsGrid {
+public:
+  //! @brief log2 of the tile side length
+  static constexpr int kTileBits = 5;
+  //! @brief tile side length in cells
+  static constexpr int32_t kTileSize = 1 << kTileBits;
+  //! @brief cells in a tile
+  static constexpr size_t kTileCells = static_cast<size_t>(kTileSize) * kTileSize;
+  //! @brief value of a cell that was never observed
+  static constexpr Cell kUnknown = std::numeric_limits<Cell>::min();
+
+  //! @brief Create an empty grid. Throws std::invalid_argument on a
+  //! non-positive resolution or limit.
+  explicit TiledLogOddsGrid(OccupancyGridParams params = OccupancyGridParams{});
+
+  //! @brief Ray trace one scan into the grid.
+  //! @param T_map_scan pose of the scan frame in the map
+  //! @param ranges one range per beam
+  //! @param angle_min angle of the first beam
+  //! @param angle_increment angle between beams
+  //! @param range_min shorter ranges are ignored
+  //! @param range_max ranges at or beyond this are misses, they clear the
+  //! cells up to range_max but mark nothing occupied
+  void InsertScan(const Transform2D &T_map_scan, const std::vector<float> &ranges,
+                  double angle_min, double angle_increment, double range_min, double range_max);
+
+  //! @brief Clear the cells from start to end, then mark the end cell if hit.
+  void InsertRay(Point2D start, Point2D end, bool hit);
+
+  //! @brief cell containing a point in the map frame
+  GridIndex CellOf(Point2D p) const;
+
+  //! @brief quantized log-odds of a cell, kUnknown if never observed
+  Cell Value(GridIndex cell) const;
+
+  //! @brief occupancy probability of a cell, 0.5 if never observed
+  double Probability(GridIndex cell) const;
+
+  //! @brief number of allocated tiles
+  size_t TileCount() const;
+
+  //! @brief all allocated tiles, in no particular order
+  std::vector<GridIndex> Tiles() const;
+
+  //! @brief Tiles changed since the last call, and mark them clean.
+  std::vector<GridIndex> TakeDirtyTiles();
+
+  //! @brief Smallest and largest allocated tile index.
+  //! @return false if the grid is empty
+  bool TileBounds(GridIndex &min, GridIndex &max) const;
+
+  //! @brief Cells of a tile as nav_msgs/OccupancyGrid values, row major.
+  //! -1 is unknown, otherwise 0 to 100. An unallocated tile is all unknown.
+  //! @param tile the tile index
+  //! @param out resized to kTileCells
+  void TileOccupancy(GridIndex tile, std::vector<int8_t> &out) const;
+
+  //! @brief the grid parameters
+  const OccupancyGridParams &Params() const;
+
+private:
+  struct Tile {
+    std::array<Cell, kTileCells> cells;
+    bool dirty = false;
+  };
+
+  static uint64_t Key(GridIndex tile);
+  Tile &TileAt(GridIndex tile);
+  //! @brief Add delta to a cell, saturating.
+  void Update(GridIndex cell, int delta);
+
+  OccupancyGridParams params_;
+  // Log-odds of one Cell step, and the sensor model in steps.
+  double step_;
+  int hit_;
+  int miss_;
+  // OccupancyGrid value of every Cell value, indexed by value - kUnknown.
+  std::vector<int8_t> occupancy_;
+  std::unordered_map<uint64_t, std::unique_ptr<Tile>> tiles_;
+  std::vector<GridIndex> dirty_;
+  // Rays mostly stay in one tile, so the last one is kept at hand.
+  uint64_t last_key_ = 0;
+  Tile *last_tile_ = nullptr;
+};
+
+extern template class TiledLogOddsGrid<int8_t>;
+extern template class TiledLogOddsGrid<int16_t>;
+
+} // namespace turtlelib
+
+#endif
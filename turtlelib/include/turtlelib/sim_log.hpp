@@ -0,0 +1,211 @@
+#ifndef TURTLELIB_SIM_LOG_INCLUDE_GUARD_HPP
+#define TURTLELIB_SIM_LOG_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Compact columnar log of a simulation run, written in chunks and read back through mmap.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace turtlelib {
+
+//! @brief What a record of a sim log holds.
+enum class SimLogChannel : uint8_t {
+  kPose = 0,         //!< x, y, theta of the ground truth body pose
+  kWheelCommand = 1, //!< left, right motor command
+  kEncoders = 2,     //!< left, right encoder ticks
+  kFakeSensor = 3,   //!< index, x, y of each landmark seen, in the body frame
+  kLaser = 4,        //!< the ranges of a scan
+};
+
+//! @brief Number of SimLogChannel values.
+constexpr size_t kSimLogChannels = 5;
+
+//! @brief Values of each channel are stored as integer multiples of this.
+constexpr std::array<double, kSimLogChannels> kSimLogQuantum = {1e-6, 1.0, 1.0, 1e-6, 1e-4};
+
+//! @brief One timed entry of a sim log.
+struct SimLogRecord {
+  SimLogChannel channel = SimLogChannel::kPose;
+  //! @brief sim time since the start of the run
+  int64_t time_ns = 0;
+  //! @brief index of the robot in the log's robot list
+  uint32_t robot = 0;
+  std::vector<double> values;
+};
+
+//! @brief Where a chunk of one channel's records is in a sim log file.
+struct SimLogChunk {
+  uint32_t channel;
+  uint32_t records;
+  int64_t first_time_ns;
+  int64_t last_time_ns;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+//! @brief Magic bytes at the start of a sim log file.
+constexpr char kSimLogMagic[8] = {'T', 'L', 'S', 'I', 'M', 'L', 'O', 'G'};
+//! @brief Magic bytes at the end of a closed sim log file.
+constexpr char kSimLogEndMagic[8] = {'T', 'L', 'S', 'I', 'M', 'E', 'N', 'D'};
+//! @brief Version of the sim log layout.
+constexpr uint32_t kSimLogVersion = 1;
+//! @brief A chunk is written once it holds this many values, however few records.
+constexpr size_t kSimLogChunkValues = 1 << 16;
+
+//! @brief Writes a sim log.
+//! File layout: magic, version, robot count and the length prefixed robot
+//! names, then the chunks, then the chunk index (one SimLogChunk each), then
+//! the index offset, the chunk count and the end magic.
+//! A chunk holds the records of one channel, column by column: times, robots,
+//! value counts, values. Numbers are zigzag varints. A time is stored as the
+//! change of the step from the previous record of the chunk. Values are
+//! differences to the same value of the robot's previous record in the chunk
+//! when that had as many values, so a smooth trajectory or a still scan costs
+//! a byte or two per value. Chunks decode on their own.
+class SimLogWriter {
+public:
+  //! @brief Create the file and write the header.
+  //! Throws std::runtime_error when the file cannot be written.
+  //! @param path the file
+  //! @param robots names of the robots, record robot i is robots[i]
+  //! @param chunk_records a channel's records are written out once it has this
+  //! many, or kSimLogChunkValues values
+  SimLogWriter(const std::string &path, const std::vector<std::string> &robots,
+               size_t chunk_records = 4096);
+
+  //! @brief Close the log if it still is open.
+  ~SimLogWriter();
+
+  SimLogWriter(const SimLogWriter &) = delete;
+  SimLogWriter &operator=(const SimLogWriter &) = delete;
+
+  //! @brief Add a record. Values are rounded to the channel's kSimLogQuantum.
+  //! Throws std::invalid_argument on a value that is not finite.
+  //! @param channel what it is
+  //! @param time_ns sim time since the start of the run
+  //! @param robot index of the robot
+  //! @param values the values
+  //! @param count number of values
+  void Append(SimLogChannel channel, int64_t time_ns, uint32_t robot, const double *values,
+              size_t count);
+
+  //! @brief Append for single precision values, such as laser ranges.
+  void Append(SimLogChannel channel, int64_t time_ns, uint32_t robot, const float *values,
+              size_t count);
+
+  //! @brief Write out the records of every channel as chunks.
+  void Flush();
+
+  //! @brief Flush, then write the index and the end of the file. Appending
+  //! afterwards throws std::logic_error. Throws std::runtime_error when a write fails.
+  void Close();
+
+private:
+  //! @brief Records of a channel not written yet, as integers.
+  struct Pending {
+    std::vector<int64_t> times;
+    std::vector<uint32_t> robots;
+    std::vector<uint32_t> counts;
+    std::vector<int64_t> values;
+  };
+
+  template <typename T>
+  void AppendValues(SimLogChannel channel, int64_t time_ns, uint32_t robot, const T *values,
+                    size_t count);
+
+  //! @brief Write the pending records of a channel as one chunk.
+  void WriteChunk(size_t channel);
+
+  std::ofstream out_;
+  size_t chunk_records_;
+  uint64_t offset_ = 0;
+  bool closed_ = false;
+  std::array<Pending, kSimLogChannels> pending_;
+  std::vector<SimLogChunk> index_;
+  std::vector<uint8_t> buffer_;
+};
+
+//! @brief Reads a closed sim log through a read only memory mapping.
+class SimLogReader {
+public:
+  //! @brief Map the file and read its header and index.
+  //! Throws std::runtime_error on a file that is not a closed sim log.
+  explicit SimLogReader(const std::string &path);
+
+  ~SimLogReader();
+
+  SimLogReader(const SimLogReader &) = delete;
+  SimLogReader &operator=(const SimLogReader &) = delete;
+
+  //! @brief names of the robots
+  const std::vector<std::string> &Robots() const;
+
+  //! @brief the chunks, in file order
+  const std::vector<SimLogChunk> &Chunks() const;
+
+  //! @brief time of the last record, -1 for an empty log
+  int64_t EndTime() const;
+
+  //! @brief Decode a chunk. Throws std::runtime_error on a corrupt chunk.
+  //! @param chunk index into Chunks()
+  //! @param out the chunk's records are appended
+  void Decode(size_t chunk, std::vector<SimLogRecord> &out) const;
+
+  //! @brief Records with begin_ns <= time < end_ns, in time order. Records at
+  //! the same time keep the order of their chunks. Only the chunks overlapping
+  //! the range are decoded.
+  //! @param begin_ns start of the range
+  //! @param end_ns end of the range, not included
+  //! @param out the records. Cleared first.
+  void Read(int64_t begin_ns, int64_t end_ns, std::vector<SimLogRecord> &out) const;
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<std::string> robots_;
+  std::vector<SimLogChunk> chunks_;
+  int64_t end_time_ = -1;
+};
+
+//! @brief Reads a sim log front to back, decoding each chunk once. Keeps one
+//! decoded chunk per channel. Assumes each channel was written in time order,
+//! as a simulation writes it.
+class SimLogCursor {
+public:
+  //! @brief Start at the beginning of a log.
+  //! @param reader the log, must outlive the cursor
+  explicit SimLogCursor(const SimLogReader &reader);
+
+  //! @brief The records not read yet with time < end_ns, in time order.
+  //! Records at the same time come in channel order.
+  //! @param end_ns end of the range, not included
+  //! @param out the records. Cleared first.
+  void ReadUntil(int64_t end_ns, std::vector<SimLogRecord> &out);
+
+  //! @brief true once every record was read
+  bool Done() const;
+
+private:
+  //! @brief Where the cursor is in one channel.
+  struct Channel {
+    std::vector<size_t> chunks;
+    size_t next_chunk = 0;
+    std::vector<SimLogRecord> records;
+    size_t next = 0;
+  };
+
+  //! @brief Decode chunks of a channel until it has a record left, or none remain.
+  //! @return whether the channel has a record left
+  bool Fill(Channel &channel);
+
+  const SimLogReader &reader_;
+  std::array<Channel, kSimLogChannels> channels_;
+};
+
+} // namespace turtlelib
+
+#endif
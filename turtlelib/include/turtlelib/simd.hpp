@@ -0,0 +1,118 @@
+#ifndef TURTLELIB_SIMD_INCLUDE_GUARD_HPP
+#define TURTLELIB_SIMD_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Portable SIMD lanes for the hot loops over point arrays.
+/// GCC and clang vector extensions. Two doubles is the native width of SSE2 on
+/// x86-64 and of NEON on aarch64, so one kernel covers both without
+/// intrinsics. Other compilers get a plain struct with the same interface,
+/// which the optimizer is free to vectorize on its own.
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace turtlelib::simd {
+
+//! @brief Number of doubles processed at once.
+constexpr size_t kLanes = 2;
+
+#if defined(__GNUC__)
+//! @brief kLanes doubles, with element wise arithmetic.
+typedef double Lanes __attribute__((vector_size(kLanes * sizeof(double))));
+
+//! @brief all lanes set to value
+inline Lanes Splat(double value) { return Lanes{} + value; }
+#else
+struct Lanes {
+  double v[kLanes];
+  double &operator[](size_t i) { return v[i]; }
+  double operator[](size_t i) const { return v[i]; }
+};
+inline Lanes &operator+=(Lanes &a, const Lanes &b) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    a.v[i] += b.v[i];
+  }
+  return a;
+}
+inline Lanes operator+(Lanes a, const Lanes &b) { return a += b; }
+inline Lanes &operator-=(Lanes &a, const Lanes &b) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    a.v[i] -= b.v[i];
+  }
+  return a;
+}
+inline Lanes operator-(Lanes a, const Lanes &b) { return a -= b; }
+inline Lanes &operator*=(Lanes &a, const Lanes &b) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    a.v[i] *= b.v[i];
+  }
+  return a;
+}
+inline Lanes operator*(Lanes a, const Lanes &b) { return a *= b; }
+inline Lanes &operator/=(Lanes &a, const Lanes &b) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    a.v[i] /= b.v[i];
+  }
+  return a;
+}
+inline Lanes operator/(Lanes a, const Lanes &b) { return a /= b; }
+
+//! @brief all lanes set to value
+inline Lanes Splat(double value) {
+  Lanes out;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.v[i] = value;
+  }
+  return out;
+}
+#endif
+
+//! @brief Load kLanes doubles, no alignment needed.
+inline Lanes Load(const double *p) {
+  Lanes v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+//! @brief Store kLanes doubles, no alignment needed.
+inline void Store(double *p, const Lanes &v) { std::memcpy(p, &v, sizeof(v)); }
+
+//! @brief lane wise minimum
+inline Lanes Min(const Lanes &a, const Lanes &b) {
+  Lanes out = a;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out[i] = b[i] < a[i] ? b[i] : a[i];
+  }
+  return out;
+}
+
+//! @brief lane wise maximum
+inline Lanes Max(const Lanes &a, const Lanes &b) {
+  Lanes out = a;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out[i] = b[i] > a[i] ? b[i] : a[i];
+  }
+  return out;
+}
+
+//! @brief lane wise square root
+inline Lanes Sqrt(const Lanes &v) {
+  Lanes out = v;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out[i] = std::sqrt(v[i]);
+  }
+  return out;
+}
+
+//! @brief sum of all lanes
+inline double HorizontalSum(const Lanes &v) {
+  double sum = 0.0;
+  for (size_t i = 0; i < kLanes; ++i) {
+    sum += v[i];
+  }
+  return sum;
+}
+
+} // namespace turtlelib::simd
+
+#endif
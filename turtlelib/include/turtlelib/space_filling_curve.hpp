@@ -0,0 +1,30 @@
+#ifndef TURTLELIB_SPACE_FILLING_CURVE_INCLUDE_GUARD_HPP
+#define TURTLELIB_SPACE_FILLING_CURVE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Morton and Hilbert curves, for ordering 2D data by locality.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Position of a cell on the Morton (Z order) curve.
+//! Interleaves the bits of x and y, x in the even bits.
+uint64_t MortonCode(uint32_t x, uint32_t y);
+
+//! @brief Position of a cell on the Hilbert curve over a 2^16 by 2^16 grid.
+//! Unlike Morton, consecutive positions are always adjacent cells, so close
+//! positions mean close cells more often.
+uint64_t HilbertIndex(uint16_t x, uint16_t y);
+
+//! @brief Order points along the Hilbert curve over their bounding box.
+//! @param points the points to order
+//! @return indices into points, sorted by Hilbert index. Ties keep their order.
+std::vector<size_t> HilbertOrder(const std::vector<Point2D> &points);
+
+} // namespace turtlelib
+
+#endif
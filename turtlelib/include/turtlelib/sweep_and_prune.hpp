@@ -0,0 +1,35 @@
+#ifndef TURTLELIB_SWEEP_AND_PRUNE_INCLUDE_GUARD_HPP
+#define TURTLELIB_SWEEP_AND_PRUNE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Broad phase collision of moving circles, by sweep and prune along x.
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace turtlelib {
+
+//! @brief Finds the circles whose bounding boxes overlap, for moving circles.
+//! The circles are kept sorted by the left side of their box, then swept
+//! along x, so only circles overlapping in x are compared in y. The order is
+//! kept between calls, and circles move little between two steps of a
+//! simulation, so the insertion sort redoing it is close to linear.
+class SweepAndPrune {
+public:
+  //! @brief Pairs of circles whose bounding boxes overlap.
+  //! @param x x of each circle center
+  //! @param y y of each circle center
+  //! @param r radius of each circle
+  //! @param pairs (i, j) with i < j for each overlap, ascending. Cleared first.
+  void Update(const std::vector<double> &x, const std::vector<double> &y,
+              const std::vector<double> &r, std::vector<std::pair<size_t, size_t>> &pairs);
+
+private:
+  // Circle indices by the left side of their box, as of the last Update.
+  std::vector<size_t> order_;
+  std::vector<double> min_x_;
+};
+
+} // namespace turtlelib
+
+#endif
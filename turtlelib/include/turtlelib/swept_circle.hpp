@@ -0,0 +1,66 @@
+#ifndef TURTLELIB_SWEPT_CIRCLE_INCLUDE_GUARD_HPP
+#define TURTLELIB_SWEPT_CIRCLE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Continuous collision of a circle moving along a twist's arc with static shapes.
+
+#include <cstddef>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/se2d.hpp"
+
+namespace turtlelib {
+
+//! @brief Sub-steps of a sweep are never shorter than this, meters.
+constexpr double kSweepContactStep = 1e-4;
+
+//! @brief A sweep takes at most this many sub-steps, the rest of the motion is one step.
+constexpr size_t kSweepMaxSubsteps = 1024;
+
+//! @brief Point of a segment closest to p.
+Point2D ClosestPoint(const Segment2D &segment, Point2D p);
+
+//! @brief Static shapes a moving circle must not pass through.
+struct SweepShapes {
+  //! @brief x of each circle center
+  std::vector<double> x;
+  //! @brief y of each circle center
+  std::vector<double> y;
+  //! @brief radius of each circle
+  std::vector<double> r;
+  std::vector<Segment2D> segments;
+
+  //! @brief Remove every shape, keeping the storage.
+  void Clear();
+};
+
+//! @brief Where a sweep ended.
+struct SweepResult {
+  Transform2D pose;
+  //! @brief whether the circle touched a shape and was pushed out of it
+  bool contact = false;
+  //! @brief number of steps the motion was split into
+  size_t substeps = 0;
+};
+
+//! @brief Move a circle along the arc of integrate_twist(twist) from start
+//! without passing through the shapes.
+//! Each sub-step is as long as the clearance to the nearest shape, so away from
+//! the shapes the whole motion is one step. Near contact a sub-step goes at
+//! most half way from the center to a shape, so the circle may sink in, but its
+//! center never passes the shape. It is then pushed out along the shape's
+//! normal before going on with the rest of the motion. The circle so slides
+//! along what it hits, and can't tunnel through a shape however thin, nor
+//! however long the motion.
+//! @param start pose at the start of the motion
+//! @param twist body twist integrated over the whole motion
+//! @param radius radius of the circle
+//! @param shapes what it can hit
+//! @param contact_step shortest sub-step, meters
+//! @return the pose it ends at, and whether it hit something
+SweepResult SweepCircle(const Transform2D &start, const Twist2D &twist, double radius,
+                        const SweepShapes &shapes, double contact_step = kSweepContactStep);
+
+} // namespace turtlelib
+
+#endif
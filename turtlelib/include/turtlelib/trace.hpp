@@ -0,0 +1,155 @@
+#ifndef TURTLELIB_TRACE_INCLUDE_GUARD_HPP
+#define TURTLELIB_TRACE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Structured debug tracing into per-thread rings, formatted offline.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "turtlelib/flight_recorder.hpp"
+
+//! @brief Compiled in trace points, 0 removes every TURTLELIB_TRACE_POINT.
+//! Set by the TURTLELIB_TRACE option of the turtlelib build.
+#ifndef TURTLELIB_TRACE
+#define TURTLELIB_TRACE 1
+#endif
+
+namespace turtlelib {
+
+//! @brief Number of values one trace record holds.
+constexpr size_t kTraceValues = 6;
+
+//! @brief One hit of a trace point, 64 bytes so a push touches one cache line.
+struct TraceRecord {
+  //! @brief steady clock of the hit, nanoseconds
+  int64_t time_ns = 0;
+  //! @brief the trace point, see RegisterTracePoint
+  uint32_t point = 0;
+  //! @brief the thread, numbered in the order threads first traced
+  uint16_t thread = 0;
+  //! @brief number of values used
+  uint16_t count = 0;
+  double values[kTraceValues] = {};
+};
+
+//! @brief Name and value names of a trace point.
+struct TracePointInfo {
+  std::string name;
+  //! @brief names of the values, comma separated
+  std::string fields;
+};
+
+//! @brief Trace points and the records of every thread, oldest first.
+struct TraceDump {
+  std::vector<TracePointInfo> points;
+  std::vector<TraceRecord> records;
+};
+
+//! @brief Magic bytes of a trace file.
+constexpr char kTraceMagic[8] = {'T', 'L', 'T', 'R', 'A', 'C', 'E', '1'};
+//! @brief Version of the trace file layout.
+constexpr uint32_t kTraceVersion = 1;
+
+//! @brief First bytes of a trace file. Then each point as its name and fields,
+//! both a uint32 length and the characters, then the records as they are in
+//! memory.
+struct TraceFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t points;
+  uint64_t records;
+};
+
+//! @brief The categories traced, a bit each. Read by every trace point, so
+//! kept apart from anything written often.
+alignas(64) inline std::atomic<uint32_t> trace_mask{0};
+
+//! @brief Turn categories of trace points on and off at run time.
+//! @param mask bit i set traces the points of category bit i, 0 (default) none
+inline void SetTraceMask(uint32_t mask) { trace_mask.store(mask, std::memory_order_relaxed); }
+
+//! @brief Whether any of the categories is traced.
+//! @param category bits of the trace point
+inline bool TraceOn(uint32_t category) {
+  return (trace_mask.load(std::memory_order_relaxed) & category) != 0;
+}
+
+//! @brief Number a trace point. The same name gets the same number, the
+//! fields of its first registration are kept. Thread safe.
+//! @param name of the point, such as "nusim.robot"
+//! @param fields names of its values, comma separated
+//! @return the number records of the point carry
+uint32_t RegisterTracePoint(const char *name, const char *fields);
+
+//! @brief Records kept per thread, for the rings of threads that start
+//! tracing after the call. Default 8192.
+void SetTraceCapacity(size_t capacity);
+
+//! @brief The ring of the calling thread, made at its first record.
+//! Rings outlive their threads, so the records of a finished worker still
+//! show up in a dump.
+FlightRecorder<TraceRecord> &ThreadTraceRing();
+
+//! @brief Record a hit of a trace point in the calling thread's ring.
+//! A push never locks or allocates, and writes no text.
+//! @param point from RegisterTracePoint
+//! @param values up to kTraceValues numbers, stored as double
+template <typename... Values> void Trace(uint32_t point, Values... values) {
+  static_assert(sizeof...(Values) <= kTraceValues, "A trace record holds kTraceValues values");
+  static_assert((std::is_arithmetic_v<Values> && ...), "Trace values are numbers");
+  auto &ring = ThreadTraceRing();
+  TraceRecord record;
+  record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+  record.point = point;
+  record.count = static_cast<uint16_t>(sizeof...(Values));
+  size_t i = 0;
+  ((record.values[i++] = static_cast<double>(values)), ...);
+  // The ring of a thread only holds records of that thread, its number is
+  // filled in by the reader.
+  ring.Push(record);
+}
+
+//! @brief Copy out every ring, records sorted by time. Safe while other
+//! threads trace, records being written are skipped.
+TraceDump SnapshotTrace();
+
+//! @brief Write SnapshotTrace to a file.
+//! Throws std::runtime_error when it can't be written.
+//! @return number of records written
+size_t DumpTrace(const std::string &path);
+
+//! @brief Read a file of DumpTrace.
+//! Throws std::runtime_error on a file that isn't one.
+TraceDump ReadTrace(const std::string &path);
+
+//! @brief One record as text: "time_ns thread name field=value ...".
+//! @param dump the points the record refers to
+//! @param record the record
+std::string FormatTraceRecord(const TraceDump &dump, const TraceRecord &record);
+
+} // namespace turtlelib
+
+//! @brief A trace point. Traced only when compiled in with TURTLELIB_TRACE and
+//! category is in the trace mask. Otherwise it costs one load and one
+//! predictable branch, its values are not even computed.
+//! @param category bits the point belongs to, see SetTraceMask
+//! @param name string literal naming the point
+//! @param fields string literal naming the values, comma separated
+//! @param ... up to kTraceValues numbers
+#define TURTLELIB_TRACE_POINT(category, name, fields, ...)                                        \
+  do {                                                                                             \
+    if (TURTLELIB_TRACE && ::turtlelib::TraceOn(category)) {                                      \
+      static const uint32_t turtlelib_trace_point = ::turtlelib::RegisterTracePoint(name, fields); \
+      ::turtlelib::Trace(turtlelib_trace_point, __VA_ARGS__);                                      \
+    }                                                                                              \
+  } while (false)
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TURTLELIB_TRIPLE_BUFFER_INCLUDE_GUARD_HPP
+#define TURTLELIB_TRIPLE_BUFFER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Lock-free hand over of the latest value from one writer to one reader.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace turtlelib {
+
+//! @brief Three copies of a value: one the writer fills, one the reader holds,
+//! and the latest published one in between.
+//! Publishing swaps the writer's copy with the middle one, taking the latest
+//! swaps the reader's copy with it, each with a single atomic exchange. So
+//! neither side ever waits for the other, and the reader always sees a whole
+//! value. Values published faster than they are taken are skipped, only the
+//! newest one is handed over.
+//! One thread may write and one thread may read at a time.
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() = default;
+
+  //! @brief Start with every copy set to a value.
+  //! @param initial what Front() holds until the first value is taken
+  explicit TripleBuffer(const T &initial) : buffers_{initial, initial, initial} {}
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  //! @brief The copy the writer fills next. It holds an older value, which
+  //! may be overwritten in place to reuse its storage.
+  T &Back() { return buffers_[back_]; }
+
+  //! @brief Hand Back() to the reader as the latest value. Back() then is
+  //! another copy.
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+  }
+
+  //! @brief Take the latest published value into Front(), if there is a newer one.
+  //! @return whether Front() changed
+  bool Update() {
+    if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+
+  //! @brief The reader's copy, the latest value as of the last Update().
+  const T &Front() const { return buffers_[front_]; }
+
+private:
+  // The middle index carries a flag telling whether it was published since
+  // the reader last took it.
+  static constexpr uint8_t kIndex = 3;
+  static constexpr uint8_t kFresh = 4;
+
+  std::array<T, 3> buffers_{};
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> middle_{1};
+  uint8_t front_ = 2;
+};
+
+} // namespace turtlelib
+
+#endif
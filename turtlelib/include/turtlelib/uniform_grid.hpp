@@ -0,0 +1,114 @@
+#ifndef TURTLELIB_UNIFORM_GRID_INCLUDE_GUARD_HPP
+#define TURTLELIB_UNIFORM_GRID_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Uniform grid over circles and segments, for ray casts and proximity queries.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/grid_walk.hpp"
+
+namespace turtlelib {
+
+//! @brief The arrays a UniformGrid answers queries from. A grid built from
+//! shapes points these at its own storage, a grid over a mapped WorldFile at
+//! the file.
+struct UniformGridView {
+  GridFrame frame;
+  //! @brief shapes of cell c are items[cell_start[c], cell_start[c + 1]),
+  //! cells_x * cells_y + 1 entries
+  const uint32_t *cell_start = nullptr;
+  //! @brief an item below circles is a circle, the rest are segments after the circles
+  const uint32_t *items = nullptr;
+  //! @brief number of items, cell_start[cells_x * cells_y]
+  size_t item_count = 0;
+  const double *circle_x = nullptr;
+  const double *circle_y = nullptr;
+  const double *circle_r = nullptr;
+  size_t circles = 0;
+  const Segment2D *segments = nullptr;
+  size_t segment_count = 0;
+};
+
+//! @brief Static world of circles and segments bucketed into square cells.
+//! Every cell lists the shapes touching it, so a query only looks at the
+//! shapes near where it is, and its cost follows the local density instead of
+//! the size of the world.
+class UniformGrid {
+public:
+  //! @brief Bucket the shapes. The grid covers their bounding box.
+  //! @param circle_x x of each circle center
+  //! @param circle_y y of each circle center
+  //! @param circle_r radius of each circle
+  //! @param segments the segments
+  //! @param cell_size side of a cell. About the spacing of the shapes is a good start.
+  UniformGrid(const std::vector<double> &circle_x, const std::vector<double> &circle_y,
+              const std::vector<double> &circle_r, const std::vector<Segment2D> &segments,
+              double cell_size);
+
+  //! @brief A grid over arrays kept by someone else, nothing is copied.
+  //! The arrays must outlive the grid.
+  //! @param view the shapes and cells, as View() of a grid gives them
+  explicit UniformGrid(const UniformGridView &view);
+
+  UniformGrid(const UniformGrid &) = delete;
+  UniformGrid &operator=(const UniformGrid &) = delete;
+  // A moved vector keeps its buffer, so the view stays valid.
+  UniformGrid(UniformGrid &&) = default;
+  UniformGrid &operator=(UniformGrid &&) = default;
+
+  //! @brief Distance along a ray to the nearest shape it hits.
+  //! The cells along the ray are walked in order (Amanatides-Woo DDA), and the
+  //! walk stops at the first cell whose shapes give a hit inside that cell.
+  //! A ray starting inside a circle doesn't see that circle.
+  //! @param origin start of the ray
+  //! @param direction unit direction of the ray
+  //! @param range_max the walk stops there
+  //! @return distance to the hit, infinity without a hit within range_max
+  double Raycast(Point2D origin, Vector2D direction, double range_max) const;
+
+  //! @brief Circles overlapping a disk.
+  //! @param center center of the disk
+  //! @param radius radius of the disk
+  //! @param out indices of the circles, ascending. Cleared first.
+  void CirclesNear(Point2D center, double radius, std::vector<size_t> &out) const;
+
+  //! @brief Segments within a distance of a point.
+  //! @param center center of the disk
+  //! @param radius radius of the disk
+  //! @param out indices of the segments, ascending. Cleared first.
+  void SegmentsNear(Point2D center, double radius, std::vector<size_t> &out) const;
+
+  //! @brief number of cells in x
+  size_t CellsX() const;
+
+  //! @brief number of cells in y
+  size_t CellsY() const;
+
+  //! @brief the arrays of the grid, valid as long as the grid
+  const UniformGridView &View() const;
+
+private:
+  //! @brief Visit the cells along a ray, see GridWalk, with visit(cell index, t_exit).
+  template <typename Visit>
+  void Walk(Point2D start, Vector2D direction, double t_end, Visit visit) const;
+
+  //! @brief Visit the items of the cells overlapping the bounding box of a disk.
+  template <typename Visit> void VisitNear(Point2D center, double radius, Visit visit) const;
+
+  // What the queries read, the vectors below or arrays of someone else.
+  UniformGridView view_;
+  // Storage of a grid built from shapes, empty for one over a view.
+  std::vector<uint32_t> cell_start_;
+  std::vector<uint32_t> items_;
+  std::vector<double> circle_x_;
+  std::vector<double> circle_y_;
+  std::vector<double> circle_r_;
+  std::vector<Segment2D> segments_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TURTLELIB_WORKER_POOL_INCLUDE_GUARD_HPP
+#define TURTLELIB_WORKER_POOL_INCLUDE_GUARD_HPP
+/// \file
+/// \brief A small persistent thread pool for data-parallel loops and background jobs.
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace turtlelib {
+
+//! @brief Fixed size pool of worker threads.
+//! The threads are created once and reused, so handing work to the pool costs a
+//! lock and a wake-up instead of a thread creation.
+class WorkerPool {
+public:
+  //! @brief Create the pool.
+  //! @param num_threads Total parallelism, counting the thread that calls
+  //! ParallelFor. 0 picks std::thread::hardware_concurrency(). 1 creates no
+  //! worker at all and runs everything inline on the caller.
+  explicit WorkerPool(size_t num_threads = 0);
+
+  //! @brief Finish queued jobs, then join all workers.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  //! @brief Total parallelism of the pool, including the calling thread.
+  //! @return number of threads that can run a ParallelFor chunk at once
+  size_t Size() const;
+
+  //! @brief Split [begin, end) into contiguous chunks and run them in parallel.
+  //! The calling thread works on chunks as well, and the call blocks until
+  //! every chunk is done. If a chunk throws, the first exception is rethrown
+  //! here after all chunks finished.
+  //! @param begin first index
+  //! @param end one past the last index
+  //! @param chunk_fn called as chunk_fn(chunk_begin, chunk_end)
+  //! @param min_chunk smallest chunk worth handing to another thread
+  void ParallelFor(size_t begin, size_t end,
+                   const std::function<void(size_t, size_t)> &chunk_fn,
+                   size_t min_chunk = 1);
+
+  //! @brief Queue a job to run on a worker without waiting for it.
+  //! With a pool of Size() 1 the job runs inline before Submit returns.
+  //! @param job the job to run. It must not throw.
+  void Submit(std::function<void()> job);
+
+private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> jobs_;
+  bool stopping_ = false;
+};
+
+} // namespace turtlelib
+
+#endif
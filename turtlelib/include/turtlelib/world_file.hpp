@@ -0,0 +1,88 @@
+#ifndef TURTLELIB_WORLD_FILE_INCLUDE_GUARD_HPP
+#define TURTLELIB_WORLD_FILE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Binary world files: obstacles, walls and their UniformGrid, loaded through mmap.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/uniform_grid.hpp"
+
+namespace turtlelib {
+
+//! @brief Magic bytes at the start of a world file.
+constexpr char kWorldFileMagic[8] = {'T', 'L', 'W', 'O', 'R', 'L', 'D', '1'};
+//! @brief Version of the world file layout.
+constexpr uint32_t kWorldFileVersion = 1;
+//! @brief Written in the byte order of the writer, a reader of the other byte
+//! order sees it reversed.
+constexpr uint32_t kWorldFileByteOrder = 0x01020304;
+//! @brief Every section starts at a multiple of this many bytes.
+constexpr size_t kWorldFileAlign = 64;
+
+//! @brief First bytes of a world file, followed by its sections.
+//! The sections are plain arrays in the byte order of the writer, in the
+//! layout of UniformGridView: circle x, y and r as double, the segments as
+//! Segment2D, then the uint32 cell starts and items of the grid.
+struct WorldFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t circles;
+  uint64_t segments;
+  uint64_t cells_x;
+  uint64_t cells_y;
+  uint64_t items;
+  double min_x;
+  double min_y;
+  double cell_size;
+  //! @brief where circle x, circle y, circle r, segments, cell starts and
+  //! items begin, in bytes from the start of the file
+  uint64_t offsets[6];
+};
+
+//! @brief Write a world file. The grid is built here, so loading the file
+//! needs no parsing and no building.
+//! Throws std::invalid_argument on shapes a UniformGrid refuses, std::runtime_error
+//! when the file can't be written.
+//! @param path the file, replaced if it exists
+//! @param circle_x x of each circle center
+//! @param circle_y y of each circle center
+//! @param circle_r radius of each circle
+//! @param segments the walls
+//! @param cell_size side of a grid cell, see UniformGrid
+void WriteWorldFile(const std::string &path, const std::vector<double> &circle_x,
+                    const std::vector<double> &circle_y, const std::vector<double> &circle_r,
+                    const std::vector<Segment2D> &segments, double cell_size);
+
+//! @brief A mapped world file. Its shapes and grid are read in place, nothing
+//! is copied, so opening it costs one pass over the grid index checking that
+//! no query can read outside the file, whatever the size of the world.
+class WorldFile {
+public:
+  //! @brief Map the file and check its header and grid.
+  //! Throws std::runtime_error on a file that is not a world file of this
+  //! version and byte order, or whose sections don't fit it.
+  explicit WorldFile(const std::string &path);
+
+  ~WorldFile();
+
+  WorldFile(const WorldFile &) = delete;
+  WorldFile &operator=(const WorldFile &) = delete;
+
+  //! @brief The shapes and grid, pointing into the mapping. A UniformGrid over
+  //! them must not outlive this file.
+  const UniformGridView &View() const;
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  UniformGridView view_;
+};
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TURTLELIB_WORLD_MAP_INCLUDE_GUARD_HPP
+#define TURTLELIB_WORLD_MAP_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Static world maps for simulation: segment floor plans and occupancy images.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/grid_walk.hpp"
+
+namespace turtlelib {
+
+//! @brief Read the segments of a floor plan file.
+//! One shape per line, in meters, # starts a comment:
+//!   segment x1 y1 x2 y2
+//!   polygon x1 y1 x2 y2 x3 y3 ...
+//! A polygon is closed, its last corner connects back to its first.
+//! Throws std::runtime_error naming the line of a malformed entry.
+//! @param path the file
+//! @return the segments
+std::vector<Segment2D> LoadSegmentWorld(const std::string &path);
+
+//! @brief The four walls of a rectangular arena centered on the origin.
+//! @param x_length length of the arena in x
+//! @param y_length length of the arena in y
+//! @return the walls at +y, -x, -y and +x, in that order
+std::vector<Segment2D> ArenaWalls(double x_length, double y_length);
+
+//! @brief Bounding volume hierarchy of segments, for nearest hit ray casts.
+class SegmentBvh {
+public:
+  //! @brief Build the tree, splitting at the median along the longer side.
+  //! @param segments the segments
+  explicit SegmentBvh(std::vector<Segment2D> segments);
+
+  //! @brief Distance along a ray to the nearest segment it hits.
+  //! @param origin start of the ray
+  //! @param direction unit direction of the ray
+  //! @param range_max hits further away are ignored
+  //! @return distance to the hit, infinity without a hit within range_max
+  double Raycast(Point2D origin, Vector2D direction, double range_max) const;
+
+  //! @brief Segments whose bounding box overlaps a disk.
+  //! @param center center of the disk
+  //! @param radius radius of the disk
+  //! @param out indices into Segments(), in tree order. Cleared first.
+  void SegmentsNear(Point2D center, double radius, std::vector<size_t> &out) const;
+
+  //! @brief the segments, in tree order
+  const std::vector<Segment2D> &Segments() const;
+
+private:
+  //! @brief A box holding a contiguous run of segments. A leaf (count > 0)
+  //! holds segments [first, first + count). An inner node's children are
+  //! first and first + 1.
+  struct Node {
+    Point2D min;
+    Point2D max;
+    uint32_t first = 0;
+    uint32_t count = 0;
+  };
+
+  //! @brief Make the node of segments [begin, end) at index node, and its subtree.
+  void Build(size_t node, size_t begin, size_t end);
+
+  std::vector<Segment2D> segments_;
+  std::vector<Node> nodes_;
+};
+
+//! @brief Static map of occupied cells, such as a scanned floor plan.
+//! Row 0 is the lowest y, as in nav_msgs/OccupancyGrid.
+class OccupancyMap {
+public:
+  //! @brief Make the map.
+  //! @param width cells in x
+  //! @param height cells in y
+  //! @param resolution cell side length, meters
+  //! @param origin lower left corner of cell (0, 0) in the world
+  //! @param occupied row major, nonzero for an occupied cell
+  OccupancyMap(size_t width, size_t height, double resolution, Point2D origin,
+               std::vector<uint8_t> occupied);
+
+  //! @brief Distance along a ray to the first occupied cell it enters.
+  //! The cell holding the origin doesn't count, so a scanner in a wall still
+  //! sees past it.
+  //! @param origin start of the ray
+  //! @param direction unit direction of the ray
+  //! @param range_max the walk stops there
+  //! @return distance to the cell border, infinity without a hit within range_max
+  double Raycast(Point2D origin, Vector2D direction, double range_max) const;
+
+  //! @brief whether the cell holding p is occupied, false outside the map
+  bool Occupied(Point2D p) const;
+
+  //! @brief Borders of occupied cells that face a free cell or the outside,
+  //! for cells whose square overlaps the bounding box of a disk. Together
+  //! they outline the walls near the disk, for collisions against the map.
+  //! @param center center of the disk
+  //! @param radius radius of the disk
+  //! @param out the borders, row by row. Cleared first.
+  void EdgesNear(Point2D center, double radius, std::vector<Segment2D> &out) const;
+
+  //! @brief cells in x
+  size_t Width() const;
+
+  //! @brief cells in y
+  size_t Height() const;
+
+  //! @brief cell side length
+  double Resolution() const;
+
+  //! @brief lower left corner of cell (0, 0)
+  Point2D Origin() const;
+
+  //! @brief occupancy of every cell, row major
+  const std::vector<uint8_t> &Cells() const;
+
+private:
+  GridFrame frame_;
+  std::vector<uint8_t> occupied_;
+};
+
+//! @brief Read a PGM image (P2 or P5) as an occupancy map, like map_server does.
+//! Darker is more occupied, a pixel is occupied when (maxval - value) / maxval
+//! is above occupied_thresh. The top row of the image is the highest y.
+//! Throws std::runtime_error on a file that is not a PGM image.
+//! @param path the image
+//! @param resolution meters per pixel
+//! @param origin world position of the lower left corner of the image
+//! @param occupied_thresh occupancy probability above which a pixel is occupied
+//! @return the map
+OccupancyMap LoadPgmMap(const std::string &path, double resolution, Point2D origin,
+                        double occupied_thresh = 0.65);
+
+} // namespace turtlelib
+
+#endif
@@ -0,0 +1,243 @@
+#include "turtlelib/batch_sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "turtlelib/geometry2d.hpp"
+#include "turtlelib/simd.hpp"
+
+namespace turtlelib {
+
+using simd::kLanes;
+using simd::Lanes;
+using simd::Load;
+using simd::Splat;
+using simd::Store;
+
+namespace {
+
+//! @brief Move a pose by a body twist over one unit of time, as integrate_twist.
+void Integrate(double &x, double &y, double &theta, double omega, double vx) {
+  double forward = vx;
+  double left = 0.0;
+  if (!almost_equal(omega, 0.0)) {
+    forward = vx * std::sin(omega) / omega;
+    left = vx * (1.0 - std::cos(omega)) / omega;
+  }
+  const double c = std::cos(theta);
+  const double s = std::sin(theta);
+  x += c * forward - s * left;
+  y += s * forward + c * left;
+  theta = normalize_angle(theta + omega);
+}
+
+} // namespace
+
+BatchSim::BatchSim(size_t worlds, BatchSimParams params, WorkerPool *pool)
+    : params_(params), pool_(pool), x_(worlds, 0.0), y_(worlds, 0.0), theta_(worlds, 0.0),
+      left_(worlds, 0.0), right_(worlds, 0.0), cmd_left_(worlds, 0.0), cmd_right_(worlds, 0.0),
+      step_omega_(worlds, 0.0), step_vx_(worlds, 0.0), noise_(params.seed) {
+  if (params_.wheel_track_to_body <= 0.0 || params_.wheel_radius <= 0.0 || params_.dt <= 0.0) {
+    throw std::invalid_argument("BatchSim needs a positive track, wheel radius and dt");
+  }
+  if (worlds > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("BatchSim has one noise stream per world, at most 2^32");
+  }
+}
+
+size_t BatchSim::Size() const { return x_.size(); }
+
+void BatchSim::SetPose(size_t world, const Transform2D &pose) {
+  x_.at(world) = pose.translation().x;
+  y_.at(world) = pose.translation().y;
+  theta_.at(world) = pose.rotation();
+}
+
+void BatchSim::SetCommand(size_t world, WheelVelocity command) {
+  cmd_left_.at(world) = command.left;
+  cmd_right_.at(world) = command.right;
+}
+
+void BatchSim::Step() {
+  if (pool_ != nullptr) {
+    pool_->ParallelFor(
+        0, Size(), [this](size_t begin, size_t end) { StepRange(begin, end); }, 256);
+  } else {
+    StepRange(0, Size());
+  }
+  ++steps_;
+}
+
+void BatchSim::StepRange(size_t begin, size_t end) {
+  const double dt = params_.dt;
+  const double turn = params_.wheel_radius / (2.0 * params_.wheel_track_to_body);
+  const double drive = params_.wheel_radius / 2.0;
+  // Noise of one world, from its own stream at this step.
+  const auto draw = [this](size_t i, double &noise_left, double &noise_right, double &slip_left,
+                           double &slip_right) {
+    double normals[2];
+    double uniforms[2];
+    noise_.Gaussians(static_cast<uint32_t>(i), steps_, normals, 2);
+    noise_.Uniforms(static_cast<uint32_t>(i), steps_, uniforms, 2);
+    noise_left = cmd_left_[i] == 0.0 ? 0.0 : normals[0] * params_.input_noise;
+    noise_right = cmd_right_[i] == 0.0 ? 0.0 : normals[1] * params_.input_noise;
+    slip_left = (2.0 * uniforms[0] - 1.0) * params_.slip_fraction;
+    slip_right = (2.0 * uniforms[1] - 1.0) * params_.slip_fraction;
+  };
+
+  size_t i = begin;
+  // kLanes worlds at a time: wheel increments and body twists in lanes, the
+  // trigonometry of the pose update per lane.
+  for (; i + kLanes <= end; i += kLanes) {
+    double noise_left[kLanes];
+    double noise_right[kLanes];
+    double slip_left[kLanes];
+    double slip_right[kLanes];
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      draw(i + lane, noise_left[lane], noise_right[lane], slip_left[lane], slip_right[lane]);
+    }
+    const Lanes delta_left = Load(cmd_left_.data() + i) * Splat(dt) + Load(noise_left);
+    const Lanes delta_right = Load(cmd_right_.data() + i) * Splat(dt) + Load(noise_right);
+    double *const omega = step_omega_.data() + i;
+    double *const vx = step_vx_.data() + i;
+    Store(omega, (delta_right - delta_left) * Splat(turn));
+    Store(vx, (delta_left + delta_right) * Splat(drive));
+    // Slip only shows in the encoders, not in how the robot moved.
+    Store(left_.data() + i, Load(left_.data() + i) + delta_left + Load(slip_left));
+    Store(right_.data() + i, Load(right_.data() + i) + delta_right + Load(slip_right));
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      Integrate(x_[i + lane], y_[i + lane], theta_[i + lane], omega[lane], vx[lane]);
+    }
+  }
+  for (; i < end; ++i) {
+    double noise_left;
+    double noise_right;
+    double slip_left;
+    double slip_right;
+    draw(i, noise_left, noise_right, slip_left, slip_right);
+    const double delta_left = cmd_left_[i] * dt + noise_left;
+    const double delta_right = cmd_right_[i] * dt + noise_right;
+    left_[i] += delta_left + slip_left;
+    right_[i] += delta_right + slip_right;
+    step_omega_[i] = (delta_right - delta_left) * turn;
+    step_vx_[i] = (delta_left + delta_right) * drive;
+    Integrate(x_[i], y_[i], theta_[i], step_omega_[i], step_vx_[i]);
+  }
+}
+
+uint64_t BatchSim::Steps() const { return steps_; }
+
+Transform2D BatchSim::Pose(size_t world) const {
+  return Transform2D{{x_.at(world), y_.at(world)}, theta_.at(world)};
+}
+
+WheelConfig BatchSim::Wheels(size_t world) const { return {left_.at(world), right_.at(world)}; }
+
+Twist2D BatchSim::StepTwist(size_t world) const {
+  return {step_omega_.at(world), step_vx_.at(world), 0.0};
+}
+
+DiffDrive BatchSim::ToDiffDrive(size_t world) const {
+  return DiffDrive{params_.wheel_track_to_body, params_.wheel_radius, Pose(world), Wheels(world)};
+}
+
+BatchSimState BatchSim::State() const {
+  return {steps_, x_, y_, theta_, left_, right_, cmd_left_, cmd_right_, step_omega_, step_vx_};
+}
+
+void BatchSim::SetState(const BatchSimState &state) {
+  const size_t worlds = Size();
+  for (const auto *column :
+       {&state.x, &state.y, &state.theta, &state.left, &state.right, &state.cmd_left,
+        &state.cmd_right, &state.step_omega, &state.step_vx}) {
+    if (column->size() != worlds) {
+      throw std::invalid_argument("BatchSim state is of another number of worlds");
+    }
+  }
+  steps_ = state.steps;
+  x_ = state.x;
+  y_ = state.y;
+  theta_ = state.theta;
+  left_ = state.left;
+  right_ = state.right;
+  cmd_left_ = state.cmd_left;
+  cmd_right_ = state.cmd_right;
+  step_omega_ = state.step_omega;
+  step_vx_ = state.step_vx;
+}
+
+const BatchSimParams &BatchSim::Params() const { return params_; }
+
+const std::vector<double> &BatchSim::X() const { return x_; }
+
+const std::vector<double> &BatchSim::Y() const { return y_; }
+
+const std::vector<double> &BatchSim::Theta() const { return theta_; }
+
+BatchLogWriter::BatchLogWriter(const std::string &path, size_t worlds)
+    : out_(path, std::ios::binary | std::ios::trunc), frame_(worlds) {
+  BatchLogHeader header{};
+  std::copy(std::begin(kBatchLogMagic), std::end(kBatchLogMagic), header.magic);
+  header.version = kBatchLogVersion;
+  header.record_size = sizeof(BatchLogRecord);
+  header.worlds = worlds;
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!out_) {
+    throw std::runtime_error("Can't write batch log " + path);
+  }
+}
+
+void BatchLogWriter::Write(const BatchSim &sim) {
+  if (sim.Size() != frame_.size()) {
+    throw std::invalid_argument("Batch log was opened for a different number of worlds");
+  }
+  for (size_t i = 0; i < frame_.size(); ++i) {
+    const WheelConfig wheels = sim.Wheels(i);
+    frame_[i] = {static_cast<float>(sim.X()[i]), static_cast<float>(sim.Y()[i]),
+                 static_cast<float>(sim.Theta()[i]), static_cast<float>(wheels.left),
+                 static_cast<float>(wheels.right)};
+  }
+  const uint64_t step = sim.Steps();
+  out_.write(reinterpret_cast<const char *>(&step), sizeof(step));
+  out_.write(reinterpret_cast<const char *>(frame_.data()),
+             static_cast<std::streamsize>(frame_.size() * sizeof(BatchLogRecord)));
+  if (!out_) {
+    throw std::runtime_error("Can't write batch log frame");
+  }
+}
+
+BatchLog ReadBatchLog(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open batch log " + path);
+  }
+  BatchLogHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || !std::equal(std::begin(header.magic), std::end(header.magic),
+                         std::begin(kBatchLogMagic))) {
+    throw std::runtime_error("Not a batch log file");
+  }
+  if (header.version != kBatchLogVersion || header.record_size != sizeof(BatchLogRecord)) {
+    throw std::runtime_error("Unknown batch log version");
+  }
+  BatchLog log;
+  log.worlds = header.worlds;
+  uint64_t step = 0;
+  std::vector<BatchLogRecord> frame(header.worlds);
+  while (in.read(reinterpret_cast<char *>(&step), sizeof(step))) {
+    in.read(reinterpret_cast<char *>(frame.data()),
+            static_cast<std::streamsize>(frame.size() * sizeof(BatchLogRecord)));
+    if (!in) {
+      // A frame cut short by a crash of the writer.
+      break;
+    }
+    log.steps.push_back(step);
+    log.records.insert(log.records.end(), frame.begin(), frame.end());
+  }
+  return log;
+}
+
+} // namespace turtlelib
@@ -0,0 +1,68 @@
+//! @file Batch Monte Carlo trials of the diff drive robot, without ROS.
+//! @brief Runs many randomized worlds at once and logs them to a binary file.
+// Usage: batch_sim <worlds> <steps> <log_path> [log_every] [threads] [seed]
+//  worlds - number of independent worlds
+//  steps - number of 5 ms steps to run
+//  log_path - batch log output, read back with turtlelib::ReadBatchLog
+//  log_every - log a frame every this many steps, default 20
+//  threads - worker threads, 0 for all cores (default)
+//  seed - seed of the commands and of the noise, default 0
+// Each world drives a random constant wheel command, with the noise nusim gets
+// in start_robot.launch.xml.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "turtlelib/batch_sim.hpp"
+#include "turtlelib/worker_pool.hpp"
+
+using namespace turtlelib;
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <worlds> <steps> <log_path> [log_every] [threads] [seed]\n";
+    return 1;
+  }
+  const size_t worlds = std::stoul(argv[1]);
+  const size_t steps = std::stoul(argv[2]);
+  const std::string log_path = argv[3];
+  const size_t log_every = argc > 4 ? std::max<size_t>(1, std::stoul(argv[4])) : 20;
+  const size_t threads = argc > 5 ? std::stoul(argv[5]) : 0;
+  const uint64_t seed = argc > 6 ? std::stoull(argv[6]) : 0;
+
+  BatchSimParams params;
+  params.input_noise = 0.04;
+  params.slip_fraction = 0.02;
+  params.seed = seed;
+  WorkerPool pool(threads);
+  BatchSim sim(worlds, params, &pool);
+
+  // Up to the 6.2 rad/s a turtlebot wheel does.
+  std::mt19937_64 gen(seed);
+  std::uniform_real_distribution<double> wheel(-6.2, 6.2);
+  for (size_t i = 0; i < worlds; ++i) {
+    sim.SetCommand(i, {wheel(gen), wheel(gen)});
+  }
+
+  BatchLogWriter log(log_path, worlds);
+  log.Write(sim);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t step = 1; step <= steps; ++step) {
+    sim.Step();
+    if (step % log_every == 0) {
+      log.Write(sim);
+    }
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << worlds << " worlds x " << steps << " steps on " << pool.Size() << " threads in "
+            << seconds << " s, " << static_cast<double>(worlds * steps) / seconds
+            << " world steps/s\n";
+  return 0;
+}
@@ -0,0 +1,258 @@
+#include "turtlelib/circle_fit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "turtlelib/simd.hpp"
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief Second and third order moments of centered points, z = x^2 + y^2.
+struct Moments {
+  double xx = 0.0;
+  double yy = 0.0;
+  double xy = 0.0;
+  double xz = 0.0;
+  double yz = 0.0;
+  double zz = 0.0;
+};
+
+using simd::HorizontalSum;
+using simd::kLanes;
+using simd::Lanes;
+using simd::Load;
+using simd::Splat;
+
+void SumPoints(const double *x, const double *y, size_t n, double &sum_x, double &sum_y) {
+  Lanes acc_x = Splat(0.0);
+  Lanes acc_y = Splat(0.0);
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    acc_x += Load(x + i);
+    acc_y += Load(y + i);
+  }
+  sum_x = HorizontalSum(acc_x);
+  sum_y = HorizontalSum(acc_y);
+  for (; i < n; ++i) {
+    sum_x += x[i];
+    sum_y += y[i];
+  }
+}
+
+Moments CenteredMoments(const double *x, const double *y, size_t n, double mean_x,
+                        double mean_y) {
+  Lanes xx = Splat(0.0), yy = Splat(0.0), xy = Splat(0.0);
+  Lanes xz = Splat(0.0), yz = Splat(0.0), zz = Splat(0.0);
+  const Lanes mx = Splat(mean_x);
+  const Lanes my = Splat(mean_y);
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const Lanes cx = Load(x + i) - mx;
+    const Lanes cy = Load(y + i) - my;
+    const Lanes cz = cx * cx + cy * cy;
+    xx += cx * cx;
+    yy += cy * cy;
+    xy += cx * cy;
+    xz += cx * cz;
+    yz += cy * cz;
+    zz += cz * cz;
+  }
+  Moments m{HorizontalSum(xx), HorizontalSum(yy), HorizontalSum(xy),
+            HorizontalSum(xz), HorizontalSum(yz), HorizontalSum(zz)};
+  for (; i < n; ++i) {
+    const double cx = x[i] - mean_x;
+    const double cy = y[i] - mean_y;
+    const double cz = cx * cx + cy * cy;
+    m.xx += cx * cx;
+    m.yy += cy * cy;
+    m.xy += cx * cy;
+    m.xz += cx * cz;
+    m.yz += cy * cz;
+    m.zz += cz * cz;
+  }
+  return m;
+}
+
+constexpr double kFullCircleTolerance = 1e-6;
+
+} // namespace
+
+CircleFit FitCircle(const double *x, const double *y, size_t n) {
+  if (n < 3) {
+    throw std::invalid_argument("FitCircle needs at least 3 points");
+  }
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  SumPoints(x, y, n, sum_x, sum_y);
+  const double mean_x = sum_x / n;
+  const double mean_y = sum_y / n;
+
+  auto m = CenteredMoments(x, y, n, mean_x, mean_y);
+  m.xx /= n;
+  m.yy /= n;
+  m.xy /= n;
+  m.xz /= n;
+  m.yz /= n;
+  m.zz /= n;
+
+  // ############# Begin Citation [8]#############
+  // Taubin fit, solved with Newton's method on its characteristic polynomial.
+  const double m_z = m.xx + m.yy;
+  const double cov_xy = m.xx * m.yy - m.xy * m.xy;
+  const double var_z = m.zz - m_z * m_z;
+  const double a3 = 4.0 * m_z;
+  const double a2 = -3.0 * m_z * m_z - m.zz;
+  const double a1 = var_z * m_z + 4.0 * cov_xy * m_z - m.xz * m.xz - m.yz * m.yz;
+  const double a0 = m.xz * (m.xz * m.yy - m.yz * m.xy) + m.yz * (m.yz * m.xx - m.xz * m.xy) -
+                    var_z * cov_xy;
+
+  double root = 0.0;
+  double poly = a0;
+  for (int iter = 0; iter < 99; ++iter) {
+    const double d_poly = a1 + root * (2.0 * a2 + 3.0 * a3 * root);
+    const double next_root = root - poly / d_poly;
+    if (next_root == root || !std::isfinite(next_root)) {
+      break;
+    }
+    const double next_poly = a0 + next_root * (a1 + next_root * (a2 + next_root * a3));
+    if (std::abs(next_poly) >= std::abs(poly)) {
+      break;
+    }
+    root = next_root;
+    poly = next_poly;
+  }
+
+  const double det = root * root - root * m_z + cov_xy;
+  if (det == 0.0 || !std::isfinite(det)) {
+    throw std::domain_error("Points are on a line, no circle fits");
+  }
+  const double center_x = (m.xz * (m.yy - root) - m.yz * m.xy) / det / 2.0;
+  const double center_y = (m.yz * (m.xx - root) - m.xz * m.xy) / det / 2.0;
+  // ############# End Citation [8]#############
+
+  CircleFit fit;
+  fit.center = {center_x + mean_x, center_y + mean_y};
+  fit.radius = std::sqrt(center_x * center_x + center_y * center_y + m_z);
+
+  double residual_sq = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const double residual = std::hypot(x[i] - fit.center.x, y[i] - fit.center.y) - fit.radius;
+    residual_sq += residual * residual;
+  }
+  fit.rms_residual = std::sqrt(residual_sq / n);
+  return fit;
+}
+
+LandmarkDetector::LandmarkDetector(LandmarkDetectorParams params) : params_(params) {}
+
+void LandmarkDetector::UpdateAngleTable(size_t count, double angle_min, double angle_increment) {
+  if (cos_table_.size() == count && table_angle_min_ == angle_min &&
+      table_angle_increment_ == angle_increment) {
+    return;
+  }
+  cos_table_.resize(count);
+  sin_table_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const double angle = angle_min + angle_increment * i;
+    cos_table_.at(i) = std::cos(angle);
+    sin_table_.at(i) = std::sin(angle);
+  }
+  table_angle_min_ = angle_min;
+  table_angle_increment_ = angle_increment;
+}
+
+const std::vector<DetectedLandmark> &
+LandmarkDetector::Detect(const std::vector<float> &ranges, double angle_min,
+                         double angle_increment, double range_min, double range_max) {
+  points_x_.clear();
+  points_y_.clear();
+  clusters_.clear();
+  landmarks_.clear();
+  const size_t count = ranges.size();
+  if (count == 0) {
+    return landmarks_;
+  }
+  UpdateAngleTable(count, angle_min, angle_increment);
+
+  auto valid = [&](size_t i) {
+    return std::isfinite(ranges[i]) && ranges[i] >= range_min && ranges[i] < range_max;
+  };
+  auto point_x = [&](size_t i) { return ranges[i] * cos_table_[i]; };
+  auto point_y = [&](size_t i) { return ranges[i] * sin_table_[i]; };
+  const double threshold_sq = params_.cluster_threshold * params_.cluster_threshold;
+  // Whether beam i continues the cluster of beam i - 1.
+  auto connected = [&](size_t prev, size_t i) {
+    if (!valid(prev) || !valid(i)) {
+      return false;
+    }
+    const double dx = point_x(i) - point_x(prev);
+    const double dy = point_y(i) - point_y(prev);
+    return dx * dx + dy * dy <= threshold_sq;
+  };
+
+  // On a full circle scan, start at a break so no cluster straddles the end.
+  const bool full_circle =
+      std::abs(angle_increment) * count >= 2.0 * PI - kFullCircleTolerance;
+  size_t start = 0;
+  if (full_circle) {
+    for (size_t i = 0; i < count; ++i) {
+      if (!connected((i + count - 1) % count, i)) {
+        start = i;
+        break;
+      }
+    }
+  }
+
+  for (size_t k = 0; k < count; ++k) {
+    const size_t i = (start + k) % count;
+    if (!valid(i)) {
+      continue;
+    }
+    const bool joins = k > 0 && connected((i + count - 1) % count, i);
+    if (!joins || clusters_.empty()) {
+      clusters_.push_back({points_x_.size(), points_x_.size()});
+    }
+    points_x_.push_back(point_x(i));
+    points_y_.push_back(point_y(i));
+    clusters_.back().end = points_x_.size();
+  }
+
+  for (const auto &cluster : clusters_) {
+    const size_t n = cluster.end - cluster.begin;
+    if (n < std::max<size_t>(3, params_.min_cluster_points)) {
+      continue;
+    }
+    CircleFit fit;
+    try {
+      fit = FitCircle(points_x_.data() + cluster.begin, points_y_.data() + cluster.begin, n);
+    } catch (const std::domain_error &) {
+      // A straight wall.
+      continue;
+    }
+    if (fit.radius < params_.min_radius || fit.radius > params_.max_radius ||
+        fit.rms_residual > params_.max_rms_residual) {
+      continue;
+    }
+    // A cylinder is seen from outside, so its center lies beyond the points.
+    // A circle fitted to a concave corner has its center on the near side.
+    const double center_range = std::hypot(fit.center.x, fit.center.y);
+    const auto &mid_x = points_x_.at(cluster.begin + n / 2);
+    const auto &mid_y = points_y_.at(cluster.begin + n / 2);
+    if (center_range <= std::hypot(mid_x, mid_y)) {
+      continue;
+    }
+    landmarks_.push_back({fit, center_range, std::atan2(fit.center.y, fit.center.x), n});
+  }
+  return landmarks_;
+}
+
+const std::vector<PointCluster> &LandmarkDetector::Clusters() const { return clusters_; }
+
+const std::vector<double> &LandmarkDetector::PointsX() const { return points_x_; }
+
+const std::vector<double> &LandmarkDetector::PointsY() const { return points_y_; }
+
+} // namespace turtlelib
@@ -0,0 +1,94 @@
+#include "turtlelib/event_scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace turtlelib {
+
+namespace {
+constexpr uint32_t kDeliver = 0;
+constexpr uint32_t kSample = 1;
+} // namespace
+
+size_t EventScheduler::AddStream(const EventStreamConfig &config, Callback on_sample,
+                                 Callback on_deliver) {
+  if (config.period.count() <= 0 || config.latency.count() < 0) {
+    throw std::invalid_argument("Event stream needs a positive period and no negative latency");
+  }
+  // First sample not before now: phase + k * period >= now.
+  auto first = config.phase;
+  if (first < now_) {
+    first += ((now_ - first + config.period - std::chrono::nanoseconds{1}) / config.period) *
+             config.period;
+  }
+
+  streams_.push_back({config, std::move(on_sample), std::move(on_deliver)});
+  // At most one pending sample, plus the deliveries still in flight.
+  size_t events = 0;
+  for (const auto &stream : streams_) {
+    events += 1;
+    if (stream.on_deliver) {
+      events += static_cast<size_t>(stream.config.latency / stream.config.period) + 1;
+    }
+  }
+  queue_.reserve(events);
+  Push({first, static_cast<uint32_t>(streams_.size() - 1), kSample, first});
+  return streams_.size() - 1;
+}
+
+std::chrono::nanoseconds EventScheduler::NextEventTime() const {
+  if (queue_.empty()) {
+    return std::chrono::nanoseconds::max();
+  }
+  return queue_.front().time;
+}
+
+size_t EventScheduler::RunUntil(std::chrono::nanoseconds time) {
+  size_t count = 0;
+  while (!queue_.empty() && queue_.front().time <= time) {
+    std::pop_heap(queue_.begin(), queue_.end(), Later);
+    const Event event = queue_.back();
+    queue_.pop_back();
+    now_ = std::max(now_, event.time);
+    const Stream &stream = streams_[event.stream];
+    if (event.kind == kSample) {
+      // Queue the next sample and the delivery before running the callback,
+      // so a callback calling RunUntil sees a consistent queue.
+      Push({event.time + stream.config.period, event.stream, kSample,
+            event.time + stream.config.period});
+      if (stream.on_deliver) {
+        Push({event.time + stream.config.latency, event.stream, kDeliver, event.time});
+      }
+      stream.on_sample(event.sample_time);
+    } else {
+      stream.on_deliver(event.sample_time);
+    }
+    ++count;
+  }
+  now_ = std::max(now_, time);
+  return count;
+}
+
+std::chrono::nanoseconds EventScheduler::Now() const { return now_; }
+
+size_t EventScheduler::Pending() const { return queue_.size(); }
+
+size_t EventScheduler::Capacity() const { return queue_.capacity(); }
+
+bool EventScheduler::Later(const Event &a, const Event &b) {
+  if (a.time != b.time) {
+    return a.time > b.time;
+  }
+  if (a.stream != b.stream) {
+    return a.stream > b.stream;
+  }
+  return a.kind > b.kind;
+}
+
+void EventScheduler::Push(const Event &event) {
+  queue_.push_back(event);
+  std::push_heap(queue_.begin(), queue_.end(), Later);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,100 @@
+#include "turtlelib/flight_recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace turtlelib {
+
+void *MapFlightRecord(const std::string &path, size_t bytes) {
+  void *memory = MAP_FAILED;
+  if (path.empty()) {
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Can't open flight record file " + path);
+    }
+    // A fresh truncated file reads as zeros, so every slot starts empty.
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+      close(fd);
+      throw std::runtime_error("Can't size flight record file " + path);
+    }
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the file alive.
+    close(fd);
+  }
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Can't map flight record memory");
+  }
+  return memory;
+}
+
+void UnmapFlightRecord(void *memory, size_t bytes) { munmap(memory, bytes); }
+
+void WriteFlightRecordFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+  if (!out) {
+    throw std::runtime_error("Can't write flight record dump " + path);
+  }
+}
+
+std::vector<std::vector<uint8_t>> ReadFlightRecordRaw(const std::string &path,
+                                                      size_t record_size) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open flight record file " + path);
+  }
+  const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+
+  FlightRecordHeader header{};
+  if (bytes.size() < sizeof(header)) {
+    throw std::runtime_error("Flight record file is too short");
+  }
+  std::copy_n(bytes.begin(), sizeof(header), reinterpret_cast<uint8_t *>(&header));
+  if (!std::equal(std::begin(header.magic), std::end(header.magic),
+                  std::begin(kFlightRecordMagic))) {
+    throw std::runtime_error("Not a flight record file");
+  }
+  if (header.version != kFlightRecordVersion) {
+    throw std::runtime_error("Unknown flight record version");
+  }
+  if (header.record_size != record_size) {
+    throw std::runtime_error("Flight record holds a different record type");
+  }
+  const size_t slot_size = sizeof(uint64_t) + (record_size + 7) / 8 * 8;
+  if (bytes.size() < sizeof(header) + header.capacity * slot_size) {
+    throw std::runtime_error("Flight record file is truncated");
+  }
+
+  // Slots of a live file are in ring order, sort them by sequence.
+  std::vector<std::pair<uint64_t, size_t>> slots;
+  for (size_t i = 0; i < header.capacity; ++i) {
+    const size_t offset = sizeof(header) + i * slot_size;
+    uint64_t sequence = 0;
+    std::copy_n(bytes.begin() + offset, sizeof(sequence), reinterpret_cast<uint8_t *>(&sequence));
+    // 0 never written, odd was being written when the file was read.
+    if (sequence != 0 && sequence % 2 == 0) {
+      slots.emplace_back(sequence, offset + sizeof(uint64_t));
+    }
+  }
+  std::sort(slots.begin(), slots.end());
+
+  std::vector<std::vector<uint8_t>> records;
+  for (const auto &slot : slots) {
+    const auto start = bytes.begin() + slot.second;
+    records.emplace_back(start, start + record_size);
+  }
+  return records;
+}
+
+} // namespace turtlelib
@@ -1,5 +1,6 @@
 #include "turtlelib/geometry2d.hpp"
 #include <iostream>
+#include <limits>
 
 namespace turtlelib {
 
@@ -116,4 +117,34 @@ double angle(const Vector2D &v1, const Vector2D &v2) {
   // ############# End Citation [3]#############
 }
 
+double RayCircleDistance(Point2D origin, Vector2D direction, Point2D center, double radius) {
+  const Vector2D v = center - origin;
+  const double v2 = dot(v, v);
+  if (v2 <= radius * radius) {
+    return std::numeric_limits<double>::infinity();
+  }
+  // ############# Begin Citation [6]#############
+  const double proj = dot(v, direction);
+  const double half_chord_sq = radius * radius - v2 + proj * proj;
+  // ############# End Citation [6]#############
+  if (half_chord_sq < 0.0 || proj < 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return proj - std::sqrt(half_chord_sq);
+}
+
+double RaySegmentDistance(Point2D origin, Vector2D direction, const Segment2D &segment) {
+  // ############# Begin Citation [7]#############
+  const Vector2D e = segment.b - segment.a;
+  const Vector2D w = segment.a - origin;
+  const double denom = direction.x * e.y - direction.y * e.x;
+  if (denom == 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double t = (w.x * e.y - w.y * e.x) / denom;
+  const double u = (w.x * direction.y - w.y * direction.x) / denom;
+  // ############# End Citation [7]#############
+  return t >= 0.0 && u >= 0.0 && u <= 1.0 ? t : std::numeric_limits<double>::infinity();
+}
+
 } // namespace turtlelib
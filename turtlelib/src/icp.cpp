@@ -0,0 +1,225 @@
+#include "turtlelib/icp.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "turtlelib/simd.hpp"
+
+namespace turtlelib {
+
+namespace {
+
+using simd::HorizontalSum;
+using simd::kLanes;
+using simd::Lanes;
+using simd::Load;
+using simd::Splat;
+
+//! @brief Point to line pairs of one iteration, one array per field.
+struct Pairs {
+  std::vector<double> px, py; // scan point moved by the current guess
+  std::vector<double> qx, qy; // matched reference point
+  std::vector<double> nx, ny; // line normal at the reference point
+
+  void Clear() {
+    for (auto *v : {&px, &py, &qx, &qy, &nx, &ny}) {
+      v->clear();
+    }
+  }
+  size_t Size() const { return px.size(); }
+};
+
+//! @brief Gauss-Newton normal equations over [tx ty theta], H is symmetric.
+struct NormalEquations {
+  double h_xx = 0.0, h_xy = 0.0, h_xt = 0.0, h_yy = 0.0, h_yt = 0.0, h_tt = 0.0;
+  double g_x = 0.0, g_y = 0.0, g_t = 0.0;
+  double sq_error = 0.0;
+
+  //! @brief Add the terms of one pair with residual r and Jacobian [nx ny j].
+  void Add(double nx, double ny, double j, double r) {
+    h_xx += nx * nx;
+    h_xy += nx * ny;
+    h_xt += nx * j;
+    h_yy += ny * ny;
+    h_yt += ny * j;
+    h_tt += j * j;
+    g_x += nx * r;
+    g_y += ny * r;
+    g_t += j * r;
+    sq_error += r * r;
+  }
+};
+
+//! @brief Residuals and Jacobians of every pair, summed into the normal equations.
+//! Residual r = n . (p - q). Moving the scan by a small [dx dy dtheta] changes
+//! p by [dx - dtheta * py, dy + dtheta * px], so the Jacobian is
+//! [nx, ny, ny * px - nx * py].
+NormalEquations Accumulate(const Pairs &pairs) {
+  const size_t n = pairs.Size();
+  Lanes h_xx = Splat(0.0), h_xy = Splat(0.0), h_xt = Splat(0.0);
+  Lanes h_yy = Splat(0.0), h_yt = Splat(0.0), h_tt = Splat(0.0);
+  Lanes g_x = Splat(0.0), g_y = Splat(0.0), g_t = Splat(0.0);
+  Lanes sq_error = Splat(0.0);
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const Lanes px = Load(pairs.px.data() + i);
+    const Lanes py = Load(pairs.py.data() + i);
+    const Lanes nx = Load(pairs.nx.data() + i);
+    const Lanes ny = Load(pairs.ny.data() + i);
+    const Lanes r = nx * (px - Load(pairs.qx.data() + i)) + ny * (py - Load(pairs.qy.data() + i));
+    const Lanes j = ny * px - nx * py;
+    h_xx += nx * nx;
+    h_xy += nx * ny;
+    h_xt += nx * j;
+    h_yy += ny * ny;
+    h_yt += ny * j;
+    h_tt += j * j;
+    g_x += nx * r;
+    g_y += ny * r;
+    g_t += j * r;
+    sq_error += r * r;
+  }
+  NormalEquations eq{HorizontalSum(h_xx), HorizontalSum(h_xy), HorizontalSum(h_xt),
+                     HorizontalSum(h_yy), HorizontalSum(h_yt), HorizontalSum(h_tt),
+                     HorizontalSum(g_x),  HorizontalSum(g_y),  HorizontalSum(g_t),
+                     HorizontalSum(sq_error)};
+  for (; i < n; ++i) {
+    const double nx = pairs.nx[i];
+    const double ny = pairs.ny[i];
+    const double r = nx * (pairs.px[i] - pairs.qx[i]) + ny * (pairs.py[i] - pairs.qy[i]);
+    eq.Add(nx, ny, ny * pairs.px[i] - nx * pairs.py[i], r);
+  }
+  return eq;
+}
+
+//! @brief Solve H * step = -g with Cramer's rule, false when H is singular.
+bool SolveStep(const NormalEquations &eq, double &dx, double &dy, double &dtheta) {
+  const double a = eq.h_xx, b = eq.h_xy, c = eq.h_xt, d = eq.h_yy, e = eq.h_yt, f = eq.h_tt;
+  const double det = a * (d * f - e * e) - b * (b * f - c * e) + c * (b * e - c * d);
+  if (std::abs(det) < 1e-12) {
+    return false;
+  }
+  const double r0 = -eq.g_x, r1 = -eq.g_y, r2 = -eq.g_t;
+  dx = (r0 * (d * f - e * e) - b * (r1 * f - e * r2) + c * (r1 * e - d * r2)) / det;
+  dy = (a * (r1 * f - e * r2) - r0 * (b * f - c * e) + c * (b * r2 - r1 * c)) / det;
+  dtheta = (a * (d * r2 - r1 * e) - b * (b * r2 - r1 * c) + r0 * (b * e - c * d)) / det;
+  return true;
+}
+
+} // namespace
+
+void ScanToPoints(const std::vector<float> &ranges, double angle_min, double angle_increment,
+                  double range_min, double range_max, std::vector<double> &x,
+                  std::vector<double> &y) {
+  x.clear();
+  y.clear();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const double range = ranges[i];
+    if (!std::isfinite(range) || range < range_min || range >= range_max) {
+      continue;
+    }
+    const double angle = angle_min + angle_increment * i;
+    x.push_back(range * std::cos(angle));
+    y.push_back(range * std::sin(angle));
+  }
+}
+
+ScanMatcher::ScanMatcher(IcpParams params) : params_(params) {}
+
+void ScanMatcher::SetReference(const std::vector<double> &x, const std::vector<double> &y) {
+  if (x.size() != y.size()) {
+    throw std::invalid_argument("Reference needs as many x as y");
+  }
+  ref_x_ = x;
+  ref_y_ = y;
+  tree_.Build(ref_x_, ref_y_);
+
+  // The line at a point runs through its neighbours in beam order, as long as
+  // they are close, i.e. on the same surface.
+  const size_t n = x.size();
+  const double max_sq = params_.max_neighbour_distance * params_.max_neighbour_distance;
+  auto close = [&](size_t a, size_t b) {
+    const double dx = x[a] - x[b];
+    const double dy = y[a] - y[b];
+    return dx * dx + dy * dy <= max_sq;
+  };
+  normal_x_.assign(n, 0.0);
+  normal_y_.assign(n, 0.0);
+  for (size_t i = 0; i < n; ++i) {
+    const size_t prev = (i > 0 && close(i, i - 1)) ? i - 1 : i;
+    const size_t next = (i + 1 < n && close(i, i + 1)) ? i + 1 : i;
+    const double dx = x[next] - x[prev];
+    const double dy = y[next] - y[prev];
+    const double length = std::hypot(dx, dy);
+    if (prev == next || length == 0.0) {
+      continue;
+    }
+    normal_x_[i] = -dy / length;
+    normal_y_[i] = dx / length;
+  }
+}
+
+bool ScanMatcher::HasReference() const { return tree_.Size() > 0; }
+
+IcpResult ScanMatcher::Match(const std::vector<double> &x, const std::vector<double> &y,
+                             const Transform2D &initial_guess) const {
+  if (x.size() != y.size()) {
+    throw std::invalid_argument("Scan needs as many x as y");
+  }
+  IcpResult result;
+  result.T_ref_scan = initial_guess;
+  if (!HasReference()) {
+    return result;
+  }
+
+  Pairs pairs;
+  for (auto *v : {&pairs.px, &pairs.py, &pairs.qx, &pairs.qy, &pairs.nx, &pairs.ny}) {
+    v->reserve(x.size());
+  }
+
+  for (size_t iter = 0; iter < params_.max_iterations; ++iter) {
+    result.iterations = iter + 1;
+    pairs.Clear();
+    for (size_t i = 0; i < x.size(); ++i) {
+      const Point2D p = result.T_ref_scan(Point2D{x[i], y[i]});
+      const size_t match = tree_.Nearest(p, params_.max_correspondence_distance);
+      if (match == KdTree2D::kNone || (normal_x_[match] == 0.0 && normal_y_[match] == 0.0)) {
+        continue;
+      }
+      pairs.px.push_back(p.x);
+      pairs.py.push_back(p.y);
+      pairs.qx.push_back(ref_x_[match]);
+      pairs.qy.push_back(ref_y_[match]);
+      pairs.nx.push_back(normal_x_[match]);
+      pairs.ny.push_back(normal_y_[match]);
+    }
+    result.correspondences = pairs.Size();
+    if (pairs.Size() < std::max<size_t>(3, params_.min_correspondences)) {
+      result.valid = false;
+      return result;
+    }
+
+    const auto eq = Accumulate(pairs);
+    result.rms_error = std::sqrt(eq.sq_error / pairs.Size());
+    double dx = 0.0;
+    double dy = 0.0;
+    double dtheta = 0.0;
+    if (!SolveStep(eq, dx, dy, dtheta)) {
+      // Everything on one line, the match is not constrained.
+      result.valid = false;
+      return result;
+    }
+    // The step is in the reference frame, so it goes on the left.
+    result.T_ref_scan = Transform2D{{dx, dy}, dtheta} * result.T_ref_scan;
+    result.valid = true;
+    if (std::hypot(dx, dy) < params_.translation_tolerance &&
+        std::abs(dtheta) < params_.rotation_tolerance) {
+      result.converged = true;
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace turtlelib
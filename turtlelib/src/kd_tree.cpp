@@ -0,0 +1,76 @@
+#include "turtlelib/kd_tree.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace turtlelib {
+
+void KdTree2D::Build(const std::vector<double> &x, const std::vector<double> &y) {
+  if (x.size() != y.size()) {
+    throw std::invalid_argument("KdTree2D needs as many x as y");
+  }
+  // Sort a permutation first, then gather the coordinates in tree order.
+  index_.resize(x.size());
+  std::iota(index_.begin(), index_.end(), 0);
+  x_ = x;
+  y_ = y;
+  BuildRange(0, index_.size(), 0);
+  for (size_t i = 0; i < index_.size(); ++i) {
+    x_.at(i) = x.at(index_.at(i));
+    y_.at(i) = y.at(index_.at(i));
+  }
+}
+
+void KdTree2D::BuildRange(size_t begin, size_t end, size_t depth) {
+  if (end - begin <= 1) {
+    return;
+  }
+  const size_t mid = begin + (end - begin) / 2;
+  // x_ and y_ still hold the original order here, index_ is being permuted.
+  const auto &axis = depth % 2 == 0 ? x_ : y_;
+  std::nth_element(index_.begin() + begin, index_.begin() + mid, index_.begin() + end,
+                   [&axis](size_t a, size_t b) { return axis[a] < axis[b]; });
+  BuildRange(begin, mid, depth + 1);
+  BuildRange(mid + 1, end, depth + 1);
+}
+
+size_t KdTree2D::Nearest(Point2D query, double max_distance) const {
+  size_t best = kNone;
+  double best_sq = max_distance * max_distance;
+  Search(0, index_.size(), 0, query, best, best_sq);
+  return best;
+}
+
+size_t KdTree2D::Size() const { return index_.size(); }
+
+void KdTree2D::Search(size_t begin, size_t end, size_t depth, Point2D query, size_t &best,
+                      double &best_sq) const {
+  if (begin >= end) {
+    return;
+  }
+  const size_t mid = begin + (end - begin) / 2;
+  const double dx = query.x - x_[mid];
+  const double dy = query.y - y_[mid];
+  const double d_sq = dx * dx + dy * dy;
+  if (d_sq < best_sq) {
+    best_sq = d_sq;
+    best = index_[mid];
+  }
+  // Descend into the side of the split the query is on first, the other side
+  // only if the splitting line is closer than the best match so far.
+  const double split = depth % 2 == 0 ? dx : dy;
+  if (split < 0.0) {
+    Search(begin, mid, depth + 1, query, best, best_sq);
+    if (split * split < best_sq) {
+      Search(mid + 1, end, depth + 1, query, best, best_sq);
+    }
+  } else {
+    Search(mid + 1, end, depth + 1, query, best, best_sq);
+    if (split * split < best_sq) {
+      Search(begin, mid, depth + 1, query, best, best_sq);
+    }
+  }
+}
+
+} // namespace turtlelib
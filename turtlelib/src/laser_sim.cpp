@@ -0,0 +1,143 @@
+#include "turtlelib/laser_sim.hpp"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "turtlelib/simd.hpp"
+
+namespace turtlelib {
+
+using simd::kLanes;
+using simd::Lanes;
+using simd::Load;
+using simd::Max;
+using simd::Min;
+using simd::Splat;
+using simd::Sqrt;
+using simd::Store;
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+//! @brief t where the beam meets the circle in front of it, infinity elsewhere.
+//! @param half_chord_sq negative when the beam passes the circle
+//! @param t distance to the near intersection
+Lanes CircleHitOrInf(const Lanes &half_chord_sq, const Lanes &t) {
+  Lanes out = t;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out[i] = half_chord_sq[i] >= 0.0 && t[i] >= 0.0 ? t[i] : kInf;
+  }
+  return out;
+}
+
+//! @brief t where the beam meets the segment in front of it, infinity elsewhere.
+//! @param t distance along the beam
+//! @param u position along the segment, in [0, 1] on it. NaN for a parallel beam.
+Lanes SegmentHitOrInf(const Lanes &t, const Lanes &u) {
+  Lanes out = t;
+  for (size_t i = 0; i < kLanes; ++i) {
+    out[i] = t[i] >= 0.0 && u[i] >= 0.0 && u[i] <= 1.0 ? t[i] : kInf;
+  }
+  return out;
+}
+
+} // namespace
+
+LaserSim::LaserSim(double angle_min, double angle_increment, size_t beams, double range_max)
+    : range_max_(range_max), beams_(beams) {
+  if (range_max <= 0.0) {
+    throw std::invalid_argument("LaserSim needs a positive range_max");
+  }
+  const size_t padded = (beams + kLanes - 1) / kLanes * kLanes;
+  body_x_.assign(padded, 1.0);
+  body_y_.assign(padded, 0.0);
+  for (size_t i = 0; i < beams; ++i) {
+    const double angle = angle_min + angle_increment * static_cast<double>(i);
+    body_x_[i] = std::cos(angle);
+    body_y_[i] = std::sin(angle);
+  }
+  dir_x_.resize(padded);
+  dir_y_.resize(padded);
+  nearest_.resize(padded);
+}
+
+size_t LaserSim::Beams() const { return beams_; }
+
+void LaserSim::Rotate(double heading) {
+  const Lanes c = Splat(std::cos(heading));
+  const Lanes s = Splat(std::sin(heading));
+  for (size_t i = 0; i < body_x_.size(); i += kLanes) {
+    const Lanes bx = Load(body_x_.data() + i);
+    const Lanes by = Load(body_y_.data() + i);
+    Store(dir_x_.data() + i, c * bx - s * by);
+    Store(dir_y_.data() + i, s * bx + c * by);
+  }
+}
+
+void LaserSim::Cast(const Transform2D &pose, const std::vector<double> &circle_x,
+                    const std::vector<double> &circle_y, const std::vector<double> &circle_r,
+                    const std::vector<Segment2D> &segments, std::vector<float> &ranges,
+                    float miss) {
+  if (circle_y.size() != circle_x.size() || circle_r.size() != circle_x.size()) {
+    throw std::invalid_argument("Circle x, y and r must be the same length");
+  }
+  const double px = pose.translation().x;
+  const double py = pose.translation().y;
+  Rotate(pose.rotation());
+  const size_t padded = body_x_.size();
+  for (size_t i = 0; i < padded; i += kLanes) {
+    Store(nearest_.data() + i, Splat(kInf));
+  }
+
+  for (size_t k = 0; k < circle_x.size(); ++k) {
+    const double vx = circle_x[k] - px;
+    const double vy = circle_y[k] - py;
+    const double r = circle_r[k];
+    const double v2 = vx * vx + vy * vy;
+    // Out of range for every beam, or around the scanner.
+    if (std::sqrt(v2) - r > range_max_ || v2 <= r * r) {
+      continue;
+    }
+    for (size_t i = 0; i < padded; i += kLanes) {
+      const Lanes dx = Load(dir_x_.data() + i);
+      const Lanes dy = Load(dir_y_.data() + i);
+      // ############# Begin Citation [6]#############
+      // Project scanner to center onto the beam, then the half chord.
+      const Lanes proj = dx * Splat(vx) + dy * Splat(vy);
+      const Lanes half_chord_sq = Splat(r * r - v2) + proj * proj;
+      // ############# End Citation [6]#############
+      const Lanes t = proj - Sqrt(Max(half_chord_sq, Splat(0.0)));
+      Store(nearest_.data() + i,
+            Min(Load(nearest_.data() + i), CircleHitOrInf(half_chord_sq, t)));
+    }
+  }
+
+  for (const auto &segment : segments) {
+    // ############# Begin Citation [7]#############
+    // p + t d = a + u e, solved with cross products.
+    const double ex = segment.b.x - segment.a.x;
+    const double ey = segment.b.y - segment.a.y;
+    const double wx = segment.a.x - px;
+    const double wy = segment.a.y - py;
+    const double w_cross_e = wx * ey - wy * ex;
+    for (size_t i = 0; i < padded; i += kLanes) {
+      const Lanes dx = Load(dir_x_.data() + i);
+      const Lanes dy = Load(dir_y_.data() + i);
+      // A parallel beam divides by 0, its u is NaN or infinite and never hits.
+      const Lanes denom = dx * Splat(ey) - dy * Splat(ex);
+      const Lanes t = Splat(w_cross_e) / denom;
+      const Lanes u = (Splat(wx) * dy - Splat(wy) * dx) / denom;
+      // ############# End Citation [7]#############
+      Store(nearest_.data() + i, Min(Load(nearest_.data() + i), SegmentHitOrInf(t, u)));
+    }
+  }
+
+  ranges.resize(beams_);
+  for (size_t i = 0; i < beams_; ++i) {
+    ranges[i] = nearest_[i] <= range_max_ ? static_cast<float>(nearest_[i]) : miss;
+  }
+}
+
+} // namespace turtlelib
@@ -0,0 +1,133 @@
+#include "turtlelib/likelihood_field.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace turtlelib {
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+// ############# Begin Citation [9]#############
+//! @brief 1D squared distance transform of a sampled function, in place.
+//! The lower envelope of the parabolas rooted at each sample.
+//! @param f samples, replaced by the transform. Read with a stride.
+//! @param n number of samples
+//! @param stride distance between samples in f
+//! @param d, v, z scratch buffers, of at least n, n and n + 1 elements
+void Transform1D(double *f, size_t n, size_t stride, std::vector<double> &d,
+                 std::vector<size_t> &v, std::vector<double> &z) {
+  size_t k = 0;
+  size_t first = 0;
+  // Infinite samples have no parabola, skip to the first finite one.
+  while (first < n && f[first * stride] == kInf) {
+    ++first;
+  }
+  if (first == n) {
+    return;
+  }
+  v[0] = first;
+  z[0] = -kInf;
+  z[1] = kInf;
+  for (size_t q = first + 1; q < n; ++q) {
+    const double fq = f[q * stride];
+    if (fq == kInf) {
+      continue;
+    }
+    auto intersect = [&](size_t p) {
+      const double qd = static_cast<double>(q);
+      const double pd = static_cast<double>(p);
+      return ((fq + qd * qd) - (f[p * stride] + pd * pd)) / (2.0 * qd - 2.0 * pd);
+    };
+    // z[0] is -inf, so k never goes below 0.
+    double s = intersect(v[k]);
+    while (s <= z[k]) {
+      --k;
+      s = intersect(v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = kInf;
+  }
+  k = 0;
+  for (size_t q = 0; q < n; ++q) {
+    while (z[k + 1] < static_cast<double>(q)) {
+      ++k;
+    }
+    const double diff = static_cast<double>(q) - static_cast<double>(v[k]);
+    d[q] = diff * diff + f[v[k] * stride];
+  }
+  for (size_t q = 0; q < n; ++q) {
+    f[q * stride] = d[q];
+  }
+}
+// ############# End Citation [9]#############
+
+} // namespace
+
+std::vector<double> SquaredDistanceTransform(const std::vector<uint8_t> &occupied, size_t width,
+                                             size_t height) {
+  if (occupied.size() != width * height) {
+    throw std::invalid_argument("Distance transform needs width * height cells");
+  }
+  std::vector<double> out(occupied.size());
+  for (size_t i = 0; i < occupied.size(); ++i) {
+    out[i] = occupied[i] ? 0.0 : kInf;
+  }
+  const size_t longest = std::max(width, height);
+  std::vector<double> d(longest + 1);
+  std::vector<size_t> v(longest + 1);
+  std::vector<double> z(longest + 2);
+  // Columns first, then rows, the transform is separable.
+  for (size_t x = 0; x < width; ++x) {
+    Transform1D(out.data() + x, height, width, d, v, z);
+  }
+  for (size_t y = 0; y < height; ++y) {
+    Transform1D(out.data() + y * width, width, 1, d, v, z);
+  }
+  return out;
+}
+
+LikelihoodField::LikelihoodField(const std::vector<uint8_t> &occupied, size_t width,
+                                 size_t height, double resolution, Point2D origin,
+                                 LikelihoodFieldParams params)
+    : width_(width), height_(height), inv_resolution_(1.0 / resolution), origin_(origin) {
+  if (resolution <= 0.0 || params.sigma_hit <= 0.0 || params.max_range <= 0.0) {
+    throw std::invalid_argument("Likelihood field needs positive resolution, sigma and range");
+  }
+  const auto squared = SquaredDistanceTransform(occupied, width, height);
+  const double random = params.z_rand / params.max_range;
+  const double hit_scale = params.z_hit / (std::sqrt(2.0 * PI) * params.sigma_hit);
+  outside_ = static_cast<float>(std::log(random));
+  distance_.resize(squared.size());
+  log_likelihood_.resize(squared.size());
+  for (size_t i = 0; i < squared.size(); ++i) {
+    const double dist = std::sqrt(squared[i]) * resolution;
+    const double hit =
+        hit_scale * std::exp(-0.5 * dist * dist / (params.sigma_hit * params.sigma_hit));
+    distance_[i] = static_cast<float>(dist);
+    log_likelihood_[i] = static_cast<float>(std::log(hit + random));
+  }
+}
+
+double LikelihoodField::Distance(Point2D p) const {
+  const double fx = (p.x - origin_.x) * inv_resolution_;
+  const double fy = (p.y - origin_.y) * inv_resolution_;
+  if (!(fx >= 0.0 && fy >= 0.0 && fx < width_ && fy < height_)) {
+    return kInf;
+  }
+  return distance_[static_cast<size_t>(fy) * width_ + static_cast<size_t>(fx)];
+}
+
+size_t LikelihoodField::Width() const { return width_; }
+
+size_t LikelihoodField::Height() const { return height_; }
+
+double LikelihoodField::Resolution() const { return 1.0 / inv_resolution_; }
+
+Point2D LikelihoodField::Origin() const { return origin_; }
+
+} // namespace turtlelib
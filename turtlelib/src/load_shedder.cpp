@@ -0,0 +1,57 @@
+#include "turtlelib/load_shedder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace turtlelib {
+
+LoadShedder::LoadShedder(const LoadShedParams &params) : params_(params) {
+  if (params_.budget.count() <= 0) {
+    throw std::invalid_argument("Load shedding needs a positive budget");
+  }
+  if (!(params_.smoothing > 0.0 && params_.smoothing <= 1.0)) {
+    throw std::invalid_argument("Load shedding smoothing must be in (0, 1]");
+  }
+  if (!(params_.restore_load < params_.shed_load)) {
+    throw std::invalid_argument("Load shedding restore_load must be under shed_load");
+  }
+}
+
+size_t LoadShedder::Record(std::chrono::nanoseconds tick) {
+  const double load =
+      static_cast<double>(tick.count()) / static_cast<double>(params_.budget.count());
+  // The first tick seeds the average, so a slow start sheds without first
+  // climbing up from 0.
+  load_ = ticks_ == 0 ? load : load_ + params_.smoothing * (load - load_);
+  ++ticks_;
+  if (tick > params_.budget) {
+    ++overruns_;
+  }
+  worst_ = std::max(worst_, tick);
+
+  // Only a load staying out of the band between the two thresholds moves the level.
+  over_ = load_ > params_.shed_load ? over_ + 1 : 0;
+  under_ = load_ < params_.restore_load ? under_ + 1 : 0;
+  if (over_ >= params_.shed_hold && level_ < params_.max_level) {
+    ++level_;
+    over_ = 0;
+  } else if (under_ >= params_.restore_hold && level_ > 0) {
+    --level_;
+    under_ = 0;
+  }
+  return level_;
+}
+
+size_t LoadShedder::Level() const { return level_; }
+
+double LoadShedder::Load() const { return load_; }
+
+uint64_t LoadShedder::Ticks() const { return ticks_; }
+
+uint64_t LoadShedder::Overruns() const { return overruns_; }
+
+std::chrono::nanoseconds LoadShedder::WorstTick() const { return worst_; }
+
+const LoadShedParams &LoadShedder::Params() const { return params_; }
+
+} // namespace turtlelib
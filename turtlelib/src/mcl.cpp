@@ -0,0 +1,270 @@
+#include "turtlelib/mcl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "turtlelib/simd.hpp"
+
+namespace turtlelib {
+
+using simd::kLanes;
+using simd::Lanes;
+using simd::Load;
+using simd::Splat;
+using simd::Store;
+
+ParticleFilter::ParticleFilter(std::shared_ptr<const LikelihoodField> field, MclParams params,
+                               WorkerPool *pool)
+    : field_(std::move(field)), params_(params), pool_(pool), gen_(params.seed) {
+  if (!field_) {
+    throw std::invalid_argument("ParticleFilter needs a likelihood field");
+  }
+  if (params_.min_particles == 0 || params_.max_particles < params_.min_particles) {
+    throw std::invalid_argument("ParticleFilter needs 0 < min_particles <= max_particles");
+  }
+  if (!(params_.kld_error > 0.0) || !std::isfinite(params_.kld_z)) {
+    throw std::invalid_argument("ParticleFilter needs a positive kld_error and a finite kld_z");
+  }
+  if (!(params_.bin_size_xy > 0.0) || !(params_.bin_size_theta > 0.0)) {
+    throw std::invalid_argument("ParticleFilter needs positive KLD bin sizes");
+  }
+  params_.beam_skip = std::max<size_t>(1, params_.beam_skip);
+}
+
+void ParticleFilter::Initialize(const Transform2D &pose, double sigma_xy, double sigma_theta) {
+  std::normal_distribution<double> xy(0.0, sigma_xy);
+  std::normal_distribution<double> theta(0.0, sigma_theta);
+  const size_t n = params_.max_particles;
+  x_.resize(n);
+  y_.resize(n);
+  theta_.resize(n);
+  weight_.assign(n, 1.0 / n);
+  for (size_t i = 0; i < n; ++i) {
+    x_[i] = pose.translation().x + xy(gen_);
+    y_[i] = pose.translation().y + xy(gen_);
+    theta_[i] = normalize_angle(pose.rotation() + theta(gen_));
+  }
+}
+
+void ParticleFilter::InitializeUniform(Point2D min, Point2D max) {
+  std::uniform_real_distribution<double> x(min.x, max.x);
+  std::uniform_real_distribution<double> y(min.y, max.y);
+  std::uniform_real_distribution<double> theta(-PI, PI);
+  const size_t n = params_.max_particles;
+  x_.resize(n);
+  y_.resize(n);
+  theta_.resize(n);
+  weight_.assign(n, 1.0 / n);
+  for (size_t i = 0; i < n; ++i) {
+    x_[i] = x(gen_);
+    y_[i] = y(gen_);
+    theta_[i] = theta(gen_);
+  }
+}
+
+void ParticleFilter::Predict(const Transform2D &T_old_new) {
+  // Odometry motion model: turn, drive straight, turn.
+  const double dx = T_old_new.translation().x;
+  const double dy = T_old_new.translation().y;
+  const double trans = std::hypot(dx, dy);
+  // Turning in place has no meaningful first rotation.
+  const double rot1 = trans < 1e-6 ? 0.0 : std::atan2(dy, dx);
+  const double rot2 = normalize_angle(T_old_new.rotation() - rot1);
+  const double sd_rot1 = std::sqrt(params_.alpha_rot_rot * rot1 * rot1 +
+                                   params_.alpha_rot_trans * trans * trans);
+  const double sd_trans =
+      std::sqrt(params_.alpha_trans_trans * trans * trans +
+                params_.alpha_trans_rot * (rot1 * rot1 + rot2 * rot2));
+  const double sd_rot2 = std::sqrt(params_.alpha_rot_rot * rot2 * rot2 +
+                                   params_.alpha_rot_trans * trans * trans);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  for (size_t i = 0; i < x_.size(); ++i) {
+    const double r1 = rot1 + sd_rot1 * noise(gen_);
+    const double t = trans + sd_trans * noise(gen_);
+    const double r2 = rot2 + sd_rot2 * noise(gen_);
+    const double heading = theta_[i] + r1;
+    x_[i] += t * std::cos(heading);
+    y_[i] += t * std::sin(heading);
+    theta_[i] = normalize_angle(heading + r2);
+  }
+}
+
+void ParticleFilter::Update(const std::vector<float> &ranges, double angle_min,
+                            double angle_increment, double range_min, double range_max) {
+  beam_x_.clear();
+  beam_y_.clear();
+  for (size_t i = 0; i < ranges.size(); i += params_.beam_skip) {
+    const double range = ranges[i];
+    if (!std::isfinite(range) || range < range_min || range >= range_max) {
+      continue;
+    }
+    const double angle = angle_min + angle_increment * i;
+    beam_x_.push_back(range * std::cos(angle));
+    beam_y_.push_back(range * std::sin(angle));
+  }
+  const size_t n = x_.size();
+  if (beam_x_.empty() || n == 0) {
+    return;
+  }
+  cos_.resize(n);
+  sin_.resize(n);
+  log_weight_.resize(n);
+  if (pool_ != nullptr) {
+    pool_->ParallelFor(
+        0, n, [this](size_t begin, size_t end) { Score(begin, end); }, 64);
+  } else {
+    Score(0, n);
+  }
+
+  // Weights are multiplied in log space, shift by the best before leaving it.
+  const double best = *std::max_element(log_weight_.begin(), log_weight_.end());
+  double total = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    weight_[i] *= std::exp(log_weight_[i] - best);
+    total += weight_[i];
+  }
+  if (!(total > 0.0)) {
+    std::fill(weight_.begin(), weight_.end(), 1.0 / n);
+    return;
+  }
+  for (auto &w : weight_) {
+    w /= total;
+  }
+}
+
+void ParticleFilter::Score(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    cos_[i] = std::cos(theta_[i]);
+    sin_[i] = std::sin(theta_[i]);
+  }
+  const LikelihoodField &field = *field_;
+  const size_t beams = beam_x_.size();
+  size_t i = begin;
+  // kLanes particles at a time: the end point of a beam is
+  // p + R(theta) * b, done for all lanes in one go.
+  for (; i + kLanes <= end; i += kLanes) {
+    const Lanes px = Load(x_.data() + i);
+    const Lanes py = Load(y_.data() + i);
+    const Lanes c = Load(cos_.data() + i);
+    const Lanes s = Load(sin_.data() + i);
+    double sum[kLanes] = {};
+    for (size_t j = 0; j < beams; ++j) {
+      const Lanes bx = Splat(beam_x_[j]);
+      const Lanes by = Splat(beam_y_[j]);
+      double wx[kLanes];
+      double wy[kLanes];
+      Store(wx, px + c * bx - s * by);
+      Store(wy, py + s * bx + c * by);
+      for (size_t lane = 0; lane < kLanes; ++lane) {
+        sum[lane] += field.LogLikelihood(wx[lane], wy[lane]);
+      }
+    }
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      log_weight_[i + lane] = sum[lane];
+    }
+  }
+  for (; i < end; ++i) {
+    double sum = 0.0;
+    for (size_t j = 0; j < beams; ++j) {
+      sum += field.LogLikelihood(x_[i] + cos_[i] * beam_x_[j] - sin_[i] * beam_y_[j],
+                                 y_[i] + sin_[i] * beam_x_[j] + cos_[i] * beam_y_[j]);
+    }
+    log_weight_[i] = sum;
+  }
+}
+
+size_t ParticleFilter::KldBound(size_t k) const {
+  if (k <= 1) {
+    return params_.min_particles;
+  }
+  // Wilson-Hilferty approximation of the chi-square quantile.
+  const double a = 2.0 / (9.0 * static_cast<double>(k - 1));
+  const double b = 1.0 - a + std::sqrt(a) * params_.kld_z;
+  const double n = static_cast<double>(k - 1) / (2.0 * params_.kld_error) * b * b * b;
+  // A large or negative kld_z takes n out of what a size_t holds, and no
+  // more than max_particles are ever drawn anyway.
+  if (!(n > 0.0)) {
+    return 0;
+  }
+  if (n >= static_cast<double>(params_.max_particles)) {
+    return params_.max_particles;
+  }
+  return static_cast<size_t>(std::ceil(n));
+}
+
+void ParticleFilter::Resample() {
+  const size_t n = x_.size();
+  if (n == 0) {
+    return;
+  }
+  cdf_.resize(n);
+  double running = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    running += weight_[i];
+    cdf_[i] = running;
+  }
+  std::uniform_real_distribution<double> pick(0.0, running);
+  next_x_.clear();
+  next_y_.clear();
+  next_theta_.clear();
+  bins_.clear();
+  // Draw until enough samples for the number of histogram bins they cover.
+  size_t required = params_.min_particles;
+  while (next_x_.size() < std::max(required, params_.min_particles) &&
+         next_x_.size() < params_.max_particles) {
+    const size_t i = std::min<size_t>(
+        std::upper_bound(cdf_.begin(), cdf_.end(), pick(gen_)) - cdf_.begin(), n - 1);
+    next_x_.push_back(x_[i]);
+    next_y_.push_back(y_[i]);
+    next_theta_.push_back(theta_[i]);
+    const auto bx = static_cast<int64_t>(std::floor(x_[i] / params_.bin_size_xy));
+    const auto by = static_cast<int64_t>(std::floor(y_[i] / params_.bin_size_xy));
+    const auto bt = static_cast<int64_t>(std::floor(theta_[i] / params_.bin_size_theta));
+    const uint64_t key = (static_cast<uint64_t>(bx & 0x1fffff) << 42) |
+                         (static_cast<uint64_t>(by & 0x1fffff) << 21) |
+                         static_cast<uint64_t>(bt & 0x1fffff);
+    if (bins_.insert(key).second) {
+      required = KldBound(bins_.size());
+    }
+  }
+  x_.swap(next_x_);
+  y_.swap(next_y_);
+  theta_.swap(next_theta_);
+  weight_.assign(x_.size(), 1.0 / x_.size());
+}
+
+Transform2D ParticleFilter::Estimate() const {
+  double x = 0.0;
+  double y = 0.0;
+  double c = 0.0;
+  double s = 0.0;
+  for (size_t i = 0; i < x_.size(); ++i) {
+    x += weight_[i] * x_[i];
+    y += weight_[i] * y_[i];
+    c += weight_[i] * std::cos(theta_[i]);
+    s += weight_[i] * std::sin(theta_[i]);
+  }
+  return Transform2D{{x, y}, std::atan2(s, c)};
+}
+
+double ParticleFilter::EffectiveSampleSize() const {
+  double sum_sq = 0.0;
+  for (const double w : weight_) {
+    sum_sq += w * w;
+  }
+  return sum_sq > 0.0 ? 1.0 / sum_sq : 0.0;
+}
+
+size_t ParticleFilter::Size() const { return x_.size(); }
+
+const std::vector<double> &ParticleFilter::X() const { return x_; }
+
+const std::vector<double> &ParticleFilter::Y() const { return y_; }
+
+const std::vector<double> &ParticleFilter::Theta() const { return theta_; }
+
+const std::vector<double> &ParticleFilter::Weights() const { return weight_; }
+
+} // namespace turtlelib
@@ -0,0 +1,87 @@
+#include "turtlelib/noise.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "turtlelib/geometry2d.hpp"
+
+namespace turtlelib {
+
+namespace {
+
+// Gaussians count their blocks from here, uniforms from 0.
+constexpr uint32_t kGaussianBlocks = 0x80000000u;
+
+//! @brief uniform in [0, 1) from the top 53 of 64 bits
+double ToUniform(uint32_t high, uint32_t low) {
+  const uint64_t bits = (static_cast<uint64_t>(high) << 32) | low;
+  return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+} // namespace
+
+PhiloxCounter Philox4x32(PhiloxCounter counter, PhiloxKey key) {
+  // ############# Begin Citation [11]#############
+  constexpr uint64_t kMultiplier0 = 0xD2511F53u;
+  constexpr uint64_t kMultiplier1 = 0xCD9E8D57u;
+  constexpr uint32_t kWeyl0 = 0x9E3779B9u;
+  constexpr uint32_t kWeyl1 = 0xBB67AE85u;
+  for (int round = 0; round < 10; ++round) {
+    if (round > 0) {
+      key[0] += kWeyl0;
+      key[1] += kWeyl1;
+    }
+    const uint64_t product0 = kMultiplier0 * counter[0];
+    const uint64_t product1 = kMultiplier1 * counter[2];
+    counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+               static_cast<uint32_t>(product1),
+               static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+               static_cast<uint32_t>(product0)};
+  }
+  // ############# End Citation [11]#############
+  return counter;
+}
+
+CounterNoise::CounterNoise(uint64_t seed)
+    : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)} {}
+
+PhiloxCounter CounterNoise::FirstCounter(uint32_t stream, uint64_t step, uint32_t first_block,
+                                         size_t n) {
+  if ((n + 1) / 2 > kGaussianBlocks) {
+    throw std::invalid_argument("CounterNoise draws at most 2^32 numbers at once");
+  }
+  return {first_block, stream, static_cast<uint32_t>(step), static_cast<uint32_t>(step >> 32)};
+}
+
+void CounterNoise::Uniforms(uint32_t stream, uint64_t step, double *out, size_t n) const {
+  PhiloxCounter counter = FirstCounter(stream, step, 0, n);
+  for (size_t i = 0; i < n; i += 2) {
+    const PhiloxCounter bits = Philox4x32(counter, key_);
+    out[i] = ToUniform(bits[0], bits[1]);
+    if (i + 1 < n) {
+      out[i + 1] = ToUniform(bits[2], bits[3]);
+    }
+    ++counter[0];
+  }
+}
+
+void CounterNoise::Gaussians(uint32_t stream, uint64_t step, double *out, size_t n) const {
+  PhiloxCounter counter = FirstCounter(stream, step, kGaussianBlocks, n);
+  for (size_t i = 0; i < n; i += 2) {
+    const PhiloxCounter bits = Philox4x32(counter, key_);
+    // 1 - u is in (0, 1], so the log is finite.
+    const double radius = std::sqrt(-2.0 * std::log(1.0 - ToUniform(bits[0], bits[1])));
+    const double angle = 2.0 * PI * ToUniform(bits[2], bits[3]);
+    out[i] = radius * std::cos(angle);
+    if (i + 1 < n) {
+      out[i + 1] = radius * std::sin(angle);
+    }
+    ++counter[0];
+  }
+}
+
+uint64_t CounterNoise::Seed() const {
+  return (static_cast<uint64_t>(key_[1]) << 32) | key_[0];
+}
+
+} // namespace turtlelib
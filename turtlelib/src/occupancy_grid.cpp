@@ -0,0 +1,197 @@
+#include "turtlelib/occupancy_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace turtlelib {
+
+namespace {
+//! @brief Floor division of a cell index by the tile size.
+template <int Bits> int32_t TileOf(int32_t cell) {
+  return cell >= 0 ? cell >> Bits : -((-cell - 1) >> Bits) - 1;
+}
+} // namespace
+
+template <typename Cell>
+TiledLogOddsGrid<Cell>::TiledLogOddsGrid(OccupancyGridParams params) : params_(params) {
+  if (params_.resolution <= 0.0 || params_.log_odds_limit <= 0.0) {
+    throw std::invalid_argument("Occupancy grid needs a positive resolution and limit");
+  }
+  constexpr int kMax = std::numeric_limits<Cell>::max();
+  step_ = params_.log_odds_limit / kMax;
+  // A sensor model finer than one step would never change a cell.
+  hit_ = std::max(1, static_cast<int>(std::lround(params_.log_odds_hit / step_)));
+  miss_ = std::min(-1, static_cast<int>(std::lround(params_.log_odds_miss / step_)));
+
+  occupancy_.resize(static_cast<size_t>(kMax) - kUnknown + 1);
+  occupancy_.at(0) = -1;
+  for (int value = kUnknown + 1; value <= kMax; ++value) {
+    const double probability = 1.0 - 1.0 / (1.0 + std::exp(value * step_));
+    occupancy_.at(value - kUnknown) = static_cast<int8_t>(std::lround(100.0 * probability));
+  }
+}
+
+template <typename Cell>
+void TiledLogOddsGrid<Cell>::InsertScan(const Transform2D &T_map_scan,
+                                        const std::vector<float> &ranges, double angle_min,
+                                        double angle_increment, double range_min,
+                                        double range_max) {
+  const Point2D origin = T_map_scan(Point2D{0.0, 0.0});
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const double range = ranges[i];
+    if (std::isnan(range) || range < range_min) {
+      continue;
+    }
+    const bool hit = range < range_max;
+    const double length = hit ? range : range_max;
+    const double angle = angle_min + angle_increment * i;
+    InsertRay(origin, T_map_scan(Point2D{length * std::cos(angle), length * std::sin(angle)}),
+              hit);
+  }
+}
+
+template <typename Cell> void TiledLogOddsGrid<Cell>::InsertRay(Point2D start, Point2D end, bool hit) {
+  // Bresenham between the two cells, every cell but the last is free space.
+  const GridIndex from = CellOf(start);
+  const GridIndex to = CellOf(end);
+  const int32_t dx = std::abs(to.x - from.x);
+  const int32_t dy = -std::abs(to.y - from.y);
+  const int32_t sx = from.x < to.x ? 1 : -1;
+  const int32_t sy = from.y < to.y ? 1 : -1;
+  int32_t error = dx + dy;
+  GridIndex cell = from;
+  while (cell.x != to.x || cell.y != to.y) {
+    Update(cell, miss_);
+    const int32_t error2 = 2 * error;
+    if (error2 >= dy) {
+      error += dy;
+      cell.x += sx;
+    }
+    if (error2 <= dx) {
+      error += dx;
+      cell.y += sy;
+    }
+  }
+  Update(to, hit ? hit_ : miss_);
+}
+
+template <typename Cell> GridIndex TiledLogOddsGrid<Cell>::CellOf(Point2D p) const {
+  return {static_cast<int32_t>(std::floor(p.x / params_.resolution)),
+          static_cast<int32_t>(std::floor(p.y / params_.resolution))};
+}
+
+template <typename Cell> Cell TiledLogOddsGrid<Cell>::Value(GridIndex cell) const {
+  const GridIndex tile{TileOf<kTileBits>(cell.x), TileOf<kTileBits>(cell.y)};
+  const auto found = tiles_.find(Key(tile));
+  if (found == tiles_.end()) {
+    return kUnknown;
+  }
+  const size_t local = static_cast<size_t>(cell.y - tile.y * kTileSize) * kTileSize +
+                       static_cast<size_t>(cell.x - tile.x * kTileSize);
+  return found->second->cells[local];
+}
+
+template <typename Cell> double TiledLogOddsGrid<Cell>::Probability(GridIndex cell) const {
+  const Cell value = Value(cell);
+  if (value == kUnknown) {
+    return 0.5;
+  }
+  return 1.0 - 1.0 / (1.0 + std::exp(value * step_));
+}
+
+template <typename Cell> size_t TiledLogOddsGrid<Cell>::TileCount() const { return tiles_.size(); }
+
+template <typename Cell> std::vector<GridIndex> TiledLogOddsGrid<Cell>::Tiles() const {
+  std::vector<GridIndex> out;
+  out.reserve(tiles_.size());
+  for (const auto &entry : tiles_) {
+    out.push_back({static_cast<int32_t>(entry.first >> 32),
+                   static_cast<int32_t>(entry.first & 0xffffffffu)});
+  }
+  return out;
+}
+
+template <typename Cell> std::vector<GridIndex> TiledLogOddsGrid<Cell>::TakeDirtyTiles() {
+  std::vector<GridIndex> out;
+  out.swap(dirty_);
+  for (const auto &tile : out) {
+    tiles_.at(Key(tile))->dirty = false;
+  }
+  return out;
+}
+
+template <typename Cell>
+bool TiledLogOddsGrid<Cell>::TileBounds(GridIndex &min, GridIndex &max) const {
+  if (tiles_.empty()) {
+    return false;
+  }
+  min = {std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max()};
+  max = {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min()};
+  for (const auto &tile : Tiles()) {
+    min = {std::min(min.x, tile.x), std::min(min.y, tile.y)};
+    max = {std::max(max.x, tile.x), std::max(max.y, tile.y)};
+  }
+  return true;
+}
+
+template <typename Cell>
+void TiledLogOddsGrid<Cell>::TileOccupancy(GridIndex tile, std::vector<int8_t> &out) const {
+  out.resize(kTileCells);
+  const auto found = tiles_.find(Key(tile));
+  if (found == tiles_.end()) {
+    std::fill(out.begin(), out.end(), int8_t{-1});
+    return;
+  }
+  const auto &cells = found->second->cells;
+  for (size_t i = 0; i < kTileCells; ++i) {
+    out[i] = occupancy_[static_cast<int>(cells[i]) - kUnknown];
+  }
+}
+
+template <typename Cell> const OccupancyGridParams &TiledLogOddsGrid<Cell>::Params() const {
+  return params_;
+}
+
+template <typename Cell> uint64_t TiledLogOddsGrid<Cell>::Key(GridIndex tile) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(tile.x)) << 32) |
+         static_cast<uint32_t>(tile.y);
+}
+
+template <typename Cell>
+typename TiledLogOddsGrid<Cell>::Tile &TiledLogOddsGrid<Cell>::TileAt(GridIndex tile) {
+  const uint64_t key = Key(tile);
+  if (last_tile_ != nullptr && key == last_key_) {
+    return *last_tile_;
+  }
+  auto &slot = tiles_[key];
+  if (!slot) {
+    slot = std::make_unique<Tile>();
+    slot->cells.fill(kUnknown);
+  }
+  last_key_ = key;
+  last_tile_ = slot.get();
+  return *slot;
+}
+
+template <typename Cell> void TiledLogOddsGrid<Cell>::Update(GridIndex cell, int delta) {
+  const GridIndex tile_index{TileOf<kTileBits>(cell.x), TileOf<kTileBits>(cell.y)};
+  Tile &tile = TileAt(tile_index);
+  const size_t local = static_cast<size_t>(cell.y - tile_index.y * kTileSize) * kTileSize +
+                       static_cast<size_t>(cell.x - tile_index.x * kTileSize);
+  Cell &value = tile.cells[local];
+  // An unknown cell starts at even odds. kUnknown itself stays out of reach.
+  constexpr int kMax = std::numeric_limits<Cell>::max();
+  const int current = value == kUnknown ? 0 : value;
+  value = static_cast<Cell>(std::clamp(current + delta, -kMax, kMax));
+  if (!tile.dirty) {
+    tile.dirty = true;
+    dirty_.push_back(tile_index);
+  }
+}
+
+template class TiledLogOddsGrid<int8_t>;
+template class TiledLogOddsGrid<int16_t>;
+
+} // namespace turtlelib
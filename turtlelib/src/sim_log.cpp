@@ -0,0 +1,442 @@
+#include "turtlelib/sim_log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief Bytes of the end of the file: index offset, chunk count, end magic.
+constexpr size_t kFooterBytes = 2 * sizeof(uint64_t) + sizeof(kSimLogEndMagic);
+//! @brief Fewest bytes a record takes in a chunk: its time, robot and count.
+constexpr size_t kMinRecordBytes = 3;
+
+void PutVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+//! @brief Small differences of either sign become small varints.
+void PutSigned(std::vector<uint8_t> &out, int64_t value) {
+  PutVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+uint64_t GetVarint(const uint8_t *&p, const uint8_t *end) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p == end) {
+      throw std::runtime_error("Sim log chunk ends inside a number");
+    }
+    const uint8_t byte = *p++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Sim log chunk holds a number that is too long");
+}
+
+int64_t GetSigned(const uint8_t *&p, const uint8_t *end) {
+  const uint64_t value = GetVarint(p, end);
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+template <typename T> void PutRaw(std::vector<uint8_t> &out, const T &value) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> T GetRaw(const uint8_t *data, size_t size, size_t offset) {
+  if (offset > size || size - offset < sizeof(T)) {
+    throw std::runtime_error("Sim log file is truncated");
+  }
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+//! @brief Where the previous record of each robot in a chunk has its values.
+//! Kept the same way by the writer and the reader so both pick the same base.
+class DeltaBase {
+public:
+  //! @brief the base of a record of count values, nullptr for zeros
+  const int64_t *Get(uint32_t robot, uint32_t count, const std::vector<int64_t> &values) const {
+    const auto found = last_.find(robot);
+    if (found == last_.end() || found->second.second != count) {
+      return nullptr;
+    }
+    return values.data() + found->second.first;
+  }
+
+  void Set(uint32_t robot, uint32_t count, size_t first) { last_[robot] = {first, count}; }
+
+private:
+  std::unordered_map<uint32_t, std::pair<size_t, uint32_t>> last_;
+};
+
+} // namespace
+
+SimLogWriter::SimLogWriter(const std::string &path, const std::vector<std::string> &robots,
+                           size_t chunk_records)
+    : out_(path, std::ios::binary | std::ios::trunc),
+      chunk_records_(std::max<size_t>(chunk_records, 1)) {
+  if (!out_) {
+    throw std::runtime_error("Can't open sim log file " + path);
+  }
+  // The fixed part of the header is built in a sized array first. Inserting
+  // the magic into the empty buffer trips -Wstringop-overflow at -O3.
+  std::array<uint8_t, sizeof(kSimLogMagic) + 2 * sizeof(uint32_t)> header{};
+  const auto robot_count = static_cast<uint32_t>(robots.size());
+  std::memcpy(header.data(), kSimLogMagic, sizeof(kSimLogMagic));
+  std::memcpy(header.data() + sizeof(kSimLogMagic), &kSimLogVersion, sizeof(uint32_t));
+  std::memcpy(header.data() + sizeof(kSimLogMagic) + sizeof(uint32_t), &robot_count,
+              sizeof(uint32_t));
+  buffer_.reserve(header.size());
+  buffer_.assign(header.begin(), header.end());
+  for (const auto &robot : robots) {
+    PutRaw(buffer_, static_cast<uint32_t>(robot.size()));
+    buffer_.insert(buffer_.end(), robot.begin(), robot.end());
+  }
+  out_.write(reinterpret_cast<const char *>(buffer_.data()),
+             static_cast<std::streamsize>(buffer_.size()));
+  offset_ = buffer_.size();
+  if (!out_) {
+    throw std::runtime_error("Can't write sim log file " + path);
+  }
+}
+
+SimLogWriter::~SimLogWriter() {
+  try {
+    Close();
+  } catch (const std::exception &) {
+    // Nothing to do about a failed write while going away.
+  }
+}
+
+void SimLogWriter::Append(SimLogChannel channel, int64_t time_ns, uint32_t robot,
+                          const double *values, size_t count) {
+  AppendValues(channel, time_ns, robot, values, count);
+}
+
+void SimLogWriter::Append(SimLogChannel channel, int64_t time_ns, uint32_t robot,
+                          const float *values, size_t count) {
+  AppendValues(channel, time_ns, robot, values, count);
+}
+
+template <typename T>
+void SimLogWriter::AppendValues(SimLogChannel channel, int64_t time_ns, uint32_t robot,
+                                const T *values, size_t count) {
+  if (closed_) {
+    throw std::logic_error("Sim log is closed");
+  }
+  const auto index = static_cast<size_t>(channel);
+  if (index >= kSimLogChannels) {
+    throw std::invalid_argument("Unknown sim log channel");
+  }
+  Pending &pending = pending_[index];
+  const double quantum = kSimLogQuantum[index];
+  // Check before touching the columns so a bad record leaves no trace.
+  for (size_t i = 0; i < count; ++i) {
+    if (!std::isfinite(values[i]) || std::abs(values[i] / quantum) > 0x1.0p62) {
+      throw std::invalid_argument("Sim log values must be finite and in range");
+    }
+  }
+  pending.times.push_back(time_ns);
+  pending.robots.push_back(robot);
+  pending.counts.push_back(static_cast<uint32_t>(count));
+  for (size_t i = 0; i < count; ++i) {
+    pending.values.push_back(std::llround(values[i] / quantum));
+  }
+  if (pending.times.size() >= chunk_records_ || pending.values.size() >= kSimLogChunkValues) {
+    WriteChunk(index);
+  }
+}
+
+void SimLogWriter::WriteChunk(size_t channel) {
+  Pending &pending = pending_[channel];
+  const size_t records = pending.times.size();
+  if (records == 0) {
+    return;
+  }
+  buffer_.clear();
+  // A fixed step makes every later difference of differences zero.
+  int64_t previous_time = 0;
+  int64_t previous_step = 0;
+  for (const auto time : pending.times) {
+    PutSigned(buffer_, time - previous_time - previous_step);
+    previous_step = time - previous_time;
+    previous_time = time;
+  }
+  for (const auto robot : pending.robots) {
+    PutVarint(buffer_, robot);
+  }
+  for (const auto count : pending.counts) {
+    PutVarint(buffer_, count);
+  }
+  DeltaBase base;
+  size_t first = 0;
+  for (size_t i = 0; i < records; ++i) {
+    const uint32_t count = pending.counts[i];
+    const int64_t *previous = base.Get(pending.robots[i], count, pending.values);
+    for (uint32_t k = 0; k < count; ++k) {
+      PutSigned(buffer_, pending.values[first + k] - (previous ? previous[k] : 0));
+    }
+    base.Set(pending.robots[i], count, first);
+    first += count;
+  }
+
+  out_.write(reinterpret_cast<const char *>(buffer_.data()),
+             static_cast<std::streamsize>(buffer_.size()));
+  if (!out_) {
+    throw std::runtime_error("Can't write sim log chunk");
+  }
+  const auto [first_time, last_time] =
+      std::minmax_element(pending.times.begin(), pending.times.end());
+  index_.push_back({static_cast<uint32_t>(channel), static_cast<uint32_t>(records), *first_time,
+                    *last_time, offset_, buffer_.size()});
+  offset_ += buffer_.size();
+
+  pending.times.clear();
+  pending.robots.clear();
+  pending.counts.clear();
+  pending.values.clear();
+}
+
+void SimLogWriter::Flush() {
+  for (size_t channel = 0; channel < kSimLogChannels; ++channel) {
+    WriteChunk(channel);
+  }
+  out_.flush();
+}
+
+void SimLogWriter::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  Flush();
+  buffer_.clear();
+  for (const auto &chunk : index_) {
+    PutRaw(buffer_, chunk);
+  }
+  PutRaw(buffer_, offset_);
+  PutRaw(buffer_, static_cast<uint64_t>(index_.size()));
+  buffer_.insert(buffer_.end(), std::begin(kSimLogEndMagic), std::end(kSimLogEndMagic));
+  out_.write(reinterpret_cast<const char *>(buffer_.data()),
+             static_cast<std::streamsize>(buffer_.size()));
+  out_.close();
+  if (!out_) {
+    throw std::runtime_error("Can't finish sim log file");
+  }
+}
+
+SimLogReader::SimLogReader(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open sim log file " + path);
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Can't stat sim log file " + path);
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  if (size_ < sizeof(kSimLogMagic) + 2 * sizeof(uint32_t) + kFooterBytes) {
+    close(fd);
+    throw std::runtime_error("Sim log file is too short: " + path);
+  }
+  void *memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive.
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Can't map sim log file " + path);
+  }
+  data_ = static_cast<const uint8_t *>(memory);
+
+  try {
+    if (!std::equal(std::begin(kSimLogMagic), std::end(kSimLogMagic), data_)) {
+      throw std::runtime_error("Not a sim log file: " + path);
+    }
+    if (GetRaw<uint32_t>(data_, size_, sizeof(kSimLogMagic)) != kSimLogVersion) {
+      throw std::runtime_error("Unknown sim log version: " + path);
+    }
+    if (!std::equal(std::begin(kSimLogEndMagic), std::end(kSimLogEndMagic),
+                    data_ + size_ - sizeof(kSimLogEndMagic))) {
+      throw std::runtime_error("Sim log file was not closed: " + path);
+    }
+    size_t offset = sizeof(kSimLogMagic) + sizeof(uint32_t);
+    const auto robots = GetRaw<uint32_t>(data_, size_, offset);
+    offset += sizeof(uint32_t);
+    for (uint32_t i = 0; i < robots; ++i) {
+      const auto length = GetRaw<uint32_t>(data_, size_, offset);
+      offset += sizeof(uint32_t);
+      if (length > size_ - offset) {
+        throw std::runtime_error("Sim log file is truncated");
+      }
+      robots_.emplace_back(reinterpret_cast<const char *>(data_ + offset), length);
+      offset += length;
+    }
+
+    const size_t footer = size_ - kFooterBytes;
+    const auto index_offset = GetRaw<uint64_t>(data_, size_, footer);
+    const auto chunks = GetRaw<uint64_t>(data_, size_, footer + sizeof(uint64_t));
+    if (index_offset < offset || index_offset > footer ||
+        (footer - index_offset) / sizeof(SimLogChunk) != chunks) {
+      throw std::runtime_error("Sim log index is corrupt: " + path);
+    }
+    for (uint64_t i = 0; i < chunks; ++i) {
+      const auto chunk =
+          GetRaw<SimLogChunk>(data_, size_, index_offset + i * sizeof(SimLogChunk));
+      if (chunk.channel >= kSimLogChannels || chunk.offset < offset ||
+          chunk.offset > index_offset || chunk.bytes > index_offset - chunk.offset) {
+        throw std::runtime_error("Sim log index is corrupt: " + path);
+      }
+      chunks_.push_back(chunk);
+      end_time_ = std::max(end_time_, chunk.last_time_ns);
+    }
+  } catch (...) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    throw;
+  }
+}
+
+SimLogReader::~SimLogReader() { munmap(const_cast<uint8_t *>(data_), size_); }
+
+const std::vector<std::string> &SimLogReader::Robots() const { return robots_; }
+
+const std::vector<SimLogChunk> &SimLogReader::Chunks() const { return chunks_; }
+
+int64_t SimLogReader::EndTime() const { return end_time_; }
+
+void SimLogReader::Decode(size_t chunk, std::vector<SimLogRecord> &out) const {
+  const SimLogChunk &info = chunks_.at(chunk);
+  const uint8_t *p = data_ + info.offset;
+  const uint8_t *const end = p + info.bytes;
+  // The count comes from the file, check it fits the chunk before allocating for it.
+  if (info.records > info.bytes / kMinRecordBytes) {
+    throw std::runtime_error("Sim log chunk is corrupt");
+  }
+  const size_t first_record = out.size();
+  out.resize(first_record + info.records);
+  const auto channel = static_cast<SimLogChannel>(info.channel);
+
+  int64_t time = 0;
+  int64_t step = 0;
+  for (size_t i = first_record; i < out.size(); ++i) {
+    step += GetSigned(p, end);
+    time += step;
+    out[i].channel = channel;
+    out[i].time_ns = time;
+  }
+  for (size_t i = first_record; i < out.size(); ++i) {
+    out[i].robot = static_cast<uint32_t>(GetVarint(p, end));
+  }
+  std::vector<uint32_t> counts(info.records);
+  size_t total = 0;
+  for (auto &count : counts) {
+    count = static_cast<uint32_t>(GetVarint(p, end));
+    total += count;
+    // Every value takes at least a byte, so this bounds a corrupt count.
+    if (total > info.bytes) {
+      throw std::runtime_error("Sim log chunk is corrupt");
+    }
+  }
+
+  std::vector<int64_t> values(total);
+  DeltaBase base;
+  const double quantum = kSimLogQuantum[info.channel];
+  size_t first = 0;
+  for (size_t i = 0; i < info.records; ++i) {
+    SimLogRecord &record = out[first_record + i];
+    const uint32_t count = counts[i];
+    const int64_t *previous = base.Get(record.robot, count, values);
+    record.values.resize(count);
+    for (uint32_t k = 0; k < count; ++k) {
+      values[first + k] = GetSigned(p, end) + (previous ? previous[k] : 0);
+      record.values[k] = static_cast<double>(values[first + k]) * quantum;
+    }
+    base.Set(record.robot, count, first);
+    first += count;
+  }
+  if (p != end) {
+    throw std::runtime_error("Sim log chunk is corrupt");
+  }
+}
+
+void SimLogReader::Read(int64_t begin_ns, int64_t end_ns, std::vector<SimLogRecord> &out) const {
+  out.clear();
+  std::vector<SimLogRecord> chunk_records;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    if (chunks_[i].last_time_ns < begin_ns || chunks_[i].first_time_ns >= end_ns) {
+      continue;
+    }
+    chunk_records.clear();
+    Decode(i, chunk_records);
+    for (auto &record : chunk_records) {
+      if (record.time_ns >= begin_ns && record.time_ns < end_ns) {
+        out.push_back(std::move(record));
+      }
+    }
+  }
+  std::stable_sort(out.begin(), out.end(), [](const SimLogRecord &a, const SimLogRecord &b) {
+    return a.time_ns < b.time_ns;
+  });
+}
+
+SimLogCursor::SimLogCursor(const SimLogReader &reader) : reader_(reader) {
+  for (size_t i = 0; i < reader.Chunks().size(); ++i) {
+    channels_[reader.Chunks()[i].channel].chunks.push_back(i);
+  }
+}
+
+bool SimLogCursor::Fill(Channel &channel) {
+  while (channel.next == channel.records.size()) {
+    if (channel.next_chunk == channel.chunks.size()) {
+      return false;
+    }
+    channel.records.clear();
+    channel.next = 0;
+    reader_.Decode(channel.chunks[channel.next_chunk++], channel.records);
+  }
+  return true;
+}
+
+void SimLogCursor::ReadUntil(int64_t end_ns, std::vector<SimLogRecord> &out) {
+  out.clear();
+  while (true) {
+    // Merge the channels, the earliest head goes first.
+    Channel *earliest = nullptr;
+    for (auto &channel : channels_) {
+      if (Fill(channel) &&
+          (!earliest ||
+           channel.records[channel.next].time_ns < earliest->records[earliest->next].time_ns)) {
+        earliest = &channel;
+      }
+    }
+    if (!earliest || earliest->records[earliest->next].time_ns >= end_ns) {
+      return;
+    }
+    out.push_back(std::move(earliest->records[earliest->next++]));
+  }
+}
+
+bool SimLogCursor::Done() const {
+  return std::all_of(channels_.begin(), channels_.end(), [](const Channel &channel) {
+    return channel.next == channel.records.size() && channel.next_chunk == channel.chunks.size();
+  });
+}
+
+} // namespace turtlelib
@@ -0,0 +1,75 @@
+#include "turtlelib/space_filling_curve.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace turtlelib {
+
+namespace {
+//! @brief Spread the 32 bits of v over the even bits of the result.
+uint64_t SpreadBits(uint32_t v) {
+  uint64_t x = v;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+  x = (x | (x << 2)) & 0x3333333333333333ull;
+  x = (x | (x << 1)) & 0x5555555555555555ull;
+  return x;
+}
+} // namespace
+
+uint64_t MortonCode(uint32_t x, uint32_t y) { return SpreadBits(x) | (SpreadBits(y) << 1); }
+
+uint64_t HilbertIndex(uint16_t x16, uint16_t y16) {
+  // Walk down from the largest quadrant, rotating the frame so every quadrant
+  // is entered the same way.
+  uint32_t x = x16;
+  uint32_t y = y16;
+  uint64_t d = 0;
+  for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+    const uint32_t rx = (x & s) ? 1 : 0;
+    const uint32_t ry = (y & s) ? 1 : 0;
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - (x & (s - 1));
+        y = s - 1 - (y & (s - 1));
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+std::vector<size_t> HilbertOrder(const std::vector<Point2D> &points) {
+  std::vector<size_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (points.size() < 2) {
+    return order;
+  }
+  double min_x = points.front().x;
+  double max_x = min_x;
+  double min_y = points.front().y;
+  double max_y = min_y;
+  for (const auto &p : points) {
+    min_x = std::min(min_x, p.x);
+    max_x = std::max(max_x, p.x);
+    min_y = std::min(min_y, p.y);
+    max_y = std::max(max_y, p.y);
+  }
+  // One scale for both axes keeps the curve's cells square.
+  const double extent = std::max({max_x - min_x, max_y - min_y, 1e-9});
+  const double scale = 65535.0 / extent;
+  std::vector<uint64_t> keys(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    keys[i] = HilbertIndex(static_cast<uint16_t>(std::lround((points[i].x - min_x) * scale)),
+                           static_cast<uint16_t>(std::lround((points[i].y - min_y) * scale)));
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+  return order;
+}
+
+} // namespace turtlelib
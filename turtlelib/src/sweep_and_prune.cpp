@@ -0,0 +1,51 @@
+#include "turtlelib/sweep_and_prune.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace turtlelib {
+
+void SweepAndPrune::Update(const std::vector<double> &x, const std::vector<double> &y,
+                           const std::vector<double> &r,
+                           std::vector<std::pair<size_t, size_t>> &pairs) {
+  const size_t n = x.size();
+  if (y.size() != n || r.size() != n) {
+    throw std::invalid_argument("SweepAndPrune needs as many y and r as x");
+  }
+  if (order_.size() != n) {
+    order_.resize(n);
+    std::iota(order_.begin(), order_.end(), 0);
+  }
+  min_x_.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    min_x_[i] = x[i] - r[i];
+  }
+  // Insertion sort, nearly free on the order of the last step.
+  for (size_t a = 1; a < n; ++a) {
+    const size_t k = order_[a];
+    size_t b = a;
+    while (b > 0 && min_x_[order_[b - 1]] > min_x_[k]) {
+      order_[b] = order_[b - 1];
+      --b;
+    }
+    order_[b] = k;
+  }
+
+  pairs.clear();
+  for (size_t a = 0; a < n; ++a) {
+    const size_t i = order_[a];
+    const double max_x = x[i] + r[i];
+    // Boxes further along start right of this one's right side, and so do all after them.
+    for (size_t b = a + 1; b < n && min_x_[order_[b]] <= max_x; ++b) {
+      const size_t j = order_[b];
+      if (std::abs(y[i] - y[j]) <= r[i] + r[j]) {
+        pairs.emplace_back(std::min(i, j), std::max(i, j));
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+}
+
+} // namespace turtlelib
@@ -0,0 +1,103 @@
+#include "turtlelib/swept_circle.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief How far a circle centered at p can move without passing a shape.
+//! Up to its clearance it touches nothing. Within half the distance from its
+//! center to a shape it may sink in, but its center stays on its own side of
+//! the shape, so a push out still goes the right way.
+double SafeStep(Point2D p, double radius, const SweepShapes &shapes) {
+  double safe = std::numeric_limits<double>::infinity();
+  const auto limit = [&](double distance) {
+    safe = std::min(safe, std::max(distance - radius, distance / 2.0));
+  };
+  for (size_t k = 0; k < shapes.x.size(); ++k) {
+    limit((p - Point2D{shapes.x[k], shapes.y[k]}).magnitude() - shapes.r[k]);
+  }
+  for (const auto &segment : shapes.segments) {
+    limit((p - ClosestPoint(segment, p)).magnitude());
+  }
+  return safe;
+}
+
+//! @brief Move p out of every shape it overlaps, one shape at a time.
+//! @return whether p overlapped a shape
+bool PushOut(Point2D &p, double radius, const SweepShapes &shapes) {
+  bool overlap = false;
+  const auto push = [&](Point2D from, double reach) {
+    const Vector2D away = p - from;
+    const double distance = away.magnitude();
+    if (distance >= reach) {
+      return;
+    }
+    overlap = true;
+    // A center right on the shape leaves along x.
+    const Vector2D direction = distance > 0.0 ? away * (1.0 / distance) : Vector2D{1.0, 0.0};
+    p = from + direction * reach;
+  };
+  for (size_t k = 0; k < shapes.x.size(); ++k) {
+    push({shapes.x[k], shapes.y[k]}, shapes.r[k] + radius);
+  }
+  for (const auto &segment : shapes.segments) {
+    push(ClosestPoint(segment, p), radius);
+  }
+  return overlap;
+}
+
+} // namespace
+
+Point2D ClosestPoint(const Segment2D &segment, Point2D p) {
+  const Vector2D along = segment.b - segment.a;
+  const double length_sq = dot(along, along);
+  if (length_sq == 0.0) {
+    return segment.a;
+  }
+  const double t = std::clamp(dot(p - segment.a, along) / length_sq, 0.0, 1.0);
+  return segment.a + along * t;
+}
+
+void SweepShapes::Clear() {
+  x.clear();
+  y.clear();
+  r.clear();
+  segments.clear();
+}
+
+SweepResult SweepCircle(const Transform2D &start, const Twist2D &twist, double radius,
+                        const SweepShapes &shapes, double contact_step) {
+  // The center moves at a constant speed along the arc, so s of the motion
+  // covers s * length of it.
+  const double length = std::hypot(twist.x, twist.y);
+  SweepResult result{start, false, 0};
+  double done = 0.0;
+  while (done < 1.0) {
+    Point2D center = result.pose.translation().ToPoint();
+    if (PushOut(center, radius, shapes)) {
+      result.contact = true;
+      result.pose = Transform2D{{center.x, center.y}, result.pose.rotation()};
+    }
+    double step = 1.0 - done;
+    const double safe = SafeStep(center, radius, shapes);
+    if (length > 0.0 && safe < step * length && result.substeps + 1 < kSweepMaxSubsteps) {
+      step = std::max(safe, contact_step) / length;
+    }
+    step = std::min(step, 1.0 - done);
+    result.pose *= integrate_twist({twist.omega * step, twist.x * step, twist.y * step});
+    done += step;
+    ++result.substeps;
+  }
+  Point2D center = result.pose.translation().ToPoint();
+  if (PushOut(center, radius, shapes)) {
+    result.contact = true;
+    result.pose = Transform2D{{center.x, center.y}, result.pose.rotation()};
+  }
+  return result;
+}
+
+} // namespace turtlelib
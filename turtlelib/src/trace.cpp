@@ -0,0 +1,192 @@
+#include "turtlelib/trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief Every trace point and every ring, only touched when a point is
+//! first hit, a thread first traces, or the trace is read.
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<TracePointInfo> points;
+  std::vector<std::unique_ptr<FlightRecorder<TraceRecord>>> rings;
+  size_t capacity = 8192;
+};
+
+TraceRegistry &Registry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+void WriteString(std::ofstream &out, const std::string &text) {
+  const auto size = static_cast<uint32_t>(text.size());
+  out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+//! @brief Read a length prefixed string at offset, moving offset past it.
+std::string ReadString(const std::vector<char> &bytes, size_t &offset) {
+  uint32_t size = 0;
+  if (bytes.size() - offset < sizeof(size)) {
+    throw std::runtime_error("Trace file is truncated");
+  }
+  std::copy_n(bytes.begin() + static_cast<std::ptrdiff_t>(offset), sizeof(size),
+              reinterpret_cast<char *>(&size));
+  offset += sizeof(size);
+  if (bytes.size() - offset < size) {
+    throw std::runtime_error("Trace file is truncated");
+  }
+  const auto start = bytes.begin() + static_cast<std::ptrdiff_t>(offset);
+  offset += size;
+  return std::string(start, start + size);
+}
+
+} // namespace
+
+uint32_t RegisterTracePoint(const char *name, const char *fields) {
+  auto &registry = Registry();
+  const std::lock_guard<std::mutex> lock(registry.mutex);
+  const auto found =
+      std::find_if(registry.points.begin(), registry.points.end(),
+                   [name](const TracePointInfo &point) { return point.name == name; });
+  if (found != registry.points.end()) {
+    return static_cast<uint32_t>(found - registry.points.begin());
+  }
+  registry.points.push_back({name, fields});
+  return static_cast<uint32_t>(registry.points.size() - 1);
+}
+
+void SetTraceCapacity(size_t capacity) {
+  auto &registry = Registry();
+  const std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.capacity = std::max<size_t>(1, capacity);
+}
+
+FlightRecorder<TraceRecord> &ThreadTraceRing() {
+  thread_local FlightRecorder<TraceRecord> *ring = nullptr;
+  if (!ring) {
+    auto &registry = Registry();
+    const std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.rings.push_back(
+        std::make_unique<FlightRecorder<TraceRecord>>("", registry.capacity));
+    ring = registry.rings.back().get();
+  }
+  return *ring;
+}
+
+TraceDump SnapshotTrace() {
+  auto &registry = Registry();
+  TraceDump dump;
+  {
+    const std::lock_guard<std::mutex> lock(registry.mutex);
+    dump.points = registry.points;
+    for (size_t thread = 0; thread < registry.rings.size(); ++thread) {
+      for (auto record : registry.rings[thread]->Snapshot()) {
+        record.thread = static_cast<uint16_t>(thread);
+        dump.records.push_back(record);
+      }
+    }
+  }
+  std::stable_sort(
+      dump.records.begin(), dump.records.end(),
+      [](const TraceRecord &a, const TraceRecord &b) { return a.time_ns < b.time_ns; });
+  return dump;
+}
+
+size_t DumpTrace(const std::string &path) {
+  const auto dump = SnapshotTrace();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Can't open trace file " + path);
+  }
+  TraceFileHeader header{};
+  std::copy(std::begin(kTraceMagic), std::end(kTraceMagic), header.magic);
+  header.version = kTraceVersion;
+  header.record_size = sizeof(TraceRecord);
+  header.points = dump.points.size();
+  header.records = dump.records.size();
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const auto &point : dump.points) {
+    WriteString(out, point.name);
+    WriteString(out, point.fields);
+  }
+  out.write(reinterpret_cast<const char *>(dump.records.data()),
+            static_cast<std::streamsize>(dump.records.size() * sizeof(TraceRecord)));
+  out.close();
+  if (!out) {
+    throw std::runtime_error("Can't write trace file " + path);
+  }
+  return dump.records.size();
+}
+
+TraceDump ReadTrace(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open trace file " + path);
+  }
+  const std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                                std::istreambuf_iterator<char>());
+
+  TraceFileHeader header{};
+  if (bytes.size() < sizeof(header)) {
+    throw std::runtime_error("Trace file is too short");
+  }
+  std::copy_n(bytes.begin(), sizeof(header), reinterpret_cast<char *>(&header));
+  if (!std::equal(std::begin(kTraceMagic), std::end(kTraceMagic), header.magic)) {
+    throw std::runtime_error("Not a trace file");
+  }
+  if (header.version != kTraceVersion || header.record_size != sizeof(TraceRecord)) {
+    throw std::runtime_error("Unknown trace file version");
+  }
+
+  TraceDump dump;
+  size_t offset = sizeof(header);
+  for (uint64_t i = 0; i < header.points; ++i) {
+    auto name = ReadString(bytes, offset);
+    auto fields = ReadString(bytes, offset);
+    dump.points.push_back({std::move(name), std::move(fields)});
+  }
+  if (header.records > (bytes.size() - offset) / sizeof(TraceRecord)) {
+    throw std::runtime_error("Trace file is truncated");
+  }
+  dump.records.resize(header.records);
+  std::copy_n(bytes.begin() + static_cast<std::ptrdiff_t>(offset),
+              header.records * sizeof(TraceRecord),
+              reinterpret_cast<char *>(dump.records.data()));
+  return dump;
+}
+
+std::string FormatTraceRecord(const TraceDump &dump, const TraceRecord &record) {
+  std::ostringstream out;
+  out.precision(9);
+  out << record.time_ns << " " << record.thread << " ";
+  if (record.point >= dump.points.size()) {
+    out << "point" << record.point;
+    for (size_t i = 0; i < std::min<size_t>(record.count, kTraceValues); ++i) {
+      out << " " << record.values[i];
+    }
+    return out.str();
+  }
+  const auto &point = dump.points[record.point];
+  out << point.name;
+  std::istringstream fields(point.fields);
+  std::string field;
+  for (size_t i = 0; i < std::min<size_t>(record.count, kTraceValues); ++i) {
+    if (!std::getline(fields, field, ',')) {
+      field = std::to_string(i);
+    }
+    out << " " << field << "=" << record.values[i];
+  }
+  return out.str();
+}
+
+} // namespace turtlelib
@@ -0,0 +1,33 @@
+//! @file Print a trace file as text.
+//! @brief Formats the binary records of turtlelib::DumpTrace, one line each.
+// Usage: trace_format <trace_file> [point]
+//  trace_file - written by turtlelib::DumpTrace, such as nusim's trace_file
+//  point - only print the records of the trace point of this name
+// Each line is: steady clock ns, thread, point name, then field=value pairs.
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "turtlelib/trace.hpp"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace_file> [point]\n";
+    return 1;
+  }
+  try {
+    const auto dump = turtlelib::ReadTrace(argv[1]);
+    for (const auto &record : dump.records) {
+      if (argc > 2 && (record.point >= dump.points.size() ||
+                       dump.points[record.point].name != argv[2])) {
+        continue;
+      }
+      std::cout << turtlelib::FormatTraceRecord(dump, record) << "\n";
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
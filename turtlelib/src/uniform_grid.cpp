@@ -0,0 +1,209 @@
+#include "turtlelib/uniform_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "turtlelib/swept_circle.hpp"
+
+namespace turtlelib {
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+// 16M cells, 64 MB of cell starts, is already more than a floor plan needs.
+constexpr double kMaxCells = 1 << 24;
+
+} // namespace
+
+template <typename Visit>
+void UniformGrid::Walk(Point2D start, Vector2D direction, double t_end, Visit visit) const {
+  GridWalk(view_.frame, start, direction, t_end, [&](size_t x, size_t y, double t_exit) {
+    return visit(y * view_.frame.cells_x + x, t_exit);
+  });
+}
+
+template <typename Visit>
+void UniformGrid::VisitNear(Point2D center, double radius, Visit visit) const {
+  const GridFrame &frame = view_.frame;
+  const size_t x_begin = frame.CellX(center.x - radius);
+  const size_t x_end = frame.CellX(center.x + radius);
+  const size_t y_begin = frame.CellY(center.y - radius);
+  const size_t y_end = frame.CellY(center.y + radius);
+  for (size_t y = y_begin; y <= y_end; ++y) {
+    for (size_t x = x_begin; x <= x_end; ++x) {
+      const size_t cell = y * frame.cells_x + x;
+      for (uint32_t k = view_.cell_start[cell]; k < view_.cell_start[cell + 1]; ++k) {
+        visit(static_cast<size_t>(view_.items[k]));
+      }
+    }
+  }
+}
+
+UniformGrid::UniformGrid(const std::vector<double> &circle_x, const std::vector<double> &circle_y,
+                         const std::vector<double> &circle_r,
+                         const std::vector<Segment2D> &segments, double cell_size)
+    : circle_x_(circle_x), circle_y_(circle_y), circle_r_(circle_r), segments_(segments) {
+  if (circle_y.size() != circle_x.size() || circle_r.size() != circle_x.size()) {
+    throw std::invalid_argument("Circle x, y and r must be the same length");
+  }
+  if (!(cell_size > 0.0)) {
+    throw std::invalid_argument("UniformGrid needs a positive cell size");
+  }
+  const size_t shapes = circle_x.size() + segments.size();
+  if (shapes >= std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("Too many shapes for a UniformGrid");
+  }
+
+  // Bounding box of every shape, empty at the origin without any.
+  double min_x = shapes > 0 ? kInf : 0.0;
+  double min_y = min_x;
+  double max_x = -min_x;
+  double max_y = -min_x;
+  const auto grow = [&](double x, double y) {
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  };
+  for (size_t i = 0; i < circle_x.size(); ++i) {
+    grow(circle_x[i] - circle_r[i], circle_y[i] - circle_r[i]);
+    grow(circle_x[i] + circle_r[i], circle_y[i] + circle_r[i]);
+  }
+  for (const auto &segment : segments) {
+    grow(segment.a.x, segment.a.y);
+    grow(segment.b.x, segment.b.y);
+  }
+  const double cells_x = std::max(1.0, std::ceil((max_x - min_x) / cell_size));
+  const double cells_y = std::max(1.0, std::ceil((max_y - min_y) / cell_size));
+  if (cells_x * cells_y > kMaxCells) {
+    throw std::invalid_argument("UniformGrid cell size is too small for the world");
+  }
+  GridFrame &frame = view_.frame;
+  frame.min = {min_x, min_y};
+  frame.cell_size = cell_size;
+  frame.cells_x = static_cast<size_t>(cells_x);
+  frame.cells_y = static_cast<size_t>(cells_y);
+
+  // Cells of each shape: the bounding box of a circle, the cells a segment crosses.
+  const auto for_each_cell = [&](size_t item, auto &&fn) {
+    if (item < circle_x_.size()) {
+      const size_t x_begin = frame.CellX(circle_x_[item] - circle_r_[item]);
+      const size_t x_end = frame.CellX(circle_x_[item] + circle_r_[item]);
+      const size_t y_begin = frame.CellY(circle_y_[item] - circle_r_[item]);
+      const size_t y_end = frame.CellY(circle_y_[item] + circle_r_[item]);
+      for (size_t y = y_begin; y <= y_end; ++y) {
+        for (size_t x = x_begin; x <= x_end; ++x) {
+          fn(y * frame.cells_x + x);
+        }
+      }
+      return;
+    }
+    const Segment2D &segment = segments_[item - circle_x_.size()];
+    const Vector2D along = segment.b - segment.a;
+    const double length = along.magnitude();
+    if (length == 0.0) {
+      fn(frame.CellY(segment.a.y) * frame.cells_x + frame.CellX(segment.a.x));
+      return;
+    }
+    Walk(segment.a, along * (1.0 / length), length, [&fn](size_t cell, double) {
+      fn(cell);
+      return false;
+    });
+  };
+
+  // Counting pass then filling pass, all shapes of a cell end up adjacent.
+  cell_start_.assign(frame.cells_x * frame.cells_y + 1, 0);
+  for (size_t item = 0; item < shapes; ++item) {
+    for_each_cell(item, [this](size_t cell) { ++cell_start_[cell + 1]; });
+  }
+  for (size_t cell = 0; cell + 1 < cell_start_.size(); ++cell) {
+    cell_start_[cell + 1] += cell_start_[cell];
+  }
+  items_.resize(cell_start_.back());
+  std::vector<uint32_t> fill(cell_start_.begin(), cell_start_.end() - 1);
+  for (size_t item = 0; item < shapes; ++item) {
+    for_each_cell(item,
+                  [this, &fill, item](size_t cell) { items_[fill[cell]++] = item; });
+  }
+
+  view_.cell_start = cell_start_.data();
+  view_.items = items_.data();
+  view_.item_count = items_.size();
+  view_.circle_x = circle_x_.data();
+  view_.circle_y = circle_y_.data();
+  view_.circle_r = circle_r_.data();
+  view_.circles = circle_x_.size();
+  view_.segments = segments_.data();
+  view_.segment_count = segments_.size();
+}
+
+UniformGrid::UniformGrid(const UniformGridView &view) : view_(view) {}
+
+double UniformGrid::Raycast(Point2D origin, Vector2D direction, double range_max) const {
+  double t_enter = 0.0;
+  double t_leave = range_max;
+  if (!view_.frame.Clip(origin, direction, t_enter, t_leave)) {
+    return kInf;
+  }
+
+  double nearest = kInf;
+  Walk(origin + direction * t_enter, direction, t_leave - t_enter,
+       [&](size_t cell, double t_exit) {
+         for (uint32_t k = view_.cell_start[cell]; k < view_.cell_start[cell + 1]; ++k) {
+           const size_t item = view_.items[k];
+           const double t =
+               item < view_.circles
+                   ? RayCircleDistance(origin, direction,
+                                       {view_.circle_x[item], view_.circle_y[item]},
+                                       view_.circle_r[item])
+                   : RaySegmentDistance(origin, direction, view_.segments[item - view_.circles]);
+           nearest = std::min(nearest, t);
+         }
+         // A hit inside this cell beats anything in the cells further along.
+         return nearest <= t_enter + t_exit;
+       });
+  return nearest <= range_max ? nearest : kInf;
+}
+
+void UniformGrid::CirclesNear(Point2D center, double radius, std::vector<size_t> &out) const {
+  out.clear();
+  VisitNear(center, radius, [&](size_t item) {
+    if (item >= view_.circles) {
+      return;
+    }
+    const double dx = view_.circle_x[item] - center.x;
+    const double dy = view_.circle_y[item] - center.y;
+    const double reach = view_.circle_r[item] + radius;
+    if (dx * dx + dy * dy <= reach * reach) {
+      out.push_back(item);
+    }
+  });
+  // A circle over several cells was found once per cell.
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void UniformGrid::SegmentsNear(Point2D center, double radius, std::vector<size_t> &out) const {
+  out.clear();
+  VisitNear(center, radius, [&](size_t item) {
+    if (item < view_.circles) {
+      return;
+    }
+    const size_t segment = item - view_.circles;
+    if ((ClosestPoint(view_.segments[segment], center) - center).magnitude() <= radius) {
+      out.push_back(segment);
+    }
+  });
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+size_t UniformGrid::CellsX() const { return view_.frame.cells_x; }
+
+size_t UniformGrid::CellsY() const { return view_.frame.cells_y; }
+
+const UniformGridView &UniformGrid::View() const { return view_; }
+
+} // namespace turtlelib
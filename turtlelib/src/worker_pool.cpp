@@ -0,0 +1,130 @@
+#include "turtlelib/worker_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace turtlelib {
+
+WorkerPool::WorkerPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // The caller of ParallelFor is one of the threads.
+  for (size_t i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&WorkerPool::WorkerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t WorkerPool::Size() const { return workers_.size() + 1; }
+
+void WorkerPool::ParallelFor(size_t begin, size_t end,
+                             const std::function<void(size_t, size_t)> &chunk_fn,
+                             size_t min_chunk) {
+  if (end <= begin) {
+    return;
+  }
+  const size_t count = end - begin;
+  const size_t num_chunks =
+      std::min(Size(), std::max<size_t>(1, count / std::max<size_t>(1, min_chunk)));
+  if (num_chunks == 1) {
+    chunk_fn(begin, end);
+    return;
+  }
+
+  // Chunks are claimed through a shared counter, so a busy worker never holds
+  // up the rest. The caller claims chunks too. The bookkeeping is shared, since
+  // a helper job may only get dequeued after the caller already finished every
+  // chunk and returned. Such a late helper finds no chunk left and never
+  // touches chunk_fn.
+  struct LoopState {
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<size_t> done_chunks{0};
+    std::exception_ptr first_error;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+  };
+  auto state = std::make_shared<LoopState>();
+  const size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+  const auto *fn = &chunk_fn;
+
+  auto run_chunks = [state, fn, begin, end, chunk_size, num_chunks]() {
+    for (size_t c = state->next_chunk++; c < num_chunks; c = state->next_chunk++) {
+      const size_t chunk_begin = std::min(end, begin + c * chunk_size);
+      const size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+      try {
+        // Rounding the chunk size up can leave the last chunks empty.
+        if (chunk_begin < chunk_end) {
+          (*fn)(chunk_begin, chunk_end);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->done_mutex);
+        if (!state->first_error) {
+          state->first_error = std::current_exception();
+        }
+      }
+      if (++state->done_chunks == num_chunks) {
+        std::lock_guard<std::mutex> lock(state->done_mutex);
+        state->done_cv.notify_all();
+      }
+    }
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 1; i < num_chunks; ++i) {
+      jobs_.emplace_back(run_chunks);
+    }
+  }
+  cv_.notify_all();
+  run_chunks();
+
+  std::unique_lock<std::mutex> lock(state->done_mutex);
+  state->done_cv.wait(lock, [&]() { return state->done_chunks == num_chunks; });
+  if (state->first_error) {
+    std::rethrow_exception(state->first_error);
+  }
+}
+
+void WorkerPool::Submit(std::function<void()> job) {
+  if (workers_.empty()) {
+    job();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  cv_.notify_one();
+}
+
+void WorkerPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        // Only reached when stopping and nothing is left to do.
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
+
+} // namespace turtlelib
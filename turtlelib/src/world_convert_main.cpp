@@ -0,0 +1,113 @@
+//! @file Convert a nusim world from its parameter file to a binary world file.
+//! @brief Reads the obstacles and walls nusim would, builds their grid and writes them out.
+// Usage: world_convert <params.yaml> <world_file> [node]
+//  params.yaml - ROS parameter file, as nusim's config/basic_world.yaml
+//  world_file - output, for nusim's world_file parameter
+//  node - node whose ros__parameters to read, default the first one in the file
+// Read like nusim reads them: obstacles/x, obstacles/y, obstacles/radii or
+// obstacles/r, obstacle_grid_cell (default 0.5), and the walls from
+// world_map when it is a segment file, else from arena_x_length and
+// arena_y_length (default 5.0 and 3.0).
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "turtlelib/world_file.hpp"
+#include "turtlelib/world_map.hpp"
+
+using namespace turtlelib;
+
+namespace {
+
+//! @brief A parameter, written either flat as "obstacles/x" or nested.
+//! @return the node, undefined when it is not there
+YAML::Node Find(const YAML::Node &params, const std::string &name) {
+  if (const auto flat = params[name]) {
+    return flat;
+  }
+  const auto slash = name.find('/');
+  if (slash == std::string::npos) {
+    return YAML::Node(YAML::NodeType::Undefined);
+  }
+  const auto group = params[name.substr(0, slash)];
+  if (!group || !group.IsMap()) {
+    return YAML::Node(YAML::NodeType::Undefined);
+  }
+  return Find(group, name.substr(slash + 1));
+}
+
+template <typename T>
+T Get(const YAML::Node &params, const std::string &name, const T &fallback) {
+  const auto node = Find(params, name);
+  return node ? node.as<T>() : fallback;
+}
+
+template <typename T> T Get(const YAML::Node &params, const std::string &name) {
+  const auto node = Find(params, name);
+  if (!node) {
+    throw std::runtime_error("Parameter " + name + " is missing");
+  }
+  return node.as<T>();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <params.yaml> <world_file> [node]\n";
+    return 1;
+  }
+  try {
+    const auto root = YAML::LoadFile(argv[1]);
+    YAML::Node params;
+    bool found = false;
+    for (const auto &entry : root) {
+      if ((argc < 4 || entry.first.as<std::string>() == argv[3]) &&
+          entry.second["ros__parameters"]) {
+        params = entry.second["ros__parameters"];
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      throw std::runtime_error("No ros__parameters in " + std::string(argv[1]));
+    }
+
+    const auto x = Get<std::vector<double>>(params, "obstacles/x");
+    const auto y = Get<std::vector<double>>(params, "obstacles/y");
+    auto r = Get<std::vector<double>>(params, "obstacles/radii", {});
+    if (x.size() != y.size()) {
+      throw std::runtime_error("obstacles/x and obstacles/y differ in length");
+    }
+    if (r.empty()) {
+      r.assign(x.size(), Get<double>(params, "obstacles/r"));
+    } else if (r.size() != x.size()) {
+      throw std::runtime_error("obstacles/radii and obstacles/x differ in length");
+    }
+
+    const auto world_map = Get<std::string>(params, "world_map", "");
+    if (world_map.size() >= 4 && world_map.compare(world_map.size() - 4, 4, ".pgm") == 0) {
+      throw std::runtime_error("A world file holds segments, not the .pgm world_map " +
+                               world_map);
+    }
+    const auto walls = world_map.empty() ? ArenaWalls(Get<double>(params, "arena_x_length", 5.0),
+                                                      Get<double>(params, "arena_y_length", 3.0))
+                                         : LoadSegmentWorld(world_map);
+    const double cell_size = Get<double>(params, "obstacle_grid_cell", 0.5);
+
+    const auto start = std::chrono::steady_clock::now();
+    WriteWorldFile(argv[2], x, y, r, walls, cell_size);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Wrote " << x.size() << " obstacles and " << walls.size() << " walls to "
+              << argv[2] << " in " << elapsed.count() << " s\n";
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include "turtlelib/world_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+namespace turtlelib {
+
+namespace {
+
+static_assert(std::is_trivially_copyable_v<Segment2D> && sizeof(Segment2D) == 4 * sizeof(double),
+              "Segment2D is stored as four doubles");
+static_assert(sizeof(WorldFileHeader) % 8 == 0, "Sections after the header stay aligned");
+
+// Same bound as UniformGrid puts on the cells it builds.
+constexpr uint64_t kMaxCells = 1 << 24;
+
+enum Section : size_t { kCircleX, kCircleY, kCircleR, kSegments, kCellStart, kItems, kSections };
+
+//! @brief round up to the next section start
+uint64_t Align(uint64_t offset) {
+  return (offset + kWorldFileAlign - 1) / kWorldFileAlign * kWorldFileAlign;
+}
+
+} // namespace
+
+void WriteWorldFile(const std::string &path, const std::vector<double> &circle_x,
+                    const std::vector<double> &circle_y, const std::vector<double> &circle_r,
+                    const std::vector<Segment2D> &segments, double cell_size) {
+  const UniformGrid grid(circle_x, circle_y, circle_r, segments, cell_size);
+  const UniformGridView &view = grid.View();
+
+  WorldFileHeader header{};
+  std::copy(std::begin(kWorldFileMagic), std::end(kWorldFileMagic), header.magic);
+  header.version = kWorldFileVersion;
+  header.byte_order = kWorldFileByteOrder;
+  header.circles = view.circles;
+  header.segments = view.segment_count;
+  header.cells_x = view.frame.cells_x;
+  header.cells_y = view.frame.cells_y;
+  header.items = view.item_count;
+  header.min_x = view.frame.min.x;
+  header.min_y = view.frame.min.y;
+  header.cell_size = view.frame.cell_size;
+
+  const void *data[kSections] = {view.circle_x, view.circle_y,   view.circle_r,
+                                 view.segments, view.cell_start, view.items};
+  const uint64_t bytes[kSections] = {
+      view.circles * sizeof(double),
+      view.circles * sizeof(double),
+      view.circles * sizeof(double),
+      view.segment_count * sizeof(Segment2D),
+      (header.cells_x * header.cells_y + 1) * sizeof(uint32_t),
+      view.item_count * sizeof(uint32_t)};
+  uint64_t offset = sizeof(header);
+  for (size_t section = 0; section < kSections; ++section) {
+    offset = Align(offset);
+    header.offsets[section] = offset;
+    offset += bytes[section];
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Can't open world file " + path);
+  }
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  const char padding[kWorldFileAlign] = {};
+  uint64_t written = sizeof(header);
+  for (size_t section = 0; section < kSections; ++section) {
+    out.write(padding, static_cast<std::streamsize>(header.offsets[section] - written));
+    if (bytes[section] > 0) {
+      out.write(static_cast<const char *>(data[section]),
+                static_cast<std::streamsize>(bytes[section]));
+    }
+    written = header.offsets[section] + bytes[section];
+  }
+  out.close();
+  if (!out) {
+    throw std::runtime_error("Can't write world file " + path);
+  }
+}
+
+WorldFile::WorldFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Can't open world file " + path);
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Can't stat world file " + path);
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  if (size_ < sizeof(WorldFileHeader)) {
+    close(fd);
+    throw std::runtime_error("World file is too short: " + path);
+  }
+  void *memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive.
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Can't map world file " + path);
+  }
+  data_ = static_cast<const uint8_t *>(memory);
+
+  try {
+    WorldFileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (!std::equal(std::begin(kWorldFileMagic), std::end(kWorldFileMagic), header.magic)) {
+      throw std::runtime_error("Not a world file: " + path);
+    }
+    if (header.version != kWorldFileVersion) {
+      throw std::runtime_error("Unknown world file version: " + path);
+    }
+    if (header.byte_order != kWorldFileByteOrder) {
+      throw std::runtime_error("World file was written on a machine of another byte order: " +
+                               path);
+    }
+    if (header.cells_x == 0 || header.cells_y == 0 || header.cells_x > kMaxCells ||
+        header.cells_y > kMaxCells || header.cells_x * header.cells_y > kMaxCells ||
+        !(header.cell_size > 0.0) || !std::isfinite(header.cell_size) ||
+        !std::isfinite(header.min_x) || !std::isfinite(header.min_y)) {
+      throw std::runtime_error("World file has a broken grid: " + path);
+    }
+    const uint64_t cells = header.cells_x * header.cells_y;
+    const uint64_t counts[kSections] = {header.circles,  header.circles, header.circles,
+                                        header.segments, cells + 1,      header.items};
+    const uint64_t sizes[kSections] = {sizeof(double),    sizeof(double),   sizeof(double),
+                                       sizeof(Segment2D), sizeof(uint32_t), sizeof(uint32_t)};
+    for (size_t section = 0; section < kSections; ++section) {
+      const uint64_t offset = header.offsets[section];
+      if (offset % alignof(double) != 0 || offset > size_ ||
+          counts[section] > (size_ - offset) / sizes[section]) {
+        throw std::runtime_error("World file is truncated: " + path);
+      }
+    }
+
+    view_.frame.min = {header.min_x, header.min_y};
+    view_.frame.cell_size = header.cell_size;
+    view_.frame.cells_x = header.cells_x;
+    view_.frame.cells_y = header.cells_y;
+    const auto at = [this, &header](Section which) {
+      return data_ + header.offsets[which];
+    };
+    view_.circle_x = reinterpret_cast<const double *>(at(kCircleX));
+    view_.circle_y = reinterpret_cast<const double *>(at(kCircleY));
+    view_.circle_r = reinterpret_cast<const double *>(at(kCircleR));
+    view_.circles = header.circles;
+    view_.segments = reinterpret_cast<const Segment2D *>(at(kSegments));
+    view_.segment_count = header.segments;
+    view_.cell_start = reinterpret_cast<const uint32_t *>(at(kCellStart));
+    view_.items = reinterpret_cast<const uint32_t *>(at(kItems));
+    view_.item_count = header.items;
+
+    // The only pass over the data: a query trusts these to stay in bounds.
+    if (view_.cell_start[0] != 0 || view_.cell_start[cells] != header.items) {
+      throw std::runtime_error("World file has a broken grid: " + path);
+    }
+    for (uint64_t cell = 0; cell < cells; ++cell) {
+      if (view_.cell_start[cell + 1] < view_.cell_start[cell]) {
+        throw std::runtime_error("World file has a broken grid: " + path);
+      }
+    }
+    const uint64_t shapes = header.circles + header.segments;
+    if (std::any_of(view_.items, view_.items + header.items,
+                    [shapes](uint32_t item) { return item >= shapes; })) {
+      throw std::runtime_error("World file has a broken grid: " + path);
+    }
+  } catch (...) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    throw;
+  }
+}
+
+WorldFile::~WorldFile() { munmap(const_cast<uint8_t *>(data_), size_); }
+
+const UniformGridView &WorldFile::View() const { return view_; }
+
+} // namespace turtlelib
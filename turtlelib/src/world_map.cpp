@@ -0,0 +1,403 @@
+#include "turtlelib/world_map.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace turtlelib {
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+// Few enough segments that testing them all beats another box test.
+constexpr size_t kLeafSegments = 4;
+
+//! @brief Distance along a ray to where it enters a box, infinity on a miss.
+//! @param bound hits further than this don't matter
+double BoxEntry(Point2D min, Point2D max, Point2D origin, Vector2D direction, double bound) {
+  double t_enter = 0.0;
+  double t_leave = bound;
+  const double origins[2] = {origin.x, origin.y};
+  const double directions[2] = {direction.x, direction.y};
+  const double mins[2] = {min.x, min.y};
+  const double maxs[2] = {max.x, max.y};
+  for (int axis = 0; axis < 2; ++axis) {
+    if (directions[axis] == 0.0) {
+      if (origins[axis] < mins[axis] || origins[axis] > maxs[axis]) {
+        return kInf;
+      }
+      continue;
+    }
+    double t0 = (mins[axis] - origins[axis]) / directions[axis];
+    double t1 = (maxs[axis] - origins[axis]) / directions[axis];
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    t_enter = std::max(t_enter, t0);
+    t_leave = std::min(t_leave, t1);
+  }
+  return t_enter <= t_leave ? t_enter : kInf;
+}
+
+//! @brief Next whitespace separated token of a PGM header, skipping # comments.
+std::string PgmToken(std::istream &in) {
+  std::string token;
+  int c = in.get();
+  while (in) {
+    if (c == '#') {
+      while (in && c != '\n') {
+        c = in.get();
+      }
+    } else if (std::isspace(c)) {
+      c = in.get();
+    } else {
+      break;
+    }
+  }
+  while (in && !std::isspace(c) && c != '#') {
+    token.push_back(static_cast<char>(c));
+    c = in.get();
+  }
+  if (c == '#') {
+    in.unget();
+  }
+  // Otherwise c was the single whitespace that ends the header after the last field.
+  return token;
+}
+
+} // namespace
+
+std::vector<Segment2D> LoadSegmentWorld(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Can't open segment world " + path);
+  }
+  std::vector<Segment2D> segments;
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string kind;
+    if (!(fields >> kind)) {
+      continue;
+    }
+    std::vector<double> numbers;
+    double number = 0.0;
+    while (fields >> number) {
+      numbers.push_back(number);
+    }
+    const std::string where = path + ":" + std::to_string(line_number);
+    if (!fields.eof()) {
+      throw std::runtime_error(where + " has a field that is not a number");
+    }
+    std::vector<Point2D> corners;
+    for (size_t i = 0; i + 1 < numbers.size(); i += 2) {
+      corners.push_back({numbers[i], numbers[i + 1]});
+    }
+    if (kind == "segment") {
+      if (numbers.size() != 4) {
+        throw std::runtime_error(where + " segment needs x1 y1 x2 y2");
+      }
+      segments.push_back({corners[0], corners[1]});
+    } else if (kind == "polygon") {
+      if (numbers.size() % 2 != 0 || corners.size() < 3) {
+        throw std::runtime_error(where + " polygon needs 3 or more x y corners");
+      }
+      for (size_t i = 0; i < corners.size(); ++i) {
+        segments.push_back({corners[i], corners[(i + 1) % corners.size()]});
+      }
+    } else {
+      throw std::runtime_error(where + " unknown shape " + kind);
+    }
+  }
+  return segments;
+}
+
+std::vector<Segment2D> ArenaWalls(double x_length, double y_length) {
+  const double x = x_length / 2;
+  const double y = y_length / 2;
+  return {{{x, y}, {-x, y}}, {{-x, y}, {-x, -y}}, {{-x, -y}, {x, -y}}, {{x, -y}, {x, y}}};
+}
+
+SegmentBvh::SegmentBvh(std::vector<Segment2D> segments) : segments_(std::move(segments)) {
+  if (segments_.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("Too many segments for a SegmentBvh");
+  }
+  if (segments_.empty()) {
+    return;
+  }
+  // A binary tree with leaves of at least one segment.
+  nodes_.reserve(2 * segments_.size());
+  nodes_.emplace_back();
+  Build(0, 0, segments_.size());
+}
+
+void SegmentBvh::Build(size_t node, size_t begin, size_t end) {
+  Point2D min{kInf, kInf};
+  Point2D max{-kInf, -kInf};
+  Point2D center_min{kInf, kInf};
+  Point2D center_max{-kInf, -kInf};
+  for (size_t i = begin; i < end; ++i) {
+    const Segment2D &s = segments_[i];
+    min = {std::min({min.x, s.a.x, s.b.x}), std::min({min.y, s.a.y, s.b.y})};
+    max = {std::max({max.x, s.a.x, s.b.x}), std::max({max.y, s.a.y, s.b.y})};
+    const Point2D center{(s.a.x + s.b.x) / 2.0, (s.a.y + s.b.y) / 2.0};
+    center_min = {std::min(center_min.x, center.x), std::min(center_min.y, center.y)};
+    center_max = {std::max(center_max.x, center.x), std::max(center_max.y, center.y)};
+  }
+  nodes_[node].min = min;
+  nodes_[node].max = max;
+  if (end - begin <= kLeafSegments) {
+    nodes_[node].first = static_cast<uint32_t>(begin);
+    nodes_[node].count = static_cast<uint32_t>(end - begin);
+    return;
+  }
+
+  const bool split_x = center_max.x - center_min.x >= center_max.y - center_min.y;
+  const size_t mid = begin + (end - begin) / 2;
+  std::nth_element(segments_.begin() + begin, segments_.begin() + mid, segments_.begin() + end,
+                   [split_x](const Segment2D &l, const Segment2D &r) {
+                     return split_x ? l.a.x + l.b.x < r.a.x + r.b.x
+                                    : l.a.y + l.b.y < r.a.y + r.b.y;
+                   });
+  const size_t child = nodes_.size();
+  nodes_.emplace_back();
+  nodes_.emplace_back();
+  nodes_[node].first = static_cast<uint32_t>(child);
+  Build(child, begin, mid);
+  Build(child + 1, mid, end);
+}
+
+double SegmentBvh::Raycast(Point2D origin, Vector2D direction, double range_max) const {
+  if (nodes_.empty()) {
+    return kInf;
+  }
+  double nearest = kInf;
+  // Median splits keep the depth at log2 of the segment count.
+  uint32_t stack[64];
+  size_t top = 0;
+  if (BoxEntry(nodes_[0].min, nodes_[0].max, origin, direction, range_max) < kInf) {
+    stack[top++] = 0;
+  }
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    const double bound = std::min(nearest, range_max);
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        nearest = std::min(nearest, RaySegmentDistance(origin, direction, segments_[i]));
+      }
+      continue;
+    }
+    const double t_first =
+        BoxEntry(nodes_[node.first].min, nodes_[node.first].max, origin, direction, bound);
+    const double t_second = BoxEntry(nodes_[node.first + 1].min, nodes_[node.first + 1].max,
+                                     origin, direction, bound);
+    // The nearer child goes on top, so its hits can prune the other one.
+    const bool first_nearer = t_first <= t_second;
+    const double t_near = first_nearer ? t_first : t_second;
+    const double t_far = first_nearer ? t_second : t_first;
+    if (t_far < kInf) {
+      stack[top++] = first_nearer ? node.first + 1 : node.first;
+    }
+    if (t_near < kInf) {
+      stack[top++] = first_nearer ? node.first : node.first + 1;
+    }
+  }
+  return nearest <= range_max ? nearest : kInf;
+}
+
+void SegmentBvh::SegmentsNear(Point2D center, double radius, std::vector<size_t> &out) const {
+  out.clear();
+  if (nodes_.empty()) {
+    return;
+  }
+  const auto near = [&](const Node &node) {
+    const double dx = std::max({node.min.x - center.x, 0.0, center.x - node.max.x});
+    const double dy = std::max({node.min.y - center.y, 0.0, center.y - node.max.y});
+    return dx * dx + dy * dy <= radius * radius;
+  };
+  uint32_t stack[64];
+  size_t top = 0;
+  if (near(nodes_[0])) {
+    stack[top++] = 0;
+  }
+  while (top > 0) {
+    const Node &node = nodes_[stack[--top]];
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        const Segment2D &s = segments_[i];
+        if (near({{std::min(s.a.x, s.b.x), std::min(s.a.y, s.b.y)},
+                  {std::max(s.a.x, s.b.x), std::max(s.a.y, s.b.y)}})) {
+          out.push_back(i);
+        }
+      }
+      continue;
+    }
+    // Second child first, so the leaves come out in tree order.
+    if (near(nodes_[node.first + 1])) {
+      stack[top++] = node.first + 1;
+    }
+    if (near(nodes_[node.first])) {
+      stack[top++] = node.first;
+    }
+  }
+}
+
+const std::vector<Segment2D> &SegmentBvh::Segments() const { return segments_; }
+
+OccupancyMap::OccupancyMap(size_t width, size_t height, double resolution, Point2D origin,
+                           std::vector<uint8_t> occupied)
+    : occupied_(std::move(occupied)) {
+  if (width == 0 || height == 0 || !(resolution > 0.0)) {
+    throw std::invalid_argument("OccupancyMap needs cells and a positive resolution");
+  }
+  if (occupied_.size() != width * height) {
+    throw std::invalid_argument("OccupancyMap needs width * height cells");
+  }
+  frame_.min = origin;
+  frame_.cell_size = resolution;
+  frame_.cells_x = width;
+  frame_.cells_y = height;
+}
+
+double OccupancyMap::Raycast(Point2D origin, Vector2D direction, double range_max) const {
+  double t_enter = 0.0;
+  double t_leave = range_max;
+  if (!frame_.Clip(origin, direction, t_enter, t_leave)) {
+    return kInf;
+  }
+  // Starting inside the map, the first cell is the one holding the origin.
+  bool skip = t_enter == 0.0;
+  double t_cell = 0.0;
+  double hit = kInf;
+  GridWalk(frame_, origin + direction * t_enter, direction, t_leave - t_enter,
+           [&](size_t x, size_t y, double t_exit) {
+             if (!skip && occupied_[y * frame_.cells_x + x] != 0) {
+               hit = t_enter + t_cell;
+               return true;
+             }
+             skip = false;
+             t_cell = t_exit;
+             return false;
+           });
+  return hit <= range_max ? hit : kInf;
+}
+
+bool OccupancyMap::Occupied(Point2D p) const {
+  const Point2D max{frame_.min.x + frame_.cell_size * static_cast<double>(frame_.cells_x),
+                    frame_.min.y + frame_.cell_size * static_cast<double>(frame_.cells_y)};
+  if (p.x < frame_.min.x || p.y < frame_.min.y || p.x >= max.x || p.y >= max.y) {
+    return false;
+  }
+  return occupied_[frame_.CellY(p.y) * frame_.cells_x + frame_.CellX(p.x)] != 0;
+}
+
+void OccupancyMap::EdgesNear(Point2D center, double radius, std::vector<Segment2D> &out) const {
+  out.clear();
+  const double size = frame_.cell_size;
+  const Point2D max{frame_.min.x + size * static_cast<double>(frame_.cells_x),
+                    frame_.min.y + size * static_cast<double>(frame_.cells_y)};
+  if (center.x + radius < frame_.min.x || center.y + radius < frame_.min.y ||
+      center.x - radius > max.x || center.y - radius > max.y) {
+    return;
+  }
+  const size_t x_first = frame_.CellX(center.x - radius);
+  const size_t x_last = frame_.CellX(center.x + radius);
+  const size_t y_first = frame_.CellY(center.y - radius);
+  const size_t y_last = frame_.CellY(center.y + radius);
+  const auto occupied = [this](size_t x, size_t y) {
+    return occupied_[y * frame_.cells_x + x] != 0;
+  };
+  for (size_t y = y_first; y <= y_last; ++y) {
+    for (size_t x = x_first; x <= x_last; ++x) {
+      if (!occupied(x, y)) {
+        continue;
+      }
+      const double left = frame_.min.x + size * static_cast<double>(x);
+      const double bottom = frame_.min.y + size * static_cast<double>(y);
+      const Point2D corners[4] = {
+          {left, bottom}, {left + size, bottom}, {left + size, bottom + size}, {left, bottom + size}};
+      if (y == 0 || !occupied(x, y - 1)) {
+        out.push_back({corners[0], corners[1]});
+      }
+      if (x + 1 == frame_.cells_x || !occupied(x + 1, y)) {
+        out.push_back({corners[1], corners[2]});
+      }
+      if (y + 1 == frame_.cells_y || !occupied(x, y + 1)) {
+        out.push_back({corners[2], corners[3]});
+      }
+      if (x == 0 || !occupied(x - 1, y)) {
+        out.push_back({corners[3], corners[0]});
+      }
+    }
+  }
+}
+
+size_t OccupancyMap::Width() const { return frame_.cells_x; }
+
+size_t OccupancyMap::Height() const { return frame_.cells_y; }
+
+double OccupancyMap::Resolution() const { return frame_.cell_size; }
+
+Point2D OccupancyMap::Origin() const { return frame_.min; }
+
+const std::vector<uint8_t> &OccupancyMap::Cells() const { return occupied_; }
+
+OccupancyMap LoadPgmMap(const std::string &path, double resolution, Point2D origin,
+                        double occupied_thresh) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open map image " + path);
+  }
+  const std::string magic = PgmToken(in);
+  if (magic != "P2" && magic != "P5") {
+    throw std::runtime_error(path + " is not a PGM image");
+  }
+  size_t width = 0;
+  size_t height = 0;
+  int maxval = 0;
+  try {
+    width = std::stoul(PgmToken(in));
+    height = std::stoul(PgmToken(in));
+    maxval = std::stoi(PgmToken(in));
+  } catch (const std::logic_error &) {
+    throw std::runtime_error(path + " has a malformed PGM header");
+  }
+  if (maxval <= 0 || maxval > 65535) {
+    throw std::runtime_error(path + " has a PGM maxval out of range");
+  }
+
+  std::vector<uint8_t> occupied(width * height, 0);
+  for (size_t row = 0; row < height; ++row) {
+    for (size_t col = 0; col < width; ++col) {
+      int value = 0;
+      if (magic == "P2") {
+        if (!(in >> value)) {
+          throw std::runtime_error(path + " ends before its last pixel");
+        }
+      } else {
+        // Big endian when a pixel takes two bytes.
+        value = in.get();
+        if (maxval > 255) {
+          value = (value << 8) | in.get();
+        }
+        if (!in) {
+          throw std::runtime_error(path + " ends before its last pixel");
+        }
+      }
+      const double occupancy = static_cast<double>(maxval - value) / maxval;
+      // The image starts at the top row, the map at the bottom one.
+      occupied[(height - 1 - row) * width + col] = occupancy > occupied_thresh ? 1 : 0;
+    }
+  }
+  return OccupancyMap(width, height, resolution, origin, std::move(occupied));
+}
+
+} // namespace turtlelib
@@ -0,0 +1,155 @@
+#include "turtlelib/batch_sim.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "turtlelib/diff_drive.hpp"
+#include "turtlelib/worker_pool.hpp"
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+TEST_CASE("Noiseless worlds follow DiffDrive", "[batch_sim]") {
+  BatchSimParams params;
+  BatchSim sim(5, params);
+  std::vector<DiffDrive> robots;
+  for (size_t i = 0; i < sim.Size(); ++i) {
+    const Transform2D start{{0.1 * i, -0.2 * i}, 0.5 * i};
+    const WheelVelocity command{1.0 + i, 3.0 - 2.0 * i};
+    sim.SetPose(i, start);
+    sim.SetCommand(i, command);
+    robots.emplace_back(params.wheel_track_to_body, params.wheel_radius, start);
+  }
+  for (int step = 0; step < 400; ++step) {
+    sim.Step();
+    for (size_t i = 0; i < sim.Size(); ++i) {
+      robots[i].UpdateBodyConfigWithVel(WheelVelocity{1.0 + i, 3.0 - 2.0 * i} * params.dt);
+    }
+  }
+  REQUIRE(sim.Steps() == 400);
+  for (size_t i = 0; i < sim.Size(); ++i) {
+    const auto expected = robots[i].GetBodyConfig();
+    const auto actual = sim.Pose(i);
+    REQUIRE_THAT(actual.translation().x, WithinAbs(expected.translation().x, 1e-9));
+    REQUIRE_THAT(actual.translation().y, WithinAbs(expected.translation().y, 1e-9));
+    REQUIRE_THAT(std::cos(actual.rotation() - expected.rotation()), WithinAbs(1.0, 1e-12));
+    REQUIRE_THAT(sim.Wheels(i).left, WithinAbs(robots[i].GetWheelConfig().left, 1e-9));
+    REQUIRE_THAT(sim.Wheels(i).right, WithinAbs(robots[i].GetWheelConfig().right, 1e-9));
+    // The last step is the twist of that step's wheel increments.
+    const auto twist = robots[i].TwistFromWheelDelta(
+        WheelConfig{1.0 + i, 3.0 - 2.0 * i} * params.dt);
+    REQUIRE_THAT(sim.StepTwist(i).omega, WithinAbs(twist.omega, 1e-12));
+    REQUIRE_THAT(sim.StepTwist(i).x, WithinAbs(twist.x, 1e-12));
+    REQUIRE(sim.StepTwist(i).y == 0.0);
+  }
+}
+
+TEST_CASE("Noisy worlds do not depend on the thread count", "[batch_sim]") {
+  BatchSimParams params;
+  params.input_noise = 0.01;
+  params.slip_fraction = 0.005;
+  params.seed = 42;
+  WorkerPool pool(4);
+  BatchSim inline_sim(1001, params);
+  BatchSim pooled_sim(1001, params, &pool);
+  for (size_t i = 0; i < inline_sim.Size(); ++i) {
+    inline_sim.SetCommand(i, {2.0, 2.5});
+    pooled_sim.SetCommand(i, {2.0, 2.5});
+  }
+  for (int step = 0; step < 50; ++step) {
+    inline_sim.Step();
+    pooled_sim.Step();
+  }
+  REQUIRE(inline_sim.X() == pooled_sim.X());
+  REQUIRE(inline_sim.Y() == pooled_sim.Y());
+  REQUIRE(inline_sim.Theta() == pooled_sim.Theta());
+  // Each world draws its own noise.
+  REQUIRE(inline_sim.X()[0] != inline_sim.X()[1]);
+}
+
+TEST_CASE("A standing world only slips its encoders", "[batch_sim]") {
+  BatchSimParams params;
+  params.input_noise = 0.1;
+  params.slip_fraction = 0.01;
+  BatchSim sim(3, params);
+  for (int step = 0; step < 10; ++step) {
+    sim.Step();
+  }
+  for (size_t i = 0; i < sim.Size(); ++i) {
+    REQUIRE(sim.X()[i] == 0.0);
+    REQUIRE(sim.Theta()[i] == 0.0);
+    REQUIRE(std::abs(sim.Wheels(i).left) <= 10 * params.slip_fraction);
+  }
+}
+
+TEST_CASE("A sim set to a snapshot repeats the original", "[batch_sim]") {
+  BatchSimParams params;
+  params.input_noise = 0.02;
+  params.slip_fraction = 0.01;
+  params.seed = 9;
+  BatchSim sim(4, params);
+  for (size_t i = 0; i < sim.Size(); ++i) {
+    sim.SetCommand(i, {1.0 + i, 2.0});
+  }
+  for (int step = 0; step < 30; ++step) {
+    sim.Step();
+  }
+  const auto snapshot = sim.State();
+
+  BatchSim fork(4, params);
+  fork.SetState(snapshot);
+  BatchSimParams other_seed = params;
+  other_seed.seed = 10;
+  BatchSim other(4, other_seed);
+  other.SetState(snapshot);
+  REQUIRE(fork.Steps() == sim.Steps());
+  REQUIRE(fork.StepTwist(2).x == sim.StepTwist(2).x);
+  for (int step = 0; step < 30; ++step) {
+    sim.Step();
+    fork.Step();
+    other.Step();
+  }
+  REQUIRE(fork.X() == sim.X());
+  REQUIRE(fork.Theta() == sim.Theta());
+  REQUIRE(fork.Wheels(3).left == sim.Wheels(3).left);
+  // Same start and commands, other noise.
+  REQUIRE(other.X() != sim.X());
+  REQUIRE_THAT(other.X()[0], WithinAbs(sim.X()[0], 0.05));
+
+  // Going back to the snapshot forgets the steps after it.
+  sim.SetState(snapshot);
+  REQUIRE(sim.State().x == snapshot.x);
+  REQUIRE(sim.Steps() == 30);
+  REQUIRE_THROWS_AS(BatchSim(3, params).SetState(snapshot), std::invalid_argument);
+}
+
+TEST_CASE("Batch log reads back what was written", "[batch_sim]") {
+  const std::string path = "test_batch_sim.log";
+  BatchSim sim(3);
+  sim.SetCommand(1, {1.0, 1.0});
+  {
+    BatchLogWriter log(path, sim.Size());
+    log.Write(sim);
+    for (int step = 0; step < 10; ++step) {
+      sim.Step();
+    }
+    log.Write(sim);
+  }
+  const BatchLog log = ReadBatchLog(path);
+  std::remove(path.c_str());
+  REQUIRE(log.worlds == 3);
+  REQUIRE(log.steps == std::vector<uint64_t>{0, 10});
+  REQUIRE(log.records.size() == 6);
+  REQUIRE(log.records[1].x == 0.0f);
+  REQUIRE_THAT(log.records[3 + 1].x, WithinAbs(sim.X()[1], 1e-6));
+  REQUIRE_THAT(log.records[3 + 1].left, WithinAbs(10 * BatchSimParams{}.dt, 1e-6));
+}
+
+} // namespace turtlelib
@@ -0,0 +1,100 @@
+#include "turtlelib/circle_fit.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+//! @brief Range along a ray from the origin to a circle, inf on a miss.
+double RayToCircle(double angle, Point2D center, double radius) {
+  const double proj = center.x * std::cos(angle) + center.y * std::sin(angle);
+  const double d_sq = center.x * center.x + center.y * center.y - proj * proj;
+  if (proj < 0.0 || d_sq > radius * radius) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return proj - std::sqrt(radius * radius - d_sq);
+}
+
+//! @brief Range along a ray from the origin to the line x = wall_x.
+double RayToWall(double angle, double wall_x) {
+  const double c = std::cos(angle);
+  return c > 1e-9 ? wall_x / c : std::numeric_limits<double>::infinity();
+}
+} // namespace
+
+TEST_CASE("FitCircle recovers a circle", "[circle_fit]") {
+  // 13 points, so both the SIMD body and the scalar tail run.
+  std::vector<double> x;
+  std::vector<double> y;
+  for (int i = 0; i < 13; ++i) {
+    const double angle = -0.8 + 0.1 * i;
+    x.push_back(1.5 + 0.2 * std::cos(angle));
+    y.push_back(-0.5 + 0.2 * std::sin(angle));
+  }
+  const auto fit = FitCircle(x.data(), y.data(), x.size());
+  REQUIRE_THAT(fit.center.x, WithinAbs(1.5, 1e-9));
+  REQUIRE_THAT(fit.center.y, WithinAbs(-0.5, 1e-9));
+  REQUIRE_THAT(fit.radius, WithinAbs(0.2, 1e-9));
+  REQUIRE_THAT(fit.rms_residual, WithinAbs(0.0, 1e-9));
+
+  REQUIRE_THROWS_AS(FitCircle(x.data(), y.data(), 2), std::invalid_argument);
+  const std::vector<double> line_x{0.0, 1.0, 2.0, 3.0};
+  const std::vector<double> line_y{1.0, 1.0, 1.0, 1.0};
+  REQUIRE_THROWS_AS(FitCircle(line_x.data(), line_y.data(), 4), std::domain_error);
+}
+
+TEST_CASE("LandmarkDetector finds cylinders and skips walls", "[circle_fit]") {
+  const size_t count = 360;
+  const double increment = 2.0 * PI / count;
+  const Point2D cylinder_a{1.0, 0.5};
+  const Point2D cylinder_b{-0.8, -0.6};
+  // One cylinder straddles the start of the scan.
+  const Point2D cylinder_wrap{0.9, 0.0};
+  const double radius = 0.05;
+
+  std::vector<float> ranges(count);
+  for (size_t i = 0; i < count; ++i) {
+    const double angle = increment * i;
+    double range = RayToWall(angle, 2.0);
+    for (const auto &center : {cylinder_a, cylinder_b, cylinder_wrap}) {
+      range = std::min(range, RayToCircle(angle, center, radius));
+    }
+    ranges.at(i) = static_cast<float>(range);
+  }
+
+  LandmarkDetectorParams params;
+  params.cluster_threshold = 0.1;
+  params.min_cluster_points = 3;
+  LandmarkDetector detector(params);
+  const auto &found = detector.Detect(ranges, 0.0, increment, 0.1, 3.5);
+
+  REQUIRE(found.size() == 3);
+  for (const auto &center : {cylinder_a, cylinder_b, cylinder_wrap}) {
+    bool matched = false;
+    for (const auto &landmark : found) {
+      const double error =
+          std::hypot(landmark.circle.center.x - center.x, landmark.circle.center.y - center.y);
+      if (error < 5e-3) {
+        matched = true;
+        REQUIRE_THAT(landmark.circle.radius, WithinAbs(radius, 5e-3));
+        REQUIRE_THAT(landmark.range, WithinAbs(std::hypot(center.x, center.y), 5e-3));
+        REQUIRE_THAT(landmark.bearing, WithinAbs(std::atan2(center.y, center.x), 5e-3));
+      }
+    }
+    CAPTURE(center.x, center.y);
+    REQUIRE(matched);
+  }
+
+  // Running again on the same scan gives the same answer from reused buffers.
+  REQUIRE(detector.Detect(ranges, 0.0, increment, 0.1, 3.5).size() == 3);
+}
+
+} // namespace turtlelib
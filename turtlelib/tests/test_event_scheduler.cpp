@@ -0,0 +1,90 @@
+#include "turtlelib/event_scheduler.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace turtlelib {
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Streams run in time order with their phase", "[event_scheduler]") {
+  EventScheduler scheduler;
+  std::vector<std::string> log;
+  scheduler.AddStream({10ms, 0ms, 0ms}, [&](std::chrono::nanoseconds t) {
+    log.push_back("physics " + std::to_string(t / 1ms));
+  });
+  scheduler.AddStream({20ms, 5ms, 0ms}, [&](std::chrono::nanoseconds t) {
+    log.push_back("sensor " + std::to_string(t / 1ms));
+  });
+  REQUIRE(scheduler.NextEventTime() == 0ms);
+  REQUIRE(scheduler.RunUntil(30ms) == 6);
+  REQUIRE(log == std::vector<std::string>{"physics 0", "sensor 5", "physics 10", "physics 20",
+                                          "sensor 25", "physics 30"});
+  REQUIRE(scheduler.Now() == 30ms);
+  REQUIRE(scheduler.NextEventTime() == 40ms);
+}
+
+TEST_CASE("Events at the same time run in the order of their streams", "[event_scheduler]") {
+  EventScheduler scheduler;
+  std::vector<int> log;
+  scheduler.AddStream({10ms}, [&](std::chrono::nanoseconds) { log.push_back(0); });
+  scheduler.AddStream({5ms}, [&](std::chrono::nanoseconds) { log.push_back(1); });
+  scheduler.RunUntil(10ms);
+  REQUIRE(log == std::vector<int>{0, 1, 1, 0, 1});
+}
+
+TEST_CASE("Samples are delivered after their latency", "[event_scheduler]") {
+  EventScheduler scheduler;
+  std::vector<std::pair<int64_t, int64_t>> delivered;
+  scheduler.AddStream(
+      {10ms, 0ms, 25ms}, [](std::chrono::nanoseconds) {},
+      [&](std::chrono::nanoseconds sample) {
+        delivered.emplace_back(scheduler.Now() / 1ms, sample / 1ms);
+      });
+  scheduler.RunUntil(50ms);
+  REQUIRE(delivered == std::vector<std::pair<int64_t, int64_t>>{{25, 0}, {35, 10}, {45, 20}});
+}
+
+TEST_CASE("Running events does not grow the queue", "[event_scheduler]") {
+  EventScheduler scheduler;
+  scheduler.AddStream({5ms}, [](std::chrono::nanoseconds) {});
+  scheduler.AddStream({200ms, 3ms, 30ms}, [](std::chrono::nanoseconds) {},
+                      [](std::chrono::nanoseconds) {});
+  scheduler.AddStream({7ms, 1ms, 20ms}, [](std::chrono::nanoseconds) {},
+                      [](std::chrono::nanoseconds) {});
+  const size_t capacity = scheduler.Capacity();
+  size_t most = 0;
+  for (auto t = 0ms; t < 2000ms; t += 1ms) {
+    scheduler.RunUntil(t);
+    most = std::max(most, scheduler.Pending());
+  }
+  REQUIRE(most <= capacity);
+  REQUIRE(scheduler.Capacity() == capacity);
+}
+
+TEST_CASE("A stream added later starts at its next sample", "[event_scheduler]") {
+  EventScheduler scheduler;
+  scheduler.AddStream({10ms}, [](std::chrono::nanoseconds) {});
+  scheduler.RunUntil(23ms);
+  std::vector<int64_t> samples;
+  scheduler.AddStream({10ms, 5ms, 0ms},
+                      [&](std::chrono::nanoseconds t) { samples.push_back(t / 1ms); });
+  scheduler.RunUntil(50ms);
+  REQUIRE(samples == std::vector<int64_t>{25, 35, 45});
+}
+
+TEST_CASE("Bad stream timing throws", "[event_scheduler]") {
+  EventScheduler scheduler;
+  REQUIRE_THROWS_AS(scheduler.AddStream({0ms}, [](std::chrono::nanoseconds) {}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(scheduler.AddStream({10ms, 0ms, -1ms}, [](std::chrono::nanoseconds) {}),
+                    std::invalid_argument);
+}
+
+} // namespace turtlelib
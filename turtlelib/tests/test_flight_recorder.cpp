@@ -0,0 +1,130 @@
+#include "turtlelib/flight_recorder.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace turtlelib {
+
+namespace {
+struct TestRecord {
+  uint64_t id;
+  double value;
+  uint8_t tag;
+};
+} // namespace
+
+TEST_CASE("Ring keeps the newest records in order", "[flight_recorder]") {
+  FlightRecorder<TestRecord> recorder("", 4);
+  REQUIRE(recorder.Snapshot().empty());
+
+  for (uint64_t i = 0; i < 10; ++i) {
+    recorder.Push({i, 0.5 * i, static_cast<uint8_t>(i)});
+  }
+  REQUIRE(recorder.Count() == 10);
+  const auto records = recorder.Snapshot();
+  REQUIRE(records.size() == 4);
+  for (size_t i = 0; i < records.size(); ++i) {
+    REQUIRE(records.at(i).id == 6 + i);
+    REQUIRE(records.at(i).value == 0.5 * (6 + i));
+  }
+}
+
+TEST_CASE("Dumps and live files read back", "[flight_recorder]") {
+  const std::string live_path = "test_flight_recorder_live.bin";
+  const std::string dump_path = "test_flight_recorder_dump.bin";
+  {
+    FlightRecorder<TestRecord> recorder(live_path, 8);
+    for (uint64_t i = 0; i < 5; ++i) {
+      recorder.Push({i, 1.0, 0});
+    }
+    REQUIRE(recorder.Dump(dump_path) == 5);
+
+    // The live file is readable while the recorder is still writing.
+    const auto live = ReadFlightRecord<TestRecord>(live_path);
+    REQUIRE(live.size() == 5);
+    REQUIRE(live.back().id == 4);
+  }
+  const auto dumped = ReadFlightRecord<TestRecord>(dump_path);
+  REQUIRE(dumped.size() == 5);
+  for (size_t i = 0; i < dumped.size(); ++i) {
+    REQUIRE(dumped.at(i).id == i);
+  }
+
+  // A different record type is refused.
+  REQUIRE_THROWS_AS(ReadFlightRecord<uint32_t>(dump_path), std::runtime_error);
+
+  std::remove(live_path.c_str());
+  std::remove(dump_path.c_str());
+}
+
+TEST_CASE("Concurrent writers lose nothing", "[flight_recorder]") {
+  constexpr size_t kThreads = 4;
+  constexpr uint64_t kPerThread = 1000;
+  FlightRecorder<TestRecord> recorder("", kThreads * kPerThread);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&recorder, t]() {
+      for (uint64_t i = 0; i < kPerThread; ++i) {
+        recorder.Push({t * kPerThread + i, 0.0, static_cast<uint8_t>(t)});
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const auto records = recorder.Snapshot();
+  REQUIRE(records.size() == kThreads * kPerThread);
+  std::vector<bool> seen(kThreads * kPerThread, false);
+  for (const auto &record : records) {
+    REQUIRE(record.id / kPerThread == record.tag);
+    seen.at(record.id) = true;
+  }
+  for (auto s : seen) {
+    REQUIRE(s);
+  }
+}
+
+TEST_CASE("Writers lapping each other never leave a torn record", "[flight_recorder]") {
+  constexpr size_t kThreads = 4;
+  constexpr uint64_t kPerThread = 20000;
+  // Two slots, so writers a lap apart meet in the same slot all the time.
+  FlightRecorder<TestRecord> recorder("", 2);
+  const auto whole = [](const TestRecord &record) {
+    return record.value == static_cast<double>(record.id) &&
+           record.tag == static_cast<uint8_t>(record.id);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&recorder, t]() {
+      for (uint64_t i = 0; i < kPerThread; ++i) {
+        const uint64_t id = t * kPerThread + i;
+        recorder.Push({id, static_cast<double>(id), static_cast<uint8_t>(id)});
+      }
+    });
+  }
+  size_t torn = 0;
+  for (int i = 0; i < 2000; ++i) {
+    for (const auto &record : recorder.Snapshot()) {
+      torn += whole(record) ? 0 : 1;
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  REQUIRE(torn == 0);
+  const auto records = recorder.Snapshot();
+  REQUIRE(records.size() == 2);
+  for (const auto &record : records) {
+    REQUIRE(whole(record));
+  }
+}
+
+} // namespace turtlelib
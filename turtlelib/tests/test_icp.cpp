@@ -0,0 +1,93 @@
+#include "turtlelib/icp.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+constexpr double kRoomXMin = -2.0;
+constexpr double kRoomXMax = 3.0;
+constexpr double kRoomYMin = -1.5;
+constexpr double kRoomYMax = 2.5;
+
+//! @brief Scan of a rectangular room from a pose inside it.
+std::vector<float> RoomScan(const Transform2D &T_world_scan, size_t beams) {
+  std::vector<float> ranges;
+  const auto origin = T_world_scan.translation();
+  for (size_t i = 0; i < beams; ++i) {
+    const double angle = T_world_scan.rotation() + 2.0 * PI * i / beams;
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    double range = std::numeric_limits<double>::infinity();
+    if (c > 1e-9) {
+      range = std::min(range, (kRoomXMax - origin.x) / c);
+    } else if (c < -1e-9) {
+      range = std::min(range, (kRoomXMin - origin.x) / c);
+    }
+    if (s > 1e-9) {
+      range = std::min(range, (kRoomYMax - origin.y) / s);
+    } else if (s < -1e-9) {
+      range = std::min(range, (kRoomYMin - origin.y) / s);
+    }
+    ranges.push_back(static_cast<float>(range));
+  }
+  return ranges;
+}
+} // namespace
+
+TEST_CASE("ScanToPoints drops invalid ranges", "[icp]") {
+  std::vector<double> x;
+  std::vector<double> y;
+  ScanToPoints({1.0f, 0.05f, 2.0f, 5.0f}, 0.0, PI / 2.0, 0.1, 3.5, x, y);
+  REQUIRE(x.size() == 2);
+  REQUIRE_THAT(x.at(0), WithinAbs(1.0, 1e-9));
+  REQUIRE_THAT(y.at(0), WithinAbs(0.0, 1e-9));
+  REQUIRE_THAT(x.at(1), WithinAbs(-2.0, 1e-6));
+  REQUIRE_THAT(y.at(1), WithinAbs(0.0, 1e-6));
+}
+
+TEST_CASE("ScanMatcher recovers the motion between two scans", "[icp]") {
+  // 359 beams, so both the SIMD body and the scalar tail run.
+  const size_t beams = 359;
+  const double inc = 2.0 * PI / beams;
+  const Transform2D T_world_ref{{0.2, 0.1}, 0.0};
+  const Transform2D T_world_scan{{0.28, 0.06}, 0.06};
+  const auto expected = T_world_ref.inv() * T_world_scan;
+
+  std::vector<double> ref_x, ref_y, x, y;
+  ScanToPoints(RoomScan(T_world_ref, beams), 0.0, inc, 0.1, 10.0, ref_x, ref_y);
+  ScanToPoints(RoomScan(T_world_scan, beams), 0.0, inc, 0.1, 10.0, x, y);
+
+  ScanMatcher matcher;
+  REQUIRE_FALSE(matcher.HasReference());
+  REQUIRE_FALSE(matcher.Match(x, y, Transform2D{}).valid);
+  matcher.SetReference(ref_x, ref_y);
+  REQUIRE(matcher.HasReference());
+
+  const auto result = matcher.Match(x, y, Transform2D{});
+  REQUIRE(result.valid);
+  REQUIRE(result.converged);
+  REQUIRE(result.iterations < 30);
+  REQUIRE_THAT(result.T_ref_scan.translation().x, WithinAbs(expected.translation().x, 5e-3));
+  REQUIRE_THAT(result.T_ref_scan.translation().y, WithinAbs(expected.translation().y, 5e-3));
+  REQUIRE_THAT(result.T_ref_scan.rotation(), WithinAbs(expected.rotation(), 2e-3));
+  REQUIRE(result.rms_error < 5e-3);
+}
+
+TEST_CASE("ScanMatcher rejects a scan with too few pairs", "[icp]") {
+  ScanMatcher matcher;
+  matcher.SetReference({0.0, 0.1, 0.2}, {1.0, 1.0, 1.0});
+  const auto result = matcher.Match({0.0, 0.1, 0.2}, {1.0, 1.0, 1.0}, Transform2D{});
+  REQUIRE_FALSE(result.valid);
+  REQUIRE_FALSE(result.converged);
+}
+
+} // namespace turtlelib
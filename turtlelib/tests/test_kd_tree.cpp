@@ -0,0 +1,53 @@
+#include "turtlelib/kd_tree.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <vector>
+
+namespace turtlelib {
+
+TEST_CASE("KdTree2D matches brute force", "[kd_tree]") {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> coord(-5.0, 5.0);
+  std::vector<double> x;
+  std::vector<double> y;
+  for (int i = 0; i < 257; ++i) {
+    x.push_back(coord(gen));
+    y.push_back(coord(gen));
+  }
+  KdTree2D tree;
+  tree.Build(x, y);
+  REQUIRE(tree.Size() == x.size());
+
+  for (int q = 0; q < 200; ++q) {
+    const Point2D query{coord(gen), coord(gen)};
+    size_t best = 0;
+    double best_sq = 1e300;
+    for (size_t i = 0; i < x.size(); ++i) {
+      const double d_sq = (x[i] - query.x) * (x[i] - query.x) + (y[i] - query.y) * (y[i] - query.y);
+      if (d_sq < best_sq) {
+        best_sq = d_sq;
+        best = i;
+      }
+    }
+    REQUIRE(tree.Nearest(query) == best);
+  }
+}
+
+TEST_CASE("KdTree2D max distance and empty tree", "[kd_tree]") {
+  KdTree2D tree;
+  REQUIRE(tree.Nearest({0.0, 0.0}) == KdTree2D::kNone);
+
+  tree.Build({0.0, 1.0}, {0.0, 1.0});
+  REQUIRE(tree.Nearest({0.9, 0.9}) == 1);
+  REQUIRE(tree.Nearest({0.5, 2.0}, 0.5) == KdTree2D::kNone);
+  REQUIRE(tree.Nearest({0.1, 0.0}, 0.5) == 0);
+
+  // A rebuild replaces the old points.
+  tree.Build({3.0}, {3.0});
+  REQUIRE(tree.Size() == 1);
+  REQUIRE(tree.Nearest({0.0, 0.0}) == 0);
+}
+
+} // namespace turtlelib
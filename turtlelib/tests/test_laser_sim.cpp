@@ -0,0 +1,128 @@
+#include "turtlelib/laser_sim.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief One beam at a time, the way nusim used to cast them.
+double BruteForce(Point2D origin, double angle, const std::vector<double> &cx,
+                  const std::vector<double> &cy, const std::vector<double> &cr,
+                  const std::vector<Segment2D> &segments) {
+  const double dx = std::cos(angle);
+  const double dy = std::sin(angle);
+  double nearest = std::numeric_limits<double>::infinity();
+  for (size_t k = 0; k < cx.size(); ++k) {
+    const double vx = cx[k] - origin.x;
+    const double vy = cy[k] - origin.y;
+    const double proj = vx * dx + vy * dy;
+    const double disc = cr[k] * cr[k] - (vx * vx + vy * vy) + proj * proj;
+    if (vx * vx + vy * vy > cr[k] * cr[k] && disc >= 0.0 && proj - std::sqrt(disc) >= 0.0) {
+      nearest = std::min(nearest, proj - std::sqrt(disc));
+    }
+  }
+  for (const auto &segment : segments) {
+    const double ex = segment.b.x - segment.a.x;
+    const double ey = segment.b.y - segment.a.y;
+    const double wx = segment.a.x - origin.x;
+    const double wy = segment.a.y - origin.y;
+    const double denom = dx * ey - dy * ex;
+    if (denom == 0.0) {
+      continue;
+    }
+    const double t = (wx * ey - wy * ex) / denom;
+    const double u = (wx * dy - wy * dx) / denom;
+    if (t >= 0.0 && u >= 0.0 && u <= 1.0) {
+      nearest = std::min(nearest, t);
+    }
+  }
+  return nearest;
+}
+
+//! @brief Walls of the square arena [-half, half]^2.
+std::vector<Segment2D> Box(double half) {
+  return {{{-half, -half}, {half, -half}},
+          {{half, -half}, {half, half}},
+          {{half, half}, {-half, half}},
+          {{-half, half}, {-half, -half}}};
+}
+
+} // namespace
+
+TEST_CASE("Beams hit the arena walls", "[laser_sim]") {
+  // Beams along +x, +y, -x and -y in the body frame.
+  LaserSim laser(0.0, PI / 2.0, 4, 3.5);
+  std::vector<float> ranges;
+  laser.Cast(Transform2D{{0.5, -0.25}, PI / 2.0}, {}, {}, {}, Box(1.0), ranges, -1.0f);
+  REQUIRE(ranges.size() == 4);
+  REQUIRE_THAT(ranges[0], WithinAbs(1.25, 1e-6));
+  REQUIRE_THAT(ranges[1], WithinAbs(1.5, 1e-6));
+  REQUIRE_THAT(ranges[2], WithinAbs(0.75, 1e-6));
+  REQUIRE_THAT(ranges[3], WithinAbs(0.5, 1e-6));
+}
+
+TEST_CASE("Each beam keeps its nearest hit", "[laser_sim]") {
+  LaserSim laser(0.0, PI, 2, 3.5);
+  std::vector<float> ranges;
+  // An obstacle in front of the +x wall, another one behind the -x wall.
+  laser.Cast(Transform2D{}, {0.6, -1.5}, {0.0, 0.0}, {0.1, 0.2}, Box(1.0), ranges, -1.0f);
+  REQUIRE_THAT(ranges[0], WithinAbs(0.5, 1e-6));
+  REQUIRE_THAT(ranges[1], WithinAbs(1.0, 1e-6));
+}
+
+TEST_CASE("Beams without a hit in range are misses", "[laser_sim]") {
+  LaserSim laser(0.0, PI / 2.0, 3, 1.0);
+  std::vector<float> ranges;
+  // Wall out of range along +x, obstacle behind along -x, nothing along +y.
+  laser.Cast(Transform2D{}, {-0.5}, {0.0}, {0.1}, {{{2.0, -1.0}, {2.0, 1.0}}}, ranges, 42.0f);
+  REQUIRE(ranges == std::vector<float>{42.0f, 42.0f, 0.4f});
+}
+
+TEST_CASE("Lanes agree with one beam at a time", "[laser_sim]") {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> coord(-2.0, 2.0);
+  std::uniform_real_distribution<double> radius(0.02, 0.3);
+  // An odd beam count leaves a partly filled last lane.
+  const size_t beams = 361;
+  const double increment = 2.0 * PI / static_cast<double>(beams);
+  LaserSim laser(-PI, increment, beams, 3.5);
+  std::vector<float> ranges;
+  for (int scene = 0; scene < 20; ++scene) {
+    std::vector<double> cx, cy, cr;
+    for (int k = 0; k < 8; ++k) {
+      cx.push_back(coord(gen));
+      cy.push_back(coord(gen));
+      cr.push_back(radius(gen));
+    }
+    const Point2D origin{coord(gen), coord(gen)};
+    const double heading = coord(gen);
+    laser.Cast(Transform2D{{origin.x, origin.y}, heading}, cx, cy, cr, Box(2.5), ranges, -1.0f);
+    for (size_t i = 0; i < beams; ++i) {
+      const double angle = heading - PI + increment * static_cast<double>(i);
+      const double expected = BruteForce(origin, angle, cx, cy, cr, Box(2.5));
+      REQUIRE_THAT(ranges[i], WithinAbs(expected <= 3.5 ? expected : -1.0, 1e-5));
+    }
+  }
+}
+
+TEST_CASE("A reused scan is not reallocated", "[laser_sim]") {
+  LaserSim laser(0.0, 0.01, 2048, 3.5);
+  std::vector<float> ranges;
+  laser.Cast(Transform2D{}, {}, {}, {}, Box(1.0), ranges, 0.0f);
+  const float *data = ranges.data();
+  laser.Cast(Transform2D{{0.1, 0.2}, 1.0}, {0.5}, {0.5}, {0.1}, Box(1.0), ranges, 0.0f);
+  REQUIRE(ranges.size() == 2048);
+  REQUIRE(ranges.data() == data);
+}
+
+} // namespace turtlelib
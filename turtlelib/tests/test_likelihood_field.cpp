@@ -0,0 +1,71 @@
+#include "turtlelib/likelihood_field.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+TEST_CASE("SquaredDistanceTransform matches brute force", "[likelihood_field]") {
+  const size_t width = 23;
+  const size_t height = 17;
+  std::mt19937 gen(3);
+  std::bernoulli_distribution occupied(0.05);
+  std::vector<uint8_t> grid(width * height);
+  for (auto &cell : grid) {
+    cell = occupied(gen) ? 1 : 0;
+  }
+  grid.at(0) = 1;
+
+  const auto squared = SquaredDistanceTransform(grid, width, height);
+  REQUIRE(squared.size() == grid.size());
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      double best = 1e300;
+      for (size_t oy = 0; oy < height; ++oy) {
+        for (size_t ox = 0; ox < width; ++ox) {
+          if (grid[oy * width + ox]) {
+            const double dx = static_cast<double>(x) - static_cast<double>(ox);
+            const double dy = static_cast<double>(y) - static_cast<double>(oy);
+            best = std::min(best, dx * dx + dy * dy);
+          }
+        }
+      }
+      REQUIRE(squared[y * width + x] == best);
+    }
+  }
+}
+
+TEST_CASE("SquaredDistanceTransform of an empty grid", "[likelihood_field]") {
+  const auto squared = SquaredDistanceTransform(std::vector<uint8_t>(12, 0), 4, 3);
+  REQUIRE(std::isinf(squared.at(5)));
+  REQUIRE_THROWS_AS(SquaredDistanceTransform(std::vector<uint8_t>(5, 0), 4, 3),
+                    std::invalid_argument);
+}
+
+TEST_CASE("LikelihoodField is highest on obstacles", "[likelihood_field]") {
+  // A 1 m square at 0.1 m, with a wall along x = 0.55.
+  const size_t size = 10;
+  std::vector<uint8_t> grid(size * size, 0);
+  for (size_t y = 0; y < size; ++y) {
+    grid[y * size + 5] = 1;
+  }
+  const LikelihoodField field(grid, size, size, 0.1, {-0.5, -0.5});
+  REQUIRE_THAT(field.Distance({0.05, 0.0}), WithinAbs(0.0, 1e-6));
+  REQUIRE_THAT(field.Distance({-0.25, 0.0}), WithinAbs(0.3, 1e-6));
+  REQUIRE(std::isinf(field.Distance({2.0, 0.0})));
+
+  REQUIRE(field.LogLikelihood(0.05, 0.0) > field.LogLikelihood(-0.05, 0.0));
+  REQUIRE(field.LogLikelihood(-0.05, 0.0) > field.LogLikelihood(-0.35, 0.0));
+  // Outside the map only the random component is left, which is the floor.
+  REQUIRE_THAT(field.LogLikelihood(2.0, 0.0), WithinAbs(std::log(0.1 / 3.5), 1e-6));
+  REQUIRE(field.LogLikelihood(-0.45, 0.0) >= field.LogLikelihood(2.0, 0.0));
+}
+
+} // namespace turtlelib
@@ -0,0 +1,112 @@
+#include "turtlelib/load_shedder.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <chrono>
+#include <stdexcept>
+
+namespace turtlelib {
+
+using std::chrono::milliseconds;
+
+namespace {
+
+LoadShedParams TestParams() {
+  LoadShedParams params;
+  params.budget = milliseconds{5};
+  params.max_level = 3;
+  params.shed_hold = 10;
+  params.restore_hold = 50;
+  return params;
+}
+
+} // namespace
+
+TEST_CASE("Ticks within budget never shed", "[load_shedder]") {
+  LoadShedder shedder(TestParams());
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(shedder.Record(milliseconds{3}) == 0);
+  }
+  REQUIRE(shedder.Ticks() == 1000);
+  REQUIRE(shedder.Overruns() == 0);
+  REQUIRE(shedder.WorstTick() == milliseconds{3});
+  REQUIRE_THAT(shedder.Load(), Catch::Matchers::WithinAbs(0.6, 1e-9));
+}
+
+TEST_CASE("Overload sheds one level per hold up to the top", "[load_shedder]") {
+  LoadShedder shedder(TestParams());
+  for (int i = 0; i < 9; ++i) {
+    REQUIRE(shedder.Record(milliseconds{8}) == 0);
+  }
+  REQUIRE(shedder.Record(milliseconds{8}) == 1);
+  for (int i = 0; i < 9; ++i) {
+    REQUIRE(shedder.Record(milliseconds{8}) == 1);
+  }
+  REQUIRE(shedder.Record(milliseconds{8}) == 2);
+  for (int i = 0; i < 100; ++i) {
+    shedder.Record(milliseconds{8});
+  }
+  REQUIRE(shedder.Level() == 3);
+  REQUIRE(shedder.Overruns() == 120);
+}
+
+TEST_CASE("A single slow tick does not shed", "[load_shedder]") {
+  LoadShedder shedder(TestParams());
+  for (int i = 0; i < 100; ++i) {
+    shedder.Record(milliseconds{1});
+  }
+  shedder.Record(milliseconds{20});
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(shedder.Record(milliseconds{1}) == 0);
+  }
+  REQUIRE(shedder.Overruns() == 1);
+  REQUIRE(shedder.WorstTick() == milliseconds{20});
+}
+
+TEST_CASE("Restoring needs a low load held for longer", "[load_shedder]") {
+  LoadShedder shedder(TestParams());
+  for (int i = 0; i < 30; ++i) {
+    shedder.Record(milliseconds{8});
+  }
+  REQUIRE(shedder.Level() == 3);
+
+  // Under the shed load but over the restore load holds the level.
+  for (int i = 0; i < 500; ++i) {
+    REQUIRE(shedder.Record(milliseconds{3}) == 3);
+  }
+  // Light ticks restore one level per restore_hold.
+  int ticks = 0;
+  while (shedder.Level() == 3) {
+    shedder.Record(milliseconds{1});
+    ++ticks;
+  }
+  REQUIRE(ticks >= 50);
+  for (int i = 0; i < 49; ++i) {
+    REQUIRE(shedder.Record(milliseconds{1}) == 2);
+  }
+  REQUIRE(shedder.Record(milliseconds{1}) == 1);
+}
+
+TEST_CASE("Max level 0 never sheds", "[load_shedder]") {
+  auto params = TestParams();
+  params.max_level = 0;
+  LoadShedder shedder(params);
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(shedder.Record(milliseconds{50}) == 0);
+  }
+}
+
+TEST_CASE("Bad load shedding params throw", "[load_shedder]") {
+  auto params = TestParams();
+  params.budget = milliseconds{0};
+  REQUIRE_THROWS_AS(LoadShedder(params), std::invalid_argument);
+  params = TestParams();
+  params.smoothing = 0.0;
+  REQUIRE_THROWS_AS(LoadShedder(params), std::invalid_argument);
+  params = TestParams();
+  params.restore_load = params.shed_load;
+  REQUIRE_THROWS_AS(LoadShedder(params), std::invalid_argument);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,154 @@
+#include "turtlelib/mcl.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+constexpr double kResolution = 0.05;
+constexpr double kHalfX = 2.0;
+constexpr double kHalfY = 1.5;
+const Point2D kObstacle{0.8, -0.6};
+constexpr double kObstacleRadius = 0.2;
+
+//! @brief Rectangular arena with one round obstacle, one cell of margin.
+std::shared_ptr<const LikelihoodField> MakeField() {
+  const auto width = static_cast<size_t>(std::lround(2.0 * kHalfX / kResolution)) + 2;
+  const auto height = static_cast<size_t>(std::lround(2.0 * kHalfY / kResolution)) + 2;
+  const Point2D origin{-kHalfX - kResolution, -kHalfY - kResolution};
+  std::vector<uint8_t> grid(width * height, 0);
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      const double cx = origin.x + (x + 0.5) * kResolution;
+      const double cy = origin.y + (y + 0.5) * kResolution;
+      const bool wall = std::abs(cx) > kHalfX - 0.5 * kResolution ||
+                        std::abs(cy) > kHalfY - 0.5 * kResolution;
+      const bool obstacle =
+          std::hypot(cx - kObstacle.x, cy - kObstacle.y) < kObstacleRadius;
+      grid[y * width + x] = wall || obstacle ? 1 : 0;
+    }
+  }
+  return std::make_shared<LikelihoodField>(grid, width, height, kResolution, origin);
+}
+
+//! @brief Simulated scan, 90 beams over the full circle.
+std::vector<float> Scan(const Transform2D &pose) {
+  std::vector<float> ranges;
+  for (int i = 0; i < 90; ++i) {
+    const double angle = pose.rotation() + 2.0 * PI * i / 90;
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    const auto p = pose.translation();
+    double range = std::numeric_limits<double>::infinity();
+    if (std::abs(c) > 1e-9) {
+      range = std::min(range, ((c > 0 ? kHalfX : -kHalfX) - p.x) / c);
+    }
+    if (std::abs(s) > 1e-9) {
+      range = std::min(range, ((s > 0 ? kHalfY : -kHalfY) - p.y) / s);
+    }
+    const double ox = kObstacle.x - p.x;
+    const double oy = kObstacle.y - p.y;
+    const double proj = ox * c + oy * s;
+    const double d_sq = ox * ox + oy * oy - proj * proj;
+    if (proj > 0.0 && d_sq < kObstacleRadius * kObstacleRadius) {
+      range = std::min(range, proj - std::sqrt(kObstacleRadius * kObstacleRadius - d_sq));
+    }
+    ranges.push_back(static_cast<float>(range));
+  }
+  return ranges;
+}
+} // namespace
+
+TEST_CASE("ParticleFilter tracks a moving robot and shrinks", "[mcl]") {
+  MclParams params;
+  params.max_particles = 2000;
+  params.beam_skip = 1;
+  params.seed = 11;
+  WorkerPool pool(2);
+  ParticleFilter filter(MakeField(), params, &pool);
+  Transform2D truth{{-0.5, 0.3}, 0.4};
+  filter.Initialize(Transform2D{{-0.3, 0.2}, 0.3}, 0.2, 0.2);
+  REQUIRE(filter.Size() == 2000);
+
+  const Transform2D step{{0.05, 0.0}, 0.02};
+  for (int i = 0; i < 20; ++i) {
+    truth = truth * step;
+    filter.Predict(step);
+    filter.Update(Scan(truth), 0.0, 2.0 * PI / 90, 0.1, 3.5);
+    filter.Resample();
+  }
+  const auto estimate = filter.Estimate();
+  REQUIRE_THAT(estimate.translation().x, WithinAbs(truth.translation().x, 0.05));
+  REQUIRE_THAT(estimate.translation().y, WithinAbs(truth.translation().y, 0.05));
+  REQUIRE_THAT(normalize_angle(estimate.rotation() - truth.rotation()), WithinAbs(0.0, 0.05));
+  // Converged, so KLD sampling needs far fewer particles than the start.
+  REQUIRE(filter.Size() < 1000);
+  REQUIRE(filter.Size() >= params.min_particles);
+}
+
+TEST_CASE("ParticleFilter weights and parallel scoring", "[mcl]") {
+  const auto field = MakeField();
+  MclParams params;
+  params.max_particles = 501;
+  const Transform2D truth{{0.2, 0.1}, -0.5};
+  const auto scan = Scan(truth);
+
+  // The same particles scored with and without the pool give the same weights.
+  ParticleFilter inline_filter(field, params);
+  WorkerPool pool(3);
+  ParticleFilter pool_filter(field, params, &pool);
+  inline_filter.InitializeUniform({-1.5, -1.0}, {1.5, 1.0});
+  pool_filter.InitializeUniform({-1.5, -1.0}, {1.5, 1.0});
+  inline_filter.Update(scan, 0.0, 2.0 * PI / 90, 0.1, 3.5);
+  pool_filter.Update(scan, 0.0, 2.0 * PI / 90, 0.1, 3.5);
+  double total = 0.0;
+  for (size_t i = 0; i < inline_filter.Size(); ++i) {
+    REQUIRE_THAT(pool_filter.Weights().at(i), WithinAbs(inline_filter.Weights().at(i), 1e-12));
+    total += inline_filter.Weights().at(i);
+  }
+  REQUIRE_THAT(total, WithinAbs(1.0, 1e-9));
+  REQUIRE(inline_filter.EffectiveSampleSize() < 501.0);
+
+  MclParams bad;
+  bad.min_particles = 10;
+  bad.max_particles = 5;
+  REQUIRE_THROWS_AS(ParticleFilter(field, bad), std::invalid_argument);
+  REQUIRE_THROWS_AS(ParticleFilter(nullptr), std::invalid_argument);
+  for (const double error : {0.0, -0.1, std::nan("")}) {
+    MclParams bad_kld;
+    bad_kld.kld_error = error;
+    REQUIRE_THROWS_AS(ParticleFilter(field, bad_kld), std::invalid_argument);
+  }
+  MclParams bad_z;
+  bad_z.kld_z = std::numeric_limits<double>::infinity();
+  REQUIRE_THROWS_AS(ParticleFilter(field, bad_z), std::invalid_argument);
+  MclParams bad_bins;
+  bad_bins.bin_size_xy = 0.0;
+  REQUIRE_THROWS_AS(ParticleFilter(field, bad_bins), std::invalid_argument);
+  bad_bins = MclParams{};
+  bad_bins.bin_size_theta = -0.1;
+  REQUIRE_THROWS_AS(ParticleFilter(field, bad_bins), std::invalid_argument);
+
+  // A huge kld_z asks for more particles than a size_t holds, the bound stops
+  // at max_particles.
+  MclParams greedy;
+  greedy.min_particles = 10;
+  greedy.max_particles = 300;
+  greedy.kld_z = 1e120;
+  ParticleFilter greedy_filter(field, greedy);
+  greedy_filter.Initialize(Transform2D{{0.0, 0.0}, 0.0}, 1.0, 1.0);
+  greedy_filter.Resample();
+  REQUIRE(greedy_filter.Size() == greedy.max_particles);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,77 @@
+#include "turtlelib/noise.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+TEST_CASE("Philox4x32-10 matches the Random123 known answers", "[noise]") {
+  REQUIRE(Philox4x32({0, 0, 0, 0}, {0, 0}) ==
+          PhiloxCounter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+  REQUIRE(Philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                     {0xffffffff, 0xffffffff}) ==
+          PhiloxCounter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+  // The hex digits of pi.
+  REQUIRE(Philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                     {0xa4093822, 0x299f31d0}) ==
+          PhiloxCounter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+}
+
+TEST_CASE("Counter noise only depends on seed, stream and step", "[noise]") {
+  const CounterNoise noise(1234);
+  REQUIRE(noise.Seed() == 1234);
+  std::vector<double> a(5);
+  std::vector<double> b(5);
+  noise.Gaussians(3, 77, a.data(), a.size());
+  // Other draws in between change nothing.
+  noise.Gaussians(3, 78, b.data(), b.size());
+  noise.Uniforms(3, 77, b.data(), b.size());
+  noise.Gaussians(3, 77, b.data(), b.size());
+  REQUIRE(a == b);
+  REQUIRE(CounterNoise(1234).Seed() == noise.Seed());
+
+  // A shorter draw is the start of a longer one.
+  std::vector<double> prefix(3);
+  noise.Gaussians(3, 77, prefix.data(), prefix.size());
+  REQUIRE(prefix == std::vector<double>(a.begin(), a.begin() + 3));
+
+  // Any other stream, step or seed gives other numbers.
+  noise.Gaussians(4, 77, b.data(), b.size());
+  REQUIRE(a[0] != b[0]);
+  noise.Gaussians(3, 77 + (uint64_t{1} << 32), b.data(), b.size());
+  REQUIRE(a[0] != b[0]);
+  CounterNoise(1235).Gaussians(3, 77, b.data(), b.size());
+  REQUIRE(a[0] != b[0]);
+}
+
+TEST_CASE("Counter noise has the moments it should", "[noise]") {
+  const CounterNoise noise(7);
+  std::vector<double> uniforms(100001);
+  std::vector<double> normals(100001);
+  noise.Uniforms(0, 0, uniforms.data(), uniforms.size());
+  noise.Gaussians(0, 0, normals.data(), normals.size());
+  double uniform_sum = 0.0;
+  double normal_sum = 0.0;
+  double normal_sq_sum = 0.0;
+  double product_sum = 0.0;
+  for (size_t i = 0; i < uniforms.size(); ++i) {
+    REQUIRE(uniforms[i] >= 0.0);
+    REQUIRE(uniforms[i] < 1.0);
+    uniform_sum += uniforms[i];
+    normal_sum += normals[i];
+    normal_sq_sum += normals[i] * normals[i];
+    // Same stream and step, the two kinds of draw must not be correlated.
+    product_sum += (uniforms[i] - 0.5) * normals[i];
+  }
+  const double n = static_cast<double>(uniforms.size());
+  REQUIRE_THAT(uniform_sum / n, WithinAbs(0.5, 0.005));
+  REQUIRE_THAT(normal_sum / n, WithinAbs(0.0, 0.01));
+  REQUIRE_THAT(normal_sq_sum / n, WithinAbs(1.0, 0.02));
+  REQUIRE_THAT(product_sum / n, WithinAbs(0.0, 0.005));
+}
+
+} // namespace turtlelib
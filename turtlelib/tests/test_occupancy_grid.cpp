@@ -0,0 +1,87 @@
+#include "turtlelib/occupancy_grid.hpp"
+
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace turtlelib {
+
+TEMPLATE_TEST_CASE("TiledLogOddsGrid marks hits and clears the beam", "[occupancy_grid]", int8_t,
+                   int16_t) {
+  TiledLogOddsGrid<TestType> grid;
+  REQUIRE(grid.TileCount() == 0);
+  REQUIRE(grid.Value({0, 0}) == grid.kUnknown);
+
+  // One beam along +x hitting at 1.02 m, from a scan at (0.01, 0.01).
+  for (int i = 0; i < 5; ++i) {
+    grid.InsertScan(Transform2D{{0.01, 0.01}}, {1.01f}, 0.0, 0.1, 0.05, 3.5);
+  }
+  REQUIRE(grid.Probability(grid.CellOf({1.02, 0.01})) > 0.9);
+  REQUIRE(grid.Probability(grid.CellOf({0.5, 0.01})) < 0.2);
+  REQUIRE(grid.Probability(grid.CellOf({0.5, 0.5})) == 0.5);
+  // 21 cells wide, one tile.
+  REQUIRE(grid.TileCount() == 1);
+}
+
+TEMPLATE_TEST_CASE("TiledLogOddsGrid saturates", "[occupancy_grid]", int8_t, int16_t) {
+  TiledLogOddsGrid<TestType> grid;
+  const GridIndex cell = grid.CellOf({0.0, 0.0});
+  for (int i = 0; i < 10000; ++i) {
+    grid.InsertRay({0.0, 0.0}, {0.0, 0.0}, true);
+  }
+  REQUIRE(grid.Value(cell) == std::numeric_limits<TestType>::max());
+  for (int i = 0; i < 20000; ++i) {
+    grid.InsertRay({0.0, 0.0}, {0.0, 0.0}, false);
+  }
+  REQUIRE(grid.Value(cell) == -std::numeric_limits<TestType>::max());
+  REQUIRE(grid.Value(cell) != grid.kUnknown);
+}
+
+TEST_CASE("TiledLogOddsGrid tiles are lazy and tracked when dirty", "[occupancy_grid]") {
+  TiledLogOddsGrid<int8_t> grid;
+  const int32_t size = grid.kTileSize;
+  // A beam crossing from tile (-1, 0) into tile (0, 0) and (1, 0).
+  grid.InsertRay({-0.5, 0.2}, {2.0, 0.2}, true);
+  REQUIRE(grid.TileCount() == 3);
+
+  GridIndex min;
+  GridIndex max;
+  REQUIRE(grid.TileBounds(min, max));
+  REQUIRE(min.x == -1);
+  REQUIRE(max.x == 1);
+  REQUIRE(min.y == 0);
+  REQUIRE(max.y == 0);
+
+  auto dirty = grid.TakeDirtyTiles();
+  REQUIRE(dirty.size() == 3);
+  REQUIRE(grid.TakeDirtyTiles().empty());
+
+  // Touch only the middle tile again.
+  grid.InsertRay({0.1, 0.1}, {0.3, 0.1}, true);
+  dirty = grid.TakeDirtyTiles();
+  REQUIRE(dirty.size() == 1);
+  REQUIRE(dirty.at(0).x == 0);
+  REQUIRE(dirty.at(0).y == 0);
+
+  std::vector<int8_t> occupancy;
+  grid.TileOccupancy({0, 0}, occupancy);
+  REQUIRE(occupancy.size() == static_cast<size_t>(size * size));
+  const GridIndex hit = grid.CellOf({0.3, 0.1});
+  REQUIRE(occupancy.at(hit.y * size + hit.x) > 50);
+  REQUIRE(occupancy.at(0) == -1);
+  grid.TileOccupancy({5, 5}, occupancy);
+  REQUIRE(std::all_of(occupancy.begin(), occupancy.end(), [](int8_t v) { return v == -1; }));
+}
+
+TEST_CASE("TiledLogOddsGrid rejects bad params", "[occupancy_grid]") {
+  OccupancyGridParams params;
+  params.resolution = 0.0;
+  REQUIRE_THROWS_AS(TiledLogOddsGrid<int16_t>{params}, std::invalid_argument);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,184 @@
+#include "turtlelib/sim_log.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief Size of a file in bytes.
+size_t FileSize(const std::string &path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  return static_cast<size_t>(in.tellg());
+}
+
+} // namespace
+
+TEST_CASE("A sim log gives back what was written, in time order", "[sim_log]") {
+  const std::string path = "test_sim_log_round_trip.bin";
+  const std::vector<std::string> robots = {"red", "blue"};
+  {
+    // Small chunks, so records of one range come from several of them.
+    SimLogWriter writer(path, robots, 7);
+    for (int step = 0; step < 100; ++step) {
+      const int64_t time = step * 5'000'000;
+      for (uint32_t robot = 0; robot < 2; ++robot) {
+        const double pose[3] = {0.01 * step + robot, -0.002 * step, std::sin(0.1 * step)};
+        writer.Append(SimLogChannel::kPose, time, robot, pose, 3);
+        const double ticks[2] = {3.0 * step, -7.0 * step * robot};
+        writer.Append(SimLogChannel::kEncoders, time, robot, ticks, 2);
+      }
+      if (step % 20 == 0) {
+        // Scans and sightings change length between records.
+        const std::vector<float> ranges(static_cast<size_t>(step / 20 + 1), 1.25f);
+        writer.Append(SimLogChannel::kLaser, time, 1, ranges.data(), ranges.size());
+        const double seen[3] = {2.0, 0.5, -0.25};
+        writer.Append(SimLogChannel::kFakeSensor, time, 0, seen, step % 40 == 0 ? 3 : 0);
+      }
+    }
+    const double command[2] = {100.0, -100.0};
+    writer.Append(SimLogChannel::kWheelCommand, 12'345, 0, command, 2);
+  }
+
+  const SimLogReader reader(path);
+  REQUIRE(reader.Robots() == robots);
+  REQUIRE(reader.EndTime() == 99 * 5'000'000);
+  REQUIRE(reader.Chunks().size() > 10);
+
+  std::vector<SimLogRecord> records;
+  reader.Read(0, reader.EndTime() + 1, records);
+  REQUIRE(records.size() == 100 * 4 + 5 * 2 + 1);
+  for (size_t i = 1; i < records.size(); ++i) {
+    REQUIRE(records[i - 1].time_ns <= records[i].time_ns);
+  }
+  // The command is the only record between the first two steps.
+  REQUIRE(records[6].channel == SimLogChannel::kWheelCommand);
+  REQUIRE(records[6].time_ns == 12'345);
+  REQUIRE(records[6].values == std::vector<double>{100.0, -100.0});
+
+  // One step, with records of the same time in chunk order.
+  reader.Read(40 * 5'000'000, 41 * 5'000'000, records);
+  REQUIRE(records.size() == 6);
+  REQUIRE(records[0].channel == SimLogChannel::kPose);
+  REQUIRE(records[0].robot == 0);
+  REQUIRE_THAT(records[0].values[0], WithinAbs(0.4, 1e-6));
+  REQUIRE_THAT(records[0].values[2], WithinAbs(std::sin(4.0), 1e-6));
+  REQUIRE(records[3].channel == SimLogChannel::kEncoders);
+  REQUIRE(records[3].values == std::vector<double>{120.0, -280.0});
+  REQUIRE(records[4].channel == SimLogChannel::kFakeSensor);
+  REQUIRE(records[4].values.size() == 3);
+  REQUIRE_THAT(records[4].values[2], WithinAbs(-0.25, 1e-9));
+  REQUIRE(records[5].channel == SimLogChannel::kLaser);
+  REQUIRE(records[5].robot == 1);
+  REQUIRE(records[5].values.size() == 3);
+  REQUIRE_THAT(records[5].values[1], WithinAbs(1.25, 1e-9));
+
+  // Sightings of nothing are kept too.
+  reader.Read(20 * 5'000'000, 20 * 5'000'000 + 1, records);
+  REQUIRE(records[4].channel == SimLogChannel::kFakeSensor);
+  REQUIRE(records[4].values.empty());
+
+  // A cursor gives the same records, by time and then channel.
+  reader.Read(0, reader.EndTime() + 1, records);
+  std::stable_sort(records.begin(), records.end(),
+                   [](const SimLogRecord &a, const SimLogRecord &b) {
+                     return a.time_ns < b.time_ns ||
+                            (a.time_ns == b.time_ns && a.channel < b.channel);
+                   });
+  SimLogCursor cursor(reader);
+  std::vector<SimLogRecord> part;
+  size_t next = 0;
+  for (int64_t end = 3'000'000; !cursor.Done(); end += 3'000'000) {
+    cursor.ReadUntil(end, part);
+    for (const auto &record : part) {
+      REQUIRE(record.time_ns < end);
+      REQUIRE(record.time_ns == records.at(next).time_ns);
+      REQUIRE(record.channel == records[next].channel);
+      REQUIRE(record.robot == records[next].robot);
+      REQUIRE(record.values == records[next].values);
+      ++next;
+    }
+  }
+  REQUIRE(next == records.size());
+  std::remove(path.c_str());
+}
+
+TEST_CASE("A smooth run takes a few bytes per value", "[sim_log]") {
+  const std::string path = "test_sim_log_size.bin";
+  const int steps = 20000;
+  {
+    SimLogWriter writer(path, {"red"});
+    for (int64_t step = 0; step < steps; ++step) {
+      const double t = 0.005 * step;
+      const double pose[3] = {std::cos(0.1 * t), std::sin(0.1 * t), 0.1 * t};
+      writer.Append(SimLogChannel::kPose, step * 5'000'000, 0, pose, 3);
+    }
+  }
+  // Raw doubles and a time would be 32 bytes a record.
+  REQUIRE(FileSize(path) < static_cast<size_t>(steps) * 10);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Sim logs refuse bad values and bad files", "[sim_log]") {
+  const std::string path = "test_sim_log_bad.bin";
+  {
+    SimLogWriter writer(path, {"red"});
+    const double bad[1] = {std::nan("")};
+    REQUIRE_THROWS_AS(writer.Append(SimLogChannel::kPose, 0, 0, bad, 1), std::invalid_argument);
+    // Without Close the end of the file is missing.
+    writer.Flush();
+    REQUIRE_THROWS_AS(SimLogReader(path), std::runtime_error);
+    writer.Close();
+    REQUIRE_THROWS_AS(writer.Append(SimLogChannel::kPose, 0, 0, bad, 0), std::logic_error);
+  }
+  const SimLogReader empty(path);
+  REQUIRE(empty.Chunks().empty());
+  REQUIRE(empty.EndTime() == -1);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a sim log, but long enough";
+  REQUIRE_THROWS_AS(SimLogReader(path), std::runtime_error);
+  REQUIRE_THROWS_AS(SimLogReader("no_such_sim_log.bin"), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Sim logs refuse a chunk with more records than its bytes hold", "[sim_log]") {
+  const std::string path = "test_sim_log_truncated.bin";
+  {
+    SimLogWriter writer(path, {"red"});
+    const double pose[3] = {0.1, 0.2, 0.3};
+    for (int64_t i = 0; i < 10; ++i) {
+      writer.Append(SimLogChannel::kPose, i * 5'000'000, 0, pose, 3);
+    }
+    writer.Close();
+  }
+  {
+    // Claim the one chunk has far more records, as a cut off or damaged file might.
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    const size_t footer = FileSize(path) - 2 * sizeof(uint64_t) - sizeof(kSimLogEndMagic);
+    uint64_t index_offset = 0;
+    file.seekg(static_cast<std::streamoff>(footer));
+    file.read(reinterpret_cast<char *>(&index_offset), sizeof(index_offset));
+    const uint32_t records = 0xFFFFFFFF;
+    file.seekp(static_cast<std::streamoff>(index_offset + offsetof(SimLogChunk, records)));
+    file.write(reinterpret_cast<const char *>(&records), sizeof(records));
+    REQUIRE(file.good());
+  }
+  const SimLogReader reader(path);
+  REQUIRE(reader.Chunks().size() == 1);
+  std::vector<SimLogRecord> out;
+  REQUIRE_THROWS_AS(reader.Decode(0, out), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+} // namespace turtlelib
@@ -0,0 +1,59 @@
+#include "turtlelib/space_filling_curve.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace turtlelib {
+
+TEST_CASE("MortonCode interleaves bits", "[space_filling_curve]") {
+  REQUIRE(MortonCode(0, 0) == 0);
+  REQUIRE(MortonCode(1, 0) == 1);
+  REQUIRE(MortonCode(0, 1) == 2);
+  REQUIRE(MortonCode(3, 3) == 15);
+  REQUIRE(MortonCode(0xffffffffu, 0) == 0x5555555555555555ull);
+}
+
+TEST_CASE("HilbertIndex walks adjacent cells", "[space_filling_curve]") {
+  // The first 4 by 4 cells of the curve, in order.
+  std::vector<std::pair<uint16_t, uint16_t>> by_index(16);
+  std::set<uint64_t> seen;
+  for (uint16_t x = 0; x < 4; ++x) {
+    for (uint16_t y = 0; y < 4; ++y) {
+      const uint64_t d = HilbertIndex(x, y);
+      REQUIRE(d < 16);
+      seen.insert(d);
+      by_index.at(d) = {x, y};
+    }
+  }
+  REQUIRE(seen.size() == 16);
+  REQUIRE(by_index.front() == std::pair<uint16_t, uint16_t>{0, 0});
+  for (size_t i = 1; i < by_index.size(); ++i) {
+    const int dx = std::abs(by_index[i].first - by_index[i - 1].first);
+    const int dy = std::abs(by_index[i].second - by_index[i - 1].second);
+    REQUIRE(dx + dy == 1);
+  }
+}
+
+TEST_CASE("HilbertOrder groups nearby points", "[space_filling_curve]") {
+  // Two clusters, interleaved in the input.
+  const std::vector<Point2D> points{{0.0, 0.0}, {5.0, 5.0}, {0.1, 0.0}, {5.1, 5.0}, {0.0, 0.1}};
+  const auto order = HilbertOrder(points);
+  REQUIRE(order.size() == points.size());
+  std::vector<bool> near_origin;
+  for (const auto i : order) {
+    near_origin.push_back(points.at(i).x < 1.0);
+  }
+  // All of one cluster, then all of the other.
+  size_t switches = 0;
+  for (size_t i = 1; i < near_origin.size(); ++i) {
+    switches += near_origin[i] != near_origin[i - 1] ? 1 : 0;
+  }
+  REQUIRE(switches == 1);
+  REQUIRE(HilbertOrder({}).empty());
+}
+
+} // namespace turtlelib
@@ -0,0 +1,75 @@
+#include "turtlelib/sweep_and_prune.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace turtlelib {
+
+namespace {
+
+using Pairs = std::vector<std::pair<size_t, size_t>>;
+
+//! @brief Every pair of overlapping boxes, the slow way.
+Pairs BruteForcePairs(const std::vector<double> &x, const std::vector<double> &y,
+                      const std::vector<double> &r) {
+  Pairs pairs;
+  for (size_t i = 0; i < x.size(); ++i) {
+    for (size_t j = i + 1; j < x.size(); ++j) {
+      if (std::abs(x[i] - x[j]) <= r[i] + r[j] && std::abs(y[i] - y[j]) <= r[i] + r[j]) {
+        pairs.emplace_back(i, j);
+      }
+    }
+  }
+  return pairs;
+}
+
+} // namespace
+
+TEST_CASE("Sweep and prune finds touching boxes", "[sweep_and_prune]") {
+  SweepAndPrune broad_phase;
+  Pairs pairs;
+  // 0 and 2 touch, 1 is level with 0 in x but far in y.
+  broad_phase.Update({0.0, 0.1, 0.3}, {0.0, 5.0, 0.1}, {0.1, 0.1, 0.2}, pairs);
+  REQUIRE(pairs == Pairs{{0, 2}});
+  broad_phase.Update({}, {}, {}, pairs);
+  REQUIRE(pairs.empty());
+  REQUIRE_THROWS_AS(broad_phase.Update({0.0}, {0.0, 1.0}, {0.1}, pairs), std::invalid_argument);
+}
+
+TEST_CASE("Sweep and prune matches all pairs while circles move", "[sweep_and_prune]") {
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> coord(-3.0, 3.0);
+  std::uniform_real_distribution<double> radius(0.05, 0.2);
+  std::uniform_real_distribution<double> step(-0.05, 0.05);
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> r;
+  for (int i = 0; i < 200; ++i) {
+    x.push_back(coord(gen));
+    y.push_back(coord(gen));
+    r.push_back(radius(gen));
+  }
+  SweepAndPrune broad_phase;
+  Pairs pairs;
+  for (int frame = 0; frame < 50; ++frame) {
+    broad_phase.Update(x, y, r, pairs);
+    REQUIRE(pairs == BruteForcePairs(x, y, r));
+    for (size_t i = 0; i < x.size(); ++i) {
+      x[i] += step(gen);
+      y[i] += step(gen);
+    }
+  }
+  // A different number of circles starts over.
+  x.resize(20);
+  y.resize(20);
+  r.resize(20);
+  broad_phase.Update(x, y, r, pairs);
+  REQUIRE(pairs == BruteForcePairs(x, y, r));
+}
+
+} // namespace turtlelib
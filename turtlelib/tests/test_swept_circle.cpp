@@ -0,0 +1,97 @@
+#include "turtlelib/swept_circle.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+TEST_CASE("Closest point of a segment", "[swept_circle]") {
+  const Segment2D segment{{0.0, 0.0}, {2.0, 0.0}};
+  REQUIRE_THAT(ClosestPoint(segment, {1.0, 3.0}).x, WithinAbs(1.0, 1e-12));
+  REQUIRE_THAT(ClosestPoint(segment, {1.0, 3.0}).y, WithinAbs(0.0, 1e-12));
+  REQUIRE_THAT(ClosestPoint(segment, {-4.0, 1.0}).x, WithinAbs(0.0, 1e-12));
+  REQUIRE_THAT(ClosestPoint(segment, {5.0, -1.0}).x, WithinAbs(2.0, 1e-12));
+  REQUIRE_THAT(ClosestPoint({{1.0, 1.0}, {1.0, 1.0}}, {5.0, 5.0}).y, WithinAbs(1.0, 1e-12));
+}
+
+TEST_CASE("A sweep in free space is one step of the twist", "[swept_circle]") {
+  SweepShapes shapes;
+  shapes.x = {5.0};
+  shapes.y = {5.0};
+  shapes.r = {0.2};
+  const Transform2D start{{0.3, -0.1}, 0.4};
+  const Twist2D twist{0.7, 0.5, 0.0};
+  const auto result = SweepCircle(start, twist, 0.1, shapes);
+  const auto expected = start * integrate_twist(twist);
+  REQUIRE(result.substeps == 1);
+  REQUIRE_FALSE(result.contact);
+  REQUIRE_THAT(result.pose.translation().x, WithinAbs(expected.translation().x, 1e-12));
+  REQUIRE_THAT(result.pose.translation().y, WithinAbs(expected.translation().y, 1e-12));
+  REQUIRE_THAT(result.pose.rotation(), WithinAbs(expected.rotation(), 1e-12));
+  // Turning in place never moves the center.
+  REQUIRE(SweepCircle(start, {2.0, 0.0, 0.0}, 0.1, shapes).substeps == 1);
+}
+
+TEST_CASE("A long sweep stops at thin shapes instead of tunneling", "[swept_circle]") {
+  // One meter in one step, across a wall of no thickness.
+  SweepShapes shapes;
+  shapes.segments = {{{0.5, -1.0}, {0.5, 1.0}}};
+  const auto wall = SweepCircle(Transform2D{}, {0.0, 1.0, 0.0}, 0.1, shapes);
+  REQUIRE(wall.contact);
+  REQUIRE_THAT(wall.pose.translation().x, WithinAbs(0.4, 1e-9));
+  REQUIRE(wall.substeps < 20);
+
+  // And a thin post.
+  shapes.Clear();
+  shapes.x = {0.5};
+  shapes.y = {0.0};
+  shapes.r = {0.01};
+  const auto post = SweepCircle(Transform2D{}, {0.0, 1.0, 0.0}, 0.1, shapes);
+  REQUIRE(post.contact);
+  REQUIRE(post.pose.translation().x < 0.5);
+  REQUIRE_THAT((post.pose.translation() - Vector2D{0.5, 0.0}).magnitude(),
+               WithinAbs(0.11, 1e-9));
+}
+
+TEST_CASE("A coarse sweep ends where fine ones do", "[swept_circle]") {
+  // Driving on an arc into a wall, then sliding along it.
+  SweepShapes shapes;
+  shapes.segments = {{{-1.0, 0.3}, {2.0, 0.3}}};
+  shapes.x = {1.2};
+  shapes.y = {0.0};
+  shapes.r = {0.1};
+  const Transform2D start{{0.0, 0.0}, 0.6};
+  const Twist2D twist{0.3, 0.8, 0.0};
+  const auto coarse = SweepCircle(start, twist, 0.1, shapes);
+  REQUIRE(coarse.contact);
+
+  SweepResult fine{start, false, 0};
+  const int steps = 20;
+  for (int i = 0; i < steps; ++i) {
+    const Twist2D part{twist.omega / steps, twist.x / steps, twist.y / steps};
+    fine = SweepCircle(fine.pose, part, 0.1, shapes);
+  }
+  REQUIRE_THAT(coarse.pose.translation().x, WithinAbs(fine.pose.translation().x, 2e-3));
+  REQUIRE_THAT(coarse.pose.translation().y, WithinAbs(fine.pose.translation().y, 2e-3));
+  REQUIRE_THAT(coarse.pose.rotation(), WithinAbs(fine.pose.rotation(), 1e-9));
+  // Slid along the wall, never through it.
+  REQUIRE(coarse.pose.translation().y <= 0.2 + 1e-9);
+  REQUIRE(coarse.pose.translation().x > 0.3);
+}
+
+TEST_CASE("A sweep starting inside a shape is pushed out", "[swept_circle]") {
+  SweepShapes shapes;
+  shapes.x = {0.0};
+  shapes.y = {0.0};
+  shapes.r = {0.2};
+  const auto result = SweepCircle(Transform2D{{0.25, 0.0}, 0.0}, {}, 0.1, shapes);
+  REQUIRE(result.contact);
+  REQUIRE_THAT(result.pose.translation().x, WithinAbs(0.3, 1e-12));
+  REQUIRE_THAT(result.pose.translation().y, WithinAbs(0.0, 1e-12));
+}
+
+} // namespace turtlelib
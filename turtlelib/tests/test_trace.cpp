@@ -0,0 +1,126 @@
+#include "turtlelib/trace.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace turtlelib {
+
+namespace {
+
+constexpr uint32_t kTestCategory = 1 << 3;
+
+//! @brief Records of one trace point.
+std::vector<TraceRecord> RecordsOf(const TraceDump &dump, const std::string &name) {
+  std::vector<TraceRecord> out;
+  for (const auto &record : dump.records) {
+    if (record.point < dump.points.size() && dump.points[record.point].name == name) {
+      out.push_back(record);
+    }
+  }
+  return out;
+}
+
+//! @brief Counts its calls, to see whether a trace point computed its values.
+double Counted(int &calls) {
+  ++calls;
+  return 1.0;
+}
+
+} // namespace
+
+TEST_CASE("Trace points only record when their category is on", "[trace]") {
+  int calls = 0;
+  SetTraceMask(0);
+  for (int i = 0; i < 5; ++i) {
+    TURTLELIB_TRACE_POINT(kTestCategory, "test.off", "i,counted", i, Counted(calls));
+  }
+  REQUIRE(calls == 0);
+  REQUIRE(RecordsOf(SnapshotTrace(), "test.off").empty());
+#if TURTLELIB_TRACE
+
+  SetTraceMask(kTestCategory);
+  for (int i = 0; i < 5; ++i) {
+    TURTLELIB_TRACE_POINT(kTestCategory, "test.on", "i,counted", i, Counted(calls));
+    TURTLELIB_TRACE_POINT(kTestCategory << 1, "test.other", "i", i);
+  }
+  SetTraceMask(0);
+  REQUIRE(calls == 5);
+  const auto dump = SnapshotTrace();
+  const auto records = RecordsOf(dump, "test.on");
+  REQUIRE(records.size() == 5);
+  for (size_t i = 0; i < records.size(); ++i) {
+    REQUIRE(records[i].count == 2);
+    REQUIRE(records[i].values[0] == static_cast<double>(i));
+  }
+  REQUIRE(RecordsOf(dump, "test.other").empty());
+  REQUIRE(FormatTraceRecord(dump, records[3]).find("test.on i=3 counted=1") != std::string::npos);
+#endif
+}
+
+// The rest needs the trace points compiled in.
+#if TURTLELIB_TRACE
+
+TEST_CASE("Each thread traces into its own ring", "[trace]") {
+  SetTraceMask(kTestCategory);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < 100; ++i) {
+        TURTLELIB_TRACE_POINT(kTestCategory, "test.thread", "thread,i", t, i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  SetTraceMask(0);
+
+  // The rings outlive their threads.
+  const auto records = RecordsOf(SnapshotTrace(), "test.thread");
+  REQUIRE(records.size() == 400);
+  std::vector<int> next(4, 0);
+  for (size_t k = 0; k < records.size(); ++k) {
+    if (k > 0) {
+      REQUIRE(records[k - 1].time_ns <= records[k].time_ns);
+    }
+    const auto t = static_cast<size_t>(records[k].values[0]);
+    // Records of one thread keep their order, and a ring only has one thread.
+    REQUIRE(records[k].values[1] == next.at(t)++);
+  }
+  for (size_t k = 1; k < records.size(); ++k) {
+    if (records[k].values[0] == records[0].values[0]) {
+      REQUIRE(records[k].thread == records[0].thread);
+    }
+  }
+}
+
+TEST_CASE("Trace files read back", "[trace]") {
+  const std::string path = "test_trace.trace";
+  SetTraceMask(kTestCategory);
+  TURTLELIB_TRACE_POINT(kTestCategory, "test.file", "x,y,theta", 0.5, -1.25, 3);
+  SetTraceMask(0);
+  const auto expected = SnapshotTrace();
+  REQUIRE(DumpTrace(path) == expected.records.size());
+
+  const auto dump = ReadTrace(path);
+  REQUIRE(dump.points.size() == expected.points.size());
+  REQUIRE(dump.records.size() == expected.records.size());
+  const auto records = RecordsOf(dump, "test.file");
+  REQUIRE(records.size() == 1);
+  REQUIRE(FormatTraceRecord(dump, records[0]).find("test.file x=0.5 y=-1.25 theta=3") !=
+          std::string::npos);
+
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  std::fputs("not a trace", file);
+  std::fclose(file);
+  REQUIRE_THROWS_AS(ReadTrace(path), std::runtime_error);
+  std::remove(path.c_str());
+}
+#endif
+
+} // namespace turtlelib
@@ -0,0 +1,66 @@
+#include "turtlelib/triple_buffer.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+#include <thread>
+
+namespace turtlelib {
+
+TEST_CASE("The reader gets the latest published value", "[triple_buffer]") {
+  TripleBuffer<int> buffer(-1);
+  REQUIRE_FALSE(buffer.Update());
+  REQUIRE(buffer.Front() == -1);
+
+  buffer.Back() = 1;
+  buffer.Publish();
+  REQUIRE(buffer.Update());
+  REQUIRE(buffer.Front() == 1);
+  REQUIRE_FALSE(buffer.Update());
+  REQUIRE(buffer.Front() == 1);
+
+  // Values published in between are skipped.
+  for (int i = 2; i <= 5; ++i) {
+    buffer.Back() = i;
+    buffer.Publish();
+  }
+  REQUIRE(buffer.Update());
+  REQUIRE(buffer.Front() == 5);
+  REQUIRE_FALSE(buffer.Update());
+}
+
+TEST_CASE("A concurrent reader never sees a torn value", "[triple_buffer]") {
+  // Every field of a value is the same, a reader seeing a partly written one
+  // would find them different.
+  using Value = std::array<uint64_t, 32>;
+  constexpr uint64_t kValues = 200000;
+  TripleBuffer<Value> buffer(Value{});
+
+  std::thread writer([&buffer]() {
+    for (uint64_t i = 1; i <= kValues; ++i) {
+      buffer.Back().fill(i);
+      buffer.Publish();
+    }
+  });
+  uint64_t last = 0;
+  bool torn = false;
+  bool backwards = false;
+  while (last < kValues) {
+    if (!buffer.Update()) {
+      continue;
+    }
+    const auto &value = buffer.Front();
+    for (const auto field : value) {
+      torn = torn || field != value[0];
+    }
+    backwards = backwards || value[0] <= last;
+    last = value[0];
+  }
+  writer.join();
+  REQUIRE_FALSE(torn);
+  REQUIRE_FALSE(backwards);
+  REQUIRE(last == kValues);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,145 @@
+#include "turtlelib/uniform_grid.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "turtlelib/laser_sim.hpp"
+#include "turtlelib/swept_circle.hpp"
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+//! @brief Random circles in [-half, half]^2, walls around it and a few random segments.
+struct World {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> r;
+  std::vector<Segment2D> segments;
+};
+
+World RandomWorld(std::mt19937 &gen, size_t circles, double half) {
+  std::uniform_real_distribution<double> coord(-half, half);
+  std::uniform_real_distribution<double> radius(0.01, 0.2);
+  World world;
+  for (size_t k = 0; k < circles; ++k) {
+    world.x.push_back(coord(gen));
+    world.y.push_back(coord(gen));
+    world.r.push_back(radius(gen));
+  }
+  world.segments = {{{-half, -half}, {half, -half}},
+                    {{half, -half}, {half, half}},
+                    {{half, half}, {-half, half}},
+                    {{-half, half}, {-half, -half}}};
+  for (int k = 0; k < 10; ++k) {
+    world.segments.push_back({{coord(gen), coord(gen)}, {coord(gen), coord(gen)}});
+  }
+  return world;
+}
+
+} // namespace
+
+TEST_CASE("A ray stops at the nearest shape", "[uniform_grid]") {
+  // A circle in front of a wall, and one behind it.
+  const UniformGrid grid({1.0, 3.0}, {0.0, 0.0}, {0.25, 0.5}, {{{2.0, -1.0}, {2.0, 1.0}}}, 0.3);
+  REQUIRE_THAT(grid.Raycast({0.0, 0.0}, {1.0, 0.0}, 10.0), WithinAbs(0.75, 1e-12));
+  REQUIRE_THAT(grid.Raycast({1.5, 0.0}, {1.0, 0.0}, 10.0), WithinAbs(0.5, 1e-12));
+  REQUIRE_THAT(grid.Raycast({5.0, 0.0}, {-1.0, 0.0}, 10.0), WithinAbs(1.5, 1e-12));
+  // Out of range, pointing away, and from inside a circle.
+  REQUIRE(grid.Raycast({0.0, 0.0}, {1.0, 0.0}, 0.5) == kInf);
+  REQUIRE(grid.Raycast({0.0, 0.0}, {-1.0, 0.0}, 10.0) == kInf);
+  REQUIRE_THAT(grid.Raycast({1.0, 0.0}, {1.0, 0.0}, 10.0), WithinAbs(1.0, 1e-12));
+}
+
+TEST_CASE("Grid ray casts agree with testing every shape", "[uniform_grid]") {
+  std::mt19937 gen(3);
+  const World world = RandomWorld(gen, 400, 4.0);
+  std::uniform_real_distribution<double> coord(-6.0, 6.0);
+  std::uniform_real_distribution<double> angle(-PI, PI);
+  // Beams of one scanner, each walks the grid in its own direction.
+  LaserSim laser(0.0, 2.0 * PI / 97.0, 97, 5.0);
+  std::vector<float> expected;
+  std::vector<float> actual;
+  for (double cell : {0.1, 0.37, 2.0, 50.0}) {
+    const UniformGrid grid(world.x, world.y, world.r, world.segments, cell);
+    for (int pose = 0; pose < 30; ++pose) {
+      // Some of the poses are outside the grid.
+      const Transform2D scanner{{coord(gen), coord(gen)}, angle(gen)};
+      laser.Cast(scanner, world.x, world.y, world.r, world.segments, expected, -1.0f);
+      laser.Cast(scanner, actual, -1.0f, grid);
+      for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE_THAT(actual[i], WithinAbs(expected[i], 1e-5));
+      }
+    }
+  }
+}
+
+TEST_CASE("Circles near a point", "[uniform_grid]") {
+  std::mt19937 gen(5);
+  const World world = RandomWorld(gen, 1000, 10.0);
+  const UniformGrid grid(world.x, world.y, world.r, world.segments, 0.5);
+  // The walls and the circles poking past them, in 0.5 m cells.
+  REQUIRE(grid.CellsX() >= 40);
+  REQUIRE(grid.CellsX() <= 41);
+  std::uniform_real_distribution<double> coord(-12.0, 12.0);
+  std::vector<size_t> near;
+  for (double radius : {0.0, 0.3, 2.5}) {
+    for (int query = 0; query < 50; ++query) {
+      const Point2D center{coord(gen), coord(gen)};
+      std::vector<size_t> expected;
+      for (size_t k = 0; k < world.x.size(); ++k) {
+        if (std::hypot(world.x[k] - center.x, world.y[k] - center.y) <= world.r[k] + radius) {
+          expected.push_back(k);
+        }
+      }
+      grid.CirclesNear(center, radius, near);
+      REQUIRE(near == expected);
+    }
+  }
+}
+
+TEST_CASE("Segments near a point", "[uniform_grid]") {
+  std::mt19937 gen(7);
+  const World world = RandomWorld(gen, 100, 5.0);
+  const UniformGrid grid(world.x, world.y, world.r, world.segments, 0.4);
+  std::uniform_real_distribution<double> coord(-7.0, 7.0);
+  std::vector<size_t> near;
+  for (double radius : {0.0, 0.2, 1.5}) {
+    for (int query = 0; query < 50; ++query) {
+      const Point2D center{coord(gen), coord(gen)};
+      std::vector<size_t> expected;
+      for (size_t k = 0; k < world.segments.size(); ++k) {
+        if ((ClosestPoint(world.segments[k], center) - center).magnitude() <= radius) {
+          expected.push_back(k);
+        }
+      }
+      grid.SegmentsNear(center, radius, near);
+      REQUIRE(near == expected);
+    }
+  }
+}
+
+TEST_CASE("Empty and degenerate worlds", "[uniform_grid]") {
+  const UniformGrid empty({}, {}, {}, {}, 1.0);
+  REQUIRE(empty.Raycast({0.0, 0.0}, {0.0, 1.0}, 10.0) == kInf);
+  // A single vertical wall is a one cell wide grid.
+  const UniformGrid wall({}, {}, {}, {{{1.0, -3.0}, {1.0, 3.0}}}, 1.0);
+  REQUIRE(wall.CellsX() == 1);
+  REQUIRE_THAT(wall.Raycast({-2.0, 2.5}, {1.0, 0.0}, 10.0), WithinAbs(3.0, 1e-12));
+  REQUIRE_THROWS_AS(UniformGrid({0.0}, {}, {}, {}, 1.0), std::invalid_argument);
+  REQUIRE_THROWS_AS(UniformGrid({}, {}, {}, {}, 0.0), std::invalid_argument);
+  REQUIRE_THROWS_AS(UniformGrid({}, {}, {}, {{{0.0, 0.0}, {1e4, 1e4}}}, 1e-3),
+                    std::invalid_argument);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,62 @@
+#include "turtlelib/worker_pool.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace turtlelib {
+
+TEST_CASE("ParallelFor covers every index once", "[worker_pool]") {
+  auto num_threads = GENERATE(1, 2, 4);
+  WorkerPool pool(num_threads);
+  REQUIRE(pool.Size() == static_cast<size_t>(num_threads));
+
+  auto count = GENERATE(0, 1, 5, 9, 1000);
+  std::vector<int> hits(count, 0);
+  pool.ParallelFor(0, count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      hits.at(i) += 1;
+    }
+  });
+  CAPTURE(num_threads, count);
+  REQUIRE(std::accumulate(hits.begin(), hits.end(), 0) == count);
+  for (auto hit : hits) {
+    REQUIRE(hit == 1);
+  }
+}
+
+TEST_CASE("ParallelFor reports exceptions", "[worker_pool]") {
+  WorkerPool pool(3);
+  REQUIRE_THROWS_AS(pool.ParallelFor(0, 30,
+                                     [](size_t begin, size_t) {
+                                       if (begin == 0) {
+                                         throw std::runtime_error("bad chunk");
+                                       }
+                                     }),
+                    std::runtime_error);
+
+  // The pool keeps working after a failed loop.
+  std::atomic<size_t> sum{0};
+  pool.ParallelFor(0, 100, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      sum += i;
+    }
+  });
+  REQUIRE(sum == 4950);
+}
+
+TEST_CASE("Submitted jobs finish before the pool is gone", "[worker_pool]") {
+  std::atomic<int> ran{0};
+  {
+    WorkerPool pool(2);
+    for (int i = 0; i < 20; ++i) {
+      pool.Submit([&ran]() { ran++; });
+    }
+  }
+  REQUIRE(ran == 20);
+}
+
+} // namespace turtlelib
@@ -0,0 +1,114 @@
+#include "turtlelib/world_file.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "turtlelib/world_map.hpp"
+
+namespace turtlelib {
+
+namespace {
+
+//! @brief Bytes of a file.
+std::vector<char> ReadBytes(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void WriteBytes(const std::string &path, const std::vector<char> &bytes) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+} // namespace
+
+TEST_CASE("A mapped world file queries like the grid it was built from", "[world_file]") {
+  const std::string path = "test_world_file_round_trip.world";
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> coord(-4.0, 4.0);
+  std::uniform_real_distribution<double> radius(0.02, 0.3);
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> r;
+  for (int k = 0; k < 500; ++k) {
+    x.push_back(coord(gen));
+    y.push_back(coord(gen));
+    r.push_back(radius(gen));
+  }
+  auto walls = ArenaWalls(9.0, 8.0);
+  walls.push_back({{-1.0, 2.0}, {3.0, -1.5}});
+  WriteWorldFile(path, x, y, r, walls, 0.45);
+
+  const UniformGrid built(x, y, r, walls, 0.45);
+  {
+    const WorldFile file(path);
+    const auto &view = file.View();
+    REQUIRE(view.circles == x.size());
+    REQUIRE(view.segment_count == walls.size());
+    REQUIRE(std::vector<double>(view.circle_r, view.circle_r + view.circles) == r);
+    REQUIRE(view.segments[4].b.y == -1.5);
+    REQUIRE(view.item_count == built.View().item_count);
+
+    const UniformGrid mapped(view);
+    REQUIRE(mapped.CellsX() == built.CellsX());
+    REQUIRE(mapped.CellsY() == built.CellsY());
+    std::uniform_real_distribution<double> angle(-PI, PI);
+    std::vector<size_t> expected;
+    std::vector<size_t> actual;
+    for (int query = 0; query < 200; ++query) {
+      const Point2D origin{coord(gen), coord(gen)};
+      const double heading = angle(gen);
+      const Vector2D direction{std::cos(heading), std::sin(heading)};
+      REQUIRE(mapped.Raycast(origin, direction, 6.0) == built.Raycast(origin, direction, 6.0));
+      built.CirclesNear(origin, 0.5, expected);
+      mapped.CirclesNear(origin, 0.5, actual);
+      REQUIRE(actual == expected);
+      built.SegmentsNear(origin, 0.5, expected);
+      mapped.SegmentsNear(origin, 0.5, actual);
+      REQUIRE(actual == expected);
+    }
+  }
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Broken world files are refused", "[world_file]") {
+  const std::string path = "test_world_file_broken.world";
+  REQUIRE_THROWS_AS(WorldFile("test_world_file_missing.world"), std::runtime_error);
+
+  WriteWorldFile(path, {0.0, 1.0}, {0.0, 1.0}, {0.1, 0.1}, ArenaWalls(3.0, 3.0), 0.5);
+  const auto good = ReadBytes(path);
+  REQUIRE_NOTHROW(WorldFile(path));
+
+  auto bytes = good;
+  bytes[0] = 'X';
+  WriteBytes(path, bytes);
+  REQUIRE_THROWS_AS(WorldFile(path), std::runtime_error);
+
+  // Cut inside the items.
+  bytes = good;
+  bytes.resize(bytes.size() - 2);
+  WriteBytes(path, bytes);
+  REQUIRE_THROWS_AS(WorldFile(path), std::runtime_error);
+
+  // An item naming a shape that isn't there.
+  bytes = good;
+  WorldFileHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  const uint32_t bad_item = 6;
+  std::memcpy(bytes.data() + header.offsets[5], &bad_item, sizeof(bad_item));
+  WriteBytes(path, bytes);
+  REQUIRE_THROWS_AS(WorldFile(path), std::runtime_error);
+
+  std::remove(path.c_str());
+}
+
+} // namespace turtlelib
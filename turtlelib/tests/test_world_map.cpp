@@ -0,0 +1,210 @@
+#include "turtlelib/world_map.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "turtlelib/laser_sim.hpp"
+#include "turtlelib/uniform_grid.hpp"
+
+using Catch::Matchers::WithinAbs;
+
+namespace turtlelib {
+
+namespace {
+
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+//! @brief Write contents to a file of the test's working directory.
+std::string WriteFile(const std::string &name, const std::string &contents) {
+  std::ofstream(name, std::ios::binary) << contents;
+  return name;
+}
+
+} // namespace
+
+TEST_CASE("Segment worlds read segments and closed polygons", "[world_map]") {
+  const std::string path = WriteFile("test_world_map.txt", "# a floor plan\n"
+                                                           "segment 0 0 1 0  # a wall\n"
+                                                           "\n"
+                                                           "polygon 2 2 3 2 3 3\n");
+  const auto segments = LoadSegmentWorld(path);
+  REQUIRE(segments.size() == 4);
+  REQUIRE(segments[0].b.x == 1.0);
+  // The last side closes the triangle.
+  REQUIRE(segments[3].a.x == 3.0);
+  REQUIRE(segments[3].a.y == 3.0);
+  REQUIRE(segments[3].b.x == 2.0);
+  REQUIRE(segments[3].b.y == 2.0);
+
+  WriteFile(path, "segment 0 0 1\n");
+  REQUIRE_THROWS_AS(LoadSegmentWorld(path), std::runtime_error);
+  WriteFile(path, "polygon 0 0 1 1\n");
+  REQUIRE_THROWS_AS(LoadSegmentWorld(path), std::runtime_error);
+  WriteFile(path, "segment 0 0 1 x\n");
+  REQUIRE_THROWS_AS(LoadSegmentWorld(path), std::runtime_error);
+  WriteFile(path, "circle 0 0 1\n");
+  REQUIRE_THROWS_AS(LoadSegmentWorld(path), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("The segment tree finds the nearest segment", "[world_map]") {
+  // Two parallel walls, listed far one first.
+  const SegmentBvh bvh({{{3.0, -1.0}, {3.0, 1.0}}, {{2.0, -1.0}, {2.0, 1.0}}});
+  REQUIRE_THAT(bvh.Raycast({0.0, 0.0}, {1.0, 0.0}, 10.0), WithinAbs(2.0, 1e-12));
+  REQUIRE(bvh.Raycast({0.0, 0.0}, {1.0, 0.0}, 1.5) == kInf);
+  REQUIRE(bvh.Raycast({0.0, 0.0}, {0.0, 1.0}, 10.0) == kInf);
+  REQUIRE(SegmentBvh({}).Raycast({0.0, 0.0}, {1.0, 0.0}, 10.0) == kInf);
+
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> coord(-10.0, 10.0);
+  std::uniform_real_distribution<double> step(-0.5, 0.5);
+  std::uniform_real_distribution<double> angle(-PI, PI);
+  std::vector<Segment2D> segments;
+  for (int i = 0; i < 2000; ++i) {
+    const Point2D a{coord(gen), coord(gen)};
+    segments.push_back({a, {a.x + step(gen), a.y + step(gen)}});
+  }
+  const SegmentBvh random_bvh(segments);
+  REQUIRE(random_bvh.Segments().size() == segments.size());
+  for (int ray = 0; ray < 2000; ++ray) {
+    const Point2D origin{coord(gen), coord(gen)};
+    const double heading = angle(gen);
+    const Vector2D direction{std::cos(heading), std::sin(heading)};
+    double expected = kInf;
+    for (const auto &segment : segments) {
+      expected = std::min(expected, RaySegmentDistance(origin, direction, segment));
+    }
+    if (expected > 6.0) {
+      expected = kInf;
+    }
+    REQUIRE(random_bvh.Raycast(origin, direction, 6.0) == expected);
+  }
+
+  // Disk queries find exactly the segments whose boxes reach the disk.
+  std::vector<size_t> near;
+  for (int query = 0; query < 200; ++query) {
+    const Point2D center{coord(gen), coord(gen)};
+    random_bvh.SegmentsNear(center, 0.7, near);
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < random_bvh.Segments().size(); ++i) {
+      const Segment2D &s = random_bvh.Segments()[i];
+      const double dx = std::max({std::min(s.a.x, s.b.x) - center.x, 0.0,
+                                  center.x - std::max(s.a.x, s.b.x)});
+      const double dy = std::max({std::min(s.a.y, s.b.y) - center.y, 0.0,
+                                  center.y - std::max(s.a.y, s.b.y)});
+      if (dx * dx + dy * dy <= 0.7 * 0.7) {
+        expected.push_back(i);
+      }
+    }
+    REQUIRE(near == expected);
+  }
+}
+
+TEST_CASE("Occupancy map rays stop at the first occupied cell", "[world_map]") {
+  // 4 x 3 cells of 0.5 m from (-1, -1), the right column occupied.
+  std::vector<uint8_t> cells(12, 0);
+  for (size_t row = 0; row < 3; ++row) {
+    cells[row * 4 + 3] = 1;
+  }
+  cells[0] = 1;
+  const OccupancyMap map(4, 3, 0.5, {-1.0, -1.0}, cells);
+  REQUIRE(map.Occupied({0.75, 0.0}));
+  REQUIRE(map.Occupied({-0.9, -0.9}));
+  REQUIRE_FALSE(map.Occupied({0.25, 0.0}));
+  REQUIRE_FALSE(map.Occupied({5.0, 0.0}));
+  REQUIRE_THAT(map.Raycast({-0.3, 0.1}, {1.0, 0.0}, 10.0), WithinAbs(0.8, 1e-12));
+  REQUIRE(map.Raycast({-0.3, 0.1}, {1.0, 0.0}, 0.5) == kInf);
+  REQUIRE(map.Raycast({-0.3, 0.1}, {0.0, 1.0}, 10.0) == kInf);
+  // From outside, and from inside an occupied cell.
+  REQUIRE_THAT(map.Raycast({-3.0, -0.75}, {1.0, 0.0}, 10.0), WithinAbs(2.0, 1e-12));
+  REQUIRE(map.Raycast({0.75, 0.1}, {-1.0, 0.0}, 10.0) == kInf);
+  REQUIRE_THAT(map.Raycast({-0.9, -0.9}, {1.0, 0.0}, 10.0), WithinAbs(1.4, 1e-12));
+  REQUIRE_THROWS_AS(OccupancyMap(4, 3, 0.5, {0.0, 0.0}, {}), std::invalid_argument);
+}
+
+TEST_CASE("Occupancy map edges outline the walls near a disk", "[world_map]") {
+  // 4 x 3 cells of 0.5 m from (-1, -1), a wall of the two middle cells of row 1.
+  std::vector<uint8_t> cells(12, 0);
+  cells[1 * 4 + 1] = 1;
+  cells[1 * 4 + 2] = 1;
+  const OccupancyMap map(4, 3, 0.5, {-1.0, -1.0}, cells);
+  std::vector<Segment2D> edges = {{{9.0, 9.0}, {9.0, 9.0}}};
+
+  // Around the whole wall, the border between its two cells is not an edge.
+  map.EdgesNear({0.0, 0.0}, 1.0, edges);
+  REQUIRE(edges.size() == 6);
+  double length = 0.0;
+  for (const auto &edge : edges) {
+    length += (edge.b - edge.a).magnitude();
+    // On the outline of the box from (-0.5, -0.5) to (0.5, 0).
+    const bool on_x = edge.a.x == edge.b.x && (edge.a.x == -0.5 || edge.a.x == 0.5);
+    const bool on_y = edge.a.y == edge.b.y && (edge.a.y == -0.5 || edge.a.y == 0.0);
+    REQUIRE((on_x || on_y));
+  }
+  REQUIRE_THAT(length, WithinAbs(3.0, 1e-12));
+
+  // Near the left cell only, its right side faces the other wall cell.
+  map.EdgesNear({-0.3, -0.25}, 0.05, edges);
+  REQUIRE(edges.size() == 3);
+
+  // In free space, and off the map.
+  map.EdgesNear({-0.75, 0.25}, 0.1, edges);
+  REQUIRE(edges.empty());
+  map.EdgesNear({5.0, 5.0}, 1.0, edges);
+  REQUIRE(edges.empty());
+
+  // A wall cell at the border of the map faces the outside.
+  const OccupancyMap corner(1, 1, 0.5, {0.0, 0.0}, {1});
+  corner.EdgesNear({0.25, 0.25}, 0.1, edges);
+  REQUIRE(edges.size() == 4);
+}
+
+TEST_CASE("PGM images load as occupancy maps", "[world_map]") {
+  // Top row black, bottom row white, a gray pixel that is not dark enough.
+  const std::string ascii = WriteFile("test_world_map_ascii.pgm",
+                                      "P2\n# made by hand\n3 2\n255\n0 0 100\n255 254 255\n");
+  std::string bytes = "P5 3 2 255\n";
+  for (int value : {0, 0, 100, 255, 254, 255}) {
+    bytes.push_back(static_cast<char>(value));
+  }
+  const std::string binary = WriteFile("test_world_map_binary.pgm", bytes);
+  for (const auto &path : {ascii, binary}) {
+    const OccupancyMap map = LoadPgmMap(path, 0.1, {1.0, 2.0});
+    REQUIRE(map.Width() == 3);
+    REQUIRE(map.Height() == 2);
+    REQUIRE(map.Cells() == std::vector<uint8_t>{0, 0, 0, 1, 1, 0});
+    REQUIRE(map.Occupied({1.05, 2.15}));
+    REQUIRE_FALSE(map.Occupied({1.05, 2.05}));
+    std::remove(path.c_str());
+  }
+  WriteFile(ascii, "P6 1 1 255\n");
+  REQUIRE_THROWS_AS(LoadPgmMap(ascii, 0.1, {0.0, 0.0}), std::runtime_error);
+  WriteFile(ascii, "P2 2 2 255\n0 0 0\n");
+  REQUIRE_THROWS_AS(LoadPgmMap(ascii, 0.1, {0.0, 0.0}), std::runtime_error);
+  std::remove(ascii.c_str());
+}
+
+TEST_CASE("A scan keeps the nearest hit over several worlds", "[world_map]") {
+  // Wall at x = 1, an obstacle at x = 2 behind it, an occupied cell at x = -0.5.
+  const SegmentBvh walls(std::vector<Segment2D>{{{1.0, -5.0}, {1.0, 5.0}}});
+  const UniformGrid obstacles({2.0}, {0.0}, {0.1}, {}, 0.5);
+  const OccupancyMap map(2, 1, 0.5, {-1.0, -0.25}, {1, 0});
+  LaserSim laser(0.0, PI / 2.0, 4, 3.5);
+  std::vector<float> ranges;
+  laser.Cast(Transform2D{}, ranges, -1.0f, walls, obstacles, map);
+  REQUIRE_THAT(ranges[0], WithinAbs(1.0, 1e-6));
+  REQUIRE(ranges[1] == -1.0f);
+  REQUIRE_THAT(ranges[2], WithinAbs(0.5, 1e-6));
+  REQUIRE(ranges[3] == -1.0f);
+}
+
+} // namespace turtlelib